@@ -0,0 +1,175 @@
+#include "bench.h"
+
+#include "closure.h"
+#include "compiler.h"
+#include "environment.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr int s_statement_count{ 50'000 };
+
+std::size_t s_allocation_count{ 0 };
+
+/*!
+ * Generates a program with deep expressions so that most of the nodes are
+ * operators.
+ */
+[[nodiscard]] std::string make_expression_script()
+{
+    std::string source{ "var a = 1;\nvar b = 1;\n" };
+    for (int i = 0; i < s_statement_count; ++i) {
+        // Zero operands are avoided, they are reported as a division by zero.
+        const std::string index{ std::to_string(i % 100 + 1) };
+        source += "a = (a + " + index + " * 2 - -" + index + ") / 3;\n" +
+                  "b = (a > 1 ? a - 1 : b + " + index + ");\n";
+    }
+
+    return source;
+}
+}
+
+void* operator new(std::size_t size)
+{
+    s_allocation_count++;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc{};
+}
+
+// GCC pairs the inlined std::free() with the `new` expressions of the AST
+// nodes and reports a mismatch, but operator new is replaced too.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+int main()
+{
+    const std::string source{ make_expression_script() };
+    const auto tokens = lox::scan_tokens(source).tokens;
+    std::cout << "Source size: " << source.size() / 1024 << " KiB, "
+              << tokens.size() << " tokens\n\n";
+
+    std::size_t allocations_before{ s_allocation_count };
+    auto statements = lox::parse(tokens);
+    std::cout << "parse: " << s_allocation_count - allocations_before
+              << " allocations\n";
+
+    allocations_before = s_allocation_count;
+    auto program = lox::parse_flat(tokens);
+    std::cout << "parse_flat: " << s_allocation_count - allocations_before
+              << " allocations, " << program.size() << " nodes\n\n";
+
+    std::size_t checksum{ 0 };
+    bench::report("parse", bench::measure([&]() {
+        checksum += lox::parse(tokens).size();
+    }));
+    bench::report("parse_flat", bench::measure([&]() {
+        checksum += lox::parse_flat(tokens).size();
+    }));
+    bench::report("copy, pointer AST", bench::measure([&]() {
+        const auto copy = statements;
+        checksum += copy.size();
+    }));
+    bench::report("copy, flat AST", bench::measure([&]() {
+        const auto copy = program;
+        checksum += copy.size();
+    }));
+
+    bench::report("interpret, pointer AST", bench::measure([&]() {
+        lox::environment env{};
+        lox::resolve(statements, env);
+        for (const auto& statement : statements) {
+            lox::interpret(statement, env, lox::engine::tree_walker)
+              .and_then([&checksum](auto) { checksum++; });
+        }
+    }));
+    bench::report("compile, VM", bench::measure([&]() {
+        for (const auto& statement : statements) {
+            checksum += lox::compile(statement).has_value();
+        }
+    }));
+    // The chunks are compiled on the first run and kept in the statements,
+    // the compile above is what that first run costs on top.
+    bench::report("interpret, VM", bench::measure([&]() {
+        lox::environment env{};
+        lox::resolve(statements, env);
+        for (const auto& statement : statements) {
+            lox::interpret(statement, env, lox::engine::vm)
+              .and_then([&checksum](auto) { checksum++; });
+        }
+    }));
+    bench::report("interpret, closures", bench::measure([&]() {
+        lox::environment env{};
+        lox::resolve(statements, env);
+        for (const auto& statement : statements) {
+            lox::interpret(statement, env, lox::engine::closure)
+              .and_then([&checksum](auto) { checksum++; });
+        }
+    }));
+
+    // The slots of a fresh environment are the same on every resolve, so the
+    // closures can be compiled once and only run in the loop.
+    {
+        lox::environment env{};
+        lox::resolve(statements, env);
+    }
+    std::vector<lox::closure> closures{};
+    closures.reserve(statements.size());
+    for (const auto& statement : statements) {
+        closures.push_back(lox::compile_closure(statement));
+    }
+    bench::report("run, compiled closures", bench::measure([&]() {
+        lox::environment env{};
+        lox::resolve(statements, env);
+        for (const auto& closure : closures) {
+            closure(env);
+            checksum++;
+        }
+    }));
+
+    // The closures that lox::interpret() ran, they are kept in the statements.
+    std::size_t specializations{ 0 };
+    std::size_t deoptimizations{ 0 };
+    for (const auto& statement : statements) {
+        for (const auto& counters : lox::cached_closure(statement).counters()) {
+            specializations += counters->specializations;
+            deoptimizations += counters->deoptimizations;
+        }
+    }
+    std::cout << "closures: " << specializations << " specializations, "
+              << deoptimizations << " deoptimizations\n";
+    bench::report("interpret, flat AST", bench::measure([&]() {
+        lox::environment env{};
+        lox::resolve(program, env);
+        for (const auto statement : program.statements) {
+            lox::interpret(program, statement, env).and_then(
+              [&checksum](auto) { checksum++; });
+        }
+    }));
+
+    std::cout << "\nchecksum: " << checksum << '\n';
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef LOX_BENCH_H
+#define LOX_BENCH_H
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+
+namespace bench {
+/*!
+ * Runs `func` `iterations` times and returns the best wall time of a single
+ * run in milliseconds.
+ */
+template<typename Func>
+[[nodiscard]] double measure(Func&& func, int iterations = 5)
+{
+    double best{ 0 };
+    for (int i = 0; i < iterations; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto end = std::chrono::steady_clock::now();
+        const double elapsed =
+          std::chrono::duration<double, std::milli>(end - start).count();
+        if (i == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return best;
+}
+
+inline void report(std::string_view name, double milliseconds)
+{
+    std::cout << std::left << std::setw(48) << name << std::right
+              << std::setw(12) << std::fixed << std::setprecision(3)
+              << milliseconds << " ms\n";
+}
+}
+
+#endif
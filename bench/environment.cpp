@@ -0,0 +1,178 @@
+#include "bench.h"
+
+#include "environment.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+#include "symbols.h"
+#include "token.h"
+
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+constexpr int s_global_count{ 100'000 };
+
+std::size_t s_allocation_count{ 0 };
+
+/*!
+ * The string keyed map that the environment used before symbols, for
+ * comparison.
+ */
+struct string_hash {
+    using is_transparent = void;
+
+    [[nodiscard]] std::size_t operator()(
+      std::string_view name) const LOX_NOEXCEPT
+    {
+        return std::hash<std::string_view>{}(name);
+    }
+};
+
+using string_map =
+  std::unordered_map<std::string, lox::object, string_hash, std::equal_to<>>;
+}
+
+void* operator new(std::size_t size)
+{
+    s_allocation_count++;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+int main()
+{
+    std::vector<std::string> names{};
+    for (int i = 0; i < s_global_count; ++i) {
+        names.push_back("global_" + std::to_string(i));
+    }
+
+    // The tokens that name the variables, as the scanner makes them.
+    std::vector<lox::token> tokens{};
+    for (const std::string& name : names) {
+        tokens.push_back(lox::token{ .type = lox::token::token_type::IDENTIFIER,
+          .lexeme = name,
+          .literal = {},
+          .line = 0,
+          .column_start = 0,
+          .column_end = name.size(),
+          .line_str = name,
+          .symbol = lox::symbols().intern(name) });
+    }
+
+    std::size_t checksum{ 0 };
+    bench::report("intern, 100k names", bench::measure([&]() {
+        for (const std::string& name : names) {
+            checksum += lox::symbols().intern(name);
+        }
+    }));
+
+    bench::report("define, 100k globals by symbol", bench::measure([&]() {
+        lox::environment env{};
+        for (const lox::token& name : tokens) {
+            lox::env::define(env, name, lox::object{ 1.0 });
+        }
+
+        checksum += env.values.size();
+    }));
+    bench::report("define, 100k globals by string", bench::measure([&]() {
+        string_map map{};
+        for (const std::string& name : names) {
+            map.insert_or_assign(std::string{ name }, lox::object{ 1.0 });
+        }
+
+        checksum += map.size();
+    }));
+
+    lox::environment env{};
+    string_map map{};
+    for (const lox::token& name : tokens) {
+        lox::env::define(env, name, lox::object{ 1.0 });
+        map.insert_or_assign(std::string{ name.lexeme }, lox::object{ 1.0 });
+    }
+
+    std::size_t allocations_before{ s_allocation_count };
+    bench::report("get and assign, 100k globals by symbol",
+      bench::measure([&]() {
+          for (const lox::token& name : tokens) {
+              const lox::object value{ lox::env::get(env, name) };
+              lox::env::assign(
+                env, name, lox::object{ std::get<double>(value) + 1 });
+          }
+      }));
+    std::cout << "  " << s_allocation_count - allocations_before
+              << " allocations\n";
+
+    bench::report("get and assign, 100k globals by string",
+      bench::measure([&]() {
+          for (const std::string& name : names) {
+              const auto foundIt = map.find(std::string_view{ name });
+              foundIt->second =
+                lox::object{ std::get<double>(foundIt->second) + 1 };
+          }
+      }));
+
+    // Statements that are not resolved ahead of time look the names up
+    // through the inline caches of their nodes.
+    std::string reads{};
+    for (const std::string& name : names) {
+        reads += name + " = " + name + " + 1;\n";
+    }
+    const auto read_statements = lox::parse(lox::scan_tokens(reads).tokens);
+    bench::report("interpret unresolved, 100k assignments",
+      bench::measure([&]() {
+          for (const auto& statement : read_statements) {
+              lox::interpret(statement, env, lox::engine::tree_walker)
+                .and_then([&checksum](auto) { checksum++; });
+          }
+      }));
+    const lox::inline_cache_stats stats{ lox::cache_stats(read_statements) };
+    std::cout << "  " << stats.hits << " cache hits, " << stats.misses
+              << " misses\n";
+
+    // Every line is scanned, parsed, resolved and run on its own, the way the
+    // REPL runs them.
+    std::vector<std::string> lines{};
+    for (const std::string& name : names) {
+        lines.push_back("var " + name + " = 1;");
+    }
+    for (const std::string& name : names) {
+        lines.push_back(name + " = " + name + " + 1;");
+    }
+    for (const std::string& name : names) {
+        lines.push_back("var " + name + " = " + name + " * 2;");
+    }
+
+    bench::report("REPL, 300k lines", bench::measure([&]() {
+        lox::environment repl_env{};
+        for (const std::string& line : lines) {
+            auto statements = lox::parse(lox::scan_tokens(line).tokens);
+            lox::resolve(statements, repl_env);
+            for (const auto& statement : statements) {
+                lox::interpret(statement, repl_env)
+                  .and_then([&checksum](auto) { checksum++; });
+            }
+        }
+    }, 3));
+
+    std::cout << "\nchecksum: " << checksum << '\n';
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "bench.h"
+
+#include "parser.h"
+#include "scanner.h"
+
+#include <string>
+
+namespace {
+constexpr int s_statement_count{ 100'000 };
+
+/*!
+ * Generates a source where every statement is a long expression that uses
+ * all the operator levels.
+ */
+[[nodiscard]] std::string make_expression_script()
+{
+    std::string source{};
+    for (int i = 0; i < s_statement_count; ++i) {
+        const std::string index{ std::to_string(i % 100 + 1) };
+        source += "var v" + index + " = (a + " + index + " * b - c / " +
+                  index + ") >= -d == !(e < " + index + ") != f;\n" +
+                  "print g ? h + 1 : (i <= " + index + " ? j : k * 2);\n";
+    }
+
+    return source;
+}
+
+/*!
+ * Literals and identifiers with few operators, most of the time is spent
+ * getting to the primary expressions.
+ */
+[[nodiscard]] std::string make_literal_script()
+{
+    std::string source{};
+    for (int i = 0; i < s_statement_count; ++i) {
+        source += "print " + std::to_string(i) + ";\nprint \"text\";\nname;\n";
+    }
+
+    return source;
+}
+
+void run(std::string_view name, const std::string& source)
+{
+    const auto tokens = lox::scan_tokens(source).tokens;
+    std::cout << name << ": " << source.size() / 1024 << " KiB, "
+              << tokens.size() << " tokens\n";
+
+    std::size_t checksum{ 0 };
+    const double tree_ms = bench::measure([&]() {
+        checksum += lox::parse(tokens).size();
+    });
+    const double flat_ms = bench::measure([&]() {
+        checksum += lox::parse_flat(tokens).size();
+    });
+    const lox::parse_options hash_consed{ .is_hash_consed = true };
+    const double shared_ms = bench::measure([&]() {
+        checksum += lox::parse_flat(tokens, hash_consed).size();
+    });
+    const lox::parse_options parallel{ .is_parallel = true };
+    const double parallel_ms = bench::measure([&]() {
+        checksum += lox::parse_flat(tokens, parallel).size();
+    });
+
+    const auto program = lox::parse_flat(tokens);
+    const auto shared = lox::parse_flat(tokens, hash_consed);
+    const lox::sharing_report report{ lox::report_sharing(shared) };
+
+    bench::report("parse", tree_ms);
+    bench::report("parse_flat", flat_ms);
+    bench::report("parse_flat, hash consed", shared_ms);
+    bench::report("parse_flat, parallel", parallel_ms);
+    std::cout << "parse_flat: "
+              << static_cast<double>(tokens.size()) / flat_ms / 1000
+              << " M tokens/s\n"
+              << "hash consed: " << program.size() << " -> " << shared.size()
+              << " nodes, deduplication ratio " << report.ratio() << '\n'
+              << "checksum: " << checksum << "\n\n";
+}
+}
+
+int main()
+{
+    run("Expressions", make_expression_script());
+    run("Literals", make_literal_script());
+    return 0;
+}
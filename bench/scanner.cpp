@@ -0,0 +1,139 @@
+#include "bench.h"
+
+#include "scanner.h"
+#include "simd.h"
+
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+
+namespace {
+constexpr int s_entry_count{ 100'000 };
+
+std::size_t s_allocation_count{ 0 };
+
+/*!
+ * Generates a source that looks like our generated configuration files: long
+ * identifiers, indentation, string values and comments.
+ */
+[[nodiscard]] std::string make_config_script()
+{
+    std::string source{};
+    for (int i = 0; i < s_entry_count; ++i) {
+        const std::string index{ std::to_string(i) };
+        source += "// Generated entry number " + index +
+                  ", do not edit by hand.\n"
+                  "var configuration_entry_identifier_" +
+                  index + " = \"value of the configuration entry " + index +
+                  "\";\n"
+                  "/* The weight of the entry\n   is derived from its "
+                  "index. */\n"
+                  "        var configuration_entry_weight_" +
+                  index + " = " + index + " * 2;\n";
+    }
+
+    return source;
+}
+
+/*!
+ * The same kind of source but minified into a single line.
+ */
+[[nodiscard]] std::string make_minified_script()
+{
+    std::string source{};
+    for (int i = 0; i < s_entry_count; ++i) {
+        const std::string index{ std::to_string(i) };
+        source += "var e" + index + "=\"v" + index + "\";var w" + index + "=" +
+                  index + "*2;";
+    }
+
+    return source;
+}
+
+/*!
+ * A table of numbers and strings where most of the literals repeat.
+ */
+[[nodiscard]] std::string make_data_table_script()
+{
+    std::string source{};
+    for (int i = 0; i < s_entry_count; ++i) {
+        source += "print " + std::to_string(i % 1000) + " * 0.25 + " +
+                  std::to_string(i % 37) + ".5 ? \"row\" : \"column\";\n";
+    }
+
+    return source;
+}
+}
+
+void* operator new(std::size_t size)
+{
+    s_allocation_count++;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+int main()
+{
+    const std::string source{ make_config_script() };
+    std::cout << "Source size: " << source.size() / 1024 << " KiB\n\n";
+
+    const std::map<lox::simd::level, std::string_view> names{
+        { lox::simd::level::SCALAR, "scan_tokens, scalar" },
+        { lox::simd::level::SSE2, "scan_tokens, SSE2" },
+        { lox::simd::level::AVX2, "scan_tokens, AVX2" },
+    };
+
+    std::size_t checksum{ 0 };
+    for (const auto& [level, name] : names) {
+        if (lox::simd::set_level(level) != level) {
+            std::cout << name << " is not supported.\n";
+            continue;
+        }
+
+        bench::report(name, bench::measure([&]() {
+            checksum += lox::scan_tokens(source).tokens.size();
+        }));
+    }
+
+    lox::simd::set_level(lox::simd::supported_level());
+    const lox::scan_options parallel{ .is_parallel = true };
+    bench::report("scan_tokens, parallel", bench::measure([&]() {
+        checksum += lox::scan_tokens(source, parallel).tokens.size();
+    }));
+
+    const std::string minified{ make_minified_script() };
+    std::cout << "\nMinified source size: " << minified.size() / 1024
+              << " KiB on a single line\n\n";
+    lox::simd::set_level(lox::simd::supported_level());
+    bench::report("scan_tokens, minified", bench::measure([&]() {
+        checksum += lox::scan_tokens(minified).tokens.size();
+    }));
+
+    const std::string data_table{ make_data_table_script() };
+    const std::size_t allocations_before{ s_allocation_count };
+    const auto result = lox::scan_tokens(data_table);
+    std::cout << "\nData table: " << result.tokens.size() << " tokens, "
+              << result.tokens.info->literals.size() << " distinct literals, "
+              << s_allocation_count - allocations_before
+              << " allocations\n";
+    bench::report("scan_tokens, data table", bench::measure([&]() {
+        checksum += lox::scan_tokens(data_table).tokens.size();
+    }));
+
+    std::cout << "\nchecksum: " << checksum << '\n';
+    return 0;
+}
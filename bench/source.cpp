@@ -0,0 +1,151 @@
+#include "bench.h"
+
+#include "scanner.h"
+#include "token.h"
+#include "source.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if __has_include(<sys/resource.h>)
+#include <sys/resource.h>
+#define LOX_BENCH_RSS
+#endif
+
+namespace {
+constexpr std::size_t s_source_size{ 100 * 1024 * 1024 };
+
+/*!
+ * Returns the peak resident set size of the process so far in MiB.
+ */
+[[nodiscard]] long peak_rss()
+{
+#ifdef LOX_BENCH_RSS
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024 / 1024;
+#else
+    return usage.ru_maxrss / 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+[[nodiscard]] std::filesystem::path write_source()
+{
+    const auto path =
+      std::filesystem::temp_directory_path() / "lox_bench_source.lox";
+    std::ofstream writer{ path, std::ofstream::binary };
+    std::size_t size{ 0 };
+    for (int i = 0; size < s_source_size; ++i) {
+        const std::string line{ "var value_" + std::to_string(i) + " = " +
+                                std::to_string(i) + " * 2 + 1;\n" };
+        writer << line;
+        size += line.size();
+    }
+
+    return path;
+}
+
+template<typename Load>
+void run(std::string_view name, const std::filesystem::path& path, Load load)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto holder = load(path);
+    const std::string_view text{ holder.text() };
+    const auto loaded = std::chrono::steady_clock::now();
+    const long loaded_rss{ peak_rss() };
+    const auto result = lox::scan_tokens(text);
+    const auto scanned = std::chrono::steady_clock::now();
+
+    std::cout << name << '\n';
+    bench::report("  load (time to first token)",
+      std::chrono::duration<double, std::milli>(loaded - start).count());
+    bench::report("  load and scan",
+      std::chrono::duration<double, std::milli>(scanned - start).count());
+    std::cout << "  peak RSS after load: " << loaded_rss
+              << " MiB, after scan: " << peak_rss() << " MiB ("
+              << result.tokens.size() << " tokens)\n";
+}
+/*!
+ * The way lox_cli used to read files.
+ */
+struct stream_source {
+    std::string content;
+
+    [[nodiscard]] std::string_view text() const
+    {
+        return content;
+    }
+};
+}
+
+int main(int argc, char** argv)
+{
+    // Peak RSS is per process, so each approach runs in its own process.
+    const std::string_view mode{ argc > 2 ? argv[1] : "" };
+    if (mode == "mapped") {
+        run("lox::source_file", argv[2], [](const std::filesystem::path& file) {
+            return std::move(lox::source_file::open(file.string()).value());
+        });
+        return 0;
+    }
+
+    if (mode == "token_stream") {
+        const auto start = std::chrono::steady_clock::now();
+        const auto source = lox::source_file::open(argv[2]).value();
+        lox::token_stream tokens{ source.text() };
+        const lox::compact_token first{ tokens.peek() };
+        const auto first_token = std::chrono::steady_clock::now();
+        std::size_t count{ 0 };
+        while (!tokens.at_end()) {
+            tokens.advance();
+            count++;
+        }
+        const auto scanned = std::chrono::steady_clock::now();
+
+        std::cout << "lox::source_file + lox::token_stream\n";
+        bench::report("  time to first token",
+          std::chrono::duration<double, std::milli>(first_token - start)
+            .count());
+        bench::report("  load and scan",
+          std::chrono::duration<double, std::milli>(scanned - start).count());
+        std::cout << "  peak RSS after scan: " << peak_rss() << " MiB (" << count
+                  << " tokens, first at " << first.offset << ")\n";
+        return 0;
+    }
+
+    if (mode == "stream") {
+        run("ifstream + stringstream",
+          argv[2],
+          [](const std::filesystem::path& file) {
+              const std::ifstream reader{ file, std::ifstream::in };
+              std::stringstream stream;
+              stream << reader.rdbuf();
+              return stream_source{ stream.str() };
+          });
+        return 0;
+    }
+
+    const auto path = write_source();
+    std::cout << "Source size: "
+              << std::filesystem::file_size(path) / 1024 / 1024 << " MiB\n\n";
+    for (const std::string_view child_mode :
+      { "stream", "mapped", "token_stream" }) {
+        const std::string command{ std::string{ argv[0] } + " " +
+                                   std::string{ child_mode } + " " +
+                                   path.string() };
+        std::cout.flush();
+        if (std::system(command.c_str()) != 0) {
+            std::cerr << "Failed to run '" << command << "'.\n";
+        }
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "bench.h"
+
+#include "environment.h"
+#include "heap_string.h"
+#include "interpreter.h"
+#include "number_format.h"
+#include "operations.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr int s_append_count{ 1'000'000 };
+// Copying the whole string on every append is quadratic, so it is measured
+// with fewer appends.
+constexpr int s_copying_append_count{ 50'000 };
+constexpr int s_statement_count{ 100'000 };
+
+/*!
+ * Generates a program that builds a string one short piece at a time.
+ */
+[[nodiscard]] std::string make_append_script()
+{
+    std::string source{ "var s = \"\";\n" };
+    for (int i = 0; i < s_statement_count; ++i) {
+        source += i % 2 == 0 ? "s = s + \"ab\";\n" : "s = s + 1;\n";
+    }
+
+    return source + "s == s;\n";
+}
+}
+
+int main()
+{
+    std::size_t checksum{ 0 };
+    const lox::object piece{ lox::heap_string{ "ab" } };
+
+    bench::report("append 1M, ropes", bench::measure([&]() {
+        lox::object str{ lox::heap_string{} };
+        for (int i = 0; i < s_append_count; ++i) {
+            str = lox::ops::concatenate(str, piece);
+        }
+
+        // Flattens the rope.
+        checksum += std::get<lox::heap_string>(str).view().size();
+    }));
+    bench::report("append 50k, copying", bench::measure([&]() {
+        lox::heap_string str{};
+        const lox::heap_string& text = std::get<lox::heap_string>(piece);
+        for (int i = 0; i < s_copying_append_count; ++i) {
+            str = lox::heap_string{ str.view(), text.view() };
+        }
+
+        checksum += str.size();
+    }));
+    bench::report("append 50k, ropes", bench::measure([&]() {
+        lox::object str{ lox::heap_string{} };
+        for (int i = 0; i < s_copying_append_count; ++i) {
+            str = lox::ops::concatenate(str, piece);
+        }
+
+        checksum += std::get<lox::heap_string>(str).view().size();
+    }));
+
+    bench::report("format 1M numbers, stringstream", bench::measure([&]() {
+        for (int i = 0; i < s_append_count; ++i) {
+            std::stringstream ss;
+            ss << i * 0.37;
+            checksum += ss.str().size();
+        }
+    }));
+    bench::report("format 1M numbers, format_number", bench::measure([&]() {
+        lox::number_buffer buffer{};
+        for (int i = 0; i < s_append_count; ++i) {
+            checksum += lox::format_number(i * 0.37, buffer).size();
+        }
+    }));
+    const lox::object label{ lox::heap_string{ "total: " } };
+    bench::report("concatenate 1M numbers", bench::measure([&]() {
+        for (int i = 0; i < s_append_count; ++i) {
+            checksum += std::get<lox::heap_string>(
+              lox::ops::concatenate(label, lox::object{ i * 0.37 }))
+                          .size();
+        }
+    }));
+
+    const std::string source{ make_append_script() };
+    auto statements = lox::parse(lox::scan_tokens(source).tokens);
+    for (const auto engine : { lox::engine::tree_walker, lox::engine::closure }) {
+        const bool is_tree_walker{ engine == lox::engine::tree_walker };
+        bench::report(is_tree_walker ? "interpret 100k appends, tree walker"
+                                     : "interpret 100k appends, closures",
+          bench::measure([&]() {
+              lox::environment env{};
+              lox::resolve(statements, env);
+              for (const auto& statement : statements) {
+                  lox::interpret(statement, env, engine)
+                    .and_then([&checksum](auto) { checksum++; });
+              }
+          }));
+    }
+
+    std::cout << "\nchecksum: " << checksum << '\n';
+    return 0;
+}
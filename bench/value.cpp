@@ -0,0 +1,113 @@
+#include "bench.h"
+
+#include "compiler.h"
+#include "environment.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+#include "value.h"
+#include "vm.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+constexpr std::size_t s_value_count{ 1'000'000 };
+constexpr int s_statement_count{ 20'000 };
+
+/*!
+ * Runs the same reduction over a stack of boxed values that the VM does for
+ * `a * b + c - d`, once with lox::object and once with lox::value.
+ */
+template<typename T, typename Get, typename Make>
+[[nodiscard]] double reduce(const std::vector<T>& values, Get get, Make make)
+{
+    T acc = make(0.0);
+    for (std::size_t i = 0; i + 3 < values.size(); i += 4) {
+        const T product = make(get(values[i]) * get(values[i + 1]));
+        const T sum = make(get(product) + get(values[i + 2]));
+        acc = make(get(acc) + get(sum) - get(values[i + 3]));
+    }
+
+    return get(acc);
+}
+
+[[nodiscard]] std::string make_arithmetic_script()
+{
+    std::string source{ "var a = 1.5; var b = 2.25; var c = 3;" };
+    for (int i = 0; i < s_statement_count; ++i) {
+        source += "a = (a * b + c - 4) / (b + 1) + " + std::to_string(i % 7) +
+                  " * c - b / 2;\n";
+    }
+
+    return source;
+}
+}
+
+int main()
+{
+    std::cout << "sizeof(lox::object): " << sizeof(lox::object) << " bytes\n"
+              << "sizeof(lox::value):  " << sizeof(lox::value) << " bytes\n"
+              << "Stack of " << s_value_count << " values: "
+              << s_value_count * sizeof(lox::object) / 1024 << " KiB vs "
+              << s_value_count * sizeof(lox::value) / 1024 << " KiB\n\n";
+
+    std::vector<lox::object> objects{};
+    std::vector<lox::value> values{};
+    objects.reserve(s_value_count);
+    values.reserve(s_value_count);
+    for (std::size_t i = 0; i < s_value_count; ++i) {
+        const double number = static_cast<double>(i % 97) / 7.0 + 1.0;
+        objects.emplace_back(number);
+        values.emplace_back(number);
+    }
+
+    double checksum{ 0 };
+    bench::report("reduce lox::object", bench::measure([&]() {
+        checksum += reduce(
+          objects,
+          [](const lox::object& obj) { return std::get<double>(obj); },
+          [](double number) { return lox::object{ number }; });
+    }));
+    bench::report("reduce lox::value", bench::measure([&]() {
+        checksum += reduce(
+          values,
+          [](lox::value val) { return val.as_number(); },
+          [](double number) { return lox::value{ number }; });
+    }));
+
+    const std::string source{ make_arithmetic_script() };
+    auto statements = lox::parse(lox::scan_tokens(source).tokens);
+    lox::environment resolved{};
+    lox::resolve(statements, resolved);
+
+    // Compilation is kept out of the measurement so that only evaluation on
+    // lox::object (tree walker) and lox::value (VM) is compared.
+    std::vector<lox::chunk> chunks{};
+    chunks.reserve(statements.size());
+    for (const auto& statement : statements) {
+        chunks.push_back(*lox::compile(statement));
+    }
+
+    bench::report("arithmetic script, tree walker (lox::object)",
+      bench::measure([&]() {
+          lox::environment env{ resolved };
+          for (const auto& statement : statements) {
+              lox::interpret(statement, env, lox::engine::tree_walker)
+                .and_then([&](lox::object result) {
+                    checksum += std::get<double>(result);
+                })
+                .or_else([](lox::runtime_error) {});
+          }
+      }));
+    bench::report("arithmetic script, VM (lox::value)", bench::measure([&]() {
+        lox::environment env{ resolved };
+        for (const auto& chk : chunks) {
+            checksum += std::get<double>(lox::execute(chk, env));
+        }
+    }));
+
+    std::cout << "\nchecksum: " << checksum << '\n';
+    return 0;
+}
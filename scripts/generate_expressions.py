@@ -16,22 +16,59 @@ EXPRESSIONS = {
     "grouping": ["copyable<expr*> expression"],
     "literal": ["object value"],
     "unary": ["token oprtor", "copyable<expr*> right"],
-    "variable": ["token name"],
-    "assignment": ["token name", "copyable<expr*> value"],
+    "variable": [
+        "token name",
+        "slot_index slot{unresolved_slot}",
+        "mutable inline_cache cache{}",
+    ],
+    "assignment": [
+        "token name",
+        "copyable<expr*> value",
+        "slot_index slot{unresolved_slot}",
+        "mutable inline_cache cache{}",
+    ],
 }
 
 
 STATEMENTS = {
-    "expr_stmt": ["copyable<expr*> expression"],
-    "print_stmt": ["copyable<expr*> expression"],
-    "var_stmt": ["token name", "copyable<expr*> expression"],
+    "expr_stmt": [
+        "copyable<expr*> expression",
+        "mutable closure_cache compiled{}",
+        "mutable chunk_cache bytecode{}",
+    ],
+    "print_stmt": [
+        "copyable<expr*> expression",
+        "mutable closure_cache compiled{}",
+        "mutable chunk_cache bytecode{}",
+    ],
+    "var_stmt": [
+        "token name",
+        "copyable<expr*> expression",
+        "slot_index slot{unresolved_slot}",
+        "mutable closure_cache compiled{}",
+        "mutable chunk_cache bytecode{}",
+    ],
 }
 
 
+def _is_runtime_state(typ: str) -> bool:
+    # State that the engines keep on the pointer based nodes while they run.
+    # It is not part of the flat nodes and not visited by for_each_field.
+    return typ.startswith("mutable ")
+
+
+def _fields(fields: List[str]) -> List[str]:
+    return [typ for typ in fields if not _is_runtime_state(typ)]
+
+
 def _create_structs(container: list):
     for key in container:
         content = [f"struct {key}" "{"]
         for typ in container[key]:
+            if _is_runtime_state(typ):
+                content.append(f"{typ};")
+                continue
+
             cmps: List[str] = typ.split(" ")
             content.append(f"{cmps[0]} {cmps[1]};")
 
@@ -40,6 +77,354 @@ def _create_structs(container: list):
         yield content
 
 
+def _flat_field(typ: str) -> str:
+    cmps: List[str] = typ.split(" ")
+    # Children are indices into the node array of the program.
+    if cmps[0] == "copyable<expr*>":
+        return f"node_index {cmps[1]};"
+
+    return f"{cmps[0]} {cmps[1]};"
+
+
+def _field_name(typ: str) -> str:
+    return typ.split(" ")[1].split("{")[0]
+
+
+def _layout_hash(nodes: dict) -> int:
+    # 64-bit FNV-1a of the flat fields of every node in order.
+    layout: str = ";".join(
+        key + ":" + ",".join(_flat_field(typ) for typ in _fields(fields))
+        for key, fields in nodes.items()
+    )
+    value: int = 0xCBF29CE484222325
+    for byte in layout.encode():
+        value = ((value ^ byte) * 0x100000001B3) % (1 << 64)
+
+    return value
+
+
+def _for_each_field(nodes: dict) -> List[str]:
+    outputs: List[str] = []
+    for key, fields in nodes.items():
+        for const in ["const ", ""]:
+            outputs.extend(
+                [
+                    "template<typename Func>",
+                    f"void for_each_field({const}{key}& node, Func&& func)"
+                    " LOX_NOEXCEPT {",
+                ]
+            )
+            outputs.extend(
+                f"func(node.{_field_name(typ)});" for typ in _fields(fields)
+            )
+            outputs.extend(["}", ""])
+
+    return outputs
+
+
+def _for_each_child(nodes: dict) -> List[str]:
+    outputs: List[str] = []
+    for key, fields in nodes.items():
+        children = [
+            _field_name(typ) for typ in fields if typ.startswith("copyable<expr*>")
+        ]
+        outputs.extend(
+            [
+                "template<typename Func>",
+                f"void for_each_child({key}& {'node' if children else '/* node */'},"
+                f" Func&& {'func' if children else '/* func */'}) LOX_NOEXCEPT {{",
+            ]
+        )
+        outputs.extend(f"func(node.{child});" for child in children)
+        outputs.extend(["}", ""])
+
+    return outputs
+
+
+def _generate_flat() -> List[str]:
+    nodes = {**EXPRESSIONS, **STATEMENTS}
+    outputs: List[str] = [
+        "/*!",
+        " * The same nodes stored in flat arrays. Every node of a program is an",
+        " * entry in one node array and refers to its children with 32-bit",
+        " * indices, the fields of each kind are stored in a separate payload",
+        " * array. A program is copied or discarded as a whole.",
+        " */",
+        "namespace flat {",
+        "using node_index = std::uint32_t;",
+        "",
+        "constexpr node_index no_node{ std::numeric_limits<node_index>::max() };",
+        "",
+        "enum class node_kind : std::uint8_t {",
+    ]
+    outputs.extend(f"{key.upper()}," for key in nodes)
+    outputs.extend(["};", ""])
+
+    for key, fields in nodes.items():
+        outputs.append(f"struct {key}" "{")
+        outputs.extend(_flat_field(typ) for typ in _fields(fields))
+        outputs.extend(["};", ""])
+
+    # Generic access to the fields so that code like the serializer follows
+    # changes to the nodes.
+    outputs.extend(_for_each_field(nodes))
+    # The children of a node by reference, including the missing ones, so
+    # that they can be moved to other indices.
+    outputs.extend(_for_each_child(nodes))
+
+    outputs.extend(
+        [
+            "/*!",
+            " * Changes whenever the nodes or their fields change, stored",
+            " * programs use it to detect that they are out of date.",
+            " */",
+            f"constexpr std::uint64_t layout_hash{{ {_layout_hash(nodes):#018x} }};",
+            "",
+        ]
+    )
+
+    # Maps the pointer based nodes to the flat ones so that visitors can be
+    # shared between the two.
+    outputs.extend(
+        [
+            "template<typename T> struct flat_node { using type = void; };",
+            "",
+        ]
+    )
+    for key in nodes:
+        outputs.append(
+            f"template<> struct flat_node<lox::{key}> {{ using type = {key}; }};"
+        )
+
+    outputs.extend(
+        [
+            "",
+            "/*!",
+            " * True if T is `Node` or its flat counterpart.",
+            " */",
+            "template<typename T, typename Node>",
+            "constexpr bool is_node_v = std::is_same_v<T, Node> ||",
+            "  std::is_same_v<T, typename flat_node<Node>::type>;",
+            "",
+            "/*!",
+            " * All the nodes of a program. The arrays are allocated from the",
+            " * memory resource that is given on construction, adding nodes",
+            " * throws std::bad_alloc if it runs out.",
+            " */",
+            "class program {",
+            "public:",
+            "struct node {",
+            "node_kind kind;",
+            "// Index into the payload array of the kind.",
+            "std::uint32_t payload;",
+            "};",
+            "",
+            "public:",
+            "explicit program(std::pmr::memory_resource* resource =",
+            " std::pmr::get_default_resource()) LOX_NOEXCEPT",
+            ": statements{ resource }",
+            ", m_nodes{ resource }",
+        ]
+    )
+    outputs.extend(f", m_{key}_payloads{{ resource }}" for key in nodes)
+    outputs.extend(["{", "}", ""])
+
+    for key in nodes:
+        outputs.extend(
+            [
+                f"[[nodiscard]] node_index add({key} value) {{",
+                f"return add_node(node_kind::{key.upper()}, m_{key}_payloads,"
+                " std::move(value));",
+                "}",
+                "",
+            ]
+        )
+
+    for key in nodes:
+        for const in ["const ", ""]:
+            outputs.extend(
+                [
+                    f"[[nodiscard]] {const}{key}& get_{key}(node_index index)"
+                    f" {const}LOX_NOEXCEPT {{",
+                    f"assert(kind(index) == node_kind::{key.upper()});",
+                    f"return m_{key}_payloads[m_nodes[index].payload];",
+                    "}",
+                    "",
+                ]
+            )
+
+    keys: List[str] = list(nodes)
+    for const in ["const ", ""]:
+        outputs.extend(
+            [
+                "/*!",
+                " * Calls `func` with the payload of the node. Exceptions thrown",
+                " * by `func` are propagated.",
+                " */",
+                "template<typename Func>",
+                f"decltype(auto) visit(node_index index, Func&& func) {const}"
+                "{",
+                "const node& current = m_nodes[index];",
+                "switch (current.kind) {",
+            ]
+        )
+        for key in keys[:-1]:
+            outputs.append(
+                f"case node_kind::{key.upper()}:"
+                f" return func(m_{key}_payloads[current.payload]);"
+            )
+        outputs.extend(
+            [
+                f"case node_kind::{keys[-1].upper()}:",
+                "break;",
+                "}",
+                "",
+                f"assert(current.kind == node_kind::{keys[-1].upper()});",
+                f"return func(m_{keys[-1]}_payloads[current.payload]);",
+                "}",
+                "",
+            ]
+        )
+
+    outputs.extend(
+        [
+            "/*!",
+            " * Calls `func` with the index of every child of the node in the",
+            " * order of the fields, missing children are skipped.",
+            " */",
+            "template<typename Func>",
+            "void for_each_child(node_index index, Func&& func) const"
+            " LOX_NOEXCEPT {",
+            "const node& current = m_nodes[index];",
+            "switch (current.kind) {",
+        ]
+    )
+    for key, fields in nodes.items():
+        children = [
+            typ.split(" ")[1] for typ in fields if typ.startswith("copyable<expr*>")
+        ]
+        outputs.append(f"case node_kind::{key.upper()}: {{")
+        if children:
+            outputs.append(
+                f"const {key}& payload ="
+                f" m_{key}_payloads[current.payload];"
+            )
+        for child in children:
+            outputs.extend(
+                [
+                    f"if (payload.{child} != no_node) {{",
+                    f"func(payload.{child});",
+                    "}",
+                ]
+            )
+        outputs.extend(["return;", "}"])
+    outputs.extend(["}", "}", ""])
+
+    outputs.extend(
+        [
+            "/*!",
+            " * Moves the nodes and the statements of `other` to the end of the",
+            " * program, the indices of its nodes are shifted by the number of",
+            " * nodes the program had before.",
+            " */",
+            "void append(program&& other) {",
+            "const auto offset = static_cast<node_index>(m_nodes.size());",
+            "const auto shift = [offset](node_index& child) {",
+            "if (child != no_node) {",
+            "child += offset;",
+            "}",
+            "};",
+            "",
+            "const std::array payload_offsets{",
+        ]
+    )
+    outputs.extend(
+        f"static_cast<std::uint32_t>(m_{key}_payloads.size())," for key in nodes
+    )
+    outputs.extend(
+        [
+            "};",
+            "m_nodes.reserve(m_nodes.size() + other.m_nodes.size());",
+            "for (node current : other.m_nodes) {",
+            "current.payload +="
+            " payload_offsets[static_cast<std::size_t>(current.kind)];",
+            "m_nodes.push_back(current);",
+            "}",
+            "",
+        ]
+    )
+    for key, fields in nodes.items():
+        if any(typ.startswith("copyable<expr*>") for typ in fields):
+            outputs.extend(
+                [
+                    f"for ({key}& payload : other.m_{key}_payloads) {{",
+                    "flat::for_each_child(payload, shift);",
+                    "}",
+                ]
+            )
+        outputs.extend(
+            [
+                f"m_{key}_payloads.insert(m_{key}_payloads.end(),",
+                f"std::make_move_iterator(other.m_{key}_payloads.begin()),",
+                f"std::make_move_iterator(other.m_{key}_payloads.end()));",
+            ]
+        )
+    outputs.extend(
+        [
+            "",
+            "for (const node_index statement : other.statements) {",
+            "statements.push_back(statement + offset);",
+            "}",
+            "",
+            "other.clear();",
+            "}",
+            "",
+            "[[nodiscard]] node_kind kind(node_index index) const LOX_NOEXCEPT {",
+            "assert(index < m_nodes.size());",
+            "return m_nodes[index].kind;",
+            "}",
+            "",
+            "/*!",
+            " * Returns the number of nodes.",
+            " */",
+            "[[nodiscard]] std::size_t size() const LOX_NOEXCEPT {",
+            "return m_nodes.size();",
+            "}",
+            "",
+            "void clear() LOX_NOEXCEPT {",
+            "statements.clear();",
+            "m_nodes.clear();",
+        ]
+    )
+    outputs.extend(f"m_{key}_payloads.clear();" for key in nodes)
+    outputs.extend(
+        [
+            "}",
+            "",
+            "public:",
+            "// The top level statements in source order.",
+            "std::pmr::vector<node_index> statements;",
+            "",
+            "private:",
+            "template<typename T>",
+            "node_index add_node(node_kind new_kind, std::pmr::vector<T>& payloads,"
+            " T&& value) {",
+            "assert(m_nodes.size() < no_node);",
+            "m_nodes.push_back(node{ new_kind,"
+            " static_cast<std::uint32_t>(payloads.size()) });",
+            "payloads.push_back(std::move(value));",
+            "return static_cast<node_index>(m_nodes.size() - 1);",
+            "}",
+            "",
+            "private:",
+            "std::pmr::vector<node> m_nodes;",
+        ]
+    )
+    outputs.extend(f"std::pmr::vector<{key}> m_{key}_payloads;" for key in nodes)
+    outputs.extend(["};", "}"])
+    return outputs
+
+
 def generate() -> List[str]:
     outputs: List[str] = [
         "// Auto generated. DO NOT EDIT!",
@@ -49,6 +434,16 @@ def generate() -> List[str]:
         '#include "defs.h"',
         '#include "token.h"',
         "",
+        "#include <array>",
+        "#include <cassert>",
+        "#include <cstdint>",
+        "#include <limits>",
+        "#include <memory_resource>",
+        "#include <iterator>",
+        "#include <type_traits>",
+        "#include <utility>",
+        "#include <vector>",
+        "",
         "namespace lox {",
         "struct expr;",
     ]
@@ -61,6 +456,8 @@ def generate() -> List[str]:
     for struct in _create_structs(STATEMENTS):
         outputs.extend(struct)
 
+    outputs.extend(_for_each_field({**EXPRESSIONS, **STATEMENTS}))
+
     # Expressions
     types: List[str] = list(EXPRESSIONS)
     outputs.append(
@@ -75,6 +472,9 @@ def generate() -> List[str]:
         "struct stmt : public std::variant<std::monostate," + ",".join(types) + "> {"
     )
     outputs.append("using variant::variant;};")
+    outputs.append("")
+
+    outputs.extend(_generate_flat())
 
     outputs.append("}")
     outputs.append("")
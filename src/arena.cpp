@@ -0,0 +1,87 @@
+#include "arena.h"
+
+#include <new>
+
+lox::arena_resource::counting_resource::counting_resource(
+  std::pmr::memory_resource* upstream) LOX_NOEXCEPT : m_upstream{ upstream }
+{
+}
+
+std::size_t lox::arena_resource::counting_resource::in_use() const LOX_NOEXCEPT
+{
+    return m_in_use;
+}
+
+void* lox::arena_resource::counting_resource::do_allocate(std::size_t bytes,
+  std::size_t alignment)
+{
+    void* pointer{ m_upstream->allocate(bytes, alignment) };
+    m_in_use += bytes;
+    return pointer;
+}
+
+void lox::arena_resource::counting_resource::do_deallocate(void* pointer,
+  std::size_t bytes,
+  std::size_t alignment)
+{
+    m_upstream->deallocate(pointer, bytes, alignment);
+    m_in_use -= bytes;
+}
+
+bool lox::arena_resource::counting_resource::do_is_equal(
+  const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+lox::arena_resource::arena_resource(std::size_t limit,
+  std::pmr::memory_resource* upstream) LOX_NOEXCEPT
+  : m_limit{ limit }
+  , m_upstream{ upstream }
+  , m_buffer{ &m_upstream }
+{
+}
+
+std::size_t lox::arena_resource::allocated() const LOX_NOEXCEPT
+{
+    return m_allocated;
+}
+
+std::size_t lox::arena_resource::reserved() const LOX_NOEXCEPT
+{
+    return m_upstream.in_use();
+}
+
+std::size_t lox::arena_resource::limit() const LOX_NOEXCEPT
+{
+    return m_limit;
+}
+
+void lox::arena_resource::release() LOX_NOEXCEPT
+{
+    m_buffer.release();
+    m_allocated = 0;
+}
+
+void* lox::arena_resource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    if (bytes > m_limit - m_allocated) {
+        throw std::bad_alloc{};
+    }
+
+    void* pointer{ m_buffer.allocate(bytes, alignment) };
+    m_allocated += bytes;
+    return pointer;
+}
+
+void lox::arena_resource::do_deallocate(void* /* pointer */,
+  std::size_t /* bytes */,
+  std::size_t /* alignment */)
+{
+}
+
+bool lox::arena_resource::do_is_equal(
+  const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,102 @@
+#ifndef LOX_ARENA_H
+#define LOX_ARENA_H
+
+#include "defs.h"
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+
+namespace lox {
+
+/*!
+ * A monotonic memory resource for everything that is allocated during one run
+ * of a script. Deallocation is a no-op, the memory is given back all at once
+ * by release() or the destructor.
+ *
+ * The resource counts the bytes it hands out and can be capped, an allocation
+ * that would go over the limit throws std::bad_alloc as if the memory had run
+ * out. The scanner, the parsers, the resolver and the interpreters let the
+ * exception through, so the caller can fail the run instead of the program.
+ * @note Not thread-safe.
+ */
+class arena_resource final : public std::pmr::memory_resource {
+public:
+    static constexpr std::size_t no_limit{
+        std::numeric_limits<std::size_t>::max()
+    };
+
+public:
+    /*!
+     * @param limit The maximum number of bytes that can be allocated until the
+     * next release().
+     * @param upstream Where the blocks of the arena come from.
+     */
+    explicit arena_resource(std::size_t limit = no_limit,
+      std::pmr::memory_resource* upstream =
+        std::pmr::get_default_resource()) LOX_NOEXCEPT;
+
+    arena_resource(const arena_resource&) = delete;
+    arena_resource& operator=(const arena_resource&) = delete;
+
+    /*!
+     * Returns the number of bytes that were allocated since the last release.
+     */
+    [[nodiscard]] std::size_t allocated() const LOX_NOEXCEPT;
+
+    /*!
+     * Returns the number of bytes that are taken from the upstream resource,
+     * this is the actual footprint of the arena.
+     */
+    [[nodiscard]] std::size_t reserved() const LOX_NOEXCEPT;
+
+    [[nodiscard]] std::size_t limit() const LOX_NOEXCEPT;
+
+    /*!
+     * Frees all the memory of the arena. Anything that was allocated from it
+     * must not be used afterwards, not even destroyed.
+     */
+    void release() LOX_NOEXCEPT;
+
+private:
+    /*!
+     * Forwards to the upstream resource and counts the bytes that are in use.
+     */
+    class counting_resource final : public std::pmr::memory_resource {
+    public:
+        explicit counting_resource(
+          std::pmr::memory_resource* upstream) LOX_NOEXCEPT;
+
+        [[nodiscard]] std::size_t in_use() const LOX_NOEXCEPT;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(
+          void* pointer, std::size_t bytes, std::size_t alignment) override;
+        [[nodiscard]] bool do_is_equal(
+          const std::pmr::memory_resource& other) const noexcept override;
+
+    private:
+        std::pmr::memory_resource* m_upstream;
+        std::size_t m_in_use{ 0 };
+    };
+
+private:
+    /*!
+     * @throws std::bad_alloc
+     */
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(
+      void* pointer, std::size_t bytes, std::size_t alignment) override;
+    [[nodiscard]] bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    std::size_t m_limit;
+    std::size_t m_allocated{ 0 };
+    counting_resource m_upstream;
+    std::pmr::monotonic_buffer_resource m_buffer;
+};
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "ast_printer.h"
 
 #include "defs.h"
+#include "number_format.h"
 
 #include <sstream>
 #include <variant>
@@ -10,22 +11,59 @@ namespace {
 template<typename>
 [[maybe_unused]] constexpr bool always_false_v = false;
 
-template<typename... Args>
-[[nodiscard]] std::string parenthesize(
-  std::variant<std::string_view, double> name,
-  Args&... args) LOX_NOEXCEPT;
+using lox::flat::is_node_v;
 
 std::string print_ast(std::variant<std::reference_wrapper<const lox::expr>,
   std::reference_wrapper<const lox::stmt>> ex) LOX_NOEXCEPT;
 
+/*!
+ * Prints the children of the pointer based AST.
+ */
+struct tree_printer {
+    void operator()(std::stringstream& ss,
+      const lox::copyable<lox::expr*>& child) const LOX_NOEXCEPT
+    {
+        if (!child) {
+            // Printed like an empty expression, e.g. the missing branch of a
+            // ternary after a parse error.
+            ss << "UNKNOWN";
+            return;
+        }
+
+        ss << print_ast(*child);
+    }
+
+    [[nodiscard]] static bool has(
+      const lox::copyable<lox::expr*>& child) LOX_NOEXCEPT
+    {
+        return child;
+    }
+};
+
+/*!
+ * Prints the children of a lox::flat::program. Shared nodes are printed at
+ * every place they are used, so the output is the same as for the tree.
+ */
+struct flat_printer {
+    const lox::flat::program& program;
+
+    void operator()(std::stringstream& ss,
+      lox::flat::node_index child) const LOX_NOEXCEPT;
+
+    [[nodiscard]] static bool has(lox::flat::node_index child) LOX_NOEXCEPT
+    {
+        return child != lox::flat::no_node;
+    }
+};
+
 constexpr auto object_visitor = [](std::stringstream& ss, auto&& arg) {
     using T = std::decay_t<decltype(arg)>;
-    if constexpr (std::is_same_v<T, std::string_view> ||
-                  std::is_same_v<T, std::string>) {
+    if constexpr (std::is_same_v<T, lox::heap_string>) {
         ss << arg;
     }
     else if constexpr (std::is_same_v<T, double>) {
-        ss << arg;
+        lox::number_buffer buffer{};
+        ss << lox::format_number(arg, buffer);
     }
     else if constexpr (std::is_same_v<T, bool>) {
         ss << std::boolalpha << arg;
@@ -41,96 +79,88 @@ constexpr auto object_visitor = [](std::stringstream& ss, auto&& arg) {
     }
 };
 
-constexpr auto expr_visitor = [](std::stringstream& ss, auto&& arg) {
-    using T = std::decay_t<decltype(arg)>;
-
-    if constexpr (std::is_same_v<T, std::monostate>) {
-        ss << "UNKNOWN";
-    }
-    else if constexpr (std::is_same_v<T, lox::binary>) {
-        ss << parenthesize(arg.oprtor.lexeme, arg);
-    }
-    else if constexpr (std::is_same_v<T, lox::grouping>) {
-        ss << parenthesize("group", arg);
-    }
-    else if constexpr (std::is_same_v<T, lox::literal>) {
-        std::visit(
-          [&ss](auto&& arg) {
-              using T = std::decay_t<decltype(arg)>;
-              object_visitor(ss, std::forward<const T>(arg));
-          },
-          arg.value);
-    }
-    else if constexpr (std::is_same_v<T, lox::unary>) {
-        ss << parenthesize(arg.oprtor.lexeme, arg);
-    }
-    else if constexpr (std::is_same_v<T, lox::ternary>) {
-        ss << *arg.first << " ? " << *arg.second << " : " << *arg.third;
-    }
-    else if constexpr (std::is_same_v<T, lox::variable>) {
-        ss << "(var " << arg.name.lexeme << ')';
-    }
-    else if constexpr (std::is_same_v<T, lox::expr_stmt>) {
-        ss << *arg.expression;
-    }
-    else if constexpr (std::is_same_v<T, lox::print_stmt>) {
-        ss << "print " << *arg.expression;
-    }
-    else if constexpr (std::is_same_v<T, lox::assignment>) {
-        ss << arg.name.lexeme << " = " << *arg.value;
-    }
-    else if constexpr (std::is_same_v<T, lox::var_stmt>) {
-        ss << "var " << arg.name.lexeme << " = ";
-        if (arg.expression) {
-            ss << *arg.expression;
-        }
-        else {
-            ss << "null";
-        }
-    }
-    else {
-        static_assert(always_false_v<T>, "non-exhaustive expr_visitor!");
-    }
-};
-
-void parenthesize(std::stringstream& ss, const lox::binary& bin) LOX_NOEXCEPT
-{
-    ss << print_ast(*bin.left);
-    ss << ' ';
-    ss << print_ast(*bin.right);
-}
-
+template<typename Printer, typename... Children>
 void parenthesize(std::stringstream& ss,
-  const lox::grouping& group) LOX_NOEXCEPT
+  std::string_view name,
+  const Printer& print,
+  const Children&... children) LOX_NOEXCEPT
 {
-    ss << print_ast(*group.expression);
+    ss << '(' << name;
+    ((ss << ' ', print(ss, children)), ...);
+    ss << ')';
 }
 
-void parenthesize(std::stringstream& ss, const lox::unary& un) LOX_NOEXCEPT
-{
-    ss << print_ast(*un.right);
-}
+constexpr auto expr_visitor =
+  [](std::stringstream& ss, auto&& arg, const auto& print) {
+      using T = std::decay_t<decltype(arg)>;
 
-template<typename... Args>
-[[nodiscard]] std::string parenthesize(
-  std::variant<std::string_view, double> name,
-  Args&... args) LOX_NOEXCEPT
-{
-    std::stringstream ss;
-    ss << '(';
-
-    std::visit(
-      [&ss](auto&& arg) {
-          using T = std::decay_t<decltype(arg)>;
-          object_visitor(ss, std::forward<const T>(arg));
-      },
-      name);
+      if constexpr (std::is_same_v<T, std::monostate>) {
+          ss << "UNKNOWN";
+      }
+      else if constexpr (is_node_v<T, lox::binary>) {
+          parenthesize(ss, arg.oprtor.lexeme, print, arg.left, arg.right);
+      }
+      else if constexpr (is_node_v<T, lox::grouping>) {
+          parenthesize(ss, "group", print, arg.expression);
+      }
+      else if constexpr (is_node_v<T, lox::literal>) {
+          std::visit(
+            [&ss](auto&& arg) {
+                using T = std::decay_t<decltype(arg)>;
+                object_visitor(ss, std::forward<const T>(arg));
+            },
+            arg.value);
+      }
+      else if constexpr (is_node_v<T, lox::unary>) {
+          parenthesize(ss, arg.oprtor.lexeme, print, arg.right);
+      }
+      else if constexpr (is_node_v<T, lox::ternary>) {
+          print(ss, arg.first);
+          ss << " ? ";
+          print(ss, arg.second);
+          ss << " : ";
+          print(ss, arg.third);
+      }
+      else if constexpr (is_node_v<T, lox::variable>) {
+          ss << "(var " << arg.name.lexeme << ')';
+      }
+      else if constexpr (is_node_v<T, lox::expr_stmt>) {
+          print(ss, arg.expression);
+      }
+      else if constexpr (is_node_v<T, lox::print_stmt>) {
+          ss << "print ";
+          print(ss, arg.expression);
+      }
+      else if constexpr (is_node_v<T, lox::assignment>) {
+          ss << arg.name.lexeme << " = ";
+          print(ss, arg.value);
+      }
+      else if constexpr (is_node_v<T, lox::var_stmt>) {
+          ss << "var " << arg.name.lexeme << " = ";
+          if (print.has(arg.expression)) {
+              print(ss, arg.expression);
+          }
+          else {
+              ss << "null";
+          }
+      }
+      else {
+          static_assert(always_false_v<T>, "non-exhaustive expr_visitor!");
+      }
+  };
 
-    ss << " ";
-    parenthesize(ss, args...);
-    ss << ')';
+void flat_printer::operator()(std::stringstream& ss,
+  lox::flat::node_index child) const LOX_NOEXCEPT
+{
+    if (child == lox::flat::no_node) {
+        // The flat counterpart of an empty expression.
+        expr_visitor(ss, std::monostate{}, *this);
+        return;
+    }
 
-    return ss.str();
+    program.visit(child, [&ss, this](const auto& arg) {
+        expr_visitor(ss, arg, *this);
+    });
 }
 
 [[nodiscard]] std::string print_ast(
@@ -147,7 +177,7 @@ template<typename... Args>
           [&ss](auto&& arg) {
               using T = std::decay_t<decltype(arg)>;
 
-              expr_visitor(ss, std::forward<const T>(arg));
+              expr_visitor(ss, std::forward<const T>(arg), tree_printer{});
           },
           std::get<std::reference_wrapper<const lox::stmt>>(ex).get());
     }
@@ -156,7 +186,7 @@ template<typename... Args>
           [&ss](auto&& arg) {
               using T = std::decay_t<decltype(arg)>;
 
-              expr_visitor(ss, std::forward<const T>(arg));
+              expr_visitor(ss, std::forward<const T>(arg), tree_printer{});
           },
           std::get<std::reference_wrapper<const lox::expr>>(ex).get());
     }
@@ -165,6 +195,14 @@ template<typename... Args>
 }
 }
 
+std::string lox::to_string(const flat::program& program,
+  flat::node_index index) LOX_NOEXCEPT
+{
+    std::stringstream ss;
+    flat_printer{ program }(ss, index);
+    return ss.str();
+}
+
 std::ostream& operator<<(std::ostream& os, const lox::expr& expr) LOX_NOEXCEPT
 {
     assert(!expr.valueless_by_exception());
@@ -194,3 +232,28 @@ std::ostream& operator<<(std::ostream& os,
     os << ss.str();
     return os;
 }
+
+std::ostream& operator<<(std::ostream& os, lox::value value) LOX_NOEXCEPT
+{
+    std::stringstream ss;
+    switch (value.type()) {
+        case lox::value::kind::NUMBER:
+            object_visitor(ss, value.as_number());
+            break;
+        case lox::value::kind::BOOLEAN:
+            object_visitor(ss, value.as_bool());
+            break;
+        case lox::value::kind::NIL:
+            object_visitor(ss, nullptr);
+            break;
+        case lox::value::kind::STRING:
+            object_visitor(ss, value.as_string());
+            break;
+        case lox::value::kind::EMPTY:
+            object_visitor(ss, std::monostate{});
+            break;
+    }
+
+    os << ss.str();
+    return os;
+}
@@ -2,13 +2,25 @@
 #define LOX_AST_PRINTER_H
 
 #include "expr.h"
+#include "value.h"
 
 #include <iostream>
+#include <string>
 
 std::ostream& operator<<(std::ostream& os, const lox::expr& expr) LOX_NOEXCEPT;
 std::ostream& operator<<(std::ostream& os,
   const lox::stmt& statement) LOX_NOEXCEPT;
 std::ostream& operator<<(std::ostream& os,
   const lox::object& object) LOX_NOEXCEPT;
+std::ostream& operator<<(std::ostream& os, lox::value value) LOX_NOEXCEPT;
+
+namespace lox {
+/*!
+ * Prints the node of the flat program the same way as its pointer based
+ * counterpart is printed.
+ */
+[[nodiscard]] std::string to_string(const flat::program& program,
+  flat::node_index index) LOX_NOEXCEPT;
+}
 
 #endif
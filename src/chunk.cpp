@@ -0,0 +1,135 @@
+#include "chunk.h"
+
+#include "ast_printer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <map>
+
+namespace {
+const std::map<lox::op_code, std::string_view> s_op_names{
+    { lox::op_code::CONSTANT, "CONSTANT" },
+    { lox::op_code::EMPTY, "EMPTY" },
+    { lox::op_code::NIL, "NIL" },
+    { lox::op_code::TRUE, "TRUE" },
+    { lox::op_code::FALSE, "FALSE" },
+    { lox::op_code::POP, "POP" },
+    { lox::op_code::ADD, "ADD" },
+    { lox::op_code::SUBTRACT, "SUBTRACT" },
+    { lox::op_code::MULTIPLY, "MULTIPLY" },
+    { lox::op_code::DIVIDE, "DIVIDE" },
+    { lox::op_code::GREATER, "GREATER" },
+    { lox::op_code::GREATER_EQUAL, "GREATER_EQUAL" },
+    { lox::op_code::LESS, "LESS" },
+    { lox::op_code::LESS_EQUAL, "LESS_EQUAL" },
+    { lox::op_code::NEGATE, "NEGATE" },
+    { lox::op_code::EQUAL, "EQUAL" },
+    { lox::op_code::NOT_EQUAL, "NOT_EQUAL" },
+    { lox::op_code::NOT, "NOT" },
+    { lox::op_code::DEFINE_GLOBAL, "DEFINE_GLOBAL" },
+    { lox::op_code::GET_GLOBAL, "GET_GLOBAL" },
+    { lox::op_code::SET_GLOBAL, "SET_GLOBAL" },
+    { lox::op_code::DEFINE_SLOT, "DEFINE_SLOT" },
+    { lox::op_code::GET_SLOT, "GET_SLOT" },
+    { lox::op_code::SET_SLOT, "SET_SLOT" },
+    { lox::op_code::JUMP, "JUMP" },
+    { lox::op_code::JUMP_IF_FALSE, "JUMP_IF_FALSE" },
+    { lox::op_code::PRINT, "PRINT" },
+    { lox::op_code::RETURN, "RETURN" },
+};
+
+[[nodiscard]] bool has_operand(lox::op_code code) LOX_NOEXCEPT
+{
+    switch (code) {
+        case lox::op_code::EMPTY:
+        case lox::op_code::NIL:
+        case lox::op_code::TRUE:
+        case lox::op_code::FALSE:
+        case lox::op_code::POP:
+        case lox::op_code::EQUAL:
+        case lox::op_code::NOT_EQUAL:
+        case lox::op_code::NOT:
+        case lox::op_code::PRINT:
+        case lox::op_code::RETURN:
+            return false;
+        default:
+            return true;
+    }
+}
+
+[[nodiscard]] bool has_slot(lox::op_code code) LOX_NOEXCEPT
+{
+    return code == lox::op_code::DEFINE_SLOT ||
+           code == lox::op_code::GET_SLOT || code == lox::op_code::SET_SLOT;
+}
+
+[[nodiscard]] std::uint32_t read_operand(const lox::chunk& chk,
+  std::size_t& offset) LOX_NOEXCEPT
+{
+    const std::uint32_t operand =
+      (static_cast<std::uint32_t>(chk.code[offset]) << 24) |
+      (static_cast<std::uint32_t>(chk.code[offset + 1]) << 16) |
+      (static_cast<std::uint32_t>(chk.code[offset + 2]) << 8) |
+      static_cast<std::uint32_t>(chk.code[offset + 3]);
+    offset += lox::operand_size;
+    return operand;
+}
+}
+
+std::size_t lox::chunk::line(std::size_t offset) const LOX_NOEXCEPT
+{
+    assert(!lines.empty() && lines.front().offset == 0);
+    const auto next = std::upper_bound(lines.cbegin(),
+      lines.cend(),
+      offset,
+      [](std::size_t value, const line_start& start) {
+          return value < start.offset;
+      });
+    return std::prev(next)->line;
+}
+
+std::ostream& operator<<(std::ostream& os, lox::op_code code)
+{
+    const auto foundIt = s_op_names.find(code);
+    if (foundIt != s_op_names.cend()) {
+        os << foundIt->second;
+    }
+    else {
+        os << "UNKNOWN";
+    }
+
+    return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const lox::chunk& chk)
+{
+    std::size_t offset{ 0 };
+    while (offset < chk.code.size()) {
+        const auto code = static_cast<lox::op_code>(chk.code[offset]);
+        os << std::setfill('0') << std::setw(4) << offset << ' '
+           << std::setfill(' ') << std::setw(4) << chk.line(offset) << ' '
+           << code;
+
+        offset++;
+        if (has_operand(code)) {
+            const std::uint32_t operand{ read_operand(chk, offset) };
+            os << ' ' << operand;
+            if (has_slot(code)) {
+                os << " @" << read_operand(chk, offset);
+            }
+
+            if (code == lox::op_code::CONSTANT) {
+                os << " '" << chk.constants[operand] << '\'';
+            }
+            else if (code != lox::op_code::JUMP &&
+                     code != lox::op_code::JUMP_IF_FALSE) {
+                os << " '" << chk.tokens[operand]->lexeme << '\'';
+            }
+        }
+
+        os << '\n';
+    }
+
+    return os;
+}
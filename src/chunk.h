@@ -0,0 +1,113 @@
+#ifndef LOX_CHUNK_H
+#define LOX_CHUNK_H
+
+#include "defs.h"
+#include "token.h"
+#include "value.h"
+
+#include <cstdint>
+#include <iostream>
+#include <memory_resource>
+#include <vector>
+
+namespace lox {
+
+// Number of bytes of each operand.
+inline constexpr std::size_t operand_size{ 4 };
+
+/*!
+ * Instructions understood by the VM. Operands are encoded inline after the
+ * op code as 32-bit big-endian values.
+ */
+enum class op_code : std::uint8_t {
+    // [constant index] Pushes a constant from the constant pool.
+    CONSTANT,
+    // Pushes an empty object. Used for expressions that failed to parse.
+    EMPTY,
+    NIL,
+    TRUE,
+    FALSE,
+    POP,
+
+    // [token index] Operators that may fail at run time carry the operator
+    // token so that diagnostics point at the source.
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    GREATER,
+    GREATER_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    NEGATE,
+
+    EQUAL,
+    NOT_EQUAL,
+    NOT,
+
+    // [token index] The token holds the variable name.
+    DEFINE_GLOBAL,
+    GET_GLOBAL,
+    SET_GLOBAL,
+
+    // [token index][slot] Variables that were resolved to an environment slot.
+    DEFINE_SLOT,
+    GET_SLOT,
+    SET_SLOT,
+
+    // [offset] Jumps forward by offset bytes.
+    JUMP,
+    // [offset] Pops the condition and jumps forward if it is not truthy.
+    JUMP_IF_FALSE,
+
+    PRINT,
+    // Ends the chunk, the value on top of the stack is the result.
+    RETURN
+};
+
+/*!
+ * The first byte of `code` that was compiled from `line`. Lines are stored
+ * once per run of bytes instead of once per byte.
+ */
+struct line_start {
+    std::size_t offset;
+    std::size_t line;
+};
+
+/*!
+ * Refers to the tokens of the statement it was compiled from, so the chunk
+ * must not outlive the statement.
+ */
+struct chunk {
+    /*!
+     * The instructions and the tables are allocated from `resource`.
+     */
+    explicit chunk(std::pmr::memory_resource* resource =
+                     std::pmr::get_default_resource()) LOX_NOEXCEPT
+      : code{ resource }
+      , constants{ resource }
+      , lines{ resource }
+      , tokens{ resource }
+    {
+    }
+
+    /*!
+     * The source line of the byte at `offset`.
+     */
+    [[nodiscard]] std::size_t line(std::size_t offset) const LOX_NOEXCEPT;
+
+    std::pmr::vector<std::uint8_t> code;
+    std::pmr::vector<lox::value> constants;
+    // Owns the strings in `constants`.
+    lox::heap strings;
+    // Sorted by offset, see line().
+    std::pmr::vector<line_start> lines;
+    // Tokens referenced by instructions for names and diagnostics.
+    std::pmr::vector<const lox::token*> tokens;
+};
+}
+
+std::ostream& operator<<(std::ostream& os, lox::op_code code);
+std::ostream& operator<<(std::ostream& os, const lox::chunk& chk);
+
+#endif
@@ -0,0 +1,550 @@
+#include "closure.h"
+
+#include "environment.h"
+#include "operations.h"
+
+#include <cassert>
+#include <memory>
+#include <optional>
+#include <string>
+
+#ifndef LOX_EXCEPTION_ENABLED
+#error "Closures rely on exceptions to be enabled."
+#endif
+
+namespace {
+using token_type = lox::token::token_type;
+
+using function = lox::closure::function;
+
+using lox::ops::check_concatenation_types;
+using lox::ops::check_number_operand;
+using lox::ops::is_truthy;
+
+template<typename>
+[[maybe_unused]] constexpr bool always_false_v = false;
+
+using counters_list = lox::closure::counters_list;
+
+// Generic runs in a row that see the same operand types before a node is
+// specialized.
+constexpr std::size_t s_warmup_runs{ 2 };
+// Nodes whose operand types keep changing stay generic after this many
+// deoptimizations.
+constexpr std::size_t s_max_deoptimizations{ 4 };
+
+[[nodiscard]] function compile_expr(const lox::expr& expression,
+  counters_list& counters) LOX_NOEXCEPT;
+
+[[nodiscard]] function compile_child(const lox::copyable<lox::expr*>& child,
+  counters_list& counters) LOX_NOEXCEPT
+{
+    if (!child) {
+        return [](lox::environment& /* env */) { return lox::object{}; };
+    }
+
+    return compile_expr(*child, counters);
+}
+
+/*!
+ * A unary or binary operator that is rewritten while it runs. Rewriting the
+ * node replaces `run`, the parent keeps calling the same node.
+ */
+struct operator_node {
+    using handler = lox::object (*)(operator_node&, lox::environment&);
+
+    handler run{ nullptr };
+    // Not set for unary operators.
+    function left{};
+    function right{};
+    // Set instead of `right` if the right operand is a number literal.
+    std::optional<double> right_constant{};
+    // The runtime errors of the operator point at it.
+    lox::token oprtor{};
+    lox::quickening_counters counters{};
+    // What the last generic runs asked for and how many runs in a row did.
+    lox::specialization observed{ lox::specialization::generic };
+    std::size_t observed_runs{ 0 };
+};
+
+[[nodiscard]] operator_node make_operator_node(
+  const lox::token& oprtor) LOX_NOEXCEPT
+{
+    operator_node node{};
+    node.oprtor = oprtor;
+    node.counters.oprtor = oprtor.type;
+    node.counters.line = oprtor.line;
+    node.counters.offset = oprtor.column_start;
+    return node;
+}
+
+[[nodiscard]] lox::object evaluate_right(operator_node& node,
+  lox::environment& env)
+{
+    if (node.right_constant) {
+        return lox::object{ *node.right_constant };
+    }
+
+    return node.right(env);
+}
+
+[[nodiscard]] bool is_string(const lox::object& value) LOX_NOEXCEPT
+{
+    return std::holds_alternative<lox::heap_string>(value);
+}
+
+/*!
+ * Records the specialization that the operands of a generic run ask for and
+ * rewrites the node once enough runs in a row asked for it.
+ */
+void observe(operator_node& node,
+  lox::specialization wanted,
+  operator_node::handler specialized) LOX_NOEXCEPT
+{
+    if (wanted == lox::specialization::generic ||
+        node.counters.deoptimizations >= s_max_deoptimizations) {
+        node.observed_runs = 0;
+        return;
+    }
+
+    if (wanted != node.observed) {
+        node.observed = wanted;
+        node.observed_runs = 0;
+    }
+
+    if (++node.observed_runs < s_warmup_runs) {
+        return;
+    }
+
+    node.run = specialized;
+    node.counters.current = wanted;
+    ++node.counters.specializations;
+    node.observed_runs = 0;
+}
+
+/*!
+ * Called by a specialized node whose guard failed, the operands are then
+ * handled by the generic code.
+ */
+void deoptimize(operator_node& node,
+  operator_node::handler generic) LOX_NOEXCEPT
+{
+    node.run = generic;
+    node.counters.current = lox::specialization::generic;
+    ++node.counters.deoptimizations;
+    node.observed_runs = 0;
+}
+
+/*!
+ * `-`, `/`, `*` and the comparisons, they only take numbers.
+ */
+template<typename Operation>
+struct number_operator {
+    /*!
+     * Applies the operator to any operands and records their types.
+     */
+    static lox::object generic(operator_node& node,
+      const lox::object& left,
+      const lox::object& right)
+    {
+        check_number_operand(node.oprtor, left, right);
+        observe(node, lox::specialization::number, &run_number);
+        return Operation{}(std::get<double>(left), std::get<double>(right));
+    }
+
+    static lox::object run_generic(operator_node& node, lox::environment& env)
+    {
+        const lox::object left{ node.left(env) };
+        return generic(node, left, evaluate_right(node, env));
+    }
+
+    static lox::object run_number(operator_node& node, lox::environment& env)
+    {
+        const lox::object left{ node.left(env) };
+        const lox::object right{ evaluate_right(node, env) };
+        const auto* left_number = std::get_if<double>(&left);
+        const auto* right_number = std::get_if<double>(&right);
+        // check_number_operand() rejects any zero on the right.
+        if (left_number && right_number && *right_number != 0) {
+            return Operation{}(*left_number, *right_number);
+        }
+
+        deoptimize(node, &run_generic);
+        return generic(node, left, right);
+    }
+};
+
+struct add_operator {
+    /*!
+     * Applies the operator to any operands and records their types.
+     */
+    static lox::object generic(operator_node& node,
+      lox::environment& env,
+      const lox::object& left,
+      const lox::object& right)
+    {
+        if (std::holds_alternative<double>(left) &&
+            std::holds_alternative<double>(right)) {
+            observe(node, lox::specialization::number, &run_number);
+            return std::get<double>(left) + std::get<double>(right);
+        }
+
+        check_concatenation_types(node.oprtor, left, right);
+        if (is_string(left) && is_string(right)) {
+            observe(node, lox::specialization::string, &run_string);
+        }
+        else {
+            observe(node, lox::specialization::generic, nullptr);
+        }
+
+        return lox::ops::concatenate(left, right, env.resource());
+    }
+
+    static lox::object run_generic(operator_node& node, lox::environment& env)
+    {
+        const lox::object left{ node.left(env) };
+        return generic(node, env, left, evaluate_right(node, env));
+    }
+
+    static lox::object run_number(operator_node& node, lox::environment& env)
+    {
+        const lox::object left{ node.left(env) };
+        const lox::object right{ evaluate_right(node, env) };
+        const auto* left_number = std::get_if<double>(&left);
+        const auto* right_number = std::get_if<double>(&right);
+        if (left_number && right_number) {
+            return *left_number + *right_number;
+        }
+
+        deoptimize(node, &run_generic);
+        return generic(node, env, left, right);
+    }
+
+    static lox::object run_string(operator_node& node, lox::environment& env)
+    {
+        const lox::object left{ node.left(env) };
+        const lox::object right{ evaluate_right(node, env) };
+        if (is_string(left) && is_string(right)) {
+            return lox::ops::concatenate(left, right, env.resource());
+        }
+
+        deoptimize(node, &run_generic);
+        return generic(node, env, left, right);
+    }
+};
+
+struct negate_operator {
+    /*!
+     * Applies the operator to any operand and records its type.
+     */
+    static lox::object generic(operator_node& node, const lox::object& right)
+    {
+        check_number_operand(node.oprtor, right);
+        observe(node, lox::specialization::number, &run_number);
+        return std::get<double>(right) * -1;
+    }
+
+    static lox::object run_generic(operator_node& node, lox::environment& env)
+    {
+        return generic(node, evaluate_right(node, env));
+    }
+
+    static lox::object run_number(operator_node& node, lox::environment& env)
+    {
+        const lox::object right{ evaluate_right(node, env) };
+        if (const auto* number = std::get_if<double>(&right)) {
+            return *number * -1;
+        }
+
+        deoptimize(node, &run_generic);
+        return generic(node, right);
+    }
+};
+
+/*!
+ * Starts the node in its generic form and registers its counters.
+ */
+template<typename Operator>
+[[nodiscard]] function compile_operator(operator_node node,
+  counters_list& counters) LOX_NOEXCEPT
+{
+    node.run = &Operator::run_generic;
+    auto shared = std::make_shared<operator_node>(std::move(node));
+    counters.emplace_back(shared, &shared->counters);
+    return [shared = std::move(shared)](lox::environment& env) {
+        return shared->run(*shared, env);
+    };
+}
+
+[[nodiscard]] function compile_binary(const lox::binary& expr,
+  counters_list& counters) LOX_NOEXCEPT
+{
+    if (expr.oprtor.type == token_type::EQUAL_EQUAL) {
+        return [left = compile_child(expr.left, counters),
+                 right = compile_child(expr.right, counters)](
+                 lox::environment& env) -> lox::object {
+            const lox::object left_value{ left(env) };
+            return left_value == right(env);
+        };
+    }
+
+    if (expr.oprtor.type == token_type::BANG_EQUAL) {
+        return [left = compile_child(expr.left, counters),
+                 right = compile_child(expr.right, counters)](
+                 lox::environment& env) -> lox::object {
+            const lox::object left_value{ left(env) };
+            return left_value != right(env);
+        };
+    }
+
+    operator_node node{ make_operator_node(expr.oprtor) };
+    node.left = compile_child(expr.left, counters);
+    const auto* constant =
+      expr.right ? std::get_if<lox::literal>(&*expr.right) : nullptr;
+    if (constant && std::holds_alternative<double>(constant->value)) {
+        node.right_constant = std::get<double>(constant->value);
+    }
+    else {
+        node.right = compile_child(expr.right, counters);
+    }
+
+    switch (expr.oprtor.type) {
+        case token_type::MINUS:
+            return compile_operator<number_operator<std::minus<double>>>(
+              std::move(node), counters);
+        case token_type::SLASH:
+            return compile_operator<number_operator<std::divides<double>>>(
+              std::move(node), counters);
+        case token_type::STAR:
+            return compile_operator<number_operator<std::multiplies<double>>>(
+              std::move(node), counters);
+        case token_type::GREATER:
+            return compile_operator<number_operator<std::greater<double>>>(
+              std::move(node), counters);
+        case token_type::GREATER_EQUAL:
+            return compile_operator<
+              number_operator<std::greater_equal<double>>>(
+              std::move(node), counters);
+        case token_type::LESS:
+            return compile_operator<number_operator<std::less<double>>>(
+              std::move(node), counters);
+        case token_type::LESS_EQUAL:
+            return compile_operator<number_operator<std::less_equal<double>>>(
+              std::move(node), counters);
+        case token_type::PLUS:
+            return compile_operator<add_operator>(std::move(node), counters);
+        default:
+            assert(false);
+            return [](lox::environment& /* env */) { return lox::object{}; };
+    }
+}
+
+[[nodiscard]] function compile_unary(const lox::unary& expr,
+  counters_list& counters) LOX_NOEXCEPT
+{
+    if (expr.oprtor.type == token_type::MINUS) {
+        operator_node node{ make_operator_node(expr.oprtor) };
+        node.right = compile_child(expr.right, counters);
+        return compile_operator<negate_operator>(std::move(node), counters);
+    }
+
+    assert(expr.oprtor.type == token_type::BANG);
+    return [right = compile_child(expr.right, counters)](
+             lox::environment& env) -> lox::object {
+        return !is_truthy(right(env));
+    };
+}
+
+[[nodiscard]] function compile_ternary(const lox::ternary& expr,
+  counters_list& counters) LOX_NOEXCEPT
+{
+    if (!expr.third) {
+        return [first = compile_child(expr.first, counters),
+                 second = compile_child(expr.second, counters)](
+                 lox::environment& env) -> lox::object {
+            return is_truthy(first(env)) ? second(env) : lox::object{};
+        };
+    }
+
+    return [first = compile_child(expr.first, counters),
+             second = compile_child(expr.second, counters),
+             third = compile_child(expr.third, counters)](
+             lox::environment& env) -> lox::object {
+        return is_truthy(first(env)) ? second(env) : third(env);
+    };
+}
+
+[[nodiscard]] function compile_variable(
+  const lox::variable& expr) LOX_NOEXCEPT
+{
+    if (expr.slot != lox::unresolved_slot) {
+        return [slot = expr.slot, name = expr.name](lox::environment& env) {
+            return lox::env::get(env, slot, name);
+        };
+    }
+
+    return [name = expr.name](lox::environment& env) {
+        return lox::env::get(env, name);
+    };
+}
+
+[[nodiscard]] function compile_assignment(const lox::assignment& expr,
+  counters_list& counters) LOX_NOEXCEPT
+{
+    if (expr.slot != lox::unresolved_slot) {
+        return [value = compile_child(expr.value, counters),
+                 slot = expr.slot,
+                 name = expr.name](lox::environment& env) {
+            lox::object result{ value(env) };
+            lox::env::assign(env, slot, name, result);
+            return result;
+        };
+    }
+
+    return [value = compile_child(expr.value, counters), name = expr.name](
+             lox::environment& env) {
+        lox::object result{ value(env) };
+        lox::env::assign(env, name, result);
+        return result;
+    };
+}
+
+[[nodiscard]] function compile_var_stmt(const lox::var_stmt& stmt,
+  counters_list& counters) LOX_NOEXCEPT
+{
+    function initializer{};
+    if (stmt.expression) {
+        initializer = compile_expr(*stmt.expression, counters);
+    }
+    else {
+        initializer = [](lox::environment& /* env */) {
+            return lox::object{ nullptr };
+        };
+    }
+
+    if (stmt.slot != lox::unresolved_slot) {
+        return [initializer = std::move(initializer), slot = stmt.slot](
+                 lox::environment& env) {
+            lox::object value{ initializer(env) };
+            lox::env::define(env, slot, value);
+            return value;
+        };
+    }
+
+    return [initializer = std::move(initializer), name = stmt.name](
+             lox::environment& env) {
+        lox::object value{ initializer(env) };
+        lox::env::define(env, name, value);
+        return value;
+    };
+}
+
+function compile_expr(const lox::expr& expression,
+  counters_list& counters) LOX_NOEXCEPT
+{
+    return std::visit(
+      [&counters](const auto& arg) -> function {
+          using T = std::decay_t<decltype(arg)>;
+          if constexpr (std::is_same_v<T, lox::literal>) {
+              return [value = arg.value](lox::environment& /* env */) {
+                  return value;
+              };
+          }
+          else if constexpr (std::is_same_v<T, lox::grouping>) {
+              // Evaluates to its expression, it needs no function of its own.
+              return compile_child(arg.expression, counters);
+          }
+          else if constexpr (std::is_same_v<T, lox::unary>) {
+              return compile_unary(arg, counters);
+          }
+          else if constexpr (std::is_same_v<T, lox::binary>) {
+              return compile_binary(arg, counters);
+          }
+          else if constexpr (std::is_same_v<T, lox::ternary>) {
+              return compile_ternary(arg, counters);
+          }
+          else if constexpr (std::is_same_v<T, lox::variable>) {
+              return compile_variable(arg);
+          }
+          else if constexpr (std::is_same_v<T, lox::assignment>) {
+              return compile_assignment(arg, counters);
+          }
+          else if constexpr (std::is_same_v<T, std::monostate>) {
+              return [](lox::environment& /* env */) { return lox::object{}; };
+          }
+          else {
+              static_assert(always_false_v<T>, "Unhandled type.");
+          }
+      },
+      expression);
+}
+}
+
+lox::closure::closure(function body, counters_list counters) LOX_NOEXCEPT
+  : m_body{ std::move(body) }
+  , m_counters{ std::move(counters) }
+{
+    assert(m_body);
+}
+
+lox::object lox::closure::operator()(environment& env) const
+{
+    return m_body(env);
+}
+
+const lox::closure::counters_list& lox::closure::counters() const LOX_NOEXCEPT
+{
+    return m_counters;
+}
+
+lox::closure lox::compile_closure(const stmt& statement) LOX_NOEXCEPT
+{
+    counters_list counters{};
+    function body = std::visit(
+      [&counters](const auto& arg) -> function {
+          using T = std::decay_t<decltype(arg)>;
+          if constexpr (std::is_same_v<T, lox::expr_stmt>) {
+              return compile_child(arg.expression, counters);
+          }
+          else if constexpr (std::is_same_v<T, lox::print_stmt>) {
+              return [expression = compile_child(arg.expression, counters)](
+                       lox::environment& env) {
+                  return lox::ops::print(expression(env), env.resource());
+              };
+          }
+          else if constexpr (std::is_same_v<T, lox::var_stmt>) {
+              return compile_var_stmt(arg, counters);
+          }
+          else if constexpr (std::is_same_v<T, std::monostate>) {
+              return [](lox::environment& /* env */) { return lox::object{}; };
+          }
+          else {
+              static_assert(always_false_v<T>, "Unhandled type.");
+          }
+      },
+      statement);
+    return closure{ std::move(body), std::move(counters) };
+}
+
+const lox::closure& lox::cached_closure(const stmt& statement)
+{
+    return std::visit(
+      [&statement](const auto& arg) -> const closure& {
+          using T = std::decay_t<decltype(arg)>;
+          if constexpr (std::is_same_v<T, std::monostate>) {
+              static const closure s_empty{ [](environment& /* env */) {
+                  return object{};
+              } };
+              return s_empty;
+          }
+          else {
+              if (!arg.compiled) {
+                  arg.compiled =
+                    std::make_shared<const closure>(compile_closure(statement));
+              }
+
+              return *arg.compiled;
+          }
+      },
+      statement);
+}
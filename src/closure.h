@@ -0,0 +1,92 @@
+#ifndef LOX_CLOSURE_H
+#define LOX_CLOSURE_H
+
+#include "expr.h"
+#include "defs.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace lox {
+struct environment;
+
+/*!
+ * The form an operator node of a closure runs in. The nodes start generic and
+ * record the types of their operands, once the same types are seen a few
+ * times in a row the node is rewritten to the specialized form. A guard in the
+ * specialized form rewrites it back when other types show up.
+ */
+enum class specialization : std::uint8_t {
+    generic,
+    // The operands are numbers, e.g. `a + 1`, `-a` or `a < b`.
+    number,
+    // The operands are strings, only for `+`.
+    string,
+};
+
+/*!
+ * How an operator node of a closure was rewritten while it ran.
+ */
+struct quickening_counters {
+    token::token_type oprtor{};
+    // Where the operator is, the zero based line and the byte offset into the
+    // source as in lox::token. The counters do not refer to the source, so
+    // they can outlive it.
+    std::size_t line{ 0 };
+    std::size_t offset{ 0 };
+    specialization current{ specialization::generic };
+    std::size_t specializations{ 0 };
+    std::size_t deoptimizations{ 0 };
+};
+
+/*!
+ * A statement that is compiled into nested function objects. Every node is
+ * bound to the code for its kind and operator when it is compiled, so running
+ * it neither visits the nodes nor compares operators. Variables are accessed
+ * through the slots the statement was resolved to, so it has to be run
+ * against the same environment.
+ *
+ * Arithmetic and comparison operators are rewritten to the types of their
+ * operands when the closure runs more than once, see lox::specialization.
+ */
+class closure {
+public:
+    using function = std::function<object(environment&)>;
+    using counters_list =
+      std::vector<std::shared_ptr<const quickening_counters>>;
+
+    explicit closure(function body, counters_list counters = {}) LOX_NOEXCEPT;
+
+    /*!
+     * @throws lox::runtime_error
+     */
+    object operator()(environment& env) const;
+
+    /*!
+     * The counters of the operator nodes that can be specialized, the
+     * operands of a node come before it. Copies of the closure share the
+     * nodes and their counters. The closure that lox::interpret() runs is
+     * returned by lox::cached_closure().
+     */
+    [[nodiscard]] const counters_list& counters() const LOX_NOEXCEPT;
+
+private:
+    function m_body;
+    counters_list m_counters;
+};
+
+[[nodiscard]] closure compile_closure(const stmt& statement) LOX_NOEXCEPT;
+
+/*!
+ * Returns the closure that lox::interpret() runs the statement with for
+ * engine::closure. It is compiled on the first call and kept in the statement,
+ * see lox::closure_cache, so its counters() cover every run since then. Like
+ * the inline caches, the statement should not be run by several threads at
+ * once.
+ */
+[[nodiscard]] const closure& cached_closure(const stmt& statement);
+}
+
+#endif
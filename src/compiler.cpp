@@ -0,0 +1,316 @@
+#include "compiler.h"
+
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <cassert>
+
+namespace {
+using token_type = lox::token::token_type;
+
+template<typename>
+[[maybe_unused]] constexpr bool always_false_v = false;
+
+struct compiler_state {
+    lox::chunk chk{};
+    std::size_t line{ 0 };
+    // Set when an operand does not fit in 32 bits.
+    bool overflow{ false };
+};
+
+void compile_expr(compiler_state& state, const lox::expr& expression);
+
+void emit_op(compiler_state& state, lox::op_code code)
+{
+    // The operands of an instruction are on the same line as its op code.
+    if (state.chk.lines.empty() || state.chk.lines.back().line != state.line) {
+        state.chk.lines.push_back({ state.chk.code.size(), state.line });
+    }
+
+    state.chk.code.push_back(static_cast<std::uint8_t>(code));
+}
+
+void write_operand(compiler_state& state,
+  std::size_t offset,
+  std::size_t operand) LOX_NOEXCEPT
+{
+    if (operand > std::numeric_limits<std::uint32_t>::max()) {
+        state.overflow = true;
+        return;
+    }
+
+    state.chk.code[offset] = static_cast<std::uint8_t>((operand >> 24) & 0xff);
+    state.chk.code[offset + 1] =
+      static_cast<std::uint8_t>((operand >> 16) & 0xff);
+    state.chk.code[offset + 2] =
+      static_cast<std::uint8_t>((operand >> 8) & 0xff);
+    state.chk.code[offset + 3] = static_cast<std::uint8_t>(operand & 0xff);
+}
+
+void emit_operand(compiler_state& state, std::size_t operand)
+{
+    const std::size_t offset{ state.chk.code.size() };
+    state.chk.code.resize(offset + lox::operand_size);
+    write_operand(state, offset, operand);
+}
+
+void emit_constant(compiler_state& state, const lox::object& value)
+{
+    state.chk.constants.push_back(lox::to_value(value, state.chk.strings));
+    emit_op(state, lox::op_code::CONSTANT);
+    emit_operand(state, state.chk.constants.size() - 1);
+}
+
+void emit_with_token(compiler_state& state,
+  lox::op_code code,
+  const lox::token& tkn)
+{
+    state.line = tkn.line;
+    state.chk.tokens.push_back(&tkn);
+    emit_op(state, code);
+    emit_operand(state, state.chk.tokens.size() - 1);
+}
+
+void emit_variable(compiler_state& state,
+  lox::op_code global_code,
+  lox::op_code slot_code,
+  const lox::token& name,
+  lox::slot_index slot)
+{
+    if (slot == lox::unresolved_slot) {
+        emit_with_token(state, global_code, name);
+        return;
+    }
+
+    emit_with_token(state, slot_code, name);
+    emit_operand(state, slot);
+}
+
+[[nodiscard]] std::size_t emit_jump(compiler_state& state, lox::op_code code)
+{
+    emit_op(state, code);
+    emit_operand(state, 0);
+    return state.chk.code.size() - lox::operand_size;
+}
+
+void patch_jump(compiler_state& state, std::size_t operand_offset) LOX_NOEXCEPT
+{
+    write_operand(state,
+      operand_offset,
+      state.chk.code.size() - operand_offset - lox::operand_size);
+}
+
+void compile_literal(compiler_state& state, const lox::literal& expr)
+{
+    if (std::holds_alternative<std::nullptr_t>(expr.value)) {
+        emit_op(state, lox::op_code::NIL);
+    }
+    else if (std::holds_alternative<bool>(expr.value)) {
+        emit_op(state,
+          std::get<bool>(expr.value) ? lox::op_code::TRUE
+                                     : lox::op_code::FALSE);
+    }
+    else if (std::holds_alternative<std::monostate>(expr.value)) {
+        emit_op(state, lox::op_code::EMPTY);
+    }
+    else {
+        emit_constant(state, expr.value);
+    }
+}
+
+void compile_binary(compiler_state& state, const lox::binary& expr)
+{
+    compile_expr(state, *expr.left);
+    compile_expr(state, *expr.right);
+
+    switch (expr.oprtor.type) {
+        case token_type::PLUS:
+            emit_with_token(state, lox::op_code::ADD, expr.oprtor);
+            break;
+        case token_type::MINUS:
+            emit_with_token(state, lox::op_code::SUBTRACT, expr.oprtor);
+            break;
+        case token_type::STAR:
+            emit_with_token(state, lox::op_code::MULTIPLY, expr.oprtor);
+            break;
+        case token_type::SLASH:
+            emit_with_token(state, lox::op_code::DIVIDE, expr.oprtor);
+            break;
+        case token_type::GREATER:
+            emit_with_token(state, lox::op_code::GREATER, expr.oprtor);
+            break;
+        case token_type::GREATER_EQUAL:
+            emit_with_token(state, lox::op_code::GREATER_EQUAL, expr.oprtor);
+            break;
+        case token_type::LESS:
+            emit_with_token(state, lox::op_code::LESS, expr.oprtor);
+            break;
+        case token_type::LESS_EQUAL:
+            emit_with_token(state, lox::op_code::LESS_EQUAL, expr.oprtor);
+            break;
+        case token_type::EQUAL_EQUAL:
+            emit_op(state, lox::op_code::EQUAL);
+            break;
+        case token_type::BANG_EQUAL:
+            emit_op(state, lox::op_code::NOT_EQUAL);
+            break;
+        default:
+            assert(false);
+    }
+}
+
+void compile_unary(compiler_state& state, const lox::unary& expr)
+{
+    compile_expr(state, *expr.right);
+    if (expr.oprtor.type == token_type::MINUS) {
+        emit_with_token(state, lox::op_code::NEGATE, expr.oprtor);
+    }
+    else {
+        assert(expr.oprtor.type == token_type::BANG);
+        emit_op(state, lox::op_code::NOT);
+    }
+}
+
+void compile_ternary(compiler_state& state, const lox::ternary& expr)
+{
+    compile_expr(state, *expr.first);
+    const std::size_t else_jump{ emit_jump(
+      state, lox::op_code::JUMP_IF_FALSE) };
+
+    compile_expr(state, *expr.second);
+    const std::size_t end_jump{ emit_jump(state, lox::op_code::JUMP) };
+
+    patch_jump(state, else_jump);
+    if (expr.third) {
+        compile_expr(state, *expr.third);
+    }
+    else {
+        emit_op(state, lox::op_code::EMPTY);
+    }
+
+    patch_jump(state, end_jump);
+}
+
+constexpr auto compiler_visitor = [](auto&& arg, compiler_state& state) {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr (std::is_same_v<T, lox::literal>) {
+        compile_literal(state, arg);
+    }
+    else if constexpr (std::is_same_v<T, lox::grouping>) {
+        compile_expr(state, *arg.expression);
+    }
+    else if constexpr (std::is_same_v<T, lox::unary>) {
+        compile_unary(state, arg);
+    }
+    else if constexpr (std::is_same_v<T, lox::binary>) {
+        compile_binary(state, arg);
+    }
+    else if constexpr (std::is_same_v<T, lox::ternary>) {
+        compile_ternary(state, arg);
+    }
+    else if constexpr (std::is_same_v<T, lox::expr_stmt>) {
+        compile_expr(state, *arg.expression);
+    }
+    else if constexpr (std::is_same_v<T, lox::print_stmt>) {
+        compile_expr(state, *arg.expression);
+        emit_op(state, lox::op_code::PRINT);
+    }
+    else if constexpr (std::is_same_v<T, lox::var_stmt>) {
+        if (arg.expression) {
+            compile_expr(state, *arg.expression);
+        }
+        else {
+            emit_op(state, lox::op_code::NIL);
+        }
+
+        emit_variable(state,
+          lox::op_code::DEFINE_GLOBAL,
+          lox::op_code::DEFINE_SLOT,
+          arg.name,
+          arg.slot);
+    }
+    else if constexpr (std::is_same_v<T, lox::variable>) {
+        emit_variable(state,
+          lox::op_code::GET_GLOBAL,
+          lox::op_code::GET_SLOT,
+          arg.name,
+          arg.slot);
+    }
+    else if constexpr (std::is_same_v<T, lox::assignment>) {
+        compile_expr(state, *arg.value);
+        emit_variable(state,
+          lox::op_code::SET_GLOBAL,
+          lox::op_code::SET_SLOT,
+          arg.name,
+          arg.slot);
+    }
+    else if constexpr (std::is_same_v<T, std::monostate>) {
+        emit_op(state, lox::op_code::EMPTY);
+    }
+    else {
+        static_assert(always_false_v<T>, "Unhandled type.");
+    }
+};
+
+void compile_expr(compiler_state& state, const lox::expr& expression)
+{
+    std::visit(
+      [&state](auto&& arg) {
+          compiler_visitor(std::forward<decltype(arg)>(arg), state);
+      },
+      expression);
+}
+}
+
+std::optional<lox::chunk> lox::compile(const stmt& statement,
+  std::pmr::memory_resource* resource)
+{
+    compiler_state state{ lox::chunk{ resource } };
+    // Enough for most statements, so the vectors do not grow while compiling.
+    state.chk.code.reserve(64);
+    state.chk.constants.reserve(8);
+    state.chk.lines.reserve(4);
+    state.chk.tokens.reserve(8);
+    std::visit(
+      [&state](auto&& arg) {
+          compiler_visitor(std::forward<decltype(arg)>(arg), state);
+      },
+      statement);
+    emit_op(state, lox::op_code::RETURN);
+
+    if (state.overflow) {
+        return std::nullopt;
+    }
+
+    return std::move(state.chk);
+}
+
+const lox::chunk* lox::cached_chunk(const stmt& statement)
+{
+    return std::visit(
+      [&statement](const auto& arg) -> const chunk* {
+          using T = std::decay_t<decltype(arg)>;
+          if constexpr (std::is_same_v<T, std::monostate>) {
+              static const chunk s_empty{ compile(statement).value() };
+              return &s_empty;
+          }
+          else {
+              if (!arg.bytecode.get()) {
+                  std::pmr::memory_resource* resource{
+                      arg.expression.resource()
+                  };
+                  std::optional<chunk> compiled{ compile(statement, resource) };
+                  // A statement that is too large keeps an empty chunk, so it
+                  // is not compiled again.
+                  arg.bytecode.reset(std::allocate_shared<chunk>(
+                    std::pmr::polymorphic_allocator<chunk>{ resource },
+                    compiled ? std::move(*compiled) : chunk{ resource }));
+              }
+
+              const chunk* chk{ arg.bytecode.get() };
+              return chk->code.empty() ? nullptr : chk;
+          }
+      },
+      statement);
+}
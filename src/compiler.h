@@ -0,0 +1,33 @@
+#ifndef LOX_COMPILER_H
+#define LOX_COMPILER_H
+
+#include "chunk.h"
+#include "expr.h"
+#include "defs.h"
+
+#include <optional>
+
+namespace lox {
+/*!
+ * Lowers the statement into a bytecode chunk that can be run with
+ * lox::execute(). The chunk ends with op_code::RETURN and leaves the value of
+ * the statement on top of the stack. The chunk is allocated from `resource`.
+ * Returns std::nullopt if the statement is too large for the 32-bit operands
+ * of the chunk, it has to be run by another engine then.
+ * @throws std::bad_alloc if `resource` runs out.
+ */
+[[nodiscard]] std::optional<chunk> compile(const stmt& statement,
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/*!
+ * Returns the chunk that lox::interpret() runs the statement with for
+ * engine::vm, or nullptr if lox::compile() cannot lower it. It is compiled on
+ * the first call and kept in the statement, see lox::chunk_cache, from the
+ * resource that the nodes of the statement are allocated from. The statement
+ * should not be run by several threads at once.
+ * @throws std::bad_alloc if the resource of the statement runs out.
+ */
+[[nodiscard]] const chunk* cached_chunk(const stmt& statement);
+}
+
+#endif
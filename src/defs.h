@@ -1,6 +1,13 @@
 #ifndef LOX_DEFS_H
 #define LOX_DEFS_H
 
+#include "heap_string.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
 #include <string_view>
 #include <variant>
 #include <type_traits>
@@ -23,14 +30,84 @@
 
 namespace lox {
 
-// FIXME: std::string_view may cause problems in the future.
+// Strings own their characters, so an object never refers to the source or to
+// a temporary it was made from. See lox::heap_string.
 using object = std::variant<std::monostate,
-  std::string,
-  std::string_view,
+  heap_string,
   double,
   bool,
   std::nullptr_t>;
 
+// Index of a variable in lox::environment, assigned by lox::resolve().
+using slot_index = std::uint32_t;
+
+constexpr slot_index unresolved_slot{ std::numeric_limits<slot_index>::max() };
+
+/*!
+ * Remembers the slot of a name that was not resolved ahead of time. The entry
+ * is valid while lox::environment::version is the one it was filled with,
+ * which changes whenever a new variable is declared.
+ */
+struct inline_cache {
+    // 0 if the cache was never filled, environments start at 1.
+    std::uint64_t version{ 0 };
+    slot_index slot{ unresolved_slot };
+    std::size_t hits{ 0 };
+    std::size_t misses{ 0 };
+};
+
+class closure;
+
+/*!
+ * The lox::closure that lox::interpret() compiled a statement into for
+ * engine::closure. Later runs reuse it, so the operators keep the types they
+ * were specialized to. The resolver drops it when a slot of the statement
+ * changes and the optimizer when it rewrites the statement.
+ */
+using closure_cache = std::shared_ptr<const closure>;
+
+struct chunk;
+
+/*!
+ * The bytecode that lox::interpret() compiled a statement into for
+ * engine::vm, see lox::cached_chunk(). The chunk points at the tokens of the
+ * statement, so a copied or moved statement starts without it. Like
+ * lox::closure_cache it is dropped by the resolver when a slot of the
+ * statement changes and by the optimizer when it rewrites the statement.
+ */
+class chunk_cache {
+public:
+    chunk_cache() LOX_NOEXCEPT = default;
+
+    chunk_cache(const chunk_cache& /* other */) LOX_NOEXCEPT
+    {
+    }
+
+    chunk_cache& operator=(const chunk_cache& /* other */) LOX_NOEXCEPT
+    {
+        reset();
+        return *this;
+    }
+
+    [[nodiscard]] const chunk* get() const LOX_NOEXCEPT
+    {
+        return m_chunk.get();
+    }
+
+    void reset(std::shared_ptr<const chunk> compiled = nullptr) LOX_NOEXCEPT
+    {
+        m_chunk = std::move(compiled);
+    }
+
+private:
+    std::shared_ptr<const chunk> m_chunk;
+};
+
+// Dense id of an identifier, assigned by lox::symbol_table.
+using symbol_id = std::uint32_t;
+
+constexpr symbol_id no_symbol{ std::numeric_limits<symbol_id>::max() };
+
 template<class T>
 class copyable {
 private:
@@ -38,12 +115,14 @@ private:
 
 private:
     template<typename... Args>
-    [[nodiscard]] constexpr T constrcut(Args&&... args) LOX_NOEXCEPT
+    [[nodiscard]] constexpr T constrcut(Args&&... args)
     {
         if constexpr (std::is_pointer<T>::value) {
             constexpr std::size_t argc = sizeof...(Args);
             if constexpr (argc > 0) {
-                return new NoPtr_T{ std::forward<Args>(args)... };
+                void* memory =
+                  m_resource->allocate(sizeof(NoPtr_T), alignof(NoPtr_T));
+                return new (memory) NoPtr_T{ std::forward<Args>(args)... };
             }
 
             return nullptr;
@@ -53,42 +132,58 @@ private:
         }
     }
 
+    void destroy() LOX_NOEXCEPT
+    {
+        if constexpr (std::is_pointer<T>::value) {
+            if (m_value) {
+                m_value->~NoPtr_T();
+                m_resource->deallocate(
+                  m_value, sizeof(NoPtr_T), alignof(NoPtr_T));
+            }
+        }
+    }
+
 public:
     template<typename... Args>
-    explicit constexpr copyable(Args&&... args) LOX_NOEXCEPT
+    explicit constexpr copyable(Args&&... args)
       : m_value{ constrcut(std::forward<Args>(args)...) }
     {
     }
 
+    /*!
+     * Allocates the value from `resource`, which has to outlive it. Copies are
+     * allocated from the default resource, like the std::pmr containers do,
+     * a moved value keeps its resource.
+     */
+    template<typename... Args>
+    copyable(std::allocator_arg_t /* tag */,
+      std::pmr::memory_resource* resource,
+      Args&&... args)
+      : m_resource{ resource }
+      , m_value{ constrcut(std::forward<Args>(args)...) }
+    {
+    }
+
     copyable() LOX_NOEXCEPT : m_value{ constrcut() }
     {
     }
 
     ~copyable()
     {
-        if constexpr (std::is_pointer<T>::value) {
-            if (m_value) {
-                delete m_value;
-            }
-        }
+        destroy();
     }
 
-    copyable(const copyable& other) LOX_NOEXCEPT
+    copyable(const copyable& other)
     {
         if constexpr (std::is_pointer<T>::value) {
-            if (other.m_value) {
-                m_value = new NoPtr_T{ *other.m_value };
-            }
-            else {
-                m_value = nullptr;
-            }
+            m_value = other.m_value ? constrcut(*other.m_value) : nullptr;
         }
         else {
             m_value = other.m_value;
         }
     }
 
-    copyable(copyable&& other) LOX_NOEXCEPT
+    copyable(copyable&& other) LOX_NOEXCEPT : m_resource{ other.m_resource }
     {
         m_value = std::move(other.m_value);
         if constexpr (std::is_pointer<T>::value) {
@@ -102,19 +197,13 @@ public:
     {
     }
 
-    copyable& operator=(const copyable& other) LOX_NOEXCEPT
+    copyable& operator=(const copyable& other)
     {
         if constexpr (std::is_pointer<T>::value) {
-            if (m_value) {
-                delete m_value;
-            }
-
-            if (other.m_value) {
-                m_value = new NoPtr_T{ *other.m_value };
-            }
-            else {
-                m_value = nullptr;
-            }
+            // The copy keeps the resource of this value.
+            T copy{ other.m_value ? constrcut(*other.m_value) : nullptr };
+            destroy();
+            m_value = copy;
         }
         else {
             m_value = other.m_value;
@@ -125,12 +214,12 @@ public:
 
     copyable& operator=(copyable&& other) LOX_NOEXCEPT
     {
-        if constexpr (std::is_pointer<T>::value) {
-            if (m_value) {
-                delete m_value;
-            }
+        if (this == &other) {
+            return *this;
         }
 
+        destroy();
+        m_resource = other.m_resource;
         m_value = std::move(other.m_value);
         if constexpr (std::is_pointer<T>::value) {
             other.m_value = nullptr;
@@ -139,6 +228,14 @@ public:
         return *this;
     }
 
+    /*!
+     * Where the value is allocated from.
+     */
+    [[nodiscard]] std::pmr::memory_resource* resource() const LOX_NOEXCEPT
+    {
+        return m_resource;
+    }
+
     [[nodiscard]] operator bool() const LOX_NOEXCEPT
     {
         if constexpr (std::is_pointer<T>::value) {
@@ -189,6 +286,7 @@ public:
     }
 
 private:
+    std::pmr::memory_resource* m_resource{ std::pmr::get_default_resource() };
     T m_value;
 };
 
@@ -2,45 +2,200 @@
 
 #include "token.h"
 #include "exceptions.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+namespace {
+[[noreturn]] void throw_undefined(const lox::token& name)
+{
+    throw lox::runtime_error{ name,
+        "Undefined variable '" + std::string{ name.lexeme } + "'." };
+}
+
+[[nodiscard]] bool is_defined(const lox::environment& env,
+  lox::slot_index slot) LOX_NOEXCEPT
+{
+    return slot < env.values.size() &&
+           !std::holds_alternative<std::monostate>(env.values[slot]);
+}
+
+/*!
+ * Spreads the dense symbols over the table, the index is taken from the high
+ * bits of the product.
+ */
+[[nodiscard]] std::size_t first_index(lox::symbol_id symbol,
+  std::size_t mask) LOX_NOEXCEPT
+{
+    const std::uint64_t hash{ symbol * std::uint64_t{ 0x9e3779b97f4a7c15 } };
+    return static_cast<std::size_t>(hash >> 32) & mask;
+}
+
+void grow(lox::environment& env)
+{
+    using symbol_slot = lox::environment::symbol_slot;
+    std::pmr::vector<symbol_slot> old_slots{ std::move(env.slots) };
+    env.slots = std::pmr::vector<symbol_slot>(
+      std::max<std::size_t>(old_slots.size() * 2, 64),
+      symbol_slot{ lox::no_symbol, lox::unresolved_slot },
+      old_slots.get_allocator());
+    const std::size_t mask{ env.slots.size() - 1 };
+    for (const symbol_slot& old : old_slots) {
+        if (old.symbol == lox::no_symbol) {
+            continue;
+        }
+
+        std::size_t index{ first_index(old.symbol, mask) };
+        while (env.slots[index].symbol != lox::no_symbol) {
+            index = (index + 1) & mask;
+        }
+
+        env.slots[index] = old;
+    }
+}
+}
 
 namespace lox {
 namespace env {
+std::uint64_t new_version() LOX_NOEXCEPT
+{
+    static std::atomic<std::uint64_t> s_last_version{ 0 };
+    return s_last_version.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+slot_index declare(environment& env, symbol_id symbol)
+{
+    assert(symbol != no_symbol);
+    // Keep the load factor under one half.
+    if (env.values.size() * 2 >= env.slots.size()) {
+        grow(env);
+    }
+
+    const std::size_t mask{ env.slots.size() - 1 };
+    for (std::size_t index = first_index(symbol, mask);;
+         index = (index + 1) & mask) {
+        environment::symbol_slot& current = env.slots[index];
+        if (current.symbol == symbol) {
+            return current.slot;
+        }
+
+        if (current.symbol == no_symbol) {
+            const auto slot = static_cast<slot_index>(env.values.size());
+            assert(slot != unresolved_slot);
+            env.values.emplace_back();
+            current = { symbol, slot };
+            env.version = new_version();
+            return slot;
+        }
+    }
+}
+
+slot_index declare(environment& env, const lox::token& name)
+{
+    return declare(env, lox::symbol_of(name));
+}
+
+slot_index declare(environment& env, std::string_view name)
+{
+    return declare(env, lox::symbols().intern(name));
+}
+
+slot_index find(const environment& env, symbol_id symbol) LOX_NOEXCEPT
+{
+    if (symbol == no_symbol || env.slots.empty()) {
+        return unresolved_slot;
+    }
+
+    const std::size_t mask{ env.slots.size() - 1 };
+    for (std::size_t index = first_index(symbol, mask);;
+         index = (index + 1) & mask) {
+        const environment::symbol_slot& current = env.slots[index];
+        if (current.symbol == symbol) {
+            return current.slot;
+        }
+
+        if (current.symbol == no_symbol) {
+            return unresolved_slot;
+        }
+    }
+}
+
+slot_index find(const environment& env, const lox::token& name) LOX_NOEXCEPT
+{
+    if (name.symbol != no_symbol) {
+        return find(env, name.symbol);
+    }
+
+    // A name that was never interned was never declared either.
+    return find(env, lox::symbols().find(name.lexeme));
+}
+
+slot_index find(const environment& env, std::string_view name) LOX_NOEXCEPT
+{
+    return find(env, lox::symbols().find(name));
+}
+
+slot_index find(const environment& env,
+  const lox::token& name,
+  inline_cache& cache) LOX_NOEXCEPT
+{
+    if (cache.version == env.version) {
+        ++cache.hits;
+        return cache.slot;
+    }
+
+    ++cache.misses;
+    cache.slot = find(env, name);
+    cache.version = env.version;
+    return cache.slot;
+}
+
+void define(lox::environment& env, const lox::token& name, lox::object value)
+{
+    define(env, declare(env, name), std::move(value));
+}
+
 void define(lox::environment& env,
-  std::string name,
+  slot_index slot,
   lox::object value) LOX_NOEXCEPT
 {
-    assert(env.values.find(name) == env.values.end());
-
-    env.values.emplace(std::move(name), std::move(value));
+    assert(slot < env.values.size());
+    env.values[slot] = std::move(value);
 }
 
 lox::object get(const environment& env, const lox::token& name)
 {
-    const auto foundIt = std::find_if(env.values.cbegin(),
-      env.values.cend(),
-      [&name](const auto& pair) { return pair.first == name.lexeme; });
+    return get(env, find(env, name), name);
+}
 
-    if (foundIt == env.values.cend()) {
-        throw lox::runtime_error{ name,
-            "Undefined variable '" + std::string{ name.lexeme } + "'." };
+lox::object get(const environment& env,
+  slot_index slot,
+  const lox::token& name)
+{
+    if (!is_defined(env, slot)) {
+        throw_undefined(name);
     }
 
-    return foundIt->second;
+    return env.values[slot];
 }
 
 void assign(environment& env, const lox::token& name, lox::object value)
 {
-    const auto foundIt = std::find_if(env.values.cbegin(),
-      env.values.cend(),
-      [&name](const auto& pair) { return pair.first == name.lexeme; });
+    assign(env, find(env, name), name, std::move(value));
+}
 
-    if (foundIt == env.values.cend()) {
-        throw lox::runtime_error{ name,
-            "Undefined variable '" + std::string{ name.lexeme } + "'." };
+void assign(environment& env,
+  slot_index slot,
+  const lox::token& name,
+  lox::object value)
+{
+    if (!is_defined(env, slot)) {
+        throw_undefined(name);
     }
 
-    std::string var_name{ name.lexeme.data(), name.lexeme.size() };
-    env.values[var_name] = std::move(value);
+    env.values[slot] = std::move(value);
 }
 }
 }
@@ -3,29 +3,122 @@
 
 #include "defs.h"
 
-#include <unordered_map>
-#include <string>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
 
 namespace lox {
 
 struct token;
 
+namespace env {
+/*!
+ * Returns a version that no environment had before. Environments take a new
+ * one whenever they declare a variable, so an inline cache that is checked
+ * against the version is never used with another environment.
+ */
+[[nodiscard]] std::uint64_t new_version() LOX_NOEXCEPT;
+}
+
 struct environment {
-    std::unordered_map<std::string, lox::object> values;
+    /*!
+     * An entry of the table that maps the symbols of the variables to their
+     * slots.
+     */
+    struct symbol_slot {
+        // lox::no_symbol if the entry is empty.
+        symbol_id symbol;
+        slot_index slot;
+    };
+
+    environment() LOX_NOEXCEPT
+      : environment{ std::pmr::get_default_resource() }
+    {
+    }
+
+    /*!
+     * The values of the variables and the symbol table are allocated from
+     * `resource`, which must outlive the environment.
+     */
+    explicit environment(std::pmr::memory_resource* resource) LOX_NOEXCEPT
+      : values{ resource }
+      , slots{ resource }
+      , version{ env::new_version() }
+    {
+    }
+
+    [[nodiscard]] std::pmr::memory_resource* resource() const LOX_NOEXCEPT
+    {
+        return values.get_allocator().resource();
+    }
+
+    // Variable values indexed by their slot. A slot that is declared but not
+    // yet defined holds std::monostate.
+    std::pmr::vector<lox::object> values;
+    // Open addressing table keyed by the symbol, there is one entry for every
+    // slot. The size is always a power of two. Names are never stored or
+    // compared, they are turned into symbols by the scanner.
+    std::pmr::vector<symbol_slot> slots;
+    // Changes when a variable is declared, see lox::inline_cache.
+    std::uint64_t version;
 };
 
 namespace env {
-void define(environment& env, std::string name, lox::object value) LOX_NOEXCEPT;
+/*!
+ * Returns the slot of the variable, reserving a new one if the name was not
+ * declared before.
+ */
+[[nodiscard]] slot_index declare(environment& env, symbol_id symbol);
+[[nodiscard]] slot_index declare(environment& env, const lox::token& name);
+[[nodiscard]] slot_index declare(environment& env, std::string_view name);
+
+/*!
+ * Returns the slot of the variable or lox::unresolved_slot if the name was
+ * never declared.
+ */
+[[nodiscard]] slot_index find(const environment& env,
+  symbol_id symbol) LOX_NOEXCEPT;
+[[nodiscard]] slot_index find(const environment& env,
+  const lox::token& name) LOX_NOEXCEPT;
+[[nodiscard]] slot_index find(const environment& env,
+  std::string_view name) LOX_NOEXCEPT;
+
+/*!
+ * Same as find() but the name is only looked up if a variable was declared
+ * since the cache was filled, or if the cache was filled for another
+ * environment.
+ */
+[[nodiscard]] slot_index find(const environment& env,
+  const lox::token& name,
+  inline_cache& cache) LOX_NOEXCEPT;
+
+void define(environment& env, const lox::token& name, lox::object value);
+void define(environment& env, slot_index slot, lox::object value) LOX_NOEXCEPT;
 
 /*!
  * @throws lox::runtime_error
  */
 [[nodiscard]] lox::object get(const environment& env, const lox::token& name);
 
+/*!
+ * @throws lox::runtime_error
+ */
+[[nodiscard]] lox::object get(const environment& env,
+  slot_index slot,
+  const lox::token& name);
+
 /*!
  * @throws lox::runtime_error
  */
 void assign(environment& env, const lox::token& name, lox::object value);
+
+/*!
+ * @throws lox::runtime_error
+ */
+void assign(environment& env,
+  slot_index slot,
+  const lox::token& name,
+  lox::object value);
 }
 
 }
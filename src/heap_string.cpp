@@ -0,0 +1,376 @@
+#include "heap_string.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace {
+[[nodiscard]] std::size_t hash_text(std::string_view text) noexcept
+{
+    return std::hash<std::string_view>{}(text);
+}
+
+// Marks a hash that was not computed yet. A string whose hash is 0 is hashed
+// again each time.
+constexpr std::size_t s_no_hash{ 0 };
+}
+
+struct lox::heap_string::header {
+    std::atomic<std::size_t> references;
+    std::size_t size;
+    std::pmr::memory_resource* resource;
+    // Written at most once by each thread that asks for it, with the same
+    // value, so relaxed accesses are enough.
+    std::atomic<std::size_t> hash;
+    bool is_rope;
+
+    // A flat string has its characters after the header, a rope has its
+    // pieces there, in the same allocation.
+    [[nodiscard]] char* characters() noexcept
+    {
+        assert(!is_rope);
+        return reinterpret_cast<char*>(this + 1);
+    }
+
+    [[nodiscard]] rope& pieces() noexcept
+    {
+        assert(is_rope);
+        return *reinterpret_cast<rope*>(this + 1);
+    }
+
+    [[nodiscard]] static header* make_flat(std::size_t size,
+      std::pmr::memory_resource* resource);
+    [[nodiscard]] static header* make_rope(heap_string left,
+      heap_string right,
+      std::pmr::memory_resource* resource);
+
+    static void free(header* hdr) noexcept
+    {
+        std::pmr::memory_resource* resource{ hdr->resource };
+        const std::size_t bytes{ allocation_size(hdr->is_rope, hdr->size) };
+        hdr->~header();
+        resource->deallocate(hdr, bytes, alignof(header));
+    }
+
+    [[nodiscard]] static std::size_t allocation_size(bool is_rope,
+      std::size_t size) noexcept;
+};
+
+struct lox::heap_string::rope {
+    heap_string left;
+    heap_string right;
+    // The characters once the rope is flattened, the pieces are dropped then.
+    heap_string flat;
+    // Chains the ropes that are being freed, see destroy().
+    header* next_dead{ nullptr };
+};
+
+std::size_t lox::heap_string::header::allocation_size(bool is_rope,
+  std::size_t size) noexcept
+{
+    return sizeof(header) + (is_rope ? sizeof(rope) : size);
+}
+
+lox::heap_string::header* lox::heap_string::header::make_flat(std::size_t size,
+  std::pmr::memory_resource* resource)
+{
+    assert(size > 0);
+    void* memory =
+      resource->allocate(allocation_size(false, size), alignof(header));
+    return new (memory) header{ { 1 }, size, resource, { s_no_hash }, false };
+}
+
+lox::heap_string::header* lox::heap_string::header::make_rope(heap_string left,
+  heap_string right,
+  std::pmr::memory_resource* resource)
+{
+    static_assert(alignof(header) >= alignof(rope),
+      "The pieces must be aligned after the header.");
+    const std::size_t size{ left.size() + right.size() };
+    assert(size > flat_limit);
+    void* memory =
+      resource->allocate(allocation_size(true, size), alignof(header));
+    auto* hdr =
+      new (memory) header{ { 1 }, size, resource, { s_no_hash }, true };
+    new (&hdr->pieces()) rope{ std::move(left), std::move(right), {} };
+    return hdr;
+}
+
+lox::heap_string::heap_string(header* hdr) noexcept : m_header{ hdr }
+{
+}
+
+lox::heap_string::heap_string(std::string_view text,
+  std::pmr::memory_resource* resource)
+{
+    if (text.empty()) {
+        return;
+    }
+
+    m_header = header::make_flat(text.size(), resource);
+    std::memcpy(m_header->characters(), text.data(), text.size());
+}
+
+lox::heap_string::heap_string(std::string_view left,
+  std::string_view right,
+  std::pmr::memory_resource* resource)
+{
+    if (left.empty() && right.empty()) {
+        return;
+    }
+
+    m_header = header::make_flat(left.size() + right.size(), resource);
+    std::memcpy(m_header->characters(), left.data(), left.size());
+    std::memcpy(m_header->characters() + left.size(), right.data(), right.size());
+}
+
+lox::heap_string::heap_string(const heap_string& other) noexcept
+  : m_header{ other.m_header }
+{
+    if (m_header) {
+        m_header->references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+lox::heap_string::heap_string(heap_string&& other) noexcept
+  : m_header{ other.m_header }
+{
+    other.m_header = nullptr;
+}
+
+lox::heap_string& lox::heap_string::operator=(const heap_string& other) noexcept
+{
+    if (other.m_header) {
+        other.m_header->references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    release();
+    m_header = other.m_header;
+    return *this;
+}
+
+lox::heap_string& lox::heap_string::operator=(heap_string&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_header = other.m_header;
+        other.m_header = nullptr;
+    }
+
+    return *this;
+}
+
+lox::heap_string::~heap_string()
+{
+    release();
+}
+
+std::string_view lox::heap_string::view() const
+{
+    if (!m_header) {
+        return {};
+    }
+
+    if (!m_header->is_rope) {
+        return { m_header->characters(), m_header->size };
+    }
+
+    rope& pieces = m_header->pieces();
+    if (pieces.flat.empty()) {
+        heap_string flat{ header::make_flat(
+          m_header->size, m_header->resource) };
+        flatten(m_header, flat.m_header);
+        pieces.flat = std::move(flat);
+        pieces.left = {};
+        pieces.right = {};
+    }
+
+    return pieces.flat.view();
+}
+
+std::size_t lox::heap_string::size() const noexcept
+{
+    return m_header ? m_header->size : 0;
+}
+
+std::size_t lox::heap_string::hash() const
+{
+    if (!m_header) {
+        static const std::size_t s_empty_hash{ hash_text({}) };
+        return s_empty_hash;
+    }
+
+    std::size_t hash{ m_header->hash.load(std::memory_order_relaxed) };
+    if (hash == s_no_hash) {
+        hash = hash_text(view());
+        m_header->hash.store(hash, std::memory_order_relaxed);
+    }
+
+    return hash;
+}
+
+std::size_t lox::heap_string::use_count() const noexcept
+{
+    return m_header ? m_header->references.load(std::memory_order_relaxed) : 0;
+}
+
+bool lox::heap_string::is_rope() const noexcept
+{
+    return m_header && m_header->is_rope && m_header->pieces().flat.empty();
+}
+
+void lox::heap_string::release() noexcept
+{
+    // The last owner has to see the writes of the others before it frees the
+    // characters.
+    if (m_header &&
+        m_header->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        destroy(m_header);
+    }
+
+    m_header = nullptr;
+}
+
+void lox::heap_string::flatten(header* root, header* flat)
+{
+    // A rope that was made by appending in a loop is as deep as the number of
+    // appends, so the pieces are walked with an explicit stack.
+    char* out = flat->characters();
+    std::vector<header*> pending{ root };
+    while (!pending.empty()) {
+        header* node = pending.back();
+        pending.pop_back();
+        if (!node->is_rope) {
+            std::memcpy(out, node->characters(), node->size);
+            out += node->size;
+            continue;
+        }
+
+        rope& pieces = node->pieces();
+        if (!pieces.flat.empty()) {
+            const std::string_view text{ pieces.flat.view() };
+            std::memcpy(out, text.data(), text.size());
+            out += text.size();
+            continue;
+        }
+
+        pending.push_back(pieces.right.m_header);
+        pending.push_back(pieces.left.m_header);
+    }
+
+    assert(out == flat->characters() + flat->size);
+}
+
+void lox::heap_string::destroy(header* hdr) noexcept
+{
+    // Freeing a rope can free its pieces, which can be ropes as deep as the
+    // number of appends that made them. The dead ropes are kept on a stack
+    // that is linked through the ropes themselves instead of recursing.
+    header* dead{ nullptr };
+    const auto bury = [&dead](header* node) {
+        if (!node->is_rope) {
+            header::free(node);
+            return;
+        }
+
+        node->pieces().next_dead = dead;
+        dead = node;
+    };
+
+    bury(hdr);
+    while (dead) {
+        header* node = dead;
+        rope& pieces = node->pieces();
+        dead = pieces.next_dead;
+        for (heap_string* piece : { &pieces.left, &pieces.right, &pieces.flat }) {
+            header* child = std::exchange(piece->m_header, nullptr);
+            if (child &&
+                child->references.fetch_sub(1, std::memory_order_acq_rel) ==
+                  1) {
+                bury(child);
+            }
+        }
+
+        pieces.~rope();
+        header::free(node);
+    }
+}
+
+lox::heap_string lox::heap_string::concatenate(const heap_string& left,
+  const heap_string& right,
+  std::pmr::memory_resource* resource)
+{
+    if (left.empty()) {
+        return right;
+    }
+
+    if (right.empty()) {
+        return left;
+    }
+
+    const std::size_t size{ left.size() + right.size() };
+    if (size <= flat_limit) {
+        return heap_string{ left.view(), right.view(), resource };
+    }
+
+    // Building a string a few characters at a time extends the last piece
+    // instead of making a node per append. The rope that is appended to is
+    // usually still held by a variable, so the piece is copied.
+    if (left.is_rope()) {
+        const rope& pieces = left.m_header->pieces();
+        if (pieces.right.size() + right.size() <= flat_limit) {
+            return heap_string{ header::make_rope(pieces.left,
+              heap_string{ pieces.right.view(), right.view(), resource },
+              resource) };
+        }
+    }
+
+    return heap_string{ header::make_rope(left, right, resource) };
+}
+
+namespace lox {
+heap_string operator+(const heap_string& left, const heap_string& right)
+{
+    return heap_string::concatenate(
+      left, right, std::pmr::get_default_resource());
+}
+
+bool operator==(const heap_string& left, const heap_string& right)
+{
+    if (left.m_header == right.m_header) {
+        return true;
+    }
+
+    if (left.size() != right.size()) {
+        return false;
+    }
+
+    // Only the hashes that are known are compared, computing them would look
+    // at the characters anyway.
+    const std::size_t left_hash{ left.m_header->hash.load(
+      std::memory_order_relaxed) };
+    const std::size_t right_hash{ right.m_header->hash.load(
+      std::memory_order_relaxed) };
+    if (left_hash != s_no_hash && right_hash != s_no_hash &&
+        left_hash != right_hash) {
+        return false;
+    }
+
+    return left.view() == right.view();
+}
+
+bool operator==(const heap_string& left, std::string_view right)
+{
+    return left.size() == right.size() && left.view() == right;
+}
+
+std::ostream& operator<<(std::ostream& os, const heap_string& str)
+{
+    return os << str.view();
+}
+}
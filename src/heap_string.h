@@ -0,0 +1,138 @@
+#ifndef LOX_HEAP_STRING_H
+#define LOX_HEAP_STRING_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory_resource>
+#include <string_view>
+
+namespace lox {
+
+/*!
+ * An immutable string that is shared through an intrusive reference count.
+ * The length, the hash and the characters are kept in a single allocation, so
+ * copying a string copies a pointer and bumps the count, and comparing two
+ * strings with different hashes does not look at the characters. The empty
+ * string does not allocate.
+ *
+ * Long concatenations are ropes: a node that refers to the two strings it was
+ * made of. Appending to a string is amortized O(1) that way, the characters
+ * are copied into one piece the first time they are looked at, e.g. when the
+ * string is printed or compared, see view().
+ *
+ * The characters are allocated from a memory resource, which has to outlive
+ * the string and every copy of it.
+ *
+ * The count is atomic because the scanner and the parser copy the literals of
+ * one source from several threads. Ropes are only made by the execution
+ * engines and flattening them is not synchronized, a rope must not be looked
+ * at from several threads at once.
+ */
+class heap_string {
+public:
+    /*!
+     * Concatenations up to this size are copied into a new string, longer
+     * ones are ropes.
+     */
+    static constexpr std::size_t flat_limit{ 256 };
+
+public:
+    heap_string() noexcept = default;
+
+    explicit heap_string(std::string_view text,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    /*!
+     * Makes the concatenation of the two strings with a single allocation.
+     */
+    heap_string(std::string_view left,
+      std::string_view right,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    heap_string(const heap_string& other) noexcept;
+    heap_string(heap_string&& other) noexcept;
+    heap_string& operator=(const heap_string& other) noexcept;
+    heap_string& operator=(heap_string&& other) noexcept;
+    ~heap_string();
+
+    /*!
+     * The characters of the string. A rope is flattened on the first call,
+     * the strings that share it see the flat characters from then on.
+     */
+    [[nodiscard]] std::string_view view() const;
+
+    [[nodiscard]] operator std::string_view() const
+    {
+        return view();
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_header == nullptr;
+    }
+
+    /*!
+     * The same as std::hash<std::string_view> of the characters, computed
+     * the first time it is asked for.
+     */
+    [[nodiscard]] std::size_t hash() const;
+
+    /*!
+     * The number of strings that share the characters, 0 for the empty string.
+     */
+    [[nodiscard]] std::size_t use_count() const noexcept;
+
+    /*!
+     * True if the string is a rope that was not flattened yet.
+     */
+    [[nodiscard]] bool is_rope() const noexcept;
+
+    /*!
+     * Same as `left + right`, but the new string and the rope nodes are
+     * allocated from `resource`. Flattening a rope allocates from the
+     * resource of the rope.
+     */
+    [[nodiscard]] static heap_string concatenate(const heap_string& left,
+      const heap_string& right,
+      std::pmr::memory_resource* resource);
+
+    // Hidden friends, so that they do not hide the operators of lox::object
+    // from the code in namespace lox.
+
+    /*!
+     * Concatenates the strings on the default resource. The result is a rope
+     * if it is longer than flat_limit, appending a short string to a rope
+     * copies it into the last piece of the rope while that stays under
+     * flat_limit.
+     */
+    friend heap_string operator+(const heap_string& left,
+      const heap_string& right);
+    friend bool operator==(const heap_string& left, const heap_string& right);
+    friend bool operator==(const heap_string& left, std::string_view right);
+    friend std::ostream& operator<<(std::ostream& os, const heap_string& str);
+
+private:
+    struct header;
+    struct rope;
+
+    explicit heap_string(header* hdr) noexcept;
+
+    void release() noexcept;
+
+    /*!
+     * Copies the characters of the rope `root` into the flat string `flat`.
+     */
+    static void flatten(header* root, header* flat);
+    static void destroy(header* hdr) noexcept;
+
+private:
+    header* m_header{ nullptr };
+};
+
+static_assert(sizeof(heap_string) == sizeof(void*),
+  "lox::heap_string must be a single pointer.");
+}
+
+#endif
@@ -1,11 +1,11 @@
 #include "interpreter.h"
 
-#include "ast_printer.h"
 #include "environment.h"
-#include "utils.h"
+#include "operations.h"
+#include "closure.h"
+#include "compiler.h"
+#include "vm.h"
 
-#include <optional>
-#include <sstream>
 #include <cassert>
 
 #ifndef LOX_EXCEPTION_ENABLED
@@ -15,9 +15,15 @@
 namespace {
 using token_type = lox::token::token_type;
 
+using lox::ops::check_concatenation_types;
+using lox::ops::check_number_operand;
+using lox::ops::is_truthy;
+
 template<typename>
 [[maybe_unused]] constexpr bool always_false_v = false;
 
+using lox::flat::is_node_v;
+
 // Forward declerations
 
 lox::object internal_interpret(const lox::expr& expression,
@@ -26,106 +32,44 @@ lox::object internal_interpret(const lox::stmt& statement,
   lox::environment& env);
 
 /*!
- * Checks if the left and right operands are numbers. If the right operand is
- * not provided, it checks if the left operand is a number.
- *
- * @internal
- * @param token The token that's being processed.
- * @param left The left operand.
- * @param right The right operand. Optional.
- * @throws lox::runtime_error If the operands are not numbers.
+ * Evaluates the children of the pointer based AST.
  */
-void check_number_operand(const lox::token& token,
-  const lox::object& left,
-  std::optional<std::reference_wrapper<const lox::object>> right = {})
-{
-    if (right.has_value() && std::holds_alternative<double>(left) &&
-        std::holds_alternative<double>(right->get())) {
-        if (std::get<double>(right->get()) == 0) {
-            constexpr const std::string_view msg{ "Division by zero." };
-            lox::log_error(token.line_str, token.line, token.column_end, msg);
-            throw lox::runtime_error{ token, msg.data() };
-        }
+struct tree_walker {
+    lox::environment& env;
 
-        return;
+    [[nodiscard]] lox::object operator()(
+      const lox::copyable<lox::expr*>& child) const
+    {
+        return internal_interpret(*child, env);
     }
 
-    if (!right.has_value() && std::holds_alternative<double>(left)) {
-        return;
+    [[nodiscard]] static bool has(const lox::copyable<lox::expr*>& child)
+    {
+        return child;
     }
-
-    constexpr const std::string_view msg{ "Operand must be a number." };
-    if (!std::holds_alternative<double>(left)) {
-        lox::log_error(token.line_str, token.line, 0, msg);
-        throw lox::runtime_error{ token, msg.data() };
-    }
-
-    lox::log_error(token.line_str, token.line, token.column_end, msg);
-    throw lox::runtime_error{ token, msg.data() };
-}
+};
 
 /*!
- * Checks if the left and right operands are strings or numbers. If the right
- * operand is not provided, it checks if the left operand is a string or a
- * number.
- *
- * @internal
- * @param token The token that's being processed.
- * @param left The left operand.
- * @param right The right operand. Optional.
- * @throws lox::runtime_error If the operands are not strings or numbers.
+ * Evaluates the children of a lox::flat::program.
  */
-void check_concatenation_types(const lox::token& token,
-  const lox::object& left,
-  std::optional<std::reference_wrapper<const lox::object>> right = {})
-{
-    const auto is_valid = [](const auto& obj) -> bool {
-        return std::holds_alternative<std::string_view>(obj) ||
-               std::holds_alternative<std::string>(obj) ||
-               std::holds_alternative<double>(obj);
-    };
-
-    if (right.has_value() && is_valid(left) && is_valid(right->get())) {
-        return;
-    }
-
-    if (!right.has_value() && is_valid(left)) {
-        return;
-    }
+struct flat_walker {
+    const lox::flat::program& program;
+    lox::environment& env;
 
-    constexpr const char* msg{ "Operand must be a string." };
-    lox::log_error(token.line_str, token.line, token.column_end, msg);
-    throw lox::runtime_error{ token, msg };
-}
+    [[nodiscard]] lox::object operator()(lox::flat::node_index child) const;
 
-/*!
- * An object is considered truthy if it's a non-empty string, a non-zero number
- * or a boolean true.
- *
- * @internal
- * @param object The object to check.
- * @return True if the object is truthy, false otherwise.
- */
-[[nodiscard]] bool is_truthy(const lox::object& object) LOX_NOEXCEPT
-{
-    if (std::holds_alternative<std::string_view>(object)) {
-        return !std::get<std::string_view>(object).empty();
-    }
-    else if (std::holds_alternative<double>(object)) {
-        return std::get<double>(object) > 0;
-    }
-    else if (std::holds_alternative<bool>(object)) {
-        return std::get<bool>(object);
+    [[nodiscard]] static bool has(lox::flat::node_index child)
+    {
+        return child != lox::flat::no_node;
     }
+};
 
-    return false;
-}
-
-[[nodiscard]] lox::object interpret_binary(const lox::binary& binary,
-  lox::environment& env)
+template<typename Binary, typename Walker>
+[[nodiscard]] lox::object interpret_binary(const Binary& binary,
+  const Walker& walk)
 {
-    const auto left = internal_interpret(*binary.left, env);
-    const auto right = internal_interpret(*binary.right, env);
+    const auto left = walk(binary.left);
+    const auto right = walk(binary.right);
 
     const auto type = binary.oprtor.type;
     if (type == token_type::MINUS) {
@@ -147,24 +91,7 @@ void check_concatenation_types(const lox::token& token,
         }
 
         check_concatenation_types(binary.oprtor, left, right);
-
-        const auto get_value = [](auto&& val) -> std::string {
-            std::stringstream ss;
-            if (std::holds_alternative<std::string_view>(val)) {
-                ss << std::get<std::string_view>(val);
-            }
-            else if (std::holds_alternative<double>(val)) {
-                ss << std::get<double>(val);
-            }
-            else {
-                assert(std::holds_alternative<std::string>(val));
-                ss << std::get<std::string>(val);
-            }
-
-            return ss.str();
-        };
-
-        return get_value(left) + get_value(right);
+        return lox::ops::concatenate(left, right, walk.env.resource());
     }
     else if (type == token_type::GREATER) {
         check_number_operand(binary.oprtor, left, right);
@@ -193,17 +120,16 @@ void check_concatenation_types(const lox::token& token,
     return {};
 }
 
-[[nodiscard]] lox::object interpret_unary(const lox::unary& expr,
-  lox::environment& env)
+template<typename Unary, typename Walker>
+[[nodiscard]] lox::object interpret_unary(const Unary& expr, const Walker& walk)
 {
-    const auto right = internal_interpret(*expr.right, env);
+    const auto right = walk(expr.right);
     const auto type = expr.oprtor.type;
     if (type == token_type::MINUS) {
         check_number_operand(expr.oprtor, right);
         return std::get<double>(right) * -1;
     }
     else if (type == token_type::BANG) {
-        assert(std::holds_alternative<double>(right));
         return !is_truthy(right);
     }
 
@@ -211,65 +137,104 @@ void check_concatenation_types(const lox::token& token,
     return {};
 }
 
-[[nodiscard]] lox::object interpret_var_stmt(const lox::var_stmt& stmt,
-  lox::environment& env)
+template<typename Ternary, typename Walker>
+[[nodiscard]] lox::object interpret_ternary(const Ternary& expr,
+  const Walker& walk)
 {
+    if (is_truthy(walk(expr.first))) {
+        return walk(expr.second);
+    }
+
+    if (walk.has(expr.third)) {
+        return walk(expr.third);
+    }
+
+    return {};
+}
+
+template<typename VarStmt, typename Walker>
+[[nodiscard]] lox::object interpret_var_stmt(const VarStmt& stmt,
+  const Walker& walk)
+{
+    lox::environment& env = walk.env;
     lox::object value{ nullptr };
-    if (stmt.expression) {
-        value = internal_interpret(*stmt.expression, env);
+    if (walk.has(stmt.expression)) {
+        value = walk(stmt.expression);
+    }
+
+    if (stmt.slot != lox::unresolved_slot) {
+        lox::env::define(env, stmt.slot, value);
+    }
+    else {
+        lox::env::define(env, stmt.name, value);
     }
 
-    lox::env::define(env,
-      std::string{ stmt.name.lexeme.data(), stmt.name.lexeme.size() },
-      value);
     return value;
 }
 
-[[nodiscard]] lox::object interpret_assignment(const lox::assignment& expr,
-  lox::environment& env)
+/*!
+ * Returns the slot of a variable or an assignment. Names that were not
+ * resolved ahead of time go through the inline cache of the node, the flat
+ * nodes do not have one.
+ */
+template<typename Node>
+[[nodiscard]] lox::slot_index find_slot(const Node& node,
+  const lox::environment& env) LOX_NOEXCEPT
 {
-    lox::object value{ internal_interpret(*expr.value, env) };
+    if (node.slot != lox::unresolved_slot) {
+        return node.slot;
+    }
+
+    if constexpr (requires { node.cache; }) {
+        return lox::env::find(env, node.name, node.cache);
+    }
+    else {
+        return lox::env::find(env, node.name);
+    }
+}
 
-    lox::env::assign(env, expr.name, value);
+template<typename Assignment, typename Walker>
+[[nodiscard]] lox::object interpret_assignment(const Assignment& expr,
+  const Walker& walk)
+{
+    lox::environment& env = walk.env;
+    lox::object value{ walk(expr.value) };
+    lox::env::assign(env, find_slot(expr, env), expr.name, value);
     return value;
 }
 
 constexpr auto interpreter_visitor = [](auto&& arg,
-                                       lox::environment& env) -> lox::object {
+                                       const auto& walk) -> lox::object {
     using T = std::decay_t<decltype(arg)>;
-    if constexpr (std::is_same_v<T, lox::literal>) {
+    if constexpr (is_node_v<T, lox::literal>) {
         return arg.value;
     }
-    else if constexpr (std::is_same_v<T, lox::grouping>) {
-        return internal_interpret(*arg.expression, env);
+    else if constexpr (is_node_v<T, lox::grouping>) {
+        return walk(arg.expression);
     }
-    else if constexpr (std::is_same_v<T, lox::unary>) {
-        return interpret_unary(arg, env);
+    else if constexpr (is_node_v<T, lox::unary>) {
+        return interpret_unary(arg, walk);
     }
-    else if constexpr (std::is_same_v<T, lox::binary>) {
-        return interpret_binary(arg, env);
+    else if constexpr (is_node_v<T, lox::binary>) {
+        return interpret_binary(arg, walk);
     }
-    else if constexpr (std::is_same_v<T, lox::ternary>) {
-        return {};
+    else if constexpr (is_node_v<T, lox::ternary>) {
+        return interpret_ternary(arg, walk);
     }
-    else if constexpr (std::is_same_v<T, lox::expr_stmt>) {
-        return internal_interpret(*arg.expression, env);
+    else if constexpr (is_node_v<T, lox::expr_stmt>) {
+        return walk(arg.expression);
     }
-    else if constexpr (std::is_same_v<T, lox::print_stmt>) {
-        std::stringstream ss;
-        ss << internal_interpret(*arg.expression, env);
-        std::string result{ ss.str() };
-        std::cout << result;
-        return result;
+    else if constexpr (is_node_v<T, lox::print_stmt>) {
+        return lox::ops::print(walk(arg.expression), walk.env.resource());
     }
-    else if constexpr (std::is_same_v<T, lox::var_stmt>) {
-        return interpret_var_stmt(arg, env);
+    else if constexpr (is_node_v<T, lox::var_stmt>) {
+        return interpret_var_stmt(arg, walk);
     }
-    else if constexpr (std::is_same_v<T, lox::variable>) {
-        return lox::env::get(env, arg.name);
+    else if constexpr (is_node_v<T, lox::variable>) {
+        return lox::env::get(walk.env, find_slot(arg, walk.env), arg.name);
     }
-    else if constexpr (std::is_same_v<T, lox::assignment>) {
-        return interpret_assignment(arg, env);
+    else if constexpr (is_node_v<T, lox::assignment>) {
+        return interpret_assignment(arg, walk);
     }
     else if constexpr (std::is_same_v<T, std::monostate>) {
         return {};
@@ -286,7 +251,8 @@ lox::object internal_interpret(const lox::expr& expression,
 {
     return std::visit(
       [&env](auto&& arg) -> lox::object {
-          return interpreter_visitor(std::forward<decltype(arg)>(arg), env);
+          return interpreter_visitor(
+            std::forward<decltype(arg)>(arg), tree_walker{ env });
       },
       expression);
 }
@@ -296,17 +262,88 @@ lox::object internal_interpret(const lox::stmt& statement,
 {
     return std::visit(
       [&env](auto&& arg) -> lox::object {
-          return interpreter_visitor(std::forward<decltype(arg)>(arg), env);
+          return interpreter_visitor(
+            std::forward<decltype(arg)>(arg), tree_walker{ env });
       },
       statement);
 }
+
+lox::object flat_walker::operator()(lox::flat::node_index child) const
+{
+    if (child == lox::flat::no_node) {
+        return {};
+    }
+
+    return program.visit(child, [this](const auto& arg) -> lox::object {
+        return interpreter_visitor(arg, *this);
+    });
+}
+
+/*!
+ * Adds up the inline caches of the nodes.
+ */
+struct cache_collector {
+    lox::inline_cache_stats& stats;
+
+    void operator()(const lox::copyable<lox::expr*>& child) const LOX_NOEXCEPT
+    {
+        if (child) {
+            std::visit(*this, static_cast<const lox::expr&>(*child));
+        }
+    }
+
+    void operator()(std::monostate /* empty */) const LOX_NOEXCEPT
+    {
+    }
+
+    void operator()(const lox::token& /* name */) const LOX_NOEXCEPT
+    {
+    }
+
+    void operator()(const lox::object& /* value */) const LOX_NOEXCEPT
+    {
+    }
+
+    void operator()(lox::slot_index /* slot */) const LOX_NOEXCEPT
+    {
+    }
+
+    template<typename Node>
+    void operator()(const Node& node) const LOX_NOEXCEPT
+    {
+        if constexpr (std::is_same_v<Node, lox::variable> ||
+                      std::is_same_v<Node, lox::assignment>) {
+            stats.hits += node.cache.hits;
+            stats.misses += node.cache.misses;
+        }
+
+        lox::for_each_field(node, *this);
+    }
+};
 }
 
 zx::expected<lox::object, lox::runtime_error> lox::interpret(
   const stmt& statement,
-  environment& env)
+  environment& env,
+  engine eng)
 {
     try {
+        if (eng == engine::vm) {
+            // Compiled on the first run and kept in the statement. Statements
+            // that are too large for a chunk are walked instead.
+            if (const chunk* chk = lox::cached_chunk(statement)) {
+                return zx::expected<object, lox::runtime_error>{ lox::execute(
+                  *chk, env) };
+            }
+        }
+
+        if (eng == engine::closure) {
+            // Compiled on the first run and kept in the statement.
+            return zx::expected<object, lox::runtime_error>{
+                lox::cached_closure(statement)(env)
+            };
+        }
+
         return zx::expected<object, lox::runtime_error>{ internal_interpret(
           statement, env) };
     }
@@ -315,3 +352,29 @@ zx::expected<lox::object, lox::runtime_error> lox::interpret(
           ex } };
     }
 }
+
+zx::expected<lox::object, lox::runtime_error> lox::interpret(
+  const flat::program& program,
+  flat::node_index statement,
+  environment& env)
+{
+    try {
+        return zx::expected<object, lox::runtime_error>{ flat_walker{
+          program, env }(statement) };
+    }
+    catch (lox::runtime_error ex) {
+        return zx::expected<object, lox::runtime_error>{ lox::runtime_error{
+          ex } };
+    }
+}
+
+lox::inline_cache_stats lox::cache_stats(
+  const std::vector<stmt>& statements) LOX_NOEXCEPT
+{
+    inline_cache_stats stats{};
+    for (const auto& statement : statements) {
+        std::visit(cache_collector{ stats }, statement);
+    }
+
+    return stats;
+}
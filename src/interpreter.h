@@ -6,14 +6,57 @@
 
 #include <zmcx/expected.h>
 
+#include <vector>
+
 namespace lox {
 struct environment;
 
+enum class engine {
+    // Compiles the statement to bytecode and runs it on the stack VM. The
+    // chunk is compiled on the first run and kept in the statement for the
+    // next ones, see lox::cached_chunk().
+    vm,
+    // Walks the AST directly. Kept as the reference implementation.
+    tree_walker,
+    // Compiles the statement into nested function objects on its first run
+    // and keeps them in the statement for the next ones, see lox::closure and
+    // lox::cached_closure().
+    closure,
+};
+
 /*!
+ * Runs the statement against the environment. Everything that a run allocates
+ * on the heap comes from the memory resource of the environment, except for
+ * the chunk and the closure that are kept in the statement.
  * @throws lox::runtime_error
+ * @throws std::bad_alloc if a memory resource runs out, it is not turned into
+ * a runtime error.
  */
 zx::expected<object, lox::runtime_error> interpret(const stmt& statement,
+  environment& env,
+  engine eng = engine::vm);
+
+/*!
+ * Runs one of the statements of the program by walking the flat nodes, the
+ * same way engine::tree_walker runs a lox::stmt.
+ * @throws lox::runtime_error
+ */
+zx::expected<object, lox::runtime_error> interpret(const flat::program& program,
+  flat::node_index statement,
   environment& env);
+
+/*!
+ * The inline caches of the variables and the assignments that the tree walker
+ * runs without a resolved slot, see lox::inline_cache. The caches are stored
+ * in the nodes, so a statement should not be run by several threads at once.
+ */
+struct inline_cache_stats {
+    std::size_t hits{ 0 };
+    std::size_t misses{ 0 };
+};
+
+[[nodiscard]] inline_cache_stats cache_stats(
+  const std::vector<stmt>& statements) LOX_NOEXCEPT;
 };
 
 #endif
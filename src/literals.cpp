@@ -0,0 +1,257 @@
+#include "literals.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <string>
+#include <utility>
+
+using token_type = lox::token::token_type;
+
+namespace {
+constexpr std::array<std::pair<std::string_view, token_type>, 15> s_keywords{ {
+  { "and", token_type::AND },
+  { "class", token_type::CLASS },
+  { "else", token_type::ELSE },
+  { "false", token_type::FALSE },
+  { "for", token_type::FOR },
+  { "fun", token_type::FUN },
+  { "if", token_type::IF },
+  { "nil", token_type::NIL },
+  { "or", token_type::OR },
+  { "print", token_type::PRINT },
+  { "super", token_type::SUPER },
+  { "this", token_type::THIS },
+  { "true", token_type::TRUE },
+  { "var", token_type::VAR },
+  { "while", token_type::WHILE },
+} };
+
+constexpr std::size_t s_keyword_table_size{ 32 };
+
+[[nodiscard]] constexpr std::size_t keyword_hash(std::string_view text,
+  std::uint32_t seed) LOX_NOEXCEPT
+{
+    std::uint32_t hash{ seed ^ static_cast<std::uint32_t>(text.size()) };
+    hash = hash * 31 + static_cast<unsigned char>(text[0]);
+    hash = hash * 31 + static_cast<unsigned char>(text[1]);
+    hash = hash * 31 + static_cast<unsigned char>(text.back());
+    return (hash ^ (hash >> 11)) % s_keyword_table_size;
+}
+
+/*!
+ * Finds a seed for which keyword_hash() has no collisions between keywords.
+ */
+[[nodiscard]] consteval std::uint32_t find_keyword_seed()
+{
+    for (std::uint32_t seed = 0; seed < 100'000; ++seed) {
+        std::array<bool, s_keyword_table_size> used{};
+        bool is_perfect{ true };
+        for (const auto& [text, type] : s_keywords) {
+            const std::size_t index{ keyword_hash(text, seed) };
+            if (used[index]) {
+                is_perfect = false;
+                break;
+            }
+
+            used[index] = true;
+        }
+
+        if (is_perfect) {
+            return seed;
+        }
+    }
+
+    return std::numeric_limits<std::uint32_t>::max();
+}
+
+constexpr std::uint32_t s_keyword_seed{ find_keyword_seed() };
+static_assert(s_keyword_seed != std::numeric_limits<std::uint32_t>::max(),
+  "No perfect hash was found for the keywords.");
+
+constexpr auto s_keyword_table = []() {
+    std::array<std::pair<std::string_view, token_type>, s_keyword_table_size>
+      table{};
+    for (auto& entry : table) {
+        entry.second = token_type::IDENTIFIER;
+    }
+
+    for (const auto& keyword : s_keywords) {
+        table[keyword_hash(keyword.first, s_keyword_seed)] = keyword;
+    }
+
+    return table;
+}();
+
+/*!
+ * Folds the hash into 32 bits so that the low bits that are used as the table
+ * index depend on all of them. The bits of small integral doubles only differ
+ * in the high bits.
+ */
+[[nodiscard]] constexpr std::uint32_t mix(std::uint64_t hash) LOX_NOEXCEPT
+{
+    hash ^= hash >> 32;
+    hash *= 0x9e3779b97f4a7c15;
+    return static_cast<std::uint32_t>(hash >> 32);
+}
+
+constexpr std::size_t s_shortest_keyword{ 2 };
+constexpr std::size_t s_longest_keyword{ 5 };
+
+static_assert(
+  []() {
+      for (const auto& [text, type] : s_keywords) {
+          if (text.size() < s_shortest_keyword ||
+              text.size() > s_longest_keyword) {
+              return false;
+          }
+      }
+
+      return true;
+  }(),
+  "Keyword length limits are out of date.");
+}
+
+lox::token::token_type lox::literals::classify_identifier(
+  std::string_view text) LOX_NOEXCEPT
+{
+    if (text.size() < s_shortest_keyword || text.size() > s_longest_keyword) {
+        return token_type::IDENTIFIER;
+    }
+
+    const auto& [keyword, type] =
+      s_keyword_table[keyword_hash(text, s_keyword_seed)];
+    return keyword == text ? type : token_type::IDENTIFIER;
+}
+
+double lox::literals::parse_number(std::string_view text) LOX_NOEXCEPT
+{
+    double number{ 0 };
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    [[maybe_unused]] const auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), number);
+    assert(end == text.data() + text.size());
+    if (error == std::errc::result_out_of_range) {
+        // Number literals have no sign and no exponent, so the literal is too
+        // large if its integer part is not zero and too small otherwise.
+        const std::string_view integer_part{ text.substr(0, text.find('.')) };
+        const bool is_too_large{ integer_part.find_first_not_of('0') !=
+                                 std::string_view::npos };
+        number = is_too_large ? std::numeric_limits<double>::infinity() : 0.0;
+    }
+#else
+    // strtod needs a null terminated string. Literals that fit in the buffer
+    // do not allocate.
+    std::array<char, 64> buffer{};
+    if (text.size() < buffer.size()) {
+        std::copy(text.cbegin(), text.cend(), buffer.begin());
+        number = std::strtod(buffer.data(), nullptr);
+    }
+    else {
+        number = std::strtod(std::string{ text }.c_str(), nullptr);
+    }
+#endif
+
+    return number;
+}
+
+lox::literals::literal_table::literal_table(
+  std::pmr::vector<lox::object>& literals) LOX_NOEXCEPT
+  : m_literals{ literals }
+  , m_slots{ literals.get_allocator() }
+{
+    assert(m_literals.empty());
+}
+
+std::uint32_t lox::literals::literal_table::intern(double number)
+{
+    return intern(number, mix(std::bit_cast<std::uint64_t>(number)));
+}
+
+std::uint32_t lox::literals::literal_table::intern(std::string_view str)
+{
+    return intern(str, mix(std::hash<std::string_view>{}(str)));
+}
+
+std::uint32_t lox::literals::literal_table::intern(const lox::heap_string& str)
+{
+    return intern(str, mix(str.hash()));
+}
+
+template<typename T>
+std::uint32_t lox::literals::literal_table::intern(const T& literal,
+  std::uint32_t hash)
+{
+    // Strings are looked up by their characters and stored as heap strings.
+    using stored_type = std::
+      conditional_t<std::is_same_v<T, double>, double, lox::heap_string>;
+
+    // Keep the load factor under one half.
+    if (m_literals.size() * 2 >= m_slots.size()) {
+        grow();
+    }
+
+    const std::size_t mask{ m_slots.size() - 1 };
+    for (std::size_t index = hash & mask;; index = (index + 1) & mask) {
+        slot& current = m_slots[index];
+        if (current.literal == s_empty_slot) {
+            current = { static_cast<std::uint32_t>(m_literals.size()), hash };
+            if constexpr (std::is_same_v<T, std::string_view>) {
+                // New strings come from the same resource as the table.
+                m_literals.emplace_back(std::in_place_type<stored_type>,
+                  literal,
+                  m_literals.get_allocator().resource());
+            }
+            else {
+                m_literals.emplace_back(
+                  std::in_place_type<stored_type>, literal);
+            }
+            return current.literal;
+        }
+
+        if (current.hash != hash) {
+            continue;
+        }
+
+        const auto* existing =
+          std::get_if<stored_type>(&m_literals[current.literal]);
+        if constexpr (std::is_same_v<T, double>) {
+            // Compare the bits so that 0 and -0 are kept apart.
+            if (existing &&
+                std::bit_cast<std::uint64_t>(*existing) ==
+                  std::bit_cast<std::uint64_t>(literal)) {
+                return current.literal;
+            }
+        }
+        else {
+            if (existing && *existing == literal) {
+                return current.literal;
+            }
+        }
+    }
+}
+
+void lox::literals::literal_table::grow()
+{
+    std::pmr::vector<slot> old_slots{ std::move(m_slots) };
+    m_slots.assign(
+      std::max<std::size_t>(old_slots.size() * 2, 64), slot{ s_empty_slot, 0 });
+    const std::size_t mask{ m_slots.size() - 1 };
+    for (const slot& old : old_slots) {
+        if (old.literal == s_empty_slot) {
+            continue;
+        }
+
+        std::size_t index{ old.hash & mask };
+        while (m_slots[index].literal != s_empty_slot) {
+            index = (index + 1) & mask;
+        }
+
+        m_slots[index] = old;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef LOX_LITERALS_H
+#define LOX_LITERALS_H
+
+#include "token.h"
+#include "defs.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+/*!
+ * Decoding of the literal parts of the source: keywords, numbers and strings.
+ * None of the functions here allocate except for growing the literal table and
+ * storing the characters of a new string literal.
+ */
+namespace lox::literals {
+
+/*!
+ * Returns the keyword type of `text` or token_type::IDENTIFIER if it is not a
+ * keyword. The lookup uses a perfect hash that is computed at compile time.
+ */
+[[nodiscard]] token::token_type classify_identifier(
+  std::string_view text) LOX_NOEXCEPT;
+
+/*!
+ * Parses a number literal as it is accepted by the scanner, digits optionally
+ * followed by a `.` and more digits. Numbers that are too large to be
+ * represented are infinity, numbers that are too small are zero.
+ */
+[[nodiscard]] double parse_number(std::string_view text) LOX_NOEXCEPT;
+
+/*!
+ * Stores literals in a constant table and gives identical literals the same
+ * index. The lookup table is allocated from the same memory resource as the
+ * literals.
+ */
+class literal_table {
+public:
+    explicit literal_table(
+      std::pmr::vector<lox::object>& literals) LOX_NOEXCEPT;
+
+    [[nodiscard]] std::uint32_t intern(double number);
+    [[nodiscard]] std::uint32_t intern(std::string_view str);
+    /*!
+     * Shares the characters of the string if it is not in the table yet.
+     */
+    [[nodiscard]] std::uint32_t intern(const lox::heap_string& str);
+
+private:
+    struct slot {
+        // Index into m_literals or s_empty_slot.
+        std::uint32_t literal;
+        // The 32-bit hash of the literal, used to skip most comparisons and to
+        // grow without going back to the literals.
+        std::uint32_t hash;
+    };
+
+    static constexpr std::uint32_t s_empty_slot{ compact_token::no_literal };
+
+    template<typename T>
+    [[nodiscard]] std::uint32_t intern(const T& literal, std::uint32_t hash);
+
+    void grow();
+
+private:
+    std::pmr::vector<lox::object>& m_literals;
+    // Open addressing table. The size is always a power of two.
+    std::pmr::vector<slot> m_slots;
+};
+}
+
+#endif
@@ -1,25 +1,45 @@
 #include "scanner.h"
 
+#include "arena.h"
 #include "parser.h"
+#include "program_cache.h"
 #include "ast_printer.h"
 #include "interpreter.h"
+#include "compiler.h"
+#include "optimizer.h"
+#include "resolver.h"
 #include "environment.h"
+#include "source.h"
 #include "exceptions.h"
 #include "defs.h"
 
-#include <fstream>
+#include <charconv>
 #include <iostream>
-#include <sstream>
+#include <optional>
 #include <string_view>
+#include <functional>
 #include <map>
+#include <new>
 #include <sysexits.h>
 #include <cassert>
 
 namespace {
 constexpr std::string_view s_version{ "v0.0.0.1" };
 
+constexpr std::string_view s_usage{
+    "Usage: lox++ [--verbose] [--engine=vm|tree|closure] [--no-optimize] "
+    "[--memory-limit=bytes] [--cache=dir] [script|-]"
+};
+
+constexpr std::string_view s_memory_limit_flag{ "--memory-limit=" };
+constexpr std::string_view s_cache_flag{ "--cache=" };
+
 struct arguments {
     bool verbose{ false };
+    lox::engine engine{ lox::engine::vm };
+    bool optimize{ true };
+    std::size_t memory_limit{ lox::arena_resource::no_limit };
+    std::string_view cache_directory{};
     std::string_view file_path{};
 };
 
@@ -41,15 +61,51 @@ const std::map<std::string_view,
            std::cout << s_version << '\n';
        } } };
 
+[[nodiscard]] bool parse_size(std::string_view text,
+  std::size_t& size) noexcept
+{
+    const char* end{ text.data() + text.size() };
+    const auto [ptr, error] = std::from_chars(text.data(), end, size);
+    return !text.empty() && error == std::errc{} && ptr == end;
+}
+
 arguments parse_args(int argc, char** argv) noexcept
 {
     arguments args{};
     for (int i = 1; i < argc; ++i) {
-        if (std::string_view{ "--verbose" } == argv[i]) {
+        const std::string_view arg{ argv[i] };
+        if (arg == "--verbose") {
             args.verbose = true;
         }
+        else if (arg == "--engine=vm") {
+            args.engine = lox::engine::vm;
+        }
+        else if (arg == "--engine=tree") {
+            args.engine = lox::engine::tree_walker;
+        }
+        else if (arg == "--engine=closure") {
+            args.engine = lox::engine::closure;
+        }
+        else if (arg == "--no-optimize") {
+            args.optimize = false;
+        }
+        else if (arg.starts_with(s_memory_limit_flag)) {
+            if (!parse_size(arg.substr(s_memory_limit_flag.size()),
+                  args.memory_limit)) {
+                std::cerr << s_usage << '\n';
+                exit(EX_USAGE);
+            }
+        }
+        else if (arg.starts_with(s_cache_flag) &&
+                 arg.size() > s_cache_flag.size()) {
+            args.cache_directory = arg.substr(s_cache_flag.size());
+        }
+        else if (args.file_path.empty() && !arg.starts_with("--")) {
+            args.file_path = arg;
+        }
         else {
-            args.file_path = argv[i];
+            std::cerr << s_usage << '\n';
+            exit(EX_USAGE);
         }
     }
 
@@ -59,17 +115,22 @@ arguments parse_args(int argc, char** argv) noexcept
 void interpret(const std::vector<lox::stmt>& statements,
   lox::environment& env,
   bool exit_on_error,
-  bool is_verbose) LOX_NOEXCEPT
+  const arguments& args)
 {
     assert(!statements.empty());
     for (const auto& stmt : statements) {
-        if (is_verbose) {
+        if (args.verbose) {
             std::cout << stmt << '\n';
+            if (args.engine == lox::engine::vm) {
+                if (const lox::chunk* chk = lox::cached_chunk(stmt)) {
+                    std::cout << *chk;
+                }
+            }
         }
 
-        lox::interpret(stmt, env)
+        lox::interpret(stmt, env, args.engine)
           .and_then([&](lox::object result) {
-              if (is_verbose) {
+              if (args.verbose) {
                   std::cout << result << "\n";
               }
           })
@@ -82,28 +143,118 @@ void interpret(const std::vector<lox::stmt>& statements,
     }
 }
 
-void run_file(std::string_view file_path, bool is_verbose) LOX_NOEXCEPT
+void interpret(const lox::flat::program& program,
+  lox::environment& env,
+  const arguments& args)
+{
+    for (const lox::flat::node_index stmt : program.statements) {
+        if (args.verbose) {
+            std::cout << lox::to_string(program, stmt) << '\n';
+        }
+
+        lox::interpret(program, stmt, env)
+          .and_then([&](lox::object result) {
+              if (args.verbose) {
+                  std::cout << result << "\n";
+              }
+          })
+          .or_else([&](lox::runtime_error ex) {
+              std::cerr << "Runtime error: " << ex.what() << "\n";
+              exit(EX_SOFTWARE);
+          });
+    }
+}
+
+/*!
+ * Runs the program from the cache if it has a valid entry for the source,
+ * otherwise parses it and stores it in the cache. A cached program is always
+ * run by the tree walker on the flat nodes.
+ */
+void run_cached(std::string_view source,
+  lox::arena_resource& arena,
+  const arguments& args)
+{
+    const lox::program_cache cache{ args.cache_directory };
+    std::optional<lox::flat::program> program{ cache.load(source, &arena) };
+    if (args.verbose) {
+        std::cout << "Cache: " << (program ? "hit" : "miss") << " "
+                  << cache.entry_path(source).string() << '\n';
+    }
+
+    if (!program) {
+        lox::token_stream tokens{ source, &arena };
+        std::size_t error_count{ 0 };
+        program = lox::parse_flat(tokens,
+          lox::parse_options{ .resource = &arena,
+            .error_count = &error_count });
+        // Programs with errors are parsed again on the next run so that the
+        // errors are reported again.
+        if (error_count == 0 && tokens.errors().empty()) {
+            [[maybe_unused]] const bool is_stored{ cache.store(source,
+              *program) };
+        }
+    }
+
+    if (args.optimize) {
+        lox::optimize(*program);
+    }
+
+    lox::environment env{ &arena };
+    lox::resolve(*program, env);
+    interpret(*program, env, args);
+}
+
+void run_file(const arguments& args) LOX_NOEXCEPT
 {
-    const std::ifstream reader{ file_path, std::ifstream::in };
-    if (!reader.is_open()) {
+    const std::string_view file_path{ args.file_path };
+    const auto source = lox::source_file::open(file_path);
+    if (!source) {
         std::cerr << "Cannot open '" << file_path << "' for readin!\n";
         exit(EX_NOINPUT);
     }
 
-    std::stringstream stream;
-    stream << reader.rdbuf();
-    const std::string content{ stream.str() };
-    const auto result = lox::scan_tokens(content);
-    if (!result.tokens.empty()) {
-        const auto statements = lox::parse(result.tokens);
-        if (!statements.empty()) {
-            lox::environment env{};
-            interpret(statements, env, true, is_verbose);
+    // Everything the run allocates from the arena is given back at once when
+    // the run is over. Running out of memory, e.g. by going over the memory
+    // limit, fails the run.
+    lox::arena_resource arena{ args.memory_limit };
+    try {
+        if (!args.cache_directory.empty()) {
+            run_cached(source->text(), arena, args);
         }
+        else {
+            lox::token_stream tokens{ source->text(), &arena };
+            if (!tokens.at_end()) {
+                auto statements = lox::parse(tokens, &arena);
+                if (!statements.empty()) {
+                    if (args.optimize) {
+                        lox::optimize(statements);
+                    }
+
+                    lox::environment env{ &arena };
+                    lox::resolve(statements, env);
+                    interpret(statements, env, true, args);
+                }
+            }
+        }
+    }
+    catch (const std::bad_alloc&) {
+        std::cerr << "Out of memory";
+        if (args.memory_limit != lox::arena_resource::no_limit) {
+            std::cerr << ", the run needs more than " << args.memory_limit
+                      << " bytes";
+        }
+
+        std::cerr << "!\n";
+        exit(EX_OSERR);
+    }
+
+    if (args.verbose) {
+        std::cout << "Memory: " << arena.allocated() << " bytes allocated, "
+                  << arena.reserved() << " bytes reserved.\n";
     }
 }
 
-void run_prompt(bool is_verbose) LOX_NOEXCEPT
+void run_prompt(const arguments& args) LOX_NOEXCEPT
 {
     std::string input{};
     std::cout << "Welcome to Lox++ " << s_version << '.' << '\n' << "> ";
@@ -117,8 +268,13 @@ void run_prompt(bool is_verbose) LOX_NOEXCEPT
         else {
             const auto result = lox::scan_tokens(input.c_str());
             if (!result.tokens.empty()) {
-                const auto statements = lox::parse(result.tokens);
-                interpret(statements, env, false, is_verbose);
+                auto statements = lox::parse(result.tokens);
+                if (args.optimize) {
+                    lox::optimize(statements);
+                }
+
+                lox::resolve(statements, env);
+                interpret(statements, env, false, args);
             }
         }
 
@@ -130,17 +286,12 @@ void run_prompt(bool is_verbose) LOX_NOEXCEPT
 
 int main(int argc, char** argv) LOX_NOEXCEPT
 {
-    if (argc > 2) {
-        std::cerr << "Usage: lox++ [script]\n";
-        return EX_USAGE;
-    }
-
     const auto args = parse_args(argc, argv);
     if (args.file_path.empty()) {
-        run_prompt(args.verbose);
+        run_prompt(args);
     }
     else {
-        run_file(args.file_path, args.verbose);
+        run_file(args);
     }
 
     return EX_OK;
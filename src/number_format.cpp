@@ -0,0 +1,59 @@
+#include "number_format.h"
+
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+// Integers below this are exact, they are written out in full instead of with
+// an exponent even if that is shorter, e.g. `100000000` and not `1e+08`.
+constexpr double s_exact_integer_limit{ 9007199254740992.0 };
+
+[[nodiscard]] bool is_exact_integer(double number) LOX_NOEXCEPT
+{
+    return std::fabs(number) < s_exact_integer_limit &&
+           std::trunc(number) == number;
+}
+}
+
+std::string_view lox::format_number(double number,
+  number_buffer& buffer) LOX_NOEXCEPT
+{
+    if (std::isnan(number)) {
+        // The sign of a NaN is not meaningful.
+        return "nan";
+    }
+
+    char* first = buffer.data();
+    char* last = buffer.data() + buffer.size();
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    [[maybe_unused]] const auto [end, error] = is_exact_integer(number)
+                                ? std::to_chars(first, last, number,
+                                    std::chars_format::fixed)
+                                : std::to_chars(first, last, number);
+    assert(error == std::errc{});
+    return { first, static_cast<std::size_t>(end - first) };
+#else
+    // snprintf follows the C locale, which is the default as long as the
+    // program does not call setlocale(). The precision is raised until the
+    // text reads back as the same number.
+    if (is_exact_integer(number)) {
+        const int length = std::snprintf(first, buffer.size(), "%.0f", number);
+        return { first, static_cast<std::size_t>(length) };
+    }
+
+    int length{ 0 };
+    for (int precision = 1; precision <= 17; ++precision) {
+        length = std::snprintf(first, buffer.size(), "%.*g", precision, number);
+        if (std::strtod(first, nullptr) == number) {
+            break;
+        }
+    }
+
+    assert(length > 0 && static_cast<std::size_t>(length) < buffer.size());
+    LOX_UNUSED(last);
+    return { first, static_cast<std::size_t>(length) };
+#endif
+}
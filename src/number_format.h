@@ -0,0 +1,30 @@
+#ifndef LOX_NUMBER_FORMAT_H
+#define LOX_NUMBER_FORMAT_H
+
+#include "defs.h"
+
+#include <array>
+#include <string_view>
+
+/*!
+ * Turns numbers into the text that print and concatenation show. The text
+ * does not depend on the locale and is the shortest one that reads back as
+ * the same number.
+ */
+namespace lox {
+
+// Long enough for any double, e.g. -2.2250738585072014e-308.
+using number_buffer = std::array<char, 32>;
+
+/*!
+ * Writes the shortest text that strtod() reads back as `number` into `buffer`
+ * and returns it. Integers below 2^53 are written without an exponent or a
+ * fraction, e.g. `1234567`. Other numbers use an exponent when that is
+ * shorter, e.g. `1e+21` or `1e-07`. Infinities and NaNs are `inf`, `-inf` and
+ * `nan`. Does not allocate.
+ */
+[[nodiscard]] std::string_view format_number(double number,
+  number_buffer& buffer) LOX_NOEXCEPT;
+}
+
+#endif
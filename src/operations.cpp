@@ -0,0 +1,124 @@
+#include "operations.h"
+
+#include "ast_printer.h"
+#include "exceptions.h"
+#include "number_format.h"
+#include "utils.h"
+
+#include <sstream>
+#include <cassert>
+
+namespace lox {
+namespace ops {
+void check_number_operand(const lox::token& token,
+  const lox::object& left,
+  std::optional<std::reference_wrapper<const lox::object>> right)
+{
+    if (right.has_value() && std::holds_alternative<double>(left) &&
+        std::holds_alternative<double>(right->get())) {
+        if (std::get<double>(right->get()) == 0) {
+            constexpr const std::string_view msg{ "Division by zero." };
+            lox::log_error(token.line_str, token.line, token.column_end, msg);
+            throw lox::runtime_error{ token, msg.data() };
+        }
+
+        return;
+    }
+
+    if (!right.has_value() && std::holds_alternative<double>(left)) {
+        return;
+    }
+
+    constexpr const std::string_view msg{ "Operand must be a number." };
+    if (!std::holds_alternative<double>(left)) {
+        lox::log_error(token.line_str, token.line, 0, msg);
+        throw lox::runtime_error{ token, msg.data() };
+    }
+
+    lox::log_error(token.line_str, token.line, token.column_end, msg);
+    throw lox::runtime_error{ token, msg.data() };
+}
+
+void check_concatenation_types(const lox::token& token,
+  const lox::object& left,
+  std::optional<std::reference_wrapper<const lox::object>> right)
+{
+    if (right.has_value() && is_concatenable(left) &&
+        is_concatenable(right->get())) {
+        return;
+    }
+
+    if (!right.has_value() && is_concatenable(left)) {
+        return;
+    }
+
+    constexpr const char* msg{ "Operand must be a string." };
+    lox::log_error(token.line_str, token.line, token.column_end, msg);
+    throw lox::runtime_error{ token, msg };
+}
+
+bool is_concatenable(const lox::object& object) LOX_NOEXCEPT
+{
+    return std::holds_alternative<lox::heap_string>(object) ||
+           std::holds_alternative<double>(object);
+}
+
+bool is_truthy(const lox::object& object) LOX_NOEXCEPT
+{
+    if (const auto* str = std::get_if<lox::heap_string>(&object)) {
+        return !str->empty();
+    }
+    else if (std::holds_alternative<double>(object)) {
+        return std::get<double>(object) > 0;
+    }
+    else if (std::holds_alternative<bool>(object)) {
+        return std::get<bool>(object);
+    }
+
+    return false;
+}
+
+lox::object concatenate(const lox::object& left,
+  const lox::object& right,
+  std::pmr::memory_resource* resource)
+{
+    const auto text = [resource](const lox::object& val) -> lox::heap_string {
+        if (const auto* str = std::get_if<lox::heap_string>(&val)) {
+            return *str;
+        }
+
+        // Numbers are written the way they are printed.
+        assert(std::holds_alternative<double>(val));
+        lox::number_buffer buffer{};
+        return lox::heap_string{ lox::format_number(
+                                   std::get<double>(val), buffer),
+            resource };
+    };
+
+    return lox::heap_string::concatenate(text(left), text(right), resource);
+}
+
+lox::object print(const lox::object& object,
+  std::pmr::memory_resource* resource)
+{
+    // Strings are written as they are and shared with the result.
+    if (const auto* str = std::get_if<lox::heap_string>(&object)) {
+        std::cout << *str;
+        return *str;
+    }
+
+    if (const auto* number = std::get_if<double>(&object)) {
+        lox::number_buffer buffer{};
+        const std::string_view text{ lox::format_number(*number, buffer) };
+        std::cout << text;
+        return lox::heap_string{ text, resource };
+    }
+
+    std::stringstream ss;
+    ss << object;
+    const std::string result{ ss.str() };
+    std::cout << result;
+    return lox::heap_string{ result, resource };
+}
+}
+}
@@ -0,0 +1,88 @@
+#ifndef LOX_OPERATIONS_H
+#define LOX_OPERATIONS_H
+
+#include "defs.h"
+#include "token.h"
+
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <string>
+
+#ifndef LOX_EXCEPTION_ENABLED
+#error "Operations rely on exceptions to be enabled."
+#endif
+
+/*!
+ * Operand checks and value operations that are shared by the execution
+ * engines. Keeping them in one place guarantees that the tree walker and the
+ * VM report the same errors for the same programs.
+ */
+namespace lox {
+namespace ops {
+
+/*!
+ * Checks if the left and right operands are numbers. If the right operand is
+ * not provided, it checks if the left operand is a number.
+ *
+ * @param token The token that's being processed.
+ * @param left The left operand.
+ * @param right The right operand. Optional.
+ * @throws lox::runtime_error If the operands are not numbers.
+ */
+void check_number_operand(const lox::token& token,
+  const lox::object& left,
+  std::optional<std::reference_wrapper<const lox::object>> right = {});
+
+/*!
+ * Checks if the left and right operands are strings or numbers. If the right
+ * operand is not provided, it checks if the left operand is a string or a
+ * number.
+ *
+ * @param token The token that's being processed.
+ * @param left The left operand.
+ * @param right The right operand. Optional.
+ * @throws lox::runtime_error If the operands are not strings or numbers.
+ */
+void check_concatenation_types(const lox::token& token,
+  const lox::object& left,
+  std::optional<std::reference_wrapper<const lox::object>> right = {});
+
+/*!
+ * True if the object can be an operand of a concatenation, i.e. it is a string
+ * or a number.
+ */
+[[nodiscard]] bool is_concatenable(const lox::object& object) LOX_NOEXCEPT;
+
+/*!
+ * An object is considered truthy if it's a non-empty string, a non-zero number
+ * or a boolean true.
+ *
+ * @param object The object to check.
+ * @return True if the object is truthy, false otherwise.
+ */
+[[nodiscard]] bool is_truthy(const lox::object& object) LOX_NOEXCEPT;
+
+/*!
+ * Concatenates the textual representations of the operands. Long results are
+ * ropes, so appending to a string in a loop does not copy it every time, see
+ * lox::heap_string. The operands must have been validated with
+ * check_concatenation_types(). The result is allocated from `resource`.
+ * @throws std::bad_alloc if `resource` runs out.
+ */
+[[nodiscard]] lox::object concatenate(const lox::object& left,
+  const lox::object& right,
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/*!
+ * Writes the object to the standard output and returns what was written. A
+ * string is returned as is, without copying its characters, the text of
+ * anything else is allocated from `resource`.
+ * @throws std::bad_alloc if `resource` runs out.
+ */
+[[nodiscard]] lox::object print(const lox::object& object,
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+}
+}
+
+#endif
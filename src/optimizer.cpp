@@ -0,0 +1,405 @@
+#include "optimizer.h"
+
+#include "operations.h"
+
+#include <cassert>
+#include <cmath>
+#include <optional>
+
+namespace {
+template<typename>
+[[maybe_unused]] constexpr bool always_false_v = false;
+
+using token_type = lox::token::token_type;
+
+using lox::flat::is_node_v;
+
+/*!
+ * What an expression is replaced with. At most one of `value` and `child` is
+ * set, if neither is the expression is kept.
+ */
+template<typename Child>
+struct replacement {
+    // The expression is folded into a literal with this value.
+    std::optional<lox::object> value{};
+    // The expression is replaced by one of its children.
+    const Child* child{ nullptr };
+    // True if the expression evaluates to a number whenever it does not
+    // raise an error.
+    bool is_number{ false };
+};
+
+[[nodiscard]] bool is_negative_zero(const lox::object& value) LOX_NOEXCEPT
+{
+    const auto* number = std::get_if<double>(&value);
+    return number && *number == 0 && std::signbit(*number);
+}
+
+[[nodiscard]] bool is_one(const lox::object& value) LOX_NOEXCEPT
+{
+    const auto* number = std::get_if<double>(&value);
+    return number && *number == 1;
+}
+
+/*!
+ * Evaluates the operator like the interpreter does, unless that would raise a
+ * runtime error.
+ */
+[[nodiscard]] std::optional<lox::object> fold_unary(token_type type,
+  const lox::object& right) LOX_NOEXCEPT
+{
+    if (type == token_type::BANG) {
+        return lox::object{ !lox::ops::is_truthy(right) };
+    }
+
+    // `-` raises for anything but a number.
+    assert(type == token_type::MINUS);
+    const auto* number = std::get_if<double>(&right);
+    if (!number) {
+        return std::nullopt;
+    }
+
+    return lox::object{ *number * -1 };
+}
+
+/*!
+ * Evaluates the operator like the interpreter does, unless that would raise a
+ * runtime error.
+ */
+[[nodiscard]] std::optional<lox::object> fold_binary(token_type type,
+  const lox::object& left,
+  const lox::object& right) LOX_NOEXCEPT
+{
+    const auto* left_number = std::get_if<double>(&left);
+    const auto* right_number = std::get_if<double>(&right);
+    switch (type) {
+        case token_type::EQUAL_EQUAL:
+            return lox::object{ left == right };
+        case token_type::BANG_EQUAL:
+            return lox::object{ left != right };
+        case token_type::PLUS:
+            if (left_number && right_number) {
+                return lox::object{ *left_number + *right_number };
+            }
+
+            if (lox::ops::is_concatenable(left) &&
+                lox::ops::is_concatenable(right)) {
+                return lox::ops::concatenate(left, right);
+            }
+
+            return std::nullopt;
+        default:
+            break;
+    }
+
+    // The other operators check their operands with
+    // lox::ops::check_number_operand(), which rejects any zero on the right.
+    if (!left_number || !right_number || *right_number == 0) {
+        return std::nullopt;
+    }
+
+    switch (type) {
+        case token_type::MINUS:
+            return lox::object{ *left_number - *right_number };
+        case token_type::SLASH:
+            return lox::object{ *left_number / *right_number };
+        case token_type::STAR:
+            return lox::object{ *left_number * *right_number };
+        case token_type::GREATER:
+            return lox::object{ *left_number > *right_number };
+        case token_type::GREATER_EQUAL:
+            return lox::object{ *left_number >= *right_number };
+        case token_type::LESS:
+            return lox::object{ *left_number < *right_number };
+        case token_type::LESS_EQUAL:
+            return lox::object{ *left_number <= *right_number };
+        default:
+            assert(false);
+            return std::nullopt;
+    }
+}
+
+template<typename Walker>
+using replacement_t = replacement<typename Walker::child_type>;
+
+template<typename Unary, typename Walker>
+[[nodiscard]] replacement_t<Walker> optimize_unary(Unary& expr,
+  const Walker& walk) LOX_NOEXCEPT
+{
+    replacement_t<Walker> result{};
+    walk(expr.right);
+    // `!` evaluates to a boolean.
+    result.is_number = expr.oprtor.type == token_type::MINUS;
+    if (const lox::object* right = walk.value(expr.right)) {
+        result.value = fold_unary(expr.oprtor.type, *right);
+    }
+
+    return result;
+}
+
+template<typename Binary, typename Walker>
+[[nodiscard]] replacement_t<Walker> optimize_binary(Binary& expr,
+  const Walker& walk) LOX_NOEXCEPT
+{
+    replacement_t<Walker> result{};
+    const bool is_left_number{ walk(expr.left) };
+    const bool is_right_number{ walk(expr.right) };
+    const token_type type{ expr.oprtor.type };
+    result.is_number = type == token_type::MINUS ||
+                       type == token_type::SLASH || type == token_type::STAR ||
+                       (type == token_type::PLUS && is_left_number &&
+                         is_right_number);
+
+    const lox::object* left = walk.value(expr.left);
+    const lox::object* right = walk.value(expr.right);
+    if (left && right) {
+        result.value = fold_binary(type, *left, *right);
+        return result;
+    }
+
+    // The identities only hold for numbers, anything else raises an error or
+    // is concatenated. The right operand is never zero, so the number checks
+    // pass.
+    if (right && is_left_number &&
+        (((type == token_type::STAR || type == token_type::SLASH) &&
+           is_one(*right)) ||
+          (type == token_type::PLUS && is_negative_zero(*right)))) {
+        result.child = &expr.left;
+    }
+    else if (left && is_right_number && type == token_type::PLUS &&
+             is_negative_zero(*left)) {
+        result.child = &expr.right;
+    }
+
+    return result;
+}
+
+template<typename Ternary, typename Walker>
+[[nodiscard]] replacement_t<Walker> optimize_ternary(Ternary& expr,
+  const Walker& walk) LOX_NOEXCEPT
+{
+    replacement_t<Walker> result{};
+    walk(expr.first);
+    const bool is_second_number{ walk(expr.second) };
+    const bool is_third_number{ walk.has(expr.third) && walk(expr.third) };
+    result.is_number = is_second_number && is_third_number;
+
+    const lox::object* condition = walk.value(expr.first);
+    if (!condition) {
+        return result;
+    }
+
+    if (lox::ops::is_truthy(*condition)) {
+        result.child = &expr.second;
+        result.is_number = is_second_number;
+    }
+    else if (walk.has(expr.third)) {
+        result.child = &expr.third;
+        result.is_number = is_third_number;
+    }
+    else {
+        // What the interpreter evaluates a ternary without a third branch to.
+        result.value = lox::object{};
+        result.is_number = false;
+    }
+
+    return result;
+}
+
+constexpr auto optimizer_visitor = [](auto& arg, const auto& walk) {
+    using T = std::decay_t<decltype(arg)>;
+    using Walker = std::decay_t<decltype(walk)>;
+    if constexpr (is_node_v<T, lox::unary>) {
+        return optimize_unary(arg, walk);
+    }
+    else if constexpr (is_node_v<T, lox::binary>) {
+        return optimize_binary(arg, walk);
+    }
+    else if constexpr (is_node_v<T, lox::ternary>) {
+        return optimize_ternary(arg, walk);
+    }
+    else {
+        replacement_t<Walker> result{};
+        if constexpr (is_node_v<T, lox::literal>) {
+            result.is_number = std::holds_alternative<double>(arg.value);
+        }
+        else if constexpr (is_node_v<T, lox::grouping>) {
+            result.is_number = walk(arg.expression);
+            result.child = &arg.expression;
+        }
+        else if constexpr (is_node_v<T, lox::assignment>) {
+            result.is_number = walk(arg.value);
+        }
+        else if constexpr (is_node_v<T, lox::expr_stmt> ||
+                           is_node_v<T, lox::print_stmt> ||
+                           is_node_v<T, lox::var_stmt>) {
+            if (walk.has(arg.expression)) {
+                walk(arg.expression);
+            }
+        }
+        else if constexpr (!is_node_v<T, lox::variable> &&
+                           !std::is_same_v<T, std::monostate>) {
+            static_assert(always_false_v<T>, "Unhandled type.");
+        }
+
+        return result;
+    }
+};
+
+bool optimize_expr(lox::expr& expression) LOX_NOEXCEPT;
+
+/*!
+ * Optimizes the children of the pointer based AST in place.
+ */
+struct tree_walker {
+    using child_type = lox::copyable<lox::expr*>;
+
+    /*!
+     * Optimizes the child.
+     * @return True if the child evaluates to a number.
+     */
+    bool operator()(const child_type& child) const LOX_NOEXCEPT
+    {
+        return child && optimize_expr(*child);
+    }
+
+    [[nodiscard]] static bool has(const child_type& child) LOX_NOEXCEPT
+    {
+        return child;
+    }
+
+    /*!
+     * Returns the value of the child if it is a literal.
+     */
+    [[nodiscard]] static const lox::object* value(
+      const child_type& child) LOX_NOEXCEPT
+    {
+        if (!child) {
+            return nullptr;
+        }
+
+        const auto* literal = std::get_if<lox::literal>(&*child);
+        return literal ? &literal->value : nullptr;
+    }
+};
+
+/*!
+ * Looks up the children of a lox::flat::program that is being rebuilt. The
+ * children are the indices in the original program, they are optimized before
+ * their parents.
+ */
+struct flat_walker {
+    using child_type = lox::flat::node_index;
+
+    const lox::flat::program& optimized;
+    // The index in `optimized` of each node of the original program.
+    const std::vector<lox::flat::node_index>& moved_to;
+    const std::vector<bool>& is_number;
+
+    bool operator()(child_type child) const LOX_NOEXCEPT
+    {
+        return child != lox::flat::no_node && is_number[child];
+    }
+
+    [[nodiscard]] static bool has(child_type child) LOX_NOEXCEPT
+    {
+        return child != lox::flat::no_node;
+    }
+
+    [[nodiscard]] const lox::object* value(child_type child) const LOX_NOEXCEPT
+    {
+        if (child == lox::flat::no_node) {
+            return nullptr;
+        }
+
+        const lox::flat::node_index moved{ moved_to[child] };
+        if (optimized.kind(moved) != lox::flat::node_kind::LITERAL) {
+            return nullptr;
+        }
+
+        return &optimized.get_literal(moved).value;
+    }
+};
+
+bool optimize_expr(lox::expr& expression) LOX_NOEXCEPT
+{
+    auto result = std::visit(
+      [](auto& arg) { return optimizer_visitor(arg, tree_walker{}); },
+      expression);
+
+    if (result.value) {
+        const bool is_number{ std::holds_alternative<double>(*result.value) };
+        expression = lox::literal{ std::move(*result.value) };
+        return is_number;
+    }
+
+    if (result.child) {
+        // The child is owned by the expression that it replaces.
+        lox::expr child{ std::move(**result.child) };
+        expression = std::move(child);
+    }
+
+    return result.is_number;
+}
+}
+
+void lox::optimize(std::vector<stmt>& statements) LOX_NOEXCEPT
+{
+    for (auto& statement : statements) {
+        optimize(statement);
+    }
+}
+
+void lox::optimize(stmt& statement) LOX_NOEXCEPT
+{
+    std::visit(
+      [](auto& arg) {
+          [[maybe_unused]] const auto result =
+            optimizer_visitor(arg, tree_walker{});
+          assert(!result.value && !result.child);
+          if constexpr (requires { arg.compiled; }) {
+              arg.compiled.reset();
+              arg.bytecode.reset();
+          }
+      },
+      statement);
+}
+
+void lox::optimize(flat::program& program)
+{
+    flat::program optimized{ program.statements.get_allocator().resource() };
+    std::vector<flat::node_index> moved_to(program.size(), flat::no_node);
+    std::vector<bool> is_number(program.size(), false);
+    const flat_walker walk{ optimized, moved_to, is_number };
+    for (flat::node_index index = 0; index < program.size(); ++index) {
+        program.visit(index, [&](const auto& arg) {
+            auto result = optimizer_visitor(arg, walk);
+            if (result.value) {
+                is_number[index] = std::holds_alternative<double>(*result.value);
+                moved_to[index] =
+                  optimized.add(flat::literal{ std::move(*result.value) });
+                return;
+            }
+
+            is_number[index] = result.is_number;
+            if (result.child) {
+                moved_to[index] = moved_to[*result.child];
+                return;
+            }
+
+            auto node = arg;
+            flat::for_each_child(node, [&moved_to](flat::node_index& child) {
+                if (child != flat::no_node) {
+                    child = moved_to[child];
+                }
+            });
+            moved_to[index] = optimized.add(std::move(node));
+        });
+    }
+
+    for (const flat::node_index statement : program.statements) {
+        optimized.statements.push_back(moved_to[statement]);
+    }
+
+    program = std::move(optimized);
+}
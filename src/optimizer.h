@@ -0,0 +1,37 @@
+#ifndef LOX_OPTIMIZER_H
+#define LOX_OPTIMIZER_H
+
+#include "expr.h"
+#include "defs.h"
+
+#include <vector>
+
+namespace lox {
+/*!
+ * Simplifies the expressions of the statements before they are resolved and
+ * run:
+ * - Operations on literals are folded into a literal, unless they raise a
+ *   runtime error. Those are left in place so that the error, e.g.
+ *   "Division by zero.", is still raised when the statement runs.
+ * - A ternary with a literal condition is replaced by the branch it takes.
+ * - Groupings are removed, they only matter to the parser.
+ * - `e * 1`, `e / 1`, `e + -0` and `-0 + e` are replaced by `e` if `e` is
+ *   known to be a number. These are exact for every IEEE double, including
+ *   NaN and the signed zeros.
+ *
+ * Running the optimized statements has the same output and the same errors
+ * as running the original ones.
+ */
+void optimize(std::vector<stmt>& statements) LOX_NOEXCEPT;
+void optimize(stmt& statement) LOX_NOEXCEPT;
+
+/*!
+ * Same as the other overloads for a flat program. The program is rebuilt
+ * from the same memory resource, children still come before their parents
+ * and shared nodes stay shared.
+ * @throws std::bad_alloc if the memory resource runs out.
+ */
+void optimize(flat::program& program);
+}
+
+#endif
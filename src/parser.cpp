@@ -1,10 +1,20 @@
 #include "parser.h"
 
 #include "expr.h"
+#include "thread_pool.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <exception>
 #include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
 
 #ifndef LOX_EXCEPTION_ENABLED
 #error "Parser relies on exceptions to be enabled."
@@ -16,56 +26,73 @@ using expr_c = lox::copyable<lox::expr*>;
 using token_type = lox::token::token_type;
 
 struct parser_state {
-    const std::vector<lox::token>& tokens;
-    std::size_t current{ 0 };
+    lox::token_stream& tokens;
+    std::size_t error_count{ 0 };
+    // Where the errors are logged.
+    std::ostream* diagnostics{ &std::cerr };
 };
 
 class parse_error : public std::exception {};
 
-[[nodiscard]] lox::expr parse_ternary(parser_state& state) LOX_NOEXCEPT;
+[[nodiscard]] bool is_at_end(const parser_state& state)
+{
+    return state.tokens.at_end();
+}
+
+[[nodiscard]] const lox::compact_token& peek_compact(const parser_state& state)
+{
+    assert(!is_at_end(state));
+    return state.tokens.peek();
+}
 
-[[nodiscard]] bool is_at_end(const parser_state& state) LOX_NOEXCEPT
+[[nodiscard]] lox::token peek(const parser_state& state)
 {
-    return state.current == state.tokens.size();
+    return state.tokens.materialize(peek_compact(state));
 }
 
-[[nodiscard]] const lox::token& peek(const parser_state& state) LOX_NOEXCEPT
+[[nodiscard]] lox::token previous(const parser_state& state) LOX_NOEXCEPT
 {
-    assert(state.current < state.tokens.size());
-    return state.tokens.at(state.current);
+    return state.tokens.materialize(state.tokens.previous());
 }
 
-[[nodiscard]] const lox::token& previous(const parser_state& state) LOX_NOEXCEPT
+/*!
+ * Returns the token an error at the current position is reported at, which is
+ * the last one when all of them have been consumed.
+ */
+[[nodiscard]] lox::token error_token(const parser_state& state)
 {
-    assert(state.current > 0);
-    return state.tokens.at(state.current - 1);
+    return is_at_end(state) ? previous(state) : peek(state);
 }
 
-[[maybe_unused]] const lox::token& advance(parser_state& state) LOX_NOEXCEPT
+[[maybe_unused]] lox::token advance(parser_state& state)
 {
     if (!is_at_end(state)) {
-        state.current++;
+        state.tokens.advance();
     }
 
-    assert(state.current <= state.tokens.size());
     return previous(state);
 }
 
-[[nodiscard]] bool check(const parser_state& state,
-  token_type type) LOX_NOEXCEPT
+[[nodiscard]] bool check(const parser_state& state, token_type type)
 {
     if (is_at_end(state)) {
         return false;
     }
 
-    return peek(state).type == type;
+    return peek_compact(state).type == type;
 }
 
-void log_error(const lox::token& token,
+void log_error(parser_state& state,
+  const lox::token& token,
   std::string_view message,
   bool raise_exception = false)
 {
-    lox::log_error(token.line_str, token.line, token.column_end, message);
+    state.error_count++;
+    lox::log_error(*state.diagnostics,
+      token.line_str,
+      token.line,
+      token.column_end,
+      message);
     if (raise_exception) {
         throw parse_error{};
     }
@@ -100,19 +127,19 @@ void synchronize(parser_state& state) LOX_NOEXCEPT
 }
 #endif
 
-[[maybe_unused]] const lox::token& consume(parser_state& state,
+[[maybe_unused]] lox::token consume(parser_state& state,
   token_type type,
   std::string_view error_message)
 {
     if (!check(state, type)) {
-        log_error(peek(state), error_message);
+        log_error(state, error_token(state), error_message);
     }
 
     return advance(state);
 }
 
 [[nodiscard]] bool match(parser_state& state,
-  std::initializer_list<token_type> tokens) LOX_NOEXCEPT
+  std::initializer_list<token_type> tokens)
 {
     if (std::any_of(tokens.begin(), tokens.end(), [&state](auto type) {
             return check(state, type);
@@ -125,261 +152,1321 @@ void synchronize(parser_state& state) LOX_NOEXCEPT
     return false;
 }
 
-template<typename T, typename... Args>
-[[nodiscard]] lox::copyable<lox::expr*> make_copyable(
-  Args&&... args) LOX_NOEXCEPT
-{
-    return lox::copyable<lox::expr*>{ std::forward<Args>(args)... };
-}
+/*!
+ * Builds the pointer based AST, the nodes are allocated from `resource`.
+ */
+struct tree_builder {
+    using expr_type = lox::expr;
+    using stmt_type = lox::stmt;
+
+    std::pmr::memory_resource* resource{ std::pmr::get_default_resource() };
+
+    /*!
+     * Moves the expression into a node of its own.
+     */
+    [[nodiscard]] expr_c child(expr_type expression) const
+    {
+        return expr_c{ std::allocator_arg, resource, std::move(expression) };
+    }
 
-[[nodiscard]] lox::expr parse_primary(parser_state& state) LOX_NOEXCEPT
-{
-    if (match(state, { token_type::NIL })) {
-        return lox::literal{ nullptr };
+    [[nodiscard]] static expr_type empty() LOX_NOEXCEPT
+    {
+        return {};
     }
 
-    if (match(state, { token_type::FALSE })) {
-        return lox::literal{ lox::object{ false } };
+    [[nodiscard]] static bool is_ternary(const expr_type& expr) LOX_NOEXCEPT
+    {
+        return std::holds_alternative<lox::ternary>(expr);
     }
 
-    if (match(state, { token_type::TRUE })) {
-        return lox::literal{ lox::object{ true } };
+    [[nodiscard]] static const lox::token* variable_name(
+      const expr_type& expr) LOX_NOEXCEPT
+    {
+        const auto* variable = std::get_if<lox::variable>(&expr);
+        return variable ? &variable->name : nullptr;
     }
 
-    if (match(state, { token_type::NUMBER, token_type::STRING })) {
-        return lox::literal{ previous(state).literal };
+    [[nodiscard]] expr_type literal(lox::object value) LOX_NOEXCEPT
+    {
+        return lox::literal{ std::move(value) };
     }
 
-    if (match(state, { token_type::IDENTIFIER })) {
-        return lox::variable{ previous(state) };
+    [[nodiscard]] expr_type variable(lox::token name) LOX_NOEXCEPT
+    {
+        return lox::variable{ std::move(name) };
     }
 
-    if (match(state, { token_type::LEFT_PAREN })) {
-        auto expression = parse_ternary(state);
-        try {
-            consume(state,
-              token_type::RIGHT_PAREN,
-              "Expected ')' after expression '('.");
-        }
-        catch (parse_error&) {
-        }
+    [[nodiscard]] expr_type grouping(expr_type expression)
+    {
+        return lox::grouping{ child(std::move(expression)) };
+    }
+
+    [[nodiscard]] expr_type unary(lox::token opr, expr_type right)
+    {
+        return lox::unary{ std::move(opr), child(std::move(right)) };
+    }
 
-        return lox::grouping{ expr_c{ std::move(expression) } };
+    [[nodiscard]] expr_type binary(expr_type left,
+      lox::token opr,
+      expr_type right)
+    {
+        return lox::binary{ child(std::move(left)),
+            std::move(opr),
+            child(std::move(right)) };
+    }
+
+    [[nodiscard]] expr_type assignment(lox::token name, expr_type value)
+    {
+        return lox::assignment{ std::move(name), child(std::move(value)) };
+    }
+
+    [[nodiscard]] expr_type ternary(expr_type first, expr_type second)
+    {
+        return lox::ternary{ child(std::move(first)),
+            child(std::move(second)),
+            expr_c{} };
     }
 
-    if (state.current > 0 && previous(state).type == token_type::EQUAL_EQUAL) {
-        log_error(previous(state), "Unterminated comparison.");
+    [[nodiscard]] expr_type ternary(expr_type first,
+      expr_type second,
+      expr_type third)
+    {
+        return lox::ternary{ child(std::move(first)),
+            child(std::move(second)),
+            child(std::move(third)) };
     }
 
-    return {};
+    [[nodiscard]] stmt_type var_stmt(lox::token name, expr_type initializer)
+    {
+        // Without an initializer the child still records the resource, the
+        // chunk that lox::cached_chunk() keeps in the statement uses it.
+        return lox::var_stmt{ std::move(name),
+            std::holds_alternative<std::monostate>(initializer)
+              ? expr_c{ std::allocator_arg, resource }
+              : child(std::move(initializer)) };
+    }
+
+    [[nodiscard]] stmt_type expr_stmt(expr_type expression)
+    {
+        return lox::expr_stmt{ child(std::move(expression)) };
+    }
+
+    [[nodiscard]] stmt_type print_stmt(expr_type expression)
+    {
+        return lox::print_stmt{ child(std::move(expression)) };
+    }
+};
+
+[[nodiscard]] std::size_t combine(std::size_t seed,
+  std::size_t hash) LOX_NOEXCEPT
+{
+    return seed ^ (hash + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
 }
 
-[[nodiscard]] lox::expr parse_unary(parser_state& state) LOX_NOEXCEPT
+[[nodiscard]] std::size_t hash_token(const lox::token& tkn) LOX_NOEXCEPT
 {
-    if (match(state, { token_type::BANG, token_type::MINUS })) {
-        const lox::token& opr = previous(state);
-        auto right = parse_unary(state);
-        return lox::unary{ opr, expr_c{ std::move(right) } };
-    }
+    return combine(static_cast<std::size_t>(tkn.type),
+      std::hash<std::string_view>{}(tkn.lexeme));
+}
 
-    return parse_primary(state);
+/*!
+ * Tokens are the same if they would behave the same, where they are in the
+ * source does not matter.
+ */
+[[nodiscard]] bool is_same_token(const lox::token& left,
+  const lox::token& right) LOX_NOEXCEPT
+{
+    return left.type == right.type && left.lexeme == right.lexeme;
+}
+
+[[nodiscard]] std::size_t hash_object(const lox::object& obj) LOX_NOEXCEPT
+{
+    return combine(obj.index(), std::visit([](const auto& arg) -> std::size_t {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, double>) {
+            return std::hash<std::uint64_t>{}(std::bit_cast<std::uint64_t>(arg));
+        }
+        else if constexpr (std::is_same_v<T, lox::heap_string>) {
+            return arg.hash();
+        }
+        else if constexpr (std::is_same_v<T, bool>) {
+            return arg;
+        }
+        else {
+            return 0;
+        }
+    }, obj));
 }
 
-[[nodiscard]] lox::expr parse_factor(parser_state& state) LOX_NOEXCEPT
+/*!
+ * Numbers are compared by their bits so that 0 and -0 are kept apart.
+ */
+[[nodiscard]] bool is_same_object(const lox::object& left,
+  const lox::object& right) LOX_NOEXCEPT
 {
-    auto expression = parse_unary(state);
-    while (match(state, { token_type::SLASH, token_type::STAR })) {
-        const lox::token& opr = previous(state);
-        auto right = parse_unary(state);
-        expression = lox::binary{
-            expr_c{ std::move(expression) }, opr, expr_c{ std::move(right) }
-        };
+    const auto* left_number = std::get_if<double>(&left);
+    const auto* right_number = std::get_if<double>(&right);
+    if (left_number && right_number) {
+        return std::bit_cast<std::uint64_t>(*left_number) ==
+               std::bit_cast<std::uint64_t>(*right_number);
     }
 
-    return expression;
+    return left == right;
 }
 
-[[nodiscard]] lox::expr parse_term(parser_state& state) LOX_NOEXCEPT
+// The hash and the comparison of each interned kind. The children are
+// interned before their parent, so they are compared by index.
+
+[[nodiscard]] std::size_t hash_node(const lox::flat::literal& node) LOX_NOEXCEPT
 {
-    auto expression = parse_factor(state);
-    while (match(state, { token_type::MINUS, token_type::PLUS })) {
-        const lox::token& opr = previous(state);
-        auto right = parse_factor(state);
-        expression = lox::binary{
-            expr_c{ std::move(expression) }, opr, expr_c{ std::move(right) }
-        };
-    }
+    return combine(1, hash_object(node.value));
+}
 
-    return expression;
+[[nodiscard]] bool is_same_node(const lox::flat::literal& left,
+  const lox::flat::literal& right) LOX_NOEXCEPT
+{
+    return is_same_object(left.value, right.value);
 }
 
-[[nodiscard]] lox::expr parse_comparison(parser_state& state) LOX_NOEXCEPT
+[[nodiscard]] std::size_t hash_node(
+  const lox::flat::variable& node) LOX_NOEXCEPT
 {
-    auto expression = parse_term(state);
+    return combine(2, hash_token(node.name));
+}
 
-    static const std::initializer_list<token_type> types{ token_type::GREATER,
-        token_type::GREATER_EQUAL,
-        token_type::LESS,
-        token_type::LESS_EQUAL };
+[[nodiscard]] bool is_same_node(const lox::flat::variable& left,
+  const lox::flat::variable& right) LOX_NOEXCEPT
+{
+    return is_same_token(left.name, right.name);
+}
 
-    while (match(state, types)) {
-        const lox::token& opr = previous(state);
-        auto right = parse_term(state);
-        expression = lox::binary{
-            expr_c{ std::move(expression) }, opr, expr_c{ std::move(right) }
-        };
-    }
+[[nodiscard]] std::size_t hash_node(
+  const lox::flat::grouping& node) LOX_NOEXCEPT
+{
+    return combine(3, node.expression);
+}
 
-    return expression;
+[[nodiscard]] bool is_same_node(const lox::flat::grouping& left,
+  const lox::flat::grouping& right) LOX_NOEXCEPT
+{
+    return left.expression == right.expression;
 }
 
-[[nodiscard]] lox::expr parse_equality(parser_state& state) LOX_NOEXCEPT
+[[nodiscard]] std::size_t hash_node(const lox::flat::unary& node) LOX_NOEXCEPT
 {
-    auto expression = parse_comparison(state);
-    while (match(state, { token_type::BANG_EQUAL, token_type::EQUAL_EQUAL })) {
-        const lox::token& opr = previous(state);
-        lox::expr right = parse_comparison(state);
-        expression = lox::binary{
-            expr_c{ std::move(expression) }, opr, expr_c{ std::move(right) }
-        };
-    }
+    return combine(combine(4, hash_token(node.oprtor)), node.right);
+}
 
-    return expression;
+[[nodiscard]] bool is_same_node(const lox::flat::unary& left,
+  const lox::flat::unary& right) LOX_NOEXCEPT
+{
+    return is_same_token(left.oprtor, right.oprtor) && left.right == right.right;
+}
+
+[[nodiscard]] std::size_t hash_node(const lox::flat::binary& node) LOX_NOEXCEPT
+{
+    return combine(
+      combine(combine(5, node.left), hash_token(node.oprtor)), node.right);
+}
+
+[[nodiscard]] bool is_same_node(const lox::flat::binary& left,
+  const lox::flat::binary& right) LOX_NOEXCEPT
+{
+    return left.left == right.left &&
+           is_same_token(left.oprtor, right.oprtor) &&
+           left.right == right.right;
 }
 
-[[nodiscard]] lox::expr parse_assignment(parser_state& state) LOX_NOEXCEPT
+[[nodiscard]] std::size_t hash_node(
+  const lox::flat::assignment& node) LOX_NOEXCEPT
 {
-    auto expression = parse_equality(state);
-    if (!match(state, { token_type::EQUAL })) {
-        return expression;
+    return combine(combine(6, hash_token(node.name)), node.value);
+}
+
+[[nodiscard]] bool is_same_node(const lox::flat::assignment& left,
+  const lox::flat::assignment& right) LOX_NOEXCEPT
+{
+    return is_same_token(left.name, right.name) && left.value == right.value;
+}
+
+[[nodiscard]] std::size_t hash_node(
+  const lox::flat::ternary& node) LOX_NOEXCEPT
+{
+    return combine(combine(combine(7, node.first), node.second), node.third);
+}
+
+[[nodiscard]] bool is_same_node(const lox::flat::ternary& left,
+  const lox::flat::ternary& right) LOX_NOEXCEPT
+{
+    return left.first == right.first && left.second == right.second &&
+           left.third == right.third;
+}
+
+/*!
+ * Hash-conses the expressions of a lox::flat::program, an expression that is
+ * structurally identical to one that is already in the program is not added
+ * again and the existing node is used instead.
+ */
+class node_interner {
+public:
+    explicit node_interner(lox::flat::program& program,
+      std::pmr::memory_resource* resource) LOX_NOEXCEPT
+      : m_program{ program }
+      , m_nodes{ resource }
+    {
     }
 
-    const lox::token& equals = previous(state);
-    lox::expr value = parse_assignment(state);
-    if (std::holds_alternative<lox::variable>(expression)) {
-        lox::token name = std::get<lox::variable>(expression).name;
-        expression =
-          lox::assignment{ std::move(name), expr_c{ std::move(value) } };
+    template<typename T>
+    [[nodiscard]] lox::flat::node_index intern(T node)
+    {
+        const std::size_t hash{ hash_node(node) };
+        const auto [first, last] = m_nodes.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            const bool is_same{ m_program.visit(
+              it->second, [&node](const auto& existing) {
+                  if constexpr (std::is_same_v<std::decay_t<decltype(existing)>,
+                                  T>) {
+                      return is_same_node(existing, node);
+                  }
+                  else {
+                      return false;
+                  }
+              }) };
+            if (is_same) {
+                return it->second;
+            }
+        }
+
+        const lox::flat::node_index index{ m_program.add(std::move(node)) };
+        m_nodes.emplace(hash, index);
+        return index;
+    }
+
+private:
+    lox::flat::program& m_program;
+    // The interned nodes by their hash.
+    std::pmr::unordered_multimap<std::size_t, lox::flat::node_index> m_nodes;
+};
+
+/*!
+ * Builds a lox::flat::program. Missing expressions are lox::flat::no_node.
+ * With an interner the expressions are hash-consed, statements are never
+ * shared.
+ */
+struct flat_builder {
+    using expr_type = lox::flat::node_index;
+    using stmt_type = lox::flat::node_index;
+
+    [[nodiscard]] static expr_type empty() LOX_NOEXCEPT
+    {
+        return lox::flat::no_node;
+    }
+
+    [[nodiscard]] bool is_ternary(expr_type expr) const LOX_NOEXCEPT
+    {
+        return expr != lox::flat::no_node &&
+               program.kind(expr) == lox::flat::node_kind::TERNARY;
+    }
+
+    [[nodiscard]] const lox::token* variable_name(
+      expr_type expr) const LOX_NOEXCEPT
+    {
+        if (expr == lox::flat::no_node ||
+            program.kind(expr) != lox::flat::node_kind::VARIABLE) {
+            return nullptr;
+        }
+
+        return &program.get_variable(expr).name;
+    }
+
+    [[nodiscard]] expr_type literal(lox::object value)
+    {
+        return add_expr(lox::flat::literal{ std::move(value) });
+    }
+
+    [[nodiscard]] expr_type variable(lox::token name)
+    {
+        return add_expr(lox::flat::variable{ std::move(name) });
+    }
+
+    [[nodiscard]] expr_type grouping(expr_type expression)
+    {
+        return add_expr(lox::flat::grouping{ expression });
+    }
+
+    [[nodiscard]] expr_type unary(lox::token opr, expr_type right)
+    {
+        return add_expr(lox::flat::unary{ std::move(opr), right });
+    }
+
+    [[nodiscard]] expr_type binary(expr_type left,
+      lox::token opr,
+      expr_type right)
+    {
+        return add_expr(lox::flat::binary{ left, std::move(opr), right });
+    }
+
+    [[nodiscard]] expr_type assignment(lox::token name, expr_type value)
+    {
+        return add_expr(lox::flat::assignment{ std::move(name), value });
+    }
+
+    [[nodiscard]] expr_type ternary(expr_type first,
+      expr_type second,
+      expr_type third = lox::flat::no_node)
+    {
+        return add_expr(lox::flat::ternary{ first, second, third });
+    }
+
+    [[nodiscard]] stmt_type var_stmt(lox::token name, expr_type initializer)
+    {
+        return program.add(lox::flat::var_stmt{ std::move(name), initializer });
+    }
+
+    [[nodiscard]] stmt_type expr_stmt(expr_type expression)
+    {
+        return program.add(lox::flat::expr_stmt{ expression });
+    }
+
+    [[nodiscard]] stmt_type print_stmt(expr_type expression)
+    {
+        return program.add(lox::flat::print_stmt{ expression });
+    }
+
+    template<typename T>
+    [[nodiscard]] expr_type add_expr(T node)
+    {
+        if (interner) {
+            return interner->intern(std::move(node));
+        }
+
+        return program.add(std::move(node));
+    }
+
+    lox::flat::program& program;
+    node_interner* interner{ nullptr };
+};
+
+template<typename Builder>
+using expr_t = typename Builder::expr_type;
+
+template<typename Builder>
+using stmt_t = typename Builder::stmt_type;
+
+/*!
+ * Binding powers of the infix operators from the loosest to the tightest.
+ */
+enum class precedence : std::uint8_t {
+    NONE,
+    TERNARY,
+    ASSIGNMENT,
+    EQUALITY,
+    COMPARISON,
+    TERM,
+    FACTOR,
+    UNARY,
+};
+
+template<typename Builder>
+using prefix_parser = expr_t<Builder> (*)(parser_state&, Builder&);
+
+template<typename Builder>
+using infix_parser = expr_t<Builder> (*)(parser_state&,
+  Builder&,
+  expr_t<Builder>);
+
+/*!
+ * How a token is parsed at the start of an expression and after one.
+ */
+template<typename Builder>
+struct parse_rule {
+    prefix_parser<Builder> prefix{ nullptr };
+    infix_parser<Builder> infix{ nullptr };
+    precedence infix_precedence{ precedence::NONE };
+};
+
+template<typename Builder>
+[[nodiscard]] constexpr auto make_rules() LOX_NOEXCEPT;
+
+template<typename Builder>
+[[nodiscard]] const parse_rule<Builder>& get_rule(
+  token_type type) LOX_NOEXCEPT
+{
+    static constexpr auto s_rules = make_rules<Builder>();
+    return s_rules[static_cast<std::size_t>(type)];
+}
+
+/*!
+ * Parses an expression whose infix operators bind at least as tight as
+ * `min_precedence`.
+ */
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_precedence(parser_state& state,
+  Builder& builder,
+  precedence min_precedence)
+{
+    const prefix_parser<Builder> prefix =
+      is_at_end(state) ? nullptr
+                       : get_rule<Builder>(peek_compact(state).type).prefix;
+    expr_t<Builder> expression{};
+    if (prefix) {
+        state.tokens.advance();
+        expression = prefix(state, builder);
     }
     else {
-        log_error(equals, "Invalid assignment target.", false);
+        if (state.tokens.has_previous() &&
+            state.tokens.previous().type == token_type::EQUAL_EQUAL) {
+            log_error(state, previous(state), "Unterminated comparison.");
+        }
+
+        expression = builder.empty();
+    }
+
+    while (!is_at_end(state)) {
+        const parse_rule<Builder>& rule =
+          get_rule<Builder>(peek_compact(state).type);
+        if (!rule.infix || rule.infix_precedence < min_precedence) {
+            break;
+        }
+
+        state.tokens.advance();
+        expression = rule.infix(state, builder, std::move(expression));
     }
 
     return expression;
 }
 
-[[nodiscard]] lox::expr parse_expression(parser_state& state) LOX_NOEXCEPT
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_expression(parser_state& state,
+  Builder& builder)
 {
-    return parse_assignment(state);
+    return parse_precedence(state, builder, precedence::ASSIGNMENT);
 }
 
-[[nodiscard]] lox::expr parse_ternary(parser_state& state) LOX_NOEXCEPT
+/*!
+ * Parses a full expression including the ternary operator, which binds
+ * looser than assignment.
+ */
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_ternary(parser_state& state,
+  Builder& builder)
 {
-    std::vector<lox::expr> exprs{};
-    exprs.reserve(3);
-    try {
-        exprs.push_back(parse_expression(state));
-    }
-    catch (parse_error&) {
-        advance(state);
-        exprs.push_back({});
+    return parse_precedence(state, builder, precedence::TERNARY);
+}
+
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_literal(parser_state& state,
+  Builder& builder)
+{
+    const lox::compact_token& literal = state.tokens.previous();
+    switch (literal.type) {
+        case token_type::NIL:
+            return builder.literal(nullptr);
+        case token_type::FALSE:
+            return builder.literal(lox::object{ false });
+        case token_type::TRUE:
+            return builder.literal(lox::object{ true });
+        default:
+            // Strings share the characters of the interned literal.
+            return builder.literal(state.tokens.info().literal(literal));
     }
+}
 
-    const auto push = [&exprs](auto expr) {
-        if (std::holds_alternative<lox::ternary>(expr)) {
-            exprs.push_back(lox::grouping{ expr_c{ std::move(expr) } });
-        }
-        else {
-            exprs.push_back(std::move(expr));
-        }
-    };
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_variable(parser_state& state,
+  Builder& builder)
+{
+    return builder.variable(previous(state));
+}
 
-    if (match(state, { token_type::QUESTION_MARK })) {
-        push(parse_ternary(state));
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_grouping(parser_state& state,
+  Builder& builder)
+{
+    auto expression = parse_ternary(state, builder);
+    consume(
+      state, token_type::RIGHT_PAREN, "Expected ')' after expression '('.");
+    return builder.grouping(std::move(expression));
+}
 
-        if (match(state, { token_type::COLON })) {
-            push(parse_ternary(state));
-        }
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_unary(parser_state& state, Builder& builder)
+{
+    const lox::token opr = previous(state);
+    auto right = parse_precedence(state, builder, precedence::UNARY);
+    return builder.unary(opr, std::move(right));
+}
+
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_binary(parser_state& state,
+  Builder& builder,
+  expr_t<Builder> left)
+{
+    const lox::token opr = previous(state);
+    // All the binary operators are left associative, the right operand only
+    // takes the operators that bind tighter.
+    const auto right_precedence = static_cast<precedence>(
+      static_cast<std::uint8_t>(get_rule<Builder>(opr.type).infix_precedence) +
+      1);
+    auto right = parse_precedence(state, builder, right_precedence);
+    return builder.binary(std::move(left), opr, std::move(right));
+}
+
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_assignment(parser_state& state,
+  Builder& builder,
+  expr_t<Builder> target)
+{
+    const lox::token equals = previous(state);
+    // Right associative.
+    auto value = parse_precedence(state, builder, precedence::ASSIGNMENT);
+    if (const lox::token* name = builder.variable_name(target)) {
+        return builder.assignment(*name, std::move(value));
     }
 
-    if (exprs.size() == 1) {
-        return std::move(exprs.front());
+    log_error(state, equals, "Invalid assignment target.", false);
+    return target;
+}
+
+template<typename Builder>
+[[nodiscard]] expr_t<Builder> parse_conditional(parser_state& state,
+  Builder& builder,
+  expr_t<Builder> condition)
+{
+    // Nested ternaries in the branches are wrapped in a grouping.
+    const auto parse_branch = [&state, &builder]() {
+        auto branch = parse_ternary(state, builder);
+        return builder.is_ternary(branch) ? builder.grouping(std::move(branch))
+                                          : std::move(branch);
+    };
+
+    auto second = parse_branch();
+    if (!match(state, { token_type::COLON })) {
+        log_error(state,
+          error_token(state),
+          "Expected ':' to finish the ternary operator.");
+        return builder.ternary(std::move(condition), std::move(second));
     }
 
-    if (exprs.size() != 3) {
-        log_error(peek(state), "Expected ':' to finish the ternary operator.");
+    auto third = parse_branch();
+    return builder.ternary(
+      std::move(condition), std::move(second), std::move(third));
+}
 
-        return lox::ternary{ expr_c{ std::move(exprs[0]) },
-            expr_c{ std::move(exprs[1]) },
-            expr_c{} };
+template<typename Builder>
+[[nodiscard]] constexpr auto make_rules() LOX_NOEXCEPT
+{
+    std::array<parse_rule<Builder>,
+      static_cast<std::size_t>(token_type::END_OF_FILE) + 1>
+      rules{};
+    const auto set = [&rules](token_type type, parse_rule<Builder> rule) {
+        rules[static_cast<std::size_t>(type)] = rule;
+    };
+
+    for (const token_type type : { token_type::NIL,
+           token_type::FALSE,
+           token_type::TRUE,
+           token_type::NUMBER,
+           token_type::STRING }) {
+        set(type, { &parse_literal<Builder> });
     }
 
-    assert(exprs.size() == 3);
-    return lox::ternary{ expr_c{ std::move(exprs[0]) },
-        expr_c{ std::move(exprs[1]) },
-        expr_c{ std::move(exprs[2]) } };
+    set(token_type::IDENTIFIER, { &parse_variable<Builder> });
+    set(token_type::LEFT_PAREN, { &parse_grouping<Builder> });
+    set(token_type::BANG, { &parse_unary<Builder> });
+    set(token_type::MINUS,
+      { &parse_unary<Builder>, &parse_binary<Builder>, precedence::TERM });
+    set(token_type::PLUS,
+      { nullptr, &parse_binary<Builder>, precedence::TERM });
+    set(token_type::SLASH,
+      { nullptr, &parse_binary<Builder>, precedence::FACTOR });
+    set(token_type::STAR,
+      { nullptr, &parse_binary<Builder>, precedence::FACTOR });
+    for (const token_type type : { token_type::GREATER,
+           token_type::GREATER_EQUAL,
+           token_type::LESS,
+           token_type::LESS_EQUAL }) {
+        set(type, { nullptr, &parse_binary<Builder>, precedence::COMPARISON });
+    }
+
+    set(token_type::BANG_EQUAL,
+      { nullptr, &parse_binary<Builder>, precedence::EQUALITY });
+    set(token_type::EQUAL_EQUAL,
+      { nullptr, &parse_binary<Builder>, precedence::EQUALITY });
+    set(token_type::EQUAL,
+      { nullptr, &parse_assignment<Builder>, precedence::ASSIGNMENT });
+    set(token_type::QUESTION_MARK,
+      { nullptr, &parse_conditional<Builder>, precedence::TERNARY });
+    return rules;
 }
 
-lox::var_stmt parse_var(parser_state& state)
+template<typename Builder>
+stmt_t<Builder> parse_var(parser_state& state, Builder& builder)
 {
     lox::token name =
       consume(state, token_type::IDENTIFIER, "Expected a variable name.");
 
-    lox::expr initializer{};
+    auto initializer = builder.empty();
     if (match(state, { token_type::EQUAL })) {
-        initializer = parse_expression(state);
+        initializer = parse_expression(state, builder);
     }
 
     consume(state, token_type::SEMICOLON, "Expected ';' after value.");
-    return lox::var_stmt{ std::move(name),
-        std::holds_alternative<std::monostate>(initializer)
-          ? expr_c{}
-          : expr_c{ std::move(initializer) } };
+    return builder.var_stmt(std::move(name), std::move(initializer));
 }
 
-lox::expr_stmt parse_expr_statement(parser_state& state)
+template<typename Builder>
+stmt_t<Builder> parse_expr_statement(parser_state& state, Builder& builder)
 {
-    lox::expr expr = parse_ternary(state);
+    auto expr = parse_ternary(state, builder);
     consume(state, token_type::SEMICOLON, "Expected ';' after value.");
-    return lox::expr_stmt{ expr_c{ std::move(expr) } };
+    return builder.expr_stmt(std::move(expr));
 }
 
-lox::print_stmt parse_print(parser_state& state)
+template<typename Builder>
+stmt_t<Builder> parse_print(parser_state& state, Builder& builder)
 {
-    lox::expr expr = parse_ternary(state);
+    auto expr = parse_ternary(state, builder);
     consume(state, token_type::SEMICOLON, "Expected ';' after value.");
-    return lox::print_stmt{ expr_c{ std::move(expr) } };
+    return builder.print_stmt(std::move(expr));
 }
 
-lox::stmt parse_stmt(parser_state& state)
+template<typename Builder>
+stmt_t<Builder> parse_stmt(parser_state& state, Builder& builder)
 {
     if (match(state, { token_type::PRINT })) {
-        return parse_print(state);
+        return parse_print(state, builder);
     }
 
-    return parse_expr_statement(state);
+    return parse_expr_statement(state, builder);
 }
 
-lox::stmt parse_declaration(parser_state& state)
+template<typename Builder>
+stmt_t<Builder> parse_declaration(parser_state& state, Builder& builder)
 {
     if (match(state, { token_type::VAR })) {
-        return parse_var(state);
+        return parse_var(state, builder);
+    }
+
+    return parse_stmt(state, builder);
+}
+
+/*!
+ * Parses declarations from the token at `position` on and appends them to
+ * `result`. Stops at the end of the tokens, or before a declaration if
+ * `is_synced` returns true for its position.
+ * @return The position it stopped at if `is_synced` stopped it.
+ */
+template<typename Synced>
+std::optional<std::size_t> parse_declarations(const lox::token_list& tokens,
+  std::size_t position,
+  lox::parse_result& result,
+  Synced&& is_synced) LOX_NOEXCEPT
+{
+    lox::token_stream stream{ tokens, position };
+    parser_state state{ stream };
+    tree_builder builder{};
+    while (!is_at_end(state) &&
+           peek_compact(state).type != token_type::END_OF_FILE) {
+        if (is_synced(stream.position())) {
+            return stream.position();
+        }
+
+        result.statement_starts.push_back(stream.position());
+        result.statements.push_back(parse_declaration(state, builder));
+    }
+
+    result.statement_starts.push_back(stream.position());
+    return std::nullopt;
+}
+
+/*!
+ * Points the tokens of a statement that reparse() takes over at the new
+ * source, and clears the slots like the parser leaves them.
+ */
+class rebaser {
+public:
+    rebaser(std::string_view previous_source,
+      const lox::source_info& info,
+      std::ptrdiff_t offset_shift,
+      std::ptrdiff_t line_shift) LOX_NOEXCEPT
+      : m_previous_begin{ reinterpret_cast<std::uintptr_t>(
+          previous_source.data()) }
+      , m_previous_size{ previous_source.size() }
+      , m_info{ info }
+      , m_offset_shift{ offset_shift }
+      , m_line_shift{ line_shift }
+    {
+    }
+
+    void operator()(std::string_view& text) const LOX_NOEXCEPT
+    {
+        const auto address = reinterpret_cast<std::uintptr_t>(text.data());
+        if (address < m_previous_begin ||
+            address - m_previous_begin > m_previous_size) {
+            // Not a view into the source.
+            return;
+        }
+
+        text = m_info.source.substr(
+          shift(address - m_previous_begin, m_offset_shift), text.size());
+    }
+
+    void operator()(lox::object& /* value */) const LOX_NOEXCEPT
+    {
+        // Strings own their characters, nothing to point at the new source.
+    }
+
+    void operator()(lox::token& tkn) const LOX_NOEXCEPT
+    {
+        (*this)(tkn.lexeme);
+        tkn.line = shift(tkn.line, m_line_shift);
+        tkn.column_start = shift(tkn.column_start, m_offset_shift);
+        tkn.column_end = shift(tkn.column_end, m_offset_shift);
+        tkn.line_str = m_info.line_str(tkn.line);
+    }
+
+    void operator()(lox::slot_index& slot) const LOX_NOEXCEPT
+    {
+        slot = lox::unresolved_slot;
+    }
+
+    void operator()(lox::copyable<lox::expr*>& child) const LOX_NOEXCEPT
+    {
+        if (child) {
+            std::visit(*this, static_cast<lox::expr&>(*child));
+        }
+    }
+
+    void operator()(std::monostate /* empty */) const LOX_NOEXCEPT
+    {
+    }
+
+    template<typename Node>
+        requires(!std::is_same_v<Node, lox::stmt>)
+    void operator()(Node& node) const LOX_NOEXCEPT
+    {
+        lox::for_each_field(node, *this);
+    }
+
+    void operator()(lox::stmt& statement) const LOX_NOEXCEPT
+    {
+        std::visit(*this, statement);
+    }
+
+private:
+    [[nodiscard]] static std::size_t shift(std::size_t value,
+      std::ptrdiff_t amount) LOX_NOEXCEPT
+    {
+        return static_cast<std::size_t>(static_cast<std::ptrdiff_t>(value) +
+                                        amount);
+    }
+
+private:
+    std::uintptr_t m_previous_begin;
+    std::size_t m_previous_size;
+    const lox::source_info& m_info;
+    std::ptrdiff_t m_offset_shift;
+    std::ptrdiff_t m_line_shift;
+};
+
+/*!
+ * Parses the declarations that start in `[begin, end)` and appends them to
+ * `statements`, the last one may end after `end`. Errors are logged to
+ * `diagnostics` and counted in `error_count`.
+ * @return The position the parser stopped at.
+ */
+template<typename Builder, typename Statements>
+std::size_t parse_range(const lox::token_list& tokens,
+  std::size_t begin,
+  std::size_t end,
+  Builder& builder,
+  Statements& statements,
+  std::ostream& diagnostics,
+  std::size_t& error_count)
+{
+    lox::token_stream stream{ tokens, begin };
+    parser_state state{ stream, 0, &diagnostics };
+    while (stream.position() < end && !is_at_end(state) &&
+           peek_compact(state).type != token_type::END_OF_FILE) {
+        statements.push_back(parse_declaration(state, builder));
+    }
+
+    error_count += state.error_count;
+    return stream.position();
+}
+
+/*!
+ * Returns the token indices that the segments of a parallel parse start at,
+ * followed by the number of tokens. A segment starts after a `;` outside of
+ * any parentheses or braces, which is where the next top-level declaration
+ * starts unless there are errors.
+ */
+[[nodiscard]] std::vector<std::size_t> split_segments(
+  const lox::token_list& tokens,
+  std::size_t count) LOX_NOEXCEPT
+{
+    const std::size_t target{ tokens.size() / count };
+    std::vector<std::size_t> bounds{ 0 };
+    std::size_t depth{ 0 };
+    // Nothing is left to parse after the last `;`, only END_OF_FILE.
+    for (std::size_t index = 0; index + 2 < tokens.size(); ++index) {
+        switch (tokens.compact[index].type) {
+        case token_type::LEFT_PAREN:
+        case token_type::LEFT_BRACE:
+            depth++;
+            break;
+        case token_type::RIGHT_PAREN:
+        case token_type::RIGHT_BRACE:
+            depth -= depth > 0 ? 1 : 0;
+            break;
+        case token_type::VAR:
+        case token_type::PRINT:
+            // Only starts a declaration, whatever is still open is an error.
+            depth = 0;
+            break;
+        case token_type::SEMICOLON:
+            if (depth == 0 && index + 1 >= bounds.back() + target) {
+                bounds.push_back(index + 1);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    bounds.push_back(tokens.size());
+    return bounds;
+}
+
+/*!
+ * The declarations of a segment of a parallel parse. They are parsed
+ * speculatively and only used if the sequential parse gets to the start of the
+ * segment, the errors are held back until then.
+ */
+template<typename Output>
+struct segment {
+    Output output{};
+    // The position the parser stopped at.
+    std::size_t stop{ 0 };
+    std::ostringstream diagnostics{};
+    std::size_t error_count{ 0 };
+};
+
+/*!
+ * Parses all of the tokens into the result, concurrently if the options ask
+ * for it. `parse_segment(output, begin, end, diagnostics, error_count)` parses
+ * the declarations that start in `[begin, end)` into the storage of a segment,
+ * `parse_direct(begin, end, diagnostics, error_count)` parses them into the
+ * result and `append(output)` moves a segment to the end of the result. Both
+ * return the position the parser stopped at.
+ * @return The number of errors.
+ */
+template<typename Output,
+  typename ParseSegment,
+  typename ParseDirect,
+  typename Append>
+std::size_t parse_segments(const lox::token_list& tokens,
+  const lox::parse_options& options,
+  ParseSegment&& parse_segment,
+  ParseDirect&& parse_direct,
+  Append&& append)
+{
+    std::size_t error_count{ 0 };
+    const std::size_t min_segment_size{ std::max<std::size_t>(
+      options.min_segment_size, 1) };
+    if (!options.is_parallel || tokens.size() < min_segment_size * 2) {
+        parse_direct(0, tokens.size(), std::cerr, error_count);
+        return error_count;
+    }
+
+    lox::thread_pool pool{ options.thread_count };
+    if (pool.size() == 1) {
+        parse_direct(0, tokens.size(), std::cerr, error_count);
+        return error_count;
+    }
+
+    // More segments than threads so that a slow segment does not hold up the
+    // rest.
+    const std::vector<std::size_t> bounds{ split_segments(tokens,
+      std::min(tokens.size() / min_segment_size, pool.size() * 4)) };
+    const std::size_t segment_count{ bounds.size() - 1 };
+    std::vector<segment<Output>> segments(segment_count);
+    pool.run(segment_count, [&](std::size_t index) {
+        segment<Output>& current = segments[index];
+        current.stop = parse_segment(current.output,
+          bounds[index],
+          bounds[index + 1],
+          current.diagnostics,
+          current.error_count);
+    });
+
+    // Put the segments together in order. `position` is where the sequential
+    // parse would be, the parser only looks at the tokens from where it
+    // starts on, so a segment that starts there is what it would have parsed.
+    std::size_t position{ 0 };
+    for (std::size_t index = 0; index < segment_count; ++index) {
+        segment<Output>& current = segments[index];
+        if (position == bounds[index]) {
+            std::cerr << current.diagnostics.str();
+            error_count += current.error_count;
+            append(current.output);
+            position = current.stop;
+            continue;
+        }
+
+        assert(position > bounds[index]);
+        if (position < bounds[index + 1]) {
+            // A declaration with errors ran into the segment, the speculative
+            // parse started in the middle of it.
+            position =
+              parse_direct(position, bounds[index + 1], std::cerr, error_count);
+        }
+    }
+
+    return error_count;
+}
+
+/*!
+ * Adds the nodes of a segment to the program of `builder` in the same order.
+ * A hash-consed segment is interned again, the result is the same as if it
+ * had been parsed into the program since the nodes it left out are equal to
+ * an earlier one anyway.
+ */
+void append_program(flat_builder& builder, lox::flat::program& segment)
+{
+    if (!builder.interner) {
+        builder.program.append(std::move(segment));
+        return;
+    }
+
+    std::vector<lox::flat::node_index> moved_to(segment.size());
+    for (lox::flat::node_index index = 0; index < segment.size(); ++index) {
+        moved_to[index] = segment.visit(index, [&](auto& node) {
+            lox::flat::for_each_child(
+              node, [&moved_to](lox::flat::node_index& child) {
+                  if (child != lox::flat::no_node) {
+                      child = moved_to[child];
+                  }
+              });
+
+            using T = std::decay_t<decltype(node)>;
+            if constexpr (std::is_same_v<T, lox::flat::var_stmt> ||
+                          std::is_same_v<T, lox::flat::expr_stmt> ||
+                          std::is_same_v<T, lox::flat::print_stmt>) {
+                return builder.program.add(std::move(node));
+            }
+            else {
+                return builder.add_expr(std::move(node));
+            }
+        });
     }
 
-    return parse_stmt(state);
+    for (const lox::flat::node_index statement : segment.statements) {
+        builder.program.statements.push_back(moved_to[statement]);
+    }
+}
 }
+
+std::vector<lox::stmt> lox::parse(lox::token_stream& tokens)
+{
+    return parse(tokens, std::pmr::get_default_resource());
 }
 
-std::vector<lox::stmt> lox::parse(
-  const std::vector<lox::token>& tokens) LOX_NOEXCEPT
+std::vector<lox::stmt> lox::parse(lox::token_stream& tokens,
+  std::pmr::memory_resource* resource)
+{
+    assert(!tokens.at_end());
+
+    std::vector<lox::stmt> statements{};
+    parser_state state{ tokens };
+    tree_builder builder{ resource };
+    while (!is_at_end(state) &&
+           peek_compact(state).type != token_type::END_OF_FILE) {
+        statements.push_back(parse_declaration(state, builder));
+    }
+
+    return statements;
+}
+
+std::vector<lox::stmt> lox::parse(const lox::token_list& tokens) LOX_NOEXCEPT
+{
+    assert(!tokens.empty());
+
+    lox::token_stream stream{ tokens };
+    return parse(stream);
+}
+
+std::vector<lox::stmt> lox::parse(const lox::token_list& tokens,
+  const parse_options& options) LOX_NOEXCEPT
 {
     assert(!tokens.empty());
 
     std::vector<lox::stmt> statements{};
-    parser_state state{ tokens, 0 };
-    while (!is_at_end(state) && peek(state).type != token_type::END_OF_FILE) {
-        statements.push_back(parse_declaration(state));
+    const std::size_t error_count{ parse_segments<std::vector<lox::stmt>>(
+      tokens,
+      options,
+      [&tokens](std::vector<lox::stmt>& output,
+        std::size_t begin,
+        std::size_t end,
+        std::ostream& diagnostics,
+        std::size_t& errors) {
+          tree_builder builder{};
+          return parse_range(
+            tokens, begin, end, builder, output, diagnostics, errors);
+      },
+      [&tokens, &statements](std::size_t begin,
+        std::size_t end,
+        std::ostream& diagnostics,
+        std::size_t& errors) {
+          tree_builder builder{};
+          return parse_range(
+            tokens, begin, end, builder, statements, diagnostics, errors);
+      },
+      [&statements](std::vector<lox::stmt>& output) {
+          statements.insert(statements.end(),
+            std::make_move_iterator(output.begin()),
+            std::make_move_iterator(output.end()));
+      }) };
+
+    if (options.error_count) {
+        *options.error_count += error_count;
     }
 
     return statements;
 }
+
+lox::flat::program lox::parse_flat(lox::token_stream& tokens,
+  std::pmr::memory_resource* resource)
+{
+    return parse_flat(tokens, parse_options{ .resource = resource });
+}
+
+lox::flat::program lox::parse_flat(const lox::token_list& tokens,
+  std::pmr::memory_resource* resource)
+{
+    return parse_flat(tokens, parse_options{ .resource = resource });
+}
+
+lox::flat::program lox::parse_flat(lox::token_stream& tokens,
+  const parse_options& options)
+{
+    assert(!tokens.at_end());
+
+    lox::flat::program program{ options.resource };
+    std::optional<node_interner> interner{};
+    if (options.is_hash_consed) {
+        interner.emplace(program, options.resource);
+    }
+
+    parser_state state{ tokens };
+    flat_builder builder{ program, interner ? &interner.value() : nullptr };
+    while (!is_at_end(state) &&
+           peek_compact(state).type != token_type::END_OF_FILE) {
+        program.statements.push_back(parse_declaration(state, builder));
+    }
+
+    if (options.error_count) {
+        *options.error_count += state.error_count;
+    }
+
+    return program;
+}
+
+lox::flat::program lox::parse_flat(const lox::token_list& tokens,
+  const parse_options& options)
+{
+    assert(!tokens.empty());
+
+    lox::flat::program program{ options.resource };
+    std::optional<node_interner> interner{};
+    if (options.is_hash_consed) {
+        interner.emplace(program, options.resource);
+    }
+
+    flat_builder builder{ program, interner ? &interner.value() : nullptr };
+    const std::size_t error_count{ parse_segments<lox::flat::program>(
+      tokens,
+      options,
+      [&tokens, &options](lox::flat::program& output,
+        std::size_t begin,
+        std::size_t end,
+        std::ostream& diagnostics,
+        std::size_t& errors) {
+          // Interning the segment first leaves less to intern when it is
+          // added to the program.
+          std::optional<node_interner> segment_interner{};
+          if (options.is_hash_consed) {
+              segment_interner.emplace(
+                output, std::pmr::get_default_resource());
+          }
+
+          flat_builder segment_builder{ output,
+              segment_interner ? &segment_interner.value() : nullptr };
+          return parse_range(tokens,
+            begin,
+            end,
+            segment_builder,
+            output.statements,
+            diagnostics,
+            errors);
+      },
+      [&tokens, &builder](std::size_t begin,
+        std::size_t end,
+        std::ostream& diagnostics,
+        std::size_t& errors) {
+          return parse_range(tokens,
+            begin,
+            end,
+            builder,
+            builder.program.statements,
+            diagnostics,
+            errors);
+      },
+      [&builder](lox::flat::program& output) {
+          append_program(builder, output);
+      }) };
+
+    if (options.error_count) {
+        *options.error_count += error_count;
+    }
+
+    return program;
+}
+
+double lox::sharing_report::ratio() const LOX_NOEXCEPT
+{
+    return unique_nodes == 0 ? 1.0
+                             : static_cast<double>(tree_nodes) /
+                                 static_cast<double>(unique_nodes);
+}
+
+lox::sharing_report lox::report_sharing(
+  const flat::program& program) LOX_NOEXCEPT
+{
+    // A child always comes before its parent, shared or not. Going forward the
+    // size of every subtree is known by the time its parents are reached,
+    // going backward every parent is marked before its children.
+    std::vector<std::size_t> tree_sizes(program.size(), 1);
+    for (flat::node_index index = 0; index < program.size(); ++index) {
+        program.for_each_child(index,
+          [&tree_sizes, index](flat::node_index child) {
+              assert(child < index);
+              tree_sizes[index] += tree_sizes[child];
+          });
+    }
+
+    sharing_report report{ 0, 0 };
+    std::vector<bool> is_used(program.size(), false);
+    for (const flat::node_index statement : program.statements) {
+        if (statement != flat::no_node) {
+            report.tree_nodes += tree_sizes[statement];
+            is_used[statement] = true;
+        }
+    }
+
+    for (std::size_t index = program.size(); index-- > 0;) {
+        if (!is_used[index]) {
+            continue;
+        }
+
+        report.unique_nodes++;
+        program.for_each_child(static_cast<flat::node_index>(index),
+          [&is_used](flat::node_index child) { is_used[child] = true; });
+    }
+
+    return report;
+}
+
+lox::parse_result lox::parse_source(std::string_view source) LOX_NOEXCEPT
+{
+    parse_result result{ scan_tokens(source), {}, {} };
+    if (result.scan.tokens.empty()) {
+        result.statement_starts.push_back(0);
+        return result;
+    }
+
+    parse_declarations(
+      result.scan.tokens, 0, result, [](std::size_t) { return false; });
+    return result;
+}
+
+lox::parse_result lox::reparse(parse_result previous,
+  std::string_view source,
+  const text_edit& edit) LOX_NOEXCEPT
+{
+    // The previous tables are needed to rebase the statements.
+    const std::shared_ptr<const lox::source_info> previous_info{
+        previous.scan.tokens.info
+    };
+    rescan_result rescan{ rescan_tokens(previous.scan, source, edit) };
+    parse_result result{ std::move(rescan.scan), {}, {} };
+    if (result.scan.tokens.empty()) {
+        result.statement_starts.push_back(0);
+        return result;
+    }
+
+    const lox::source_info& info = *result.scan.tokens.info;
+    const std::vector<std::size_t>& starts{ previous.statement_starts };
+    assert(starts.size() == previous.statements.size() + 1);
+
+    // The statements that end before the first rescanned token are the same,
+    // the parser does not look past the end of a statement.
+    const std::size_t kept{ static_cast<std::size_t>(
+      std::upper_bound(
+        std::next(starts.cbegin()), starts.cend(), rescan.first) -
+      std::next(starts.cbegin())) };
+    const rebaser rebase_kept{ previous_info->source, info, 0, 0 };
+    for (std::size_t index = 0; index < kept; ++index) {
+        rebase_kept(previous.statements[index]);
+        result.statements.push_back(std::move(previous.statements[index]));
+        result.statement_starts.push_back(starts[index]);
+    }
+
+    // The tokens after the rescanned ones are the same as before, a
+    // declaration that starts where a previous one started is parsed the same
+    // way. The parser also looks at the token before a declaration, so that
+    // one has to be after the rescanned tokens too, unless there is none.
+    const auto to_previous = [&rescan](std::size_t position) {
+        return position - rescan.end + rescan.previous_end;
+    };
+    const std::optional<std::size_t> synced_at{ parse_declarations(
+      result.scan.tokens,
+      starts[kept],
+      result,
+      [&](std::size_t position) {
+          const bool is_after{ position > rescan.end ||
+                               (position == 0 && rescan.end == 0 &&
+                                 rescan.previous_end == 0) };
+          return is_after &&
+                 std::binary_search(std::next(starts.cbegin(),
+                                      static_cast<std::ptrdiff_t>(kept)),
+                   starts.cend(),
+                   to_previous(position));
+      }) };
+
+    result.reused_statements = kept;
+    if (!synced_at) {
+        return result;
+    }
+
+    const std::size_t from{ to_previous(*synced_at) };
+    const auto first_reused = static_cast<std::size_t>(
+      std::lower_bound(starts.cbegin(), starts.cend(), from) - starts.cbegin());
+    const rebaser rebase_moved{ previous_info->source,
+        info,
+        static_cast<std::ptrdiff_t>(source.size()) -
+          static_cast<std::ptrdiff_t>(previous_info->source.size()),
+        static_cast<std::ptrdiff_t>(info.line_starts.size()) -
+          static_cast<std::ptrdiff_t>(previous_info->line_starts.size()) };
+    for (std::size_t index = first_reused; index < previous.statements.size();
+         ++index) {
+        rebase_moved(previous.statements[index]);
+        result.statements.push_back(std::move(previous.statements[index]));
+        result.statement_starts.push_back(starts[index] + *synced_at - from);
+    }
+
+    result.statement_starts.push_back(starts.back() + *synced_at - from);
+    result.reused_statements += previous.statements.size() - first_reused;
+    return result;
+}
@@ -1,15 +1,133 @@
 #ifndef LOX_PARSER_H
 #define LOX_PARSER_H
 
+#include "scanner.h"
 #include "token.h"
 #include "expr.h"
 #include "defs.h"
 
+#include <memory_resource>
+#include <string_view>
 #include <vector>
 
 namespace lox {
+/*!
+ * Parses the tokens as they are scanned from the stream.
+ * @throws std::bad_alloc if the resource of the stream runs out.
+ */
+[[nodiscard]] std::vector<lox::stmt> parse(lox::token_stream& tokens);
+
+/*!
+ * Same as parse() but the nodes below the statements are allocated from
+ * `resource`, which has to outlive the result.
+ * @throws std::bad_alloc if `resource` or the resource of the stream runs
+ * out.
+ */
+[[nodiscard]] std::vector<lox::stmt> parse(lox::token_stream& tokens,
+  std::pmr::memory_resource* resource);
+
 [[nodiscard]] std::vector<lox::stmt> parse(
-  const std::vector<lox::token>& tokens) LOX_NOEXCEPT;
+  const lox::token_list& tokens) LOX_NOEXCEPT;
+
+/*!
+ * Same as parse() but builds the flat representation, the whole program is
+ * stored in a few contiguous arrays instead of a node per allocation. The
+ * arrays are allocated from `resource`.
+ * @throws std::bad_alloc if `resource` runs out.
+ */
+[[nodiscard]] lox::flat::program parse_flat(lox::token_stream& tokens,
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+[[nodiscard]] lox::flat::program parse_flat(const lox::token_list& tokens,
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+struct parse_options {
+    // Stores structurally identical expressions once and shares them between
+    // all of their parents, the program becomes a DAG. A shared node keeps
+    // the tokens of its first occurrence, so diagnostics point there.
+    bool is_hash_consed{ false };
+    // Where a flat program is allocated from. The segments that are parsed
+    // concurrently are temporaries on the default resource, so the resource
+    // does not have to be thread-safe.
+    std::pmr::memory_resource* resource{ std::pmr::get_default_resource() };
+    // If given, the number of reported errors is added to it.
+    std::size_t* error_count{ nullptr };
+    // Splits a lox::token_list into segments at the `;` between top-level
+    // declarations and parses them concurrently. A token_stream is always
+    // parsed on the calling thread.
+    bool is_parallel{ false };
+    // Segments are at least this many tokens, fewer tokens are parsed on the
+    // calling thread.
+    std::size_t min_segment_size{ 64 * 1024 };
+    // The number of threads including the caller, 0 uses the hardware
+    // concurrency.
+    std::size_t thread_count{ 0 };
+};
+
+/*!
+ * Same as parse(const lox::token_list&) with the given options, the ones that
+ * only apply to the flat representation are ignored. The result, including
+ * the errors and the order they are logged in, does not depend on the
+ * options.
+ */
+[[nodiscard]] std::vector<lox::stmt> parse(const lox::token_list& tokens,
+  const parse_options& options) LOX_NOEXCEPT;
+
+[[nodiscard]] lox::flat::program parse_flat(lox::token_stream& tokens,
+  const parse_options& options);
+
+[[nodiscard]] lox::flat::program parse_flat(const lox::token_list& tokens,
+  const parse_options& options);
+
+/*!
+ * The statements of a source along with the tokens they were parsed from,
+ * which is what reparse() needs to find the statements that an edit touches.
+ */
+struct parse_result {
+    lox::scan_result scan;
+    std::vector<lox::stmt> statements;
+    // The index of the first token of each statement, followed by the index of
+    // the token the parser stopped at.
+    std::vector<std::size_t> statement_starts;
+    // The number of statements reparse() took over from the previous result.
+    std::size_t reused_statements{ 0 };
+};
+
+[[nodiscard]] parse_result parse_source(std::string_view source) LOX_NOEXCEPT;
+
+/*!
+ * Parses `source`, which is the source of `previous` with `edit` applied to
+ * it, again. The tokens are rescanned with lox::rescan_tokens() and only the
+ * statements that overlap the rescanned tokens are parsed again, the others
+ * are moved over from `previous` and their tokens are pointed at the new
+ * source. The result is the same as parse_source(source), only the errors of
+ * the statements that are parsed again are reported.
+ * @note The previous source does not have to be alive anymore, the statements
+ * of `previous` are only rebased by the address it had.
+ */
+[[nodiscard]] parse_result reparse(parse_result previous,
+  std::string_view source,
+  const text_edit& edit) LOX_NOEXCEPT;
+
+/*!
+ * How much of a flat program is shared. Only the nodes that can be reached
+ * from the statements are counted, the parser leaves a few unused nodes
+ * behind, e.g. the variable that turns out to be the target of an assignment.
+ */
+struct sharing_report {
+    // The number of nodes the statements would have if nothing was shared.
+    std::size_t tree_nodes;
+    // The number of distinct nodes the statements use.
+    std::size_t unique_nodes;
+
+    /*!
+     * Returns tree_nodes / unique_nodes, 1 when nothing is shared.
+     */
+    [[nodiscard]] double ratio() const LOX_NOEXCEPT;
+};
+
+[[nodiscard]] sharing_report report_sharing(
+  const lox::flat::program& program) LOX_NOEXCEPT;
 }
 
 #endif
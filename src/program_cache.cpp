@@ -0,0 +1,510 @@
+#include "program_cache.h"
+
+#include "source.h"
+#include "symbols.h"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <system_error>
+#include <type_traits>
+#include <variant>
+
+namespace {
+template<typename>
+[[maybe_unused]] constexpr bool always_false_v = false;
+
+using lox::flat::node_index;
+using lox::flat::node_kind;
+
+constexpr std::array<char, 4> s_magic{ 'L', 'O', 'X', 'C' };
+// Written in the byte order of the machine, files from a machine with another
+// byte order are rejected.
+constexpr std::uint32_t s_byte_order{ 0x01020304 };
+// Bump when the encoding changes. Changes to the nodes are picked up from
+// lox::flat::layout_hash.
+constexpr std::uint64_t s_format_version{ 2 };
+
+[[nodiscard]] std::uint64_t mix(std::uint64_t value) LOX_NOEXCEPT
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccd;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53;
+    value ^= value >> 33;
+    return value;
+}
+
+class writer {
+public:
+    explicit writer(std::string_view source) LOX_NOEXCEPT : m_source{ source }
+    {
+    }
+
+    template<typename T>
+    void write(T value) LOX_NOEXCEPT
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Requirement error.");
+        const auto* bytes = reinterpret_cast<const char*>(&value);
+        m_data.append(bytes, sizeof(T));
+    }
+
+    /*!
+     * Writes the view as an offset into the source. Empty views do not have
+     * to point into the source.
+     */
+    void write(std::string_view text) LOX_NOEXCEPT
+    {
+        if (text.empty()) {
+            write(std::uint32_t{ 0 });
+            write(std::uint32_t{ 0 });
+            return;
+        }
+
+        const auto address = reinterpret_cast<std::uintptr_t>(text.data());
+        const auto begin = reinterpret_cast<std::uintptr_t>(m_source.data());
+        if (address < begin || address - begin > m_source.size() ||
+            text.size() > m_source.size() - (address - begin)) {
+            m_is_valid = false;
+            return;
+        }
+
+        write(static_cast<std::uint32_t>(address - begin));
+        write(static_cast<std::uint32_t>(text.size()));
+    }
+
+    /*!
+     * Strings are written with their characters, they do not have to come
+     * from the source.
+     */
+    void write(const lox::heap_string& text) LOX_NOEXCEPT
+    {
+        write(static_cast<std::uint32_t>(text.size()));
+        m_data.append(text.view());
+    }
+
+    void write(const lox::object& value) LOX_NOEXCEPT
+    {
+        write(static_cast<std::uint8_t>(value.index()));
+        std::visit(
+          [this](const auto& arg) {
+              using T = std::decay_t<decltype(arg)>;
+              if constexpr (std::is_same_v<T, std::monostate> ||
+                            std::is_same_v<T, std::nullptr_t>) {
+                  // Nothing but the type.
+              }
+              else if constexpr (std::is_same_v<T, bool>) {
+                  write(static_cast<std::uint8_t>(arg));
+              }
+              else if constexpr (std::is_same_v<T, double> ||
+                                 std::is_same_v<T, lox::heap_string>) {
+                  write(arg);
+              }
+              else {
+                  static_assert(always_false_v<T>, "Unhandled type.");
+              }
+          },
+          value);
+    }
+
+    void write(const lox::token& tkn) LOX_NOEXCEPT
+    {
+        write(tkn.type);
+        write(tkn.lexeme);
+        write(tkn.literal);
+        write(static_cast<std::uint32_t>(tkn.line));
+        write(static_cast<std::uint32_t>(tkn.column_start));
+        write(static_cast<std::uint32_t>(tkn.column_end));
+        write(tkn.line_str);
+    }
+
+    [[nodiscard]] bool is_valid() const LOX_NOEXCEPT
+    {
+        return m_is_valid;
+    }
+
+    [[nodiscard]] std::string take() LOX_NOEXCEPT
+    {
+        return std::move(m_data);
+    }
+
+private:
+    std::string_view m_source;
+    std::string m_data{};
+    bool m_is_valid{ true };
+};
+
+/*!
+ * Reads what writer wrote. Running past the end of the data or reading a
+ * value that cannot be right invalidates the reader, the values that are read
+ * afterwards are zero.
+ */
+class reader {
+public:
+    reader(std::string_view data, std::string_view source) LOX_NOEXCEPT
+      : m_data{ data }
+      , m_source{ source }
+    {
+    }
+
+    template<typename T>
+    [[nodiscard]] T read() LOX_NOEXCEPT
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Requirement error.");
+        T value{};
+        if (!m_is_valid || m_data.size() - m_position < sizeof(T)) {
+            m_is_valid = false;
+            return value;
+        }
+
+        std::memcpy(&value, m_data.data() + m_position, sizeof(T));
+        m_position += sizeof(T);
+        return value;
+    }
+
+    void read(std::uint32_t& value) LOX_NOEXCEPT
+    {
+        value = read<std::uint32_t>();
+    }
+
+    void read(std::string_view& text) LOX_NOEXCEPT
+    {
+        const auto offset = read<std::uint32_t>();
+        const auto size = read<std::uint32_t>();
+        if (offset > m_source.size() || size > m_source.size() - offset) {
+            m_is_valid = false;
+            return;
+        }
+
+        text = m_source.substr(offset, size);
+    }
+
+    void read(lox::heap_string& text) LOX_NOEXCEPT
+    {
+        const auto size = read<std::uint32_t>();
+        if (!m_is_valid || m_data.size() - m_position < size) {
+            m_is_valid = false;
+            return;
+        }
+
+        text = lox::heap_string{ m_data.substr(m_position, size) };
+        m_position += size;
+    }
+
+    void read(lox::object& value) LOX_NOEXCEPT
+    {
+        read_alternative(read<std::uint8_t>(), value);
+    }
+
+    void read(lox::token& tkn) LOX_NOEXCEPT
+    {
+        tkn.type = read<lox::token::token_type>();
+        if (tkn.type > lox::token::token_type::END_OF_FILE) {
+            m_is_valid = false;
+        }
+
+        read(tkn.lexeme);
+        read(tkn.literal);
+        tkn.line = read<std::uint32_t>();
+        tkn.column_start = read<std::uint32_t>();
+        tkn.column_end = read<std::uint32_t>();
+        read(tkn.line_str);
+        // Symbols are only valid in the process that interned them.
+        tkn.symbol = tkn.type == lox::token::token_type::IDENTIFIER
+                       ? lox::symbols().intern(tkn.lexeme)
+                       : lox::no_symbol;
+    }
+
+    void invalidate() LOX_NOEXCEPT
+    {
+        m_is_valid = false;
+    }
+
+    [[nodiscard]] bool is_valid() const LOX_NOEXCEPT
+    {
+        return m_is_valid;
+    }
+
+    [[nodiscard]] bool is_at_end() const LOX_NOEXCEPT
+    {
+        return m_position == m_data.size();
+    }
+
+private:
+    template<std::size_t Index = 0>
+    void read_alternative(std::uint8_t index, lox::object& value) LOX_NOEXCEPT
+    {
+        if constexpr (Index == std::variant_size_v<lox::object>) {
+            LOX_UNUSED(index);
+            LOX_UNUSED(value);
+            m_is_valid = false;
+        }
+        else if (index != Index) {
+            read_alternative<Index + 1>(index, value);
+        }
+        else {
+            using T = std::variant_alternative_t<Index, lox::object>;
+            T& alternative = value.emplace<Index>();
+            if constexpr (std::is_same_v<T, std::monostate> ||
+                          std::is_same_v<T, std::nullptr_t>) {
+                // Nothing but the type.
+            }
+            else if constexpr (std::is_same_v<T, bool>) {
+                const auto byte = read<std::uint8_t>();
+                m_is_valid = m_is_valid && byte <= 1;
+                alternative = byte == 1;
+            }
+            else if constexpr (std::is_same_v<T, double>) {
+                alternative = read<double>();
+            }
+            else if constexpr (std::is_same_v<T, lox::heap_string>) {
+                read(alternative);
+            }
+            else {
+                static_assert(always_false_v<T>, "Unhandled type.");
+            }
+        }
+    }
+
+private:
+    std::string_view m_data;
+    std::string_view m_source;
+    std::size_t m_position{ 0 };
+    bool m_is_valid{ true };
+};
+
+template<typename T>
+void read_node(reader& rdr, lox::flat::program& program)
+{
+    T node{};
+    lox::flat::for_each_field(node, [&rdr](auto& field) { rdr.read(field); });
+    if (!rdr.is_valid()) {
+        return;
+    }
+
+    const node_index index{ program.add(std::move(node)) };
+    // Children come before their parents, which also rules out cycles.
+    program.for_each_child(index, [&rdr, index](node_index child) {
+        if (child >= index) {
+            rdr.invalidate();
+        }
+    });
+}
+
+void read_node(reader& rdr, lox::flat::program& program)
+{
+    switch (rdr.read<node_kind>()) {
+        case node_kind::BINARY:
+            return read_node<lox::flat::binary>(rdr, program);
+        case node_kind::TERNARY:
+            return read_node<lox::flat::ternary>(rdr, program);
+        case node_kind::GROUPING:
+            return read_node<lox::flat::grouping>(rdr, program);
+        case node_kind::LITERAL:
+            return read_node<lox::flat::literal>(rdr, program);
+        case node_kind::UNARY:
+            return read_node<lox::flat::unary>(rdr, program);
+        case node_kind::VARIABLE:
+            return read_node<lox::flat::variable>(rdr, program);
+        case node_kind::ASSIGNMENT:
+            return read_node<lox::flat::assignment>(rdr, program);
+        case node_kind::EXPR_STMT:
+            return read_node<lox::flat::expr_stmt>(rdr, program);
+        case node_kind::PRINT_STMT:
+            return read_node<lox::flat::print_stmt>(rdr, program);
+        case node_kind::VAR_STMT:
+            return read_node<lox::flat::var_stmt>(rdr, program);
+    }
+
+    rdr.invalidate();
+}
+
+[[nodiscard]] std::optional<lox::flat::program> decode(std::string_view data,
+  std::string_view source,
+  const lox::content_hash& hash,
+  std::pmr::memory_resource* resource)
+{
+    reader rdr{ data, source };
+    const bool is_current{ rdr.read<std::array<char, 4>>() == s_magic &&
+                           rdr.read<std::uint32_t>() == s_byte_order &&
+                           rdr.read<std::uint64_t>() ==
+                             lox::compiler_version() &&
+                           rdr.read<std::uint64_t>() == source.size() &&
+                           rdr.read<std::uint64_t>() == hash.low &&
+                           rdr.read<std::uint64_t>() == hash.high };
+    const auto node_count = rdr.read<std::uint32_t>();
+    const auto statement_count = rdr.read<std::uint32_t>();
+    if (!is_current || !rdr.is_valid()) {
+        return std::nullopt;
+    }
+
+    lox::flat::program program{ resource };
+    for (std::uint32_t index = 0; index < node_count && rdr.is_valid();
+         ++index) {
+        read_node(rdr, program);
+    }
+
+    for (std::uint32_t index = 0; index < statement_count && rdr.is_valid();
+         ++index) {
+        const auto statement = rdr.read<node_index>();
+        if (statement != lox::flat::no_node && statement >= program.size()) {
+            rdr.invalidate();
+        }
+
+        program.statements.push_back(statement);
+    }
+
+    if (!rdr.is_valid() || !rdr.is_at_end()) {
+        return std::nullopt;
+    }
+
+    return program;
+}
+
+[[nodiscard]] std::string to_hex(std::uint64_t value) LOX_NOEXCEPT
+{
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0') << std::setw(16) << value;
+    return ss.str();
+}
+}
+
+lox::content_hash lox::hash_content(std::string_view source) LOX_NOEXCEPT
+{
+    // Two lanes with different seeds, each word goes through both.
+    content_hash hash{ 0x9e3779b97f4a7c15 ^ source.size(),
+        0xc2b2ae3d27d4eb4f ^ source.size() };
+    std::size_t index{ 0 };
+    for (; index + 8 <= source.size(); index += 8) {
+        std::uint64_t word{};
+        std::memcpy(&word, source.data() + index, 8);
+        hash.low = mix(hash.low ^ word);
+        hash.high = mix(hash.high + word) * 0x9e3779b97f4a7c15;
+    }
+
+    std::uint64_t tail{};
+    std::memcpy(&tail, source.data() + index, source.size() - index);
+    hash.low = mix(hash.low ^ tail);
+    hash.high = mix(hash.high + tail) * 0x9e3779b97f4a7c15;
+    return hash;
+}
+
+std::uint64_t lox::compiler_version() LOX_NOEXCEPT
+{
+    // The tokens and the literals are stored by their numbering, so a change
+    // to either one makes a new version too.
+    return mix(flat::layout_hash ^ (s_format_version << 48) ^
+               (static_cast<std::uint64_t>(token::token_type::END_OF_FILE)
+                 << 32) ^
+               std::variant_size_v<object>);
+}
+
+std::optional<std::string> lox::serialize(const flat::program& program,
+  std::string_view source) LOX_NOEXCEPT
+{
+    const content_hash hash{ hash_content(source) };
+    writer wrt{ source };
+    wrt.write(s_magic);
+    wrt.write(s_byte_order);
+    wrt.write(compiler_version());
+    wrt.write(static_cast<std::uint64_t>(source.size()));
+    wrt.write(hash.low);
+    wrt.write(hash.high);
+    wrt.write(static_cast<std::uint32_t>(program.size()));
+    wrt.write(static_cast<std::uint32_t>(program.statements.size()));
+    for (node_index index = 0; index < program.size(); ++index) {
+        wrt.write(program.kind(index));
+        program.visit(index, [&wrt](const auto& node) {
+            flat::for_each_field(node, [&wrt](const auto& field) {
+                wrt.write(field);
+            });
+        });
+    }
+
+    for (const node_index statement : program.statements) {
+        wrt.write(statement);
+    }
+
+    if (!wrt.is_valid()) {
+        return std::nullopt;
+    }
+
+    return wrt.take();
+}
+
+std::optional<lox::flat::program> lox::deserialize(std::string_view data,
+  std::string_view source,
+  std::pmr::memory_resource* resource)
+{
+    return decode(data, source, hash_content(source), resource);
+}
+
+lox::program_cache::program_cache(
+  std::filesystem::path directory) LOX_NOEXCEPT
+  : m_directory{ std::move(directory) }
+{
+}
+
+std::optional<lox::flat::program> lox::program_cache::load(
+  std::string_view source,
+  std::pmr::memory_resource* resource) const
+{
+    const content_hash hash{ hash_content(source) };
+    const auto file = source_file::open(entry_path(hash).string());
+    if (!file) {
+        return std::nullopt;
+    }
+
+    return decode(file->text(), source, hash, resource);
+}
+
+bool lox::program_cache::store(std::string_view source,
+  const flat::program& program) const LOX_NOEXCEPT
+{
+    const auto data = serialize(program, source);
+    if (!data) {
+        return false;
+    }
+
+    std::error_code error{};
+    std::filesystem::create_directories(m_directory, error);
+    if (error) {
+        return false;
+    }
+
+    const std::filesystem::path path{ entry_path(hash_content(source)) };
+    std::filesystem::path temporary{ path };
+    temporary += '.' + to_hex(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream file{ temporary, std::ofstream::binary };
+        file.write(data->data(), static_cast<std::streamsize>(data->size()));
+        if (!file.good()) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
+
+std::filesystem::path lox::program_cache::entry_path(
+  std::string_view source) const LOX_NOEXCEPT
+{
+    return entry_path(hash_content(source));
+}
+
+std::filesystem::path lox::program_cache::entry_path(
+  const content_hash& hash) const LOX_NOEXCEPT
+{
+    return m_directory / (to_hex(hash.high) + to_hex(hash.low) + '-' +
+                           to_hex(compiler_version()) + ".loxc");
+}
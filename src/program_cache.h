@@ -0,0 +1,94 @@
+#ifndef LOX_PROGRAM_CACHE_H
+#define LOX_PROGRAM_CACHE_H
+
+#include "expr.h"
+#include "defs.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace lox {
+
+/*!
+ * A 128-bit hash of the contents of a source. It is fast, not cryptographic.
+ */
+struct content_hash {
+    std::uint64_t low;
+    std::uint64_t high;
+
+    [[nodiscard]] bool operator==(
+      const content_hash& other) const LOX_NOEXCEPT = default;
+};
+
+[[nodiscard]] content_hash hash_content(std::string_view source) LOX_NOEXCEPT;
+
+/*!
+ * Identifies the compiler that wrote a serialized program. It changes with the
+ * serialization format and with the layout of the flat nodes.
+ */
+[[nodiscard]] std::uint64_t compiler_version() LOX_NOEXCEPT;
+
+/*!
+ * Serializes a program that was parsed from `source`. The text of the tokens
+ * is stored as offsets into the source, so the source is needed to load it.
+ * @return std::nullopt if the program refers to text outside of the source.
+ */
+[[nodiscard]] std::optional<std::string> serialize(
+  const flat::program& program,
+  std::string_view source) LOX_NOEXCEPT;
+
+/*!
+ * Loads a program that was serialized from the same source by the same
+ * compiler version. The tokens of the program refer to `source`, which must
+ * outlive the program.
+ * @return std::nullopt if the data is for another source or compiler version,
+ * or if it is damaged.
+ * @throws std::bad_alloc if `resource` runs out.
+ */
+[[nodiscard]] std::optional<flat::program> deserialize(std::string_view data,
+  std::string_view source,
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/*!
+ * A directory of serialized programs, one file per source content and
+ * compiler version. Entries are written to a temporary file and renamed into
+ * place, so concurrent runs never see a partial entry. Entries are loaded with
+ * mmap and are never evicted.
+ */
+class program_cache {
+public:
+    explicit program_cache(std::filesystem::path directory) LOX_NOEXCEPT;
+
+    /*!
+     * Returns the program that was stored for the source, if there is a valid
+     * one.
+     * @throws std::bad_alloc if `resource` runs out.
+     */
+    [[nodiscard]] std::optional<flat::program> load(std::string_view source,
+      std::pmr::memory_resource* resource =
+        std::pmr::get_default_resource()) const;
+
+    /*!
+     * Stores the program that was parsed from the source.
+     * @return false if the entry could not be written.
+     */
+    bool store(std::string_view source,
+      const flat::program& program) const LOX_NOEXCEPT;
+
+    [[nodiscard]] std::filesystem::path entry_path(
+      std::string_view source) const LOX_NOEXCEPT;
+
+private:
+    [[nodiscard]] std::filesystem::path entry_path(
+      const content_hash& hash) const LOX_NOEXCEPT;
+
+private:
+    std::filesystem::path m_directory;
+};
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include "resolver.h"
+
+#include "environment.h"
+
+namespace {
+template<typename>
+[[maybe_unused]] constexpr bool always_false_v = false;
+
+using lox::flat::is_node_v;
+
+struct tree_walker;
+
+void resolve_expr(lox::expr& expression, const tree_walker& walk) LOX_NOEXCEPT;
+
+/*!
+ * Resolves the children of the pointer based AST.
+ */
+struct tree_walker {
+    lox::environment& env;
+    // Set when a slot changes, the closure and the chunk that the statement
+    // was compiled into are then out of date.
+    bool& is_changed;
+
+    void operator()(lox::copyable<lox::expr*>& child) const LOX_NOEXCEPT
+    {
+        resolve_expr(*child, *this);
+    }
+
+    [[nodiscard]] static bool has(
+      const lox::copyable<lox::expr*>& child) LOX_NOEXCEPT
+    {
+        return child;
+    }
+
+    void set_slot(lox::slot_index& slot,
+      lox::slot_index resolved) const LOX_NOEXCEPT
+    {
+        is_changed = is_changed || slot != resolved;
+        slot = resolved;
+    }
+};
+
+/*!
+ * Resolves the children of a lox::flat::program.
+ */
+struct flat_walker {
+    lox::flat::program& program;
+    lox::environment& env;
+
+    void operator()(lox::flat::node_index child) const;
+
+    [[nodiscard]] static bool has(lox::flat::node_index child) LOX_NOEXCEPT
+    {
+        return child != lox::flat::no_node;
+    }
+
+    static void set_slot(lox::slot_index& slot,
+      lox::slot_index resolved) LOX_NOEXCEPT
+    {
+        slot = resolved;
+    }
+};
+
+constexpr auto resolver_visitor = [](auto&& arg, const auto& walk) {
+    using T = std::decay_t<decltype(arg)>;
+    if constexpr (is_node_v<T, lox::literal> ||
+                  std::is_same_v<T, std::monostate>) {
+        // No-op
+    }
+    else if constexpr (is_node_v<T, lox::grouping>) {
+        walk(arg.expression);
+    }
+    else if constexpr (is_node_v<T, lox::unary>) {
+        walk(arg.right);
+    }
+    else if constexpr (is_node_v<T, lox::binary>) {
+        walk(arg.left);
+        walk(arg.right);
+    }
+    else if constexpr (is_node_v<T, lox::ternary>) {
+        walk(arg.first);
+        walk(arg.second);
+        if (walk.has(arg.third)) {
+            walk(arg.third);
+        }
+    }
+    else if constexpr (is_node_v<T, lox::expr_stmt> ||
+                       is_node_v<T, lox::print_stmt>) {
+        walk(arg.expression);
+    }
+    else if constexpr (is_node_v<T, lox::var_stmt>) {
+        // The initializer is resolved first so that `var a = a;` does not
+        // refer to itself.
+        if (walk.has(arg.expression)) {
+            walk(arg.expression);
+        }
+
+        walk.set_slot(arg.slot, lox::env::declare(walk.env, arg.name));
+    }
+    else if constexpr (is_node_v<T, lox::variable>) {
+        walk.set_slot(arg.slot, lox::env::find(walk.env, arg.name));
+    }
+    else if constexpr (is_node_v<T, lox::assignment>) {
+        walk(arg.value);
+        walk.set_slot(arg.slot, lox::env::find(walk.env, arg.name));
+    }
+    else {
+        static_assert(always_false_v<T>, "Unhandled type.");
+    }
+};
+
+void resolve_expr(lox::expr& expression, const tree_walker& walk) LOX_NOEXCEPT
+{
+    std::visit(
+      [&walk](auto&& arg) {
+          resolver_visitor(std::forward<decltype(arg)>(arg), walk);
+      },
+      expression);
+}
+
+void flat_walker::operator()(lox::flat::node_index child) const
+{
+    if (child == lox::flat::no_node) {
+        return;
+    }
+
+    program.visit(child, [this](auto& arg) { resolver_visitor(arg, *this); });
+}
+}
+
+void lox::resolve(std::vector<stmt>& statements, environment& env)
+{
+    for (auto& statement : statements) {
+        resolve(statement, env);
+    }
+}
+
+void lox::resolve(stmt& statement, environment& env)
+{
+    std::visit(
+      [&env](auto&& arg) {
+          bool is_changed{ false };
+          resolver_visitor(arg, tree_walker{ env, is_changed });
+          if constexpr (requires { arg.compiled; }) {
+              if (is_changed) {
+                  arg.compiled.reset();
+                  arg.bytecode.reset();
+              }
+          }
+      },
+      statement);
+}
+
+void lox::resolve(flat::program& program, environment& env)
+{
+    const flat_walker walk{ program, env };
+    for (const flat::node_index statement : program.statements) {
+        walk(statement);
+    }
+}
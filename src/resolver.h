@@ -0,0 +1,28 @@
+#ifndef LOX_RESOLVER_H
+#define LOX_RESOLVER_H
+
+#include "expr.h"
+#include "defs.h"
+
+#include <vector>
+
+namespace lox {
+struct environment;
+
+/*!
+ * Assigns every declared variable a slot in the environment and stores it in
+ * the `var_stmt`, `variable` and `assignment` nodes so that the engines can
+ * access variables by index instead of by name.
+ *
+ * Variables that are used before they are declared are left unresolved and
+ * are looked up by name at run time. The environment keeps the slots between
+ * calls, so statements that are resolved later (e.g. in the REPL) see the
+ * variables that were declared before.
+ * @throws std::bad_alloc if the resource of the environment runs out.
+ */
+void resolve(std::vector<stmt>& statements, environment& env);
+void resolve(stmt& statement, environment& env);
+void resolve(flat::program& program, environment& env);
+}
+
+#endif
@@ -1,66 +1,93 @@
 #include "scanner.h"
 
+#include "literals.h"
+#include "simd.h"
+#include "symbols.h"
+#include "thread_pool.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <optional>
 
 using token_type = lox::token::token_type;
 
 namespace {
+/*!
+ * Creates the side tables so that they, and the block that holds them, are
+ * allocated from `resource`.
+ */
+[[nodiscard]] std::shared_ptr<lox::source_info> make_info(
+  std::pmr::memory_resource* resource)
+{
+    return std::allocate_shared<lox::source_info>(
+      std::pmr::polymorphic_allocator<lox::source_info>{ resource },
+      lox::source_info{ {},
+        std::pmr::vector<lox::object>{ resource },
+        std::pmr::vector<std::uint32_t>{ resource } });
+}
+
 struct scan_data {
     std::string_view source;
-    std::vector<lox::token> tokens{};
+    std::pmr::memory_resource* resource{ std::pmr::get_default_resource() };
+    std::shared_ptr<lox::source_info> info{ make_info(resource) };
+    lox::literals::literal_table literals{ info->literals };
+    lox::symbol_cache symbols{ lox::symbols() };
+    std::pmr::vector<lox::compact_token> tokens{ resource };
+    std::pmr::vector<lox::compact_token> trivia{ resource };
     std::size_t start{ 0 };
-    std::size_t line{ 0 };
     std::size_t current{ 0 };
-    std::vector<lox::scan_result::error> errors{};
-};
-
-const std::map<std::string_view, token_type> s_keywords{
-    { "and", token_type::AND },
-    { "class", token_type::CLASS },
-    { "else", token_type::ELSE },
-    { "false", token_type::FALSE },
-    { "for", token_type::FOR },
-    { "fun", token_type::FUN },
-    { "if", token_type::IF },
-    { "nil", token_type::NIL },
-    { "or", token_type::OR },
-    { "print", token_type::PRINT },
-    { "super", token_type::SUPER },
-    { "this", token_type::THIS },
-    { "true", token_type::TRUE },
-    { "var", token_type::VAR },
-    { "while", token_type::WHILE },
+    std::pmr::vector<lox::scan_result::error> errors{ resource };
+    // Speculative scans do not have the line table. Their errors are not
+    // logged and the line is filled in once the error is known to be real.
+    bool is_speculative{ false };
+    std::size_t error_start{ 0 };
 };
 
 const std::map<lox::scan_result::error::error_type, std::string_view>
   s_error_messages{ { lox::scan_result::error::error_type::UNTERMINATED_STRING,
                       "Unterminated string." },
       { lox::scan_result::error::error_type::UNKNOWN_TOKEN,
-        "Unknown token." } };
-
-[[nodiscard]] std::string_view get_current_line_str(
-  const scan_data& scn) LOX_NOEXCEPT
+        "Unknown token." },
+      { lox::scan_result::error::error_type::SOURCE_TOO_LARGE,
+        "Source is too large, the limit is 4 GiB." } };
+
+/*!
+ * Returns true if every offset into `source`, and the offset past its end,
+ * fits in the 32-bit offsets of lox::compact_token and the line starts.
+ */
+[[nodiscard]] bool fits_offsets(std::string_view source) LOX_NOEXCEPT
 {
-    std::size_t index{ scn.start };
-    while (index > 0 && scn.source.at(index) != '\n') {
-        index--;
-    }
-
-    std::size_t start_index{ index };
-    index = scn.current;
-    while (index < scn.source.size() && scn.source.at(index) != '\n') {
-        index++;
-    }
+    return source.size() < std::numeric_limits<std::uint32_t>::max();
+}
 
-    std::size_t end_index{ index };
-    return scn.source.substr(start_index, end_index);
+/*!
+ * Returns the zero based line of the current token.
+ */
+[[nodiscard]] std::size_t current_line(const scan_data& scn) LOX_NOEXCEPT
+{
+    return scn.info->line(static_cast<std::uint32_t>(scn.start));
 }
 
 void log_error(const scan_data& scn, std::string_view message) LOX_NOEXCEPT
 {
-    lox::log_error(get_current_line_str(scn), scn.line + 1, scn.start, message);
+    const std::size_t line{ current_line(scn) };
+    lox::log_error(scn.info->line_str(line), line + 1, scn.start, message);
+}
+
+void add_error(scan_data& scn, lox::scan_result::error::error_type type)
+{
+    scn.error_start = scn.start;
+    if (scn.is_speculative) {
+        scn.errors.emplace_back(type, 0);
+        return;
+    }
+
+    scn.errors.emplace_back(type, current_line(scn));
+    log_error(scn, scn.errors.back().message);
 }
 
 [[nodiscard]] bool is_at_end(const scan_data& scn) LOX_NOEXCEPT
@@ -70,7 +97,7 @@ void log_error(const scan_data& scn, std::string_view message) LOX_NOEXCEPT
 
 [[maybe_unused]] char advance(scan_data& scn, int count = 1) LOX_NOEXCEPT
 {
-    char ch = scn.source.at(scn.current);
+    char ch = scn.source[scn.current];
     scn.current += count;
     return ch;
 }
@@ -81,7 +108,7 @@ void log_error(const scan_data& scn, std::string_view message) LOX_NOEXCEPT
         return '\0';
     }
 
-    return scn.source.at(scn.current);
+    return scn.source[scn.current];
 }
 
 [[nodiscard]] char peek_next(const scan_data& scn) LOX_NOEXCEPT
@@ -90,7 +117,7 @@ void log_error(const scan_data& scn, std::string_view message) LOX_NOEXCEPT
         return '\0';
     }
 
-    return scn.source.at(scn.current + 1);
+    return scn.source[scn.current + 1];
 }
 
 [[nodiscard]] bool match(scan_data& scn, char expected) LOX_NOEXCEPT
@@ -99,7 +126,7 @@ void log_error(const scan_data& scn, std::string_view message) LOX_NOEXCEPT
         return false;
     }
 
-    if (scn.source.at(scn.current) != expected) {
+    if (scn.source[scn.current] != expected) {
         return false;
     }
 
@@ -107,204 +134,175 @@ void log_error(const scan_data& scn, std::string_view message) LOX_NOEXCEPT
     return true;
 }
 
-[[nodiscard]] lox::token create_token(const scan_data& scn,
+[[nodiscard]] lox::compact_token create_token(const scan_data& scn,
   token_type type,
-  lox::object literal) LOX_NOEXCEPT
+  std::uint32_t literal = lox::compact_token::no_literal) LOX_NOEXCEPT
 {
     return { type,
-        scn.source.substr(scn.start, scn.current - scn.start),
-        literal,
-        scn.line,
-        scn.start,
-        scn.current,
-        get_current_line_str(scn) };
+        static_cast<std::uint32_t>(scn.start),
+        static_cast<std::uint32_t>(scn.current - scn.start),
+        literal };
 }
 
-void scan_string(scan_data& scn) LOX_NOEXCEPT
+void scan_string(scan_data& scn)
 {
-    while (peek(scn) != '"' && !is_at_end(scn)) {
-        if (peek(scn) == '\n') {
-            scn.line++;
-        }
-
-        advance(scn);
-    }
+    scn.current = lox::simd::find_either(scn.source, scn.current, '"', '"');
 
     if (is_at_end(scn)) {
-        scn.errors.emplace_back(
-          lox::scan_result::error::error_type::UNTERMINATED_STRING, scn.line);
-        log_error(scn, "Unterminated string.");
+        add_error(
+          scn, lox::scan_result::error::error_type::UNTERMINATED_STRING);
         return;
     }
 
     // Closing '"'
     advance(scn);
 
-    scn.tokens.push_back(lox::token{ token_type::STRING,
-      scn.source.substr(scn.start, scn.current - scn.start),
-      scn.source.substr(scn.start + 1, scn.current - scn.start - 2),
-      scn.line,
-      scn.start,
-      scn.current,
-      get_current_line_str(scn) });
+    const std::uint32_t literal{ scn.literals.intern(
+      scn.source.substr(scn.start + 1, scn.current - scn.start - 2)) };
+    scn.tokens.push_back(create_token(scn, token_type::STRING, literal));
 }
 
-void scan_number(scan_data& scn) LOX_NOEXCEPT
+void scan_number(scan_data& scn)
 {
     // First character was consumed before calling scan_number.
-    while (std::isdigit(peek(scn)) ||
-           (peek(scn) == '.' && std::isdigit(peek_next(scn)))) {
+    while (std::isdigit(peek(scn))) {
+        advance(scn);
+    }
+
+    // At most one fractional part, `1.2.3` is `1.2`, `.` and `3`.
+    if (peek(scn) == '.' && std::isdigit(peek_next(scn))) {
         advance(scn);
+        while (std::isdigit(peek(scn))) {
+            advance(scn);
+        }
     }
 
     const auto num_str = scn.source.substr(scn.start, scn.current - scn.start);
-    scn.tokens.push_back(lox::token{ token_type::NUMBER,
-      num_str,
-      std::stod(std::string{ num_str }),
-      scn.line,
-      scn.start,
-      scn.current,
-      get_current_line_str(scn) });
+    const std::uint32_t literal{ scn.literals.intern(
+      lox::literals::parse_number(num_str)) };
+    scn.tokens.push_back(create_token(scn, token_type::NUMBER, literal));
 }
 
-void scan_comment(scan_data& scn) LOX_NOEXCEPT
+void scan_comment(scan_data& scn, bool is_multi_line)
 {
-    bool is_multi_line{ false };
-    while (true) {
-        char ch = peek(scn);
-        if (!is_multi_line && (ch == '\n' || is_at_end(scn))) {
-            break;
-        }
-        else if (!is_multi_line && ch == '*') {
-            is_multi_line = true;
-        }
-        else if (is_multi_line && ch == '*' && peek_next(scn) == '/') {
-            // Advance for the comment ending `*/`
-            advance(scn, 2);
-            break;
-        }
-        else if (is_at_end(scn)) {
-            break;
-        }
+    // The beginning `//` or `/*` was consumed before calling scan_comment.
+    if (!is_multi_line) {
+        scn.current =
+          lox::simd::find_either(scn.source, scn.current, '\n', '\n');
+    }
+    else {
+        while (true) {
+            scn.current =
+              lox::simd::find_either(scn.source, scn.current, '*', '*');
+            if (is_at_end(scn)) {
+                break;
+            }
 
-        if (ch == '\n') {
-            scn.line++;
-        }
+            if (peek_next(scn) == '/') {
+                // Advance for the comment ending `*/`
+                advance(scn, 2);
+                break;
+            }
 
-        advance(scn);
+            advance(scn);
+        }
     }
 
-    scn.tokens.push_back(lox::token{ token_type::COMMENT,
-      // +2 for the begining `//` or `/*`.
-      scn.source.substr(
-        scn.start + 2, (scn.current - scn.start - 2) - (is_multi_line ? 2 : 0)),
-      nullptr,
-      scn.line,
-      scn.start,
-      scn.current,
-      get_current_line_str(scn) });
+    // Comments are not seen by the parser, they are kept on the side for tools
+    // that need them.
+    scn.trivia.push_back(create_token(scn, token_type::COMMENT));
 }
 
-void scan_identifier(scan_data& scn) LOX_NOEXCEPT
+void scan_identifier(scan_data& scn)
 {
-    while (lox::isalnum(peek(scn))) {
-        advance(scn);
-    }
+    scn.current = lox::simd::skip_identifier(scn.source, scn.current);
 
-    std::string_view text{ scn.source.substr(
+    const std::string_view text{ scn.source.substr(
       scn.start, scn.current - scn.start) };
-    const auto foundIt = s_keywords.find(text);
-    if (foundIt == s_keywords.cend()) {
-        if (foundIt->second == token_type::TRUE) {
-            scn.tokens.push_back(
-              create_token(scn, token_type::IDENTIFIER, true));
-        }
-        else if (foundIt->second == token_type::FALSE) {
-            scn.tokens.push_back(
-              create_token(scn, token_type::IDENTIFIER, false));
-        }
-        else if (foundIt->second == token_type::NIL) {
-            scn.tokens.push_back(
-              create_token(scn, token_type::IDENTIFIER, nullptr));
-        }
-        else {
-            scn.tokens.push_back(create_token(scn, token_type::IDENTIFIER, {}));
-        }
-    }
-    else {
-        scn.tokens.push_back(create_token(scn, foundIt->second, {}));
+    const token_type type{ lox::literals::classify_identifier(text) };
+    if (type != token_type::IDENTIFIER) {
+        scn.tokens.push_back(create_token(scn, type));
+        return;
     }
+
+    // Symbols are the same for every source, they are not interned again when
+    // tokens are moved to another scan.
+    scn.tokens.push_back(
+      create_token(scn, type, scn.symbols.intern(text)));
 }
 
-void scan_tokens_impl(scan_data& scn) LOX_NOEXCEPT
+void scan_tokens_impl(scan_data& scn)
 {
     const char ch = advance(scn);
     switch (ch) {
         case '(':
-            scn.tokens.push_back(create_token(scn, token_type::LEFT_PAREN, {}));
+            scn.tokens.push_back(create_token(scn, token_type::LEFT_PAREN));
             break;
         case ')':
             scn.tokens.push_back(
-              create_token(scn, token_type::RIGHT_PAREN, {}));
+              create_token(scn, token_type::RIGHT_PAREN));
             break;
         case '{':
-            scn.tokens.push_back(create_token(scn, token_type::LEFT_BRACE, {}));
+            scn.tokens.push_back(create_token(scn, token_type::LEFT_BRACE));
             break;
         case '}':
             scn.tokens.push_back(
-              create_token(scn, token_type::RIGHT_BRACE, {}));
+              create_token(scn, token_type::RIGHT_BRACE));
             break;
         case ',':
-            scn.tokens.push_back(create_token(scn, token_type::COMMA, {}));
+            scn.tokens.push_back(create_token(scn, token_type::COMMA));
             break;
         case '.':
-            scn.tokens.push_back(create_token(scn, token_type::DOT, {}));
+            scn.tokens.push_back(create_token(scn, token_type::DOT));
             break;
         case '-':
-            scn.tokens.push_back(create_token(scn, token_type::MINUS, {}));
+            scn.tokens.push_back(create_token(scn, token_type::MINUS));
             break;
         case '+':
-            scn.tokens.push_back(create_token(scn, token_type::PLUS, {}));
+            scn.tokens.push_back(create_token(scn, token_type::PLUS));
             break;
         case ';':
-            scn.tokens.push_back(create_token(scn, token_type::SEMICOLON, {}));
+            scn.tokens.push_back(create_token(scn, token_type::SEMICOLON));
             break;
         case '*':
-            scn.tokens.push_back(create_token(scn, token_type::STAR, {}));
+            scn.tokens.push_back(create_token(scn, token_type::STAR));
             break;
         case '?':
             scn.tokens.push_back(
-              create_token(scn, token_type::QUESTION_MARK, {}));
+              create_token(scn, token_type::QUESTION_MARK));
             break;
         case ':':
-            scn.tokens.push_back(create_token(scn, token_type::COLON, {}));
+            scn.tokens.push_back(create_token(scn, token_type::COLON));
             break;
         case '!':
             scn.tokens.push_back(
-              match(scn, '=') ? create_token(scn, token_type::BANG_EQUAL, {})
-                              : create_token(scn, token_type::BANG, {}));
+              match(scn, '=') ? create_token(scn, token_type::BANG_EQUAL)
+                              : create_token(scn, token_type::BANG));
             break;
         case '=':
             scn.tokens.push_back(
-              match(scn, '=') ? create_token(scn, token_type::EQUAL_EQUAL, {})
-                              : create_token(scn, token_type::EQUAL, {}));
+              match(scn, '=') ? create_token(scn, token_type::EQUAL_EQUAL)
+                              : create_token(scn, token_type::EQUAL));
             break;
         case '<':
             scn.tokens.push_back(
-              match(scn, '=') ? create_token(scn, token_type::LESS_EQUAL, {})
-                              : create_token(scn, token_type::LESS, {}));
+              match(scn, '=') ? create_token(scn, token_type::LESS_EQUAL)
+                              : create_token(scn, token_type::LESS));
             break;
         case '>':
             scn.tokens.push_back(
-              match(scn, '=') ? create_token(scn, token_type::GREATER_EQUAL, {})
-                              : create_token(scn, token_type::GREATER, {}));
+              match(scn, '=') ? create_token(scn, token_type::GREATER_EQUAL)
+                              : create_token(scn, token_type::GREATER));
             break;
         case '/':
-            if (match(scn, '/') || peek(scn) == '*') {
-                scan_comment(scn);
+            if (match(scn, '/')) {
+                scan_comment(scn, false);
+            }
+            else if (match(scn, '*')) {
+                scan_comment(scn, true);
             }
             else {
-                scn.tokens.push_back(create_token(scn, token_type::SLASH, {}));
+                scn.tokens.push_back(create_token(scn, token_type::SLASH));
             }
             break;
         case ' ':
@@ -312,10 +310,10 @@ void scan_tokens_impl(scan_data& scn) LOX_NOEXCEPT
         case '\r':
             [[fallthrough]];
         case '\t':
-            // Ignore whitespace.
-            break;
+            [[fallthrough]];
         case '\n':
-            scn.line++;
+            // Ignore whitespace. New lines are already in the line table.
+            scn.current = lox::simd::skip_whitespace(scn.source, scn.current);
             break;
         case '"':
             scan_string(scn);
@@ -328,12 +326,183 @@ void scan_tokens_impl(scan_data& scn) LOX_NOEXCEPT
                 scan_identifier(scn);
             }
             else {
-                scn.errors.emplace_back(
-                  lox::scan_result::error::error_type::UNKNOWN_TOKEN, scn.line);
-                log_error(scn, "Unknown token.");
+                add_error(
+                  scn, lox::scan_result::error::error_type::UNKNOWN_TOKEN);
             }
     }
 }
+
+[[nodiscard]] bool is_before(
+  const lox::compact_token& tkn, std::size_t offset) LOX_NOEXCEPT
+{
+    return tkn.offset < offset;
+}
+
+[[nodiscard]] bool has_token_at(const std::pmr::vector<lox::compact_token>& tokens,
+  std::size_t offset) LOX_NOEXCEPT
+{
+    const auto tokenIt =
+      std::lower_bound(tokens.cbegin(), tokens.cend(), offset, is_before);
+    return tokenIt != tokens.cend() && tokenIt->offset == offset;
+}
+
+/*!
+ * Returns true if a token, a comment or the error of `scn` starts at `offset`.
+ * The scanner only depends on its position, so a scan that gets to one of
+ * these offsets continues exactly like `scn` did.
+ */
+[[nodiscard]] bool starts_at(
+  const scan_data& scn, std::size_t offset) LOX_NOEXCEPT
+{
+    return has_token_at(scn.tokens, offset) ||
+           has_token_at(scn.trivia, offset) ||
+           (!scn.errors.empty() && scn.error_start == offset);
+}
+
+/*!
+ * Scans from `begin` until a token starts at or after `end`. If `ahead` is
+ * given, stops as soon as the scan lines up with it and returns the offset
+ * where that happened.
+ */
+std::optional<std::size_t> scan_range(scan_data& scn,
+  std::size_t begin,
+  std::size_t end,
+  const scan_data* ahead = nullptr)
+{
+    scn.current = begin;
+    while (!is_at_end(scn) && scn.errors.empty() && scn.current < end) {
+        if (ahead && starts_at(*ahead, scn.current)) {
+            return scn.current;
+        }
+
+        scn.start = scn.current;
+        scan_tokens_impl(scn);
+    }
+
+    return std::nullopt;
+}
+
+/*!
+ * Appends what `range` found from `from` onwards to `scn`, the literals are
+ * interned again so that their indices are the same as a sequential scan
+ * would give.
+ */
+void append(scan_data& scn, const scan_data& range, std::size_t from)
+{
+    for (auto it = std::lower_bound(
+           range.tokens.cbegin(), range.tokens.cend(), from, is_before);
+         it != range.tokens.cend();
+         ++it) {
+        lox::compact_token tkn{ *it };
+        if (tkn.literal != lox::compact_token::no_literal &&
+            tkn.type != token_type::IDENTIFIER) {
+            const lox::object& literal{ range.info->literals[tkn.literal] };
+            if (const auto* number = std::get_if<double>(&literal)) {
+                tkn.literal = scn.literals.intern(*number);
+            }
+            else {
+                tkn.literal =
+                  scn.literals.intern(std::get<lox::heap_string>(literal));
+            }
+        }
+
+        scn.tokens.push_back(tkn);
+    }
+
+    scn.trivia.insert(scn.trivia.cend(),
+      std::lower_bound(
+        range.trivia.cbegin(), range.trivia.cend(), from, is_before),
+      range.trivia.cend());
+
+    if (!range.errors.empty() && range.error_start >= from) {
+        scn.start = range.error_start;
+        add_error(scn, range.errors.front().type);
+    }
+}
+
+/*!
+ * Appends a token of a previous scan of the source that starts at `offset` in
+ * `scn`. The literal is interned again so that the indices are the same as a
+ * scan of the whole source would give.
+ */
+void take_over(scan_data& scn,
+  const lox::source_info& previous,
+  lox::compact_token tkn,
+  std::size_t offset)
+{
+    tkn.offset = static_cast<std::uint32_t>(offset);
+    if (tkn.literal != lox::compact_token::no_literal &&
+        tkn.type != token_type::IDENTIFIER) {
+        const lox::object& literal{ previous.literals[tkn.literal] };
+        if (const auto* number = std::get_if<double>(&literal)) {
+            tkn.literal = scn.literals.intern(*number);
+        }
+        else {
+            tkn.literal =
+              scn.literals.intern(std::get<lox::heap_string>(literal));
+        }
+    }
+
+    scn.tokens.push_back(tkn);
+}
+
+/*!
+ * Returns the line table of the source with the edit applied to it. Only the
+ * inserted text is searched for new lines.
+ */
+[[nodiscard]] std::pmr::vector<std::uint32_t> edit_line_starts(
+  const std::pmr::vector<std::uint32_t>& line_starts,
+  const lox::text_edit& edit,
+  std::pmr::memory_resource* resource)
+{
+    // Lines start after a new line, the ones in (offset, offset + removed]
+    // started in the removed text.
+    const auto removedIt =
+      std::upper_bound(line_starts.cbegin(), line_starts.cend(), edit.offset);
+    const auto keptIt = std::upper_bound(
+      removedIt, line_starts.cend(), edit.offset + edit.removed);
+
+    std::pmr::vector<std::uint32_t> edited{ line_starts.cbegin(),
+        removedIt,
+        resource };
+    std::size_t index{ lox::simd::find_either(edit.inserted, 0, '\n', '\n') };
+    while (index < edit.inserted.size()) {
+        edited.push_back(static_cast<std::uint32_t>(edit.offset + index + 1));
+        index = lox::simd::find_either(edit.inserted, index + 1, '\n', '\n');
+    }
+
+    std::transform(keptIt,
+      line_starts.cend(),
+      std::back_inserter(edited),
+      [&edit](std::uint32_t start) {
+          return static_cast<std::uint32_t>(
+            start + edit.inserted.size() - edit.removed);
+      });
+    return edited;
+}
+
+/*!
+ * Returns the chunk boundaries, the first one is 0 and the last one is the
+ * size of the source. All the others are at the start of a line.
+ */
+[[nodiscard]] std::vector<std::size_t> split_chunks(std::string_view source,
+  const std::pmr::vector<std::uint32_t>& line_starts,
+  std::size_t count) LOX_NOEXCEPT
+{
+    std::vector<std::size_t> bounds{ 0 };
+    for (std::size_t index = 1; index < count; ++index) {
+        const std::size_t target{ source.size() / count * index };
+        const auto lineIt =
+          std::lower_bound(line_starts.cbegin(), line_starts.cend(), target);
+        if (lineIt != line_starts.cend() && *lineIt > bounds.back() &&
+            *lineIt < source.size()) {
+            bounds.push_back(*lineIt);
+        }
+    }
+
+    bounds.push_back(source.size());
+    return bounds;
+}
 }
 
 lox::scan_result::error::error(error_type type, std::size_t ln)
@@ -343,28 +512,415 @@ lox::scan_result::error::error(error_type type, std::size_t ln)
 {
 }
 
-[[nodiscard]] lox::scan_result lox::scan_tokens(
-  std::string_view source) LOX_NOEXCEPT
+struct lox::token_stream::impl {
+    impl(std::string_view source, std::pmr::memory_resource* resource)
+      : scn{ fits_offsets(source) ? source : std::string_view{}, resource }
+    {
+        // A source that is too large is not read at all, the stream is empty
+        // and ends with the error.
+        scn.info->source = scn.source;
+        scn.info->line_starts = lox::make_line_starts(scn.source, resource);
+        info = scn.info;
+        if (scn.source.size() != source.size()) {
+            add_error(
+              scn, lox::scan_result::error::error_type::SOURCE_TOO_LARGE);
+        }
+    }
+
+    impl(const lox::token_list& tokens, std::size_t position) LOX_NOEXCEPT
+      : scn{ tokens.info->source }
+      , replay{ &tokens }
+      , replay_index{ position }
+      , info{ tokens.info }
+      , consumed{ position }
+    {
+        assert(position <= tokens.size());
+        if (position > 0) {
+            previous = tokens.compact[position - 1];
+            has_previous = true;
+        }
+    }
+
+    /*!
+     * Scans until a token is added to the buffer, or adds the END_OF_FILE
+     * token and finishes the stream when the source runs out or an error
+     * occurs.
+     */
+    void scan_next()
+    {
+        const std::size_t buffered{ scn.tokens.size() };
+        while (!is_at_end(scn) && scn.errors.empty() &&
+               scn.tokens.size() == buffered) {
+            scn.start = scn.current;
+            scan_tokens_impl(scn);
+        }
+
+        if (scn.tokens.size() != buffered) {
+            produced++;
+            return;
+        }
+
+        if (!scn.errors.empty()) {
+            std::cerr << "Stopped because of parsing errors.\n";
+        }
+
+        if (produced > 0) {
+            scn.start = scn.current;
+            scn.tokens.push_back(create_token(scn, token_type::END_OF_FILE));
+        }
+
+        is_finished = true;
+    }
+
+    /*!
+     * Makes sure that the token `ahead` of the current one is buffered.
+     * Returns false if the stream ends before that.
+     */
+    [[nodiscard]] bool fill(std::size_t ahead)
+    {
+        while (scn.tokens.size() - head <= ahead) {
+            if (is_finished) {
+                return false;
+            }
+
+            if (!replay) {
+                scan_next();
+            }
+            else if (replay_index < replay->size()) {
+                scn.tokens.push_back(replay->compact[replay_index++]);
+            }
+            else {
+                is_finished = true;
+            }
+        }
+
+        return true;
+    }
+
+    // In scan mode scn.tokens is the lookahead buffer, the tokens before
+    // `head` are consumed. Replayed tokens go through the same buffer.
+    scan_data scn;
+    const lox::token_list* replay{ nullptr };
+    std::size_t replay_index{ 0 };
+    std::shared_ptr<const lox::source_info> info;
+    std::size_t head{ 0 };
+    std::size_t produced{ 0 };
+    std::size_t consumed{ 0 };
+    lox::compact_token previous{};
+    bool has_previous{ false };
+    bool is_finished{ false };
+};
+
+lox::token_stream::token_stream(std::string_view source,
+  std::pmr::memory_resource* resource)
+  : m_impl{ std::make_unique<impl>(source, resource) }
+{
+}
+
+lox::token_stream::token_stream(const lox::token_list& tokens) LOX_NOEXCEPT
+  : token_stream{ tokens, 0 }
+{
+}
+
+lox::token_stream::token_stream(const lox::token_list& tokens,
+  std::size_t position) LOX_NOEXCEPT
+  : m_impl{ std::make_unique<impl>(tokens, position) }
+{
+}
+
+lox::token_stream::token_stream(token_stream&& other) LOX_NOEXCEPT = default;
+lox::token_stream& lox::token_stream::operator=(
+  token_stream&& other) LOX_NOEXCEPT = default;
+lox::token_stream::~token_stream() = default;
+
+bool lox::token_stream::at_end() const
+{
+    return !m_impl->fill(0);
+}
+
+const lox::compact_token& lox::token_stream::peek(std::size_t ahead) const
+{
+    assert(ahead < max_lookahead);
+    [[maybe_unused]] const bool is_filled{ m_impl->fill(ahead) };
+    assert(is_filled);
+    return m_impl->scn.tokens[m_impl->head + ahead];
+}
+
+const lox::compact_token& lox::token_stream::previous() const LOX_NOEXCEPT
+{
+    assert(m_impl->has_previous);
+    return m_impl->previous;
+}
+
+bool lox::token_stream::has_previous() const LOX_NOEXCEPT
+{
+    return m_impl->has_previous;
+}
+
+void lox::token_stream::advance()
+{
+    m_impl->previous = peek();
+    m_impl->has_previous = true;
+    m_impl->consumed++;
+    m_impl->head++;
+    if (m_impl->head == m_impl->scn.tokens.size()) {
+        // Everything in the buffer is consumed, start over so that it does not
+        // grow.
+        m_impl->scn.tokens.clear();
+        m_impl->head = 0;
+    }
+}
+
+std::size_t lox::token_stream::position() const LOX_NOEXCEPT
+{
+    return m_impl->consumed;
+}
+
+lox::token lox::token_stream::materialize(
+  const lox::compact_token& tkn) const LOX_NOEXCEPT
+{
+    return m_impl->info->materialize(tkn);
+}
+
+const lox::source_info& lox::token_stream::info() const LOX_NOEXCEPT
+{
+    return *m_impl->info;
+}
+
+const std::pmr::vector<lox::compact_token>& lox::token_stream::trivia()
+  const LOX_NOEXCEPT
 {
-    scan_data scn{ source };
-    while (!is_at_end(scn)) {
+    return m_impl->scn.trivia;
+}
+
+const std::pmr::vector<lox::scan_result::error>& lox::token_stream::errors()
+  const LOX_NOEXCEPT
+{
+    return m_impl->scn.errors;
+}
+
+lox::scan_result lox::scan_tokens(std::string_view source) LOX_NOEXCEPT
+{
+    return scan_tokens(source, std::pmr::get_default_resource());
+}
+
+lox::scan_result lox::scan_tokens(std::string_view source,
+  std::pmr::memory_resource* resource)
+{
+    token_stream stream{ source, resource };
+    std::pmr::vector<lox::compact_token> tokens{ resource };
+    while (!stream.at_end()) {
+        tokens.push_back(stream.peek());
+        stream.advance();
+    }
+
+    token_stream::impl& state = *stream.m_impl;
+    return { lox::token_list{ std::move(tokens), state.info },
+        lox::token_list{ std::move(state.scn.trivia), state.info },
+        std::move(state.scn.errors) };
+}
+
+lox::scan_result lox::scan_tokens(
+  std::string_view source, const scan_options& options)
+{
+    const std::size_t min_chunk_size{ std::max<std::size_t>(
+      options.min_chunk_size, 1) };
+    // The sequential scan also reports sources that are too large.
+    if (!options.is_parallel || source.size() < min_chunk_size * 2 ||
+        !fits_offsets(source)) {
+        return scan_tokens(source, options.resource);
+    }
+
+    lox::thread_pool pool{ options.thread_count };
+    if (pool.size() == 1) {
+        // Stitching the chunks together is only worth it when they are
+        // scanned concurrently.
+        return scan_tokens(source, options.resource);
+    }
+
+    scan_data scn{ source, options.resource };
+    scn.info->source = source;
+    scn.info->line_starts = lox::make_line_starts(source, options.resource);
+
+    // More chunks than threads so that a slow chunk does not hold up the rest.
+    const std::vector<std::size_t> bounds{ split_chunks(source,
+      scn.info->line_starts,
+      std::min(source.size() / min_chunk_size, pool.size() * 4)) };
+    const std::size_t chunk_count{ bounds.size() - 1 };
+
+    // The chunks are scanned on other threads and only live until they are
+    // stitched together, they use the default resource which is thread-safe.
+    std::vector<scan_data> chunks(chunk_count);
+    pool.run(chunk_count, [&](std::size_t index) {
+        scan_data& chunk = chunks[index];
+        chunk.source = source;
+        chunk.is_speculative = true;
+        scan_range(chunk, bounds[index], bounds[index + 1]);
+    });
+
+    // Stitch the chunks together in order. `position` is where the sequential
+    // scan would be.
+    std::size_t position{ 0 };
+    for (std::size_t index = 0; index < chunk_count && scn.errors.empty();
+         ++index) {
+        const scan_data& chunk = chunks[index];
+        if (position == bounds[index]) {
+            append(scn, chunk, 0);
+            position = chunk.current;
+            continue;
+        }
+
+        assert(position > bounds[index]);
+        if (position >= bounds[index + 1]) {
+            // A string or a comment covers the whole chunk.
+            continue;
+        }
+
+        // The previous chunk ended with a token that runs into this one, the
+        // speculative scan may have started in the middle of it.
+        scan_data fixup{ source };
+        fixup.is_speculative = true;
+        const std::optional<std::size_t> synced_at{ scan_range(
+          fixup, position, bounds[index + 1], &chunk) };
+        append(scn, fixup, 0);
+        position = fixup.current;
+        if (synced_at) {
+            append(scn, chunk, *synced_at);
+            position = chunk.current;
+        }
+    }
+
+    if (!scn.errors.empty()) {
+        std::cerr << "Stopped because of parsing errors.\n";
+    }
+
+    if (!scn.tokens.empty()) {
+        scn.start = scn.current = position;
+        scn.tokens.push_back(create_token(scn, token_type::END_OF_FILE));
+    }
+
+    return { lox::token_list{ std::move(scn.tokens), scn.info },
+        lox::token_list{ std::move(scn.trivia), scn.info },
+        std::move(scn.errors) };
+}
+
+lox::rescan_result lox::rescan_tokens(const scan_result& previous,
+  std::string_view source,
+  const text_edit& edit,
+  std::pmr::memory_resource* resource)
+{
+    assert(previous.tokens.info);
+    const lox::source_info& info = *previous.tokens.info;
+    assert(edit.offset + edit.removed <= info.source.size());
+    assert(source.size() + edit.removed ==
+           info.source.size() + edit.inserted.size());
+    assert(source.substr(edit.offset, edit.inserted.size()) == edit.inserted);
+
+    const std::pmr::vector<lox::compact_token>& tokens{
+        previous.tokens.compact
+    };
+    const std::pmr::vector<lox::compact_token>& trivia{
+        previous.trivia.compact
+    };
+    if (!previous.errors.empty() || tokens.empty() || !fits_offsets(source)) {
+        // Nothing after the error was scanned. The full scan also reports
+        // sources that are too large.
+        scan_result scan{ scan_tokens(source, resource) };
+        const std::size_t size{ scan.tokens.size() };
+        return { std::move(scan), 0, size, tokens.size() };
+    }
+
+    scan_data scn{ source, resource };
+    scn.info->source = source;
+    scn.info->line_starts = edit_line_starts(info.line_starts, edit, resource);
+
+    // A token depends on the text up to the character after it, the number
+    // scanner looks that far ahead.
+    const auto is_clean = [&edit](const lox::compact_token& tkn) {
+        return tkn.offset + tkn.length + 1 < edit.offset;
+    };
+    const auto cleanTokenIt =
+      std::partition_point(tokens.cbegin(), tokens.cend(), is_clean);
+    const auto cleanTriviaIt =
+      std::partition_point(trivia.cbegin(), trivia.cend(), is_clean);
+    std::size_t restart{ 0 };
+    for (auto it = tokens.cbegin(); it != cleanTokenIt; ++it) {
+        take_over(scn, info, *it, it->offset);
+        restart = it->offset + it->length;
+    }
+
+    scn.trivia.assign(trivia.cbegin(), cleanTriviaIt);
+    if (cleanTriviaIt != trivia.cbegin()) {
+        const lox::compact_token& comment = *std::prev(cleanTriviaIt);
+        restart = std::max<std::size_t>(restart, comment.offset + comment.length);
+    }
+
+    const std::size_t first{ scn.tokens.size() };
+    const std::size_t edit_end{ edit.offset + edit.inserted.size() };
+    const auto to_previous = [&edit](std::size_t offset) {
+        return offset + edit.removed - edit.inserted.size();
+    };
+
+    // After the edit the text is the same as before, a scan that gets to where
+    // the previous one found a token continues the same way.
+    std::optional<std::size_t> synced_at{};
+    scn.current = restart;
+    while (!is_at_end(scn) && scn.errors.empty()) {
+        if (scn.current >= edit_end &&
+            (has_token_at(tokens, to_previous(scn.current)) ||
+              has_token_at(trivia, to_previous(scn.current)))) {
+            synced_at = scn.current;
+            break;
+        }
+
         scn.start = scn.current;
         scan_tokens_impl(scn);
+    }
+
+    std::size_t end{ scn.tokens.size() };
+    std::size_t previous_end{ tokens.size() };
+    if (synced_at) {
+        const std::size_t from{ to_previous(*synced_at) };
+        const auto tokenIt =
+          std::lower_bound(tokens.cbegin(), tokens.cend(), from, is_before);
+        previous_end = static_cast<std::size_t>(tokenIt - tokens.cbegin());
+        for (auto it = tokenIt; it != tokens.cend(); ++it) {
+            take_over(scn, info, *it, it->offset + *synced_at - from);
+        }
+
+        for (auto it =
+               std::lower_bound(trivia.cbegin(), trivia.cend(), from, is_before);
+             it != trivia.cend();
+             ++it) {
+            lox::compact_token comment{ *it };
+            comment.offset += static_cast<std::uint32_t>(*synced_at - from);
+            scn.trivia.push_back(comment);
+        }
+
+        if (scn.tokens.size() == 1) {
+            // Only the END_OF_FILE token, which is not added to a source
+            // without tokens.
+            scn.tokens.clear();
+            end = 0;
+        }
+    }
+    else {
         if (!scn.errors.empty()) {
             std::cerr << "Stopped because of parsing errors.\n";
-            break;
         }
-    }
 
-    if (!scn.tokens.empty()) {
-        scn.tokens.push_back(lox::token{ token_type::END_OF_FILE,
-          "\0",
-          {},
-          scn.line,
-          scn.current,
-          scn.current,
-          get_current_line_str(scn) });
+        if (!scn.tokens.empty()) {
+            scn.start = scn.current;
+            scn.tokens.push_back(create_token(scn, token_type::END_OF_FILE));
+        }
+
+        end = scn.tokens.size();
     }
 
-    return { std::move(scn.tokens), std::move(scn.errors) };
+    return { scan_result{ lox::token_list{ std::move(scn.tokens), scn.info },
+               lox::token_list{ std::move(scn.trivia), scn.info },
+               std::move(scn.errors) },
+        first,
+        end,
+        previous_end };
 }
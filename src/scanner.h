@@ -4,6 +4,8 @@
 #include "token.h"
 #include "defs.h"
 
+#include <memory>
+#include <memory_resource>
 #include <vector>
 #include <string_view>
 
@@ -13,6 +15,9 @@ struct scan_result {
         enum class error_type {
             UNTERMINATED_STRING,
             UNKNOWN_TOKEN,
+            // The source does not fit in the 32-bit offsets of
+            // lox::compact_token, nothing is scanned.
+            SOURCE_TOO_LARGE,
         };
 
         std::string message;
@@ -27,8 +32,10 @@ struct scan_result {
     static_assert(std::is_move_assignable_v<error>, "Requirement error.");
     static_assert(std::is_move_constructible_v<error>, "Requirement error.");
 
-    std::vector<lox::token> tokens;
-    std::vector<error> errors;
+    lox::token_list tokens;
+    // Comments. They share the source information with the tokens.
+    lox::token_list trivia;
+    std::pmr::vector<error> errors;
 };
 
 /*!
@@ -41,6 +48,161 @@ struct scan_result {
  */
 [[nodiscard]] scan_result scan_tokens(std::string_view source) LOX_NOEXCEPT;
 
+/*!
+ * Same as scan_tokens(std::string_view) but the tokens, the side tables and
+ * the errors are allocated from `resource`. The resource must outlive the
+ * result.
+ * @throws std::bad_alloc if `resource` runs out.
+ */
+[[nodiscard]] scan_result scan_tokens(std::string_view source,
+  std::pmr::memory_resource* resource);
+
+struct scan_options {
+    // Splits the source into chunks at new lines and scans them concurrently.
+    bool is_parallel{ false };
+    // Chunks are at least this large, smaller sources are scanned on the
+    // calling thread.
+    std::size_t min_chunk_size{ 256 * 1024 };
+    // The number of threads including the caller, 0 uses the hardware
+    // concurrency.
+    std::size_t thread_count{ 0 };
+    // Where the result is allocated from. The chunks that are scanned
+    // concurrently are temporaries on the default resource, so the resource
+    // does not have to be thread-safe.
+    std::pmr::memory_resource* resource{ std::pmr::get_default_resource() };
+};
+
+/*!
+ * Same as scan_tokens(std::string_view) with the given options. The result,
+ * including the errors and the order they are logged in, does not depend on
+ * the options.
+ *
+ * In parallel mode each chunk is scanned speculatively as if it started
+ * outside of a string or a comment. A chunk whose start turns out to be inside
+ * of a token is scanned again from the end of that token until it lines up
+ * with the speculative tokens.
+ */
+[[nodiscard]] scan_result scan_tokens(std::string_view source,
+  const scan_options& options);
+
+/*!
+ * A change to a source, `removed` bytes at `offset` are replaced with
+ * `inserted`.
+ */
+struct text_edit {
+    std::size_t offset;
+    std::size_t removed;
+    std::string_view inserted;
+};
+
+struct rescan_result {
+    scan_result scan;
+    // The tokens before `first` are the previous ones, the tokens from `end`
+    // on are the previous tokens from `previous_end` on moved by the size of
+    // the edit. Only the tokens in between were scanned.
+    std::size_t first;
+    std::size_t end;
+    std::size_t previous_end;
+};
+
+/*!
+ * Scans `source`, which is the source of `previous` with `edit` applied to
+ * it, again. Scanning starts at the last token that cannot be affected by the
+ * edit and stops as soon as the scanner gets to a token of `previous` after
+ * the edit, from there on it would find the same tokens. The result is the
+ * same as that of scan_tokens(source, resource).
+ *
+ * When `previous` stopped at an error the whole source is scanned again.
+ * @note Only the positions of the previous tokens are used, the previous
+ * source does not have to be alive anymore.
+ */
+[[nodiscard]] rescan_result rescan_tokens(const scan_result& previous,
+  std::string_view source,
+  const text_edit& edit,
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/*!
+ * Produces tokens on demand so that the parser can consume them while the
+ * source is being scanned, only a few tokens are buffered at a time. A stream
+ * can also replay the tokens of a lox::token_list.
+ *
+ * Scanning stops at the first error like lox::scan_tokens() does.
+ * @note The source, or the token list, must outlive the stream.
+ */
+class token_stream {
+public:
+    static constexpr std::size_t max_lookahead{ 2 };
+
+public:
+    /*!
+     * The buffers and the side tables are allocated from `resource`, which
+     * must outlive the stream and anything that shares its source_info. The
+     * functions that scan ahead throw std::bad_alloc if it runs out.
+     */
+    explicit token_stream(std::string_view source,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit token_stream(const lox::token_list& tokens) LOX_NOEXCEPT;
+
+    /*!
+     * Replays the tokens from the one at `position` on, the one before it is
+     * the previous token.
+     */
+    token_stream(const lox::token_list& tokens,
+      std::size_t position) LOX_NOEXCEPT;
+
+    token_stream(token_stream&& other) LOX_NOEXCEPT;
+    token_stream& operator=(token_stream&& other) LOX_NOEXCEPT;
+    ~token_stream();
+
+    /*!
+     * Returns true when all the tokens, including the END_OF_FILE token, have
+     * been consumed.
+     */
+    [[nodiscard]] bool at_end() const;
+
+    /*!
+     * Returns the token `ahead` tokens after the current one without consuming
+     * it. `ahead` must be less than max_lookahead and the token must exist.
+     */
+    [[nodiscard]] const lox::compact_token& peek(std::size_t ahead = 0) const;
+
+    /*!
+     * Returns the last consumed token.
+     */
+    [[nodiscard]] const lox::compact_token& previous() const LOX_NOEXCEPT;
+    [[nodiscard]] bool has_previous() const LOX_NOEXCEPT;
+
+    void advance();
+
+    /*!
+     * Returns the number of tokens that have been consumed, including the ones
+     * that were skipped by starting at a position.
+     */
+    [[nodiscard]] std::size_t position() const LOX_NOEXCEPT;
+
+    [[nodiscard]] lox::token materialize(
+      const lox::compact_token& tkn) const LOX_NOEXCEPT;
+
+    /*!
+     * The side tables grow as the source is scanned. The line table is always
+     * complete.
+     */
+    [[nodiscard]] const lox::source_info& info() const LOX_NOEXCEPT;
+    [[nodiscard]] const std::pmr::vector<lox::compact_token>& trivia()
+      const LOX_NOEXCEPT;
+    [[nodiscard]] const std::pmr::vector<scan_result::error>& errors()
+      const LOX_NOEXCEPT;
+
+private:
+    struct impl;
+
+    friend scan_result scan_tokens(std::string_view source,
+      std::pmr::memory_resource* resource);
+
+private:
+    std::unique_ptr<impl> m_impl;
+};
+
 }
 
 #endif
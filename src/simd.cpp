@@ -0,0 +1,371 @@
+#include "simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LOX_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(LOX_SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__))
+// AVX2 functions are compiled with the target attribute so that the rest of
+// the library does not require AVX2.
+#define LOX_SIMD_AVX2
+#define LOX_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+namespace {
+using lox::simd::level;
+
+struct implementation {
+    level lvl;
+    std::size_t (*skip_whitespace)(std::string_view, std::size_t);
+    std::size_t (*skip_identifier)(std::string_view, std::size_t);
+    std::size_t (*find_either)(std::string_view, std::size_t, char, char);
+    std::size_t (*count)(std::string_view, char);
+};
+
+[[nodiscard]] bool is_whitespace(char ch) LOX_NOEXCEPT
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+/*!
+ * Same as lox::isalnum() but independent of the locale so that it agrees with
+ * the vectorized implementations.
+ */
+[[nodiscard]] bool is_identifier(char ch) LOX_NOEXCEPT
+{
+    const char lower = static_cast<char>(ch | 0x20);
+    return (lower >= 'a' && lower <= 'z') || (ch >= '0' && ch <= '9') ||
+           ch == '_';
+}
+
+std::size_t skip_whitespace_scalar(std::string_view source, std::size_t index)
+{
+    while (index < source.size() && is_whitespace(source[index])) {
+        index++;
+    }
+
+    return index;
+}
+
+std::size_t skip_identifier_scalar(std::string_view source, std::size_t index)
+{
+    while (index < source.size() && is_identifier(source[index])) {
+        index++;
+    }
+
+    return index;
+}
+
+std::size_t count_from_scalar(std::string_view source,
+  std::size_t index,
+  char ch)
+{
+    std::size_t result{ 0 };
+    for (; index < source.size(); ++index) {
+        result += source[index] == ch;
+    }
+
+    return result;
+}
+
+std::size_t find_either_scalar(std::string_view source,
+  std::size_t index,
+  char first,
+  char second)
+{
+    if (first == second) {
+        // The standard library already has a fast single character search.
+        return std::min(source.find(first, index), source.size());
+    }
+
+    while (index < source.size() && source[index] != first &&
+           source[index] != second) {
+        index++;
+    }
+
+    return index;
+}
+
+std::size_t count_scalar(std::string_view source, char ch)
+{
+    return count_from_scalar(source, 0, ch);
+}
+
+constexpr implementation s_scalar{ level::SCALAR,
+    skip_whitespace_scalar,
+    skip_identifier_scalar,
+    find_either_scalar,
+    count_scalar };
+
+#ifdef LOX_SIMD_SSE2
+[[nodiscard]] __m128i in_range_sse2(__m128i chars, char lo, char hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(lo - 1)),
+      _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), chars));
+}
+
+[[nodiscard]] __m128i load_sse2(std::string_view source, std::size_t index)
+{
+    return _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(source.data() + index));
+}
+
+/*!
+ * Returns the index of the first byte in the block for which `mask_of` does
+ * not set the mask bit. When all of them are set the scalar function handles
+ * the tail.
+ */
+template<typename MaskOf, typename Tail>
+std::size_t skip_sse2(std::string_view source,
+  std::size_t index,
+  MaskOf mask_of,
+  Tail tail)
+{
+    for (; index + 16 <= source.size(); index += 16) {
+        const auto mask = static_cast<std::uint32_t>(
+          _mm_movemask_epi8(mask_of(load_sse2(source, index))));
+        if (mask != 0xffff) {
+            return index + std::countr_one(mask);
+        }
+    }
+
+    return tail(source, index);
+}
+
+std::size_t skip_whitespace_sse2(std::string_view source, std::size_t index)
+{
+    return skip_sse2(
+      source,
+      index,
+      [](__m128i chars) {
+          return _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+              _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\r')),
+              _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n'))));
+      },
+      skip_whitespace_scalar);
+}
+
+std::size_t skip_identifier_sse2(std::string_view source, std::size_t index)
+{
+    return skip_sse2(
+      source,
+      index,
+      [](__m128i chars) {
+          const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+          return _mm_or_si128(
+            _mm_or_si128(
+              in_range_sse2(lower, 'a', 'z'), in_range_sse2(chars, '0', '9')),
+            _mm_cmpeq_epi8(chars, _mm_set1_epi8('_')));
+      },
+      skip_identifier_scalar);
+}
+
+std::size_t find_either_sse2(std::string_view source,
+  std::size_t index,
+  char first,
+  char second)
+{
+    const __m128i first_chars = _mm_set1_epi8(first);
+    const __m128i second_chars = _mm_set1_epi8(second);
+    for (; index + 16 <= source.size(); index += 16) {
+        const __m128i chars = load_sse2(source, index);
+        const auto mask = static_cast<std::uint32_t>(
+          _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, first_chars),
+            _mm_cmpeq_epi8(chars, second_chars))));
+        if (mask != 0) {
+            return index + std::countr_zero(mask);
+        }
+    }
+
+    return find_either_scalar(source, index, first, second);
+}
+
+std::size_t count_sse2(std::string_view source, char ch)
+{
+    const __m128i chars_to_count = _mm_set1_epi8(ch);
+    std::size_t result{ 0 };
+    std::size_t index{ 0 };
+    for (; index + 16 <= source.size(); index += 16) {
+        const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(
+          _mm_cmpeq_epi8(load_sse2(source, index), chars_to_count)));
+        result += static_cast<std::size_t>(std::popcount(mask));
+    }
+
+    return result + count_from_scalar(source, index, ch);
+}
+
+constexpr implementation s_sse2{ level::SSE2,
+    skip_whitespace_sse2,
+    skip_identifier_sse2,
+    find_either_sse2,
+    count_sse2 };
+#endif
+
+#ifdef LOX_SIMD_AVX2
+[[nodiscard]] LOX_TARGET_AVX2 inline __m256i in_range_avx2(__m256i chars,
+  char lo,
+  char hi)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8(lo - 1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), chars));
+}
+
+[[nodiscard]] LOX_TARGET_AVX2 inline __m256i load_avx2(std::string_view source,
+  std::size_t index)
+{
+    return _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(source.data() + index));
+}
+
+LOX_TARGET_AVX2 std::size_t skip_whitespace_avx2(std::string_view source,
+  std::size_t index)
+{
+    for (; index + 32 <= source.size(); index += 32) {
+        const __m256i chars = load_avx2(source, index);
+        const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+          _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+              _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r')),
+              _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n'))))));
+        if (mask != 0xffffffff) {
+            return index + std::countr_one(mask);
+        }
+    }
+
+    return skip_whitespace_sse2(source, index);
+}
+
+LOX_TARGET_AVX2 std::size_t skip_identifier_avx2(std::string_view source,
+  std::size_t index)
+{
+    for (; index + 32 <= source.size(); index += 32) {
+        const __m256i chars = load_avx2(source, index);
+        const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+        const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+          _mm256_or_si256(_mm256_or_si256(in_range_avx2(lower, 'a', 'z'),
+                            in_range_avx2(chars, '0', '9')),
+            _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('_')))));
+        if (mask != 0xffffffff) {
+            return index + std::countr_one(mask);
+        }
+    }
+
+    return skip_identifier_sse2(source, index);
+}
+
+LOX_TARGET_AVX2 std::size_t find_either_avx2(std::string_view source,
+  std::size_t index,
+  char first,
+  char second)
+{
+    const __m256i first_chars = _mm256_set1_epi8(first);
+    const __m256i second_chars = _mm256_set1_epi8(second);
+    for (; index + 32 <= source.size(); index += 32) {
+        const __m256i chars = load_avx2(source, index);
+        const auto mask = static_cast<std::uint32_t>(
+          _mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(chars, first_chars),
+            _mm256_cmpeq_epi8(chars, second_chars))));
+        if (mask != 0) {
+            return index + std::countr_zero(mask);
+        }
+    }
+
+    return find_either_sse2(source, index, first, second);
+}
+
+LOX_TARGET_AVX2 std::size_t count_avx2(std::string_view source, char ch)
+{
+    const __m256i chars_to_count = _mm256_set1_epi8(ch);
+    std::size_t result{ 0 };
+    std::size_t index{ 0 };
+    for (; index + 32 <= source.size(); index += 32) {
+        const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(load_avx2(source, index), chars_to_count)));
+        result += static_cast<std::size_t>(std::popcount(mask));
+    }
+
+    return result + count_from_scalar(source, index, ch);
+}
+
+constexpr implementation s_avx2{ level::AVX2,
+    skip_whitespace_avx2,
+    skip_identifier_avx2,
+    find_either_avx2,
+    count_avx2 };
+#endif
+
+[[nodiscard]] const implementation* get_implementation(level lvl) LOX_NOEXCEPT
+{
+    switch (lvl) {
+        case level::AVX2:
+#ifdef LOX_SIMD_AVX2
+            if (__builtin_cpu_supports("avx2")) {
+                return &s_avx2;
+            }
+#endif
+            [[fallthrough]];
+        case level::SSE2:
+#ifdef LOX_SIMD_SSE2
+            return &s_sse2;
+#endif
+            [[fallthrough]];
+        case level::SCALAR:
+            break;
+    }
+
+    return &s_scalar;
+}
+
+const implementation* s_active{ get_implementation(level::AVX2) };
+}
+
+lox::simd::level lox::simd::supported_level() LOX_NOEXCEPT
+{
+    return get_implementation(level::AVX2)->lvl;
+}
+
+lox::simd::level lox::simd::active_level() LOX_NOEXCEPT
+{
+    return s_active->lvl;
+}
+
+lox::simd::level lox::simd::set_level(level lvl) LOX_NOEXCEPT
+{
+    s_active = get_implementation(lvl);
+    return s_active->lvl;
+}
+
+std::size_t lox::simd::skip_whitespace(
+  std::string_view source, std::size_t index) LOX_NOEXCEPT
+{
+    return s_active->skip_whitespace(source, index);
+}
+
+std::size_t lox::simd::skip_identifier(
+  std::string_view source, std::size_t index) LOX_NOEXCEPT
+{
+    return s_active->skip_identifier(source, index);
+}
+
+std::size_t lox::simd::find_either(std::string_view source,
+  std::size_t index,
+  char first,
+  char second) LOX_NOEXCEPT
+{
+    return s_active->find_either(source, index, first, second);
+}
+
+std::size_t lox::simd::count(std::string_view source, char ch) LOX_NOEXCEPT
+{
+    return s_active->count(source, ch);
+}
@@ -0,0 +1,68 @@
+#ifndef LOX_SIMD_H
+#define LOX_SIMD_H
+
+#include "defs.h"
+
+#include <string_view>
+
+/*!
+ * Character scanning helpers for the scanner. Each function has a scalar
+ * implementation and, on x86-64, SSE2 and AVX2 implementations that look at
+ * 16 or 32 bytes at a time. The implementation is picked at run time based on
+ * what the CPU supports, other architectures always use the scalar one.
+ *
+ * The functions that search return an index in `[index, source.size()]`.
+ */
+namespace lox::simd {
+enum class level {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+/*!
+ * Returns the best level supported by this CPU.
+ */
+[[nodiscard]] level supported_level() LOX_NOEXCEPT;
+
+/*!
+ * Returns the level that is currently in use.
+ */
+[[nodiscard]] level active_level() LOX_NOEXCEPT;
+
+/*!
+ * Selects the implementation to use. A level that is not supported falls back
+ * to the best supported one, the selected level is returned. This is meant for
+ * tests and benchmarks.
+ */
+level set_level(level lvl) LOX_NOEXCEPT;
+
+/*!
+ * Returns the index of the first character that is not a space, a tab, a
+ * carriage return or a new line.
+ */
+[[nodiscard]] std::size_t skip_whitespace(
+  std::string_view source, std::size_t index) LOX_NOEXCEPT;
+
+/*!
+ * Returns the index of the first character that cannot be a part of an
+ * identifier, see lox::isalnum().
+ */
+[[nodiscard]] std::size_t skip_identifier(
+  std::string_view source, std::size_t index) LOX_NOEXCEPT;
+
+/*!
+ * Returns the index of the first occurrence of either `first` or `second`.
+ */
+[[nodiscard]] std::size_t find_either(std::string_view source,
+  std::size_t index,
+  char first,
+  char second) LOX_NOEXCEPT;
+
+/*!
+ * Returns the number of occurrences of `ch` in the source.
+ */
+[[nodiscard]] std::size_t count(std::string_view source, char ch) LOX_NOEXCEPT;
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include "source.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#define LOX_SOURCE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace {
+#ifdef LOX_SOURCE_MMAP
+/*!
+ * Closes the file descriptor when it goes out of scope. The standard input is
+ * left open.
+ */
+struct fd_guard {
+    int fd;
+
+    ~fd_guard()
+    {
+        if (fd > STDIN_FILENO) {
+            ::close(fd);
+        }
+    }
+};
+
+[[nodiscard]] bool read_all(int fd, std::vector<char>& buffer) LOX_NOEXCEPT
+{
+    constexpr std::size_t chunk_size{ 64 * 1024 };
+    std::size_t size{ 0 };
+    while (true) {
+        if (buffer.size() - size < chunk_size) {
+            buffer.resize(std::max(buffer.size() * 2, size + chunk_size));
+        }
+
+        const ssize_t count =
+          ::read(fd, buffer.data() + size, buffer.size() - size);
+        if (count == 0) {
+            break;
+        }
+
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        size += static_cast<std::size_t>(count);
+    }
+
+    buffer.resize(size);
+    buffer.shrink_to_fit();
+    return true;
+}
+#endif
+}
+
+std::optional<lox::source_file> lox::source_file::open(
+  std::string_view path) LOX_NOEXCEPT
+{
+    source_file file{};
+#ifdef LOX_SOURCE_MMAP
+    const std::string null_terminated_path{ path };
+    const fd_guard guard{ path == "-"
+                            ? STDIN_FILENO
+                            : ::open(null_terminated_path.c_str(), O_RDONLY) };
+    if (guard.fd < 0) {
+        return std::nullopt;
+    }
+
+    struct stat info {};
+    if (::fstat(guard.fd, &info) != 0) {
+        return std::nullopt;
+    }
+
+    // Empty files cannot be mapped.
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+        const auto size = static_cast<std::size_t>(info.st_size);
+        void* address =
+          ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, guard.fd, 0);
+        if (address != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            ::madvise(address, size, MADV_SEQUENTIAL);
+#endif
+            file.m_mapped = static_cast<const char*>(address);
+            file.m_mapped_size = size;
+            return file;
+        }
+    }
+
+    if (!read_all(guard.fd, file.m_buffer)) {
+        return std::nullopt;
+    }
+#else
+    if (path == "-") {
+        return read(std::cin);
+    }
+
+    std::ifstream reader{ std::string{ path },
+        std::ifstream::in | std::ifstream::binary };
+    if (!reader.is_open()) {
+        return std::nullopt;
+    }
+
+    file = read(reader);
+#endif
+
+    return file;
+}
+
+lox::source_file lox::source_file::read(std::istream& stream) LOX_NOEXCEPT
+{
+    source_file file{};
+    file.m_buffer.assign(
+      std::istreambuf_iterator<char>{ stream }, std::istreambuf_iterator<char>{});
+    return file;
+}
+
+lox::source_file::source_file(source_file&& other) LOX_NOEXCEPT
+  : m_mapped{ std::exchange(other.m_mapped, nullptr) }
+  , m_mapped_size{ std::exchange(other.m_mapped_size, 0) }
+  , m_buffer{ std::move(other.m_buffer) }
+{
+}
+
+lox::source_file& lox::source_file::operator=(
+  source_file&& other) LOX_NOEXCEPT
+{
+    if (this != &other) {
+        unmap();
+        m_mapped = std::exchange(other.m_mapped, nullptr);
+        m_mapped_size = std::exchange(other.m_mapped_size, 0);
+        m_buffer = std::move(other.m_buffer);
+    }
+
+    return *this;
+}
+
+lox::source_file::~source_file()
+{
+    unmap();
+}
+
+std::string_view lox::source_file::text() const LOX_NOEXCEPT
+{
+    if (m_mapped) {
+        return { m_mapped, m_mapped_size };
+    }
+
+    return { m_buffer.data(), m_buffer.size() };
+}
+
+lox::source_file::storage lox::source_file::type() const LOX_NOEXCEPT
+{
+    return m_mapped ? storage::MAPPED : storage::BUFFERED;
+}
+
+void lox::source_file::unmap() LOX_NOEXCEPT
+{
+#ifdef LOX_SOURCE_MMAP
+    if (m_mapped) {
+        ::munmap(const_cast<char*>(m_mapped), m_mapped_size);
+    }
+#endif
+
+    m_mapped = nullptr;
+    m_mapped_size = 0;
+}
@@ -0,0 +1,67 @@
+#ifndef LOX_SOURCE_H
+#define LOX_SOURCE_H
+
+#include "defs.h"
+
+#include <cstddef>
+#include <istream>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace lox {
+
+/*!
+ * Read-only contents of a source file. Regular files are memory-mapped where
+ * the platform supports it, anything else (pipes, stdin, character devices) is
+ * read into a single buffer that is owned by the instance.
+ *
+ * The text stays valid and at the same address until the instance is
+ * destroyed, moving it does not invalidate string views into the text.
+ */
+class source_file {
+public:
+    enum class storage {
+        MAPPED,
+        BUFFERED,
+    };
+
+public:
+    /*!
+     * Opens the file at the given path. "-" is read from stdin.
+     * @return std::nullopt if the file cannot be opened or read.
+     */
+    [[nodiscard]] static std::optional<source_file> open(
+      std::string_view path) LOX_NOEXCEPT;
+
+    /*!
+     * Reads the rest of the stream into a buffer.
+     */
+    [[nodiscard]] static source_file read(std::istream& stream) LOX_NOEXCEPT;
+
+    source_file(source_file&& other) LOX_NOEXCEPT;
+    source_file& operator=(source_file&& other) LOX_NOEXCEPT;
+
+    source_file(const source_file&) = delete;
+    source_file& operator=(const source_file&) = delete;
+
+    ~source_file();
+
+    [[nodiscard]] std::string_view text() const LOX_NOEXCEPT;
+    [[nodiscard]] storage type() const LOX_NOEXCEPT;
+
+private:
+    source_file() = default;
+
+    void unmap() LOX_NOEXCEPT;
+
+private:
+    // Only one of these is used depending on the storage.
+    const char* m_mapped{ nullptr };
+    std::size_t m_mapped_size{ 0 };
+    // Not a std::string, short strings would move with the instance.
+    std::vector<char> m_buffer{};
+};
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "symbols.h"
+
+#include "token.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <mutex>
+
+namespace {
+/*!
+ * Folds the hash into 32 bits so that the low bits that are used as the table
+ * index depend on all of them.
+ */
+[[nodiscard]] constexpr std::uint32_t mix(std::uint64_t hash) LOX_NOEXCEPT
+{
+    hash ^= hash >> 32;
+    hash *= 0x9e3779b97f4a7c15;
+    return static_cast<std::uint32_t>(hash >> 32);
+}
+
+[[nodiscard]] std::uint32_t hash_name(std::string_view name) LOX_NOEXCEPT
+{
+    return mix(std::hash<std::string_view>{}(name));
+}
+}
+
+lox::symbol_id lox::symbol_table::intern(std::string_view name) LOX_NOEXCEPT
+{
+    const std::uint32_t hash{ hash_name(name) };
+    {
+        const std::shared_lock lock{ m_mutex };
+        if (const symbol_id symbol = find(name, hash); symbol != no_symbol) {
+            return symbol;
+        }
+    }
+
+    const std::unique_lock lock{ m_mutex };
+    // Keep the load factor under one half.
+    if (m_names.size() * 2 >= m_slots.size()) {
+        grow();
+    }
+
+    // Another thread may have added the name since the shared lock was
+    // released, so the search starts over.
+    const std::size_t mask{ m_slots.size() - 1 };
+    for (std::size_t index = hash & mask;; index = (index + 1) & mask) {
+        slot& current = m_slots[index];
+        if (current.symbol == no_symbol) {
+            assert(m_names.size() < no_symbol);
+            current = { static_cast<symbol_id>(m_names.size()), hash };
+            m_names.emplace_back(name);
+            return current.symbol;
+        }
+
+        if (current.hash == hash && m_names[current.symbol] == name) {
+            return current.symbol;
+        }
+    }
+}
+
+lox::symbol_id lox::symbol_table::find(std::string_view name) const LOX_NOEXCEPT
+{
+    const std::shared_lock lock{ m_mutex };
+    return find(name, hash_name(name));
+}
+
+std::string_view lox::symbol_table::name(symbol_id symbol) const LOX_NOEXCEPT
+{
+    const std::shared_lock lock{ m_mutex };
+    assert(symbol < m_names.size());
+    return m_names[symbol];
+}
+
+std::size_t lox::symbol_table::size() const LOX_NOEXCEPT
+{
+    const std::shared_lock lock{ m_mutex };
+    return m_names.size();
+}
+
+lox::symbol_id lox::symbol_table::find(std::string_view name,
+  std::uint32_t hash) const LOX_NOEXCEPT
+{
+    if (m_slots.empty()) {
+        return no_symbol;
+    }
+
+    const std::size_t mask{ m_slots.size() - 1 };
+    for (std::size_t index = hash & mask;; index = (index + 1) & mask) {
+        const slot& current = m_slots[index];
+        if (current.symbol == no_symbol) {
+            return no_symbol;
+        }
+
+        if (current.hash == hash && m_names[current.symbol] == name) {
+            return current.symbol;
+        }
+    }
+}
+
+void lox::symbol_table::grow() LOX_NOEXCEPT
+{
+    std::vector<slot> old_slots{ std::move(m_slots) };
+    m_slots.assign(
+      std::max<std::size_t>(old_slots.size() * 2, 64), slot{ no_symbol, 0 });
+    const std::size_t mask{ m_slots.size() - 1 };
+    for (const slot& old : old_slots) {
+        if (old.symbol == no_symbol) {
+            continue;
+        }
+
+        std::size_t index{ old.hash & mask };
+        while (m_slots[index].symbol != no_symbol) {
+            index = (index + 1) & mask;
+        }
+
+        m_slots[index] = old;
+    }
+}
+
+lox::symbol_cache::symbol_cache(symbol_table& table) LOX_NOEXCEPT
+  : m_table{ &table }
+{
+}
+
+lox::symbol_id lox::symbol_cache::intern(std::string_view name) LOX_NOEXCEPT
+{
+    assert(!name.empty());
+    // Cheaper than hashing the whole name, the comparison decides anyway.
+    const std::size_t index{ (name.size() * 31 +
+                               static_cast<unsigned char>(name.front()) * 7 +
+                               static_cast<unsigned char>(name.back())) %
+                             m_entries.size() };
+    entry& cached = m_entries[index];
+    if (cached.symbol != no_symbol && cached.name == name) {
+        return cached.symbol;
+    }
+
+    const symbol_id symbol{ m_table->intern(name) };
+    cached = { m_table->name(symbol), symbol };
+    return symbol;
+}
+
+lox::symbol_table& lox::symbols() LOX_NOEXCEPT
+{
+    static symbol_table s_symbols{};
+    return s_symbols;
+}
+
+lox::symbol_id lox::symbol_of(const lox::token& name) LOX_NOEXCEPT
+{
+    if (name.symbol != no_symbol) {
+        return name.symbol;
+    }
+
+    return symbols().intern(name.lexeme);
+}
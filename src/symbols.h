@@ -0,0 +1,100 @@
+#ifndef LOX_SYMBOLS_H
+#define LOX_SYMBOLS_H
+
+#include "defs.h"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lox {
+struct token;
+
+/*!
+ * Gives every distinct identifier a dense id, starting at 0. Looking up a name
+ * that was interned before does not allocate. The table can be used from
+ * several threads, lookups only take a shared lock.
+ */
+class symbol_table {
+public:
+    /*!
+     * Returns the id of the name, adding it if it was not interned before.
+     */
+    [[nodiscard]] symbol_id intern(std::string_view name) LOX_NOEXCEPT;
+
+    /*!
+     * Returns the id of the name or lox::no_symbol if it was never interned.
+     */
+    [[nodiscard]] symbol_id find(std::string_view name) const LOX_NOEXCEPT;
+
+    [[nodiscard]] std::string_view name(symbol_id symbol) const LOX_NOEXCEPT;
+
+    /*!
+     * Returns the number of interned names.
+     */
+    [[nodiscard]] std::size_t size() const LOX_NOEXCEPT;
+
+private:
+    struct slot {
+        // The id of the name or lox::no_symbol.
+        symbol_id symbol;
+        // The 32-bit hash of the name, used to skip most comparisons and to
+        // grow without hashing the names again.
+        std::uint32_t hash;
+    };
+
+    [[nodiscard]] symbol_id find(std::string_view name,
+      std::uint32_t hash) const LOX_NOEXCEPT;
+
+    void grow() LOX_NOEXCEPT;
+
+private:
+    mutable std::shared_mutex m_mutex;
+    // Indexed by symbol. A deque does not move the names when it grows, so
+    // the views returned by name() stay valid.
+    std::deque<std::string> m_names;
+    // Open addressing table. The size is always a power of two.
+    std::vector<slot> m_slots;
+};
+
+/*!
+ * Remembers the names that were last interned through it, so that repeated
+ * names skip the lock and the probing of the table. A cache is used by one
+ * thread at a time.
+ */
+class symbol_cache {
+public:
+    explicit symbol_cache(symbol_table& table) LOX_NOEXCEPT;
+
+    [[nodiscard]] symbol_id intern(std::string_view name) LOX_NOEXCEPT;
+
+private:
+    struct entry {
+        // Refers to the name in the table.
+        std::string_view name{};
+        symbol_id symbol{ no_symbol };
+    };
+
+    symbol_table* m_table;
+    std::array<entry, 256> m_entries{};
+};
+
+/*!
+ * The table that the scanner interns identifiers in. Ids are the same for
+ * every source that is scanned by the process, so statements from different
+ * sources, e.g. the lines of the REPL, agree on them.
+ */
+[[nodiscard]] symbol_table& symbols() LOX_NOEXCEPT;
+
+/*!
+ * Returns the symbol of an identifier token. Tokens that were not made by the
+ * scanner have no symbol, their lexeme is interned instead.
+ */
+[[nodiscard]] symbol_id symbol_of(const lox::token& name) LOX_NOEXCEPT;
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+struct lox::thread_pool::job {
+    const std::function<void(std::size_t)>& task;
+    const std::size_t count;
+    std::atomic<std::size_t> next{ 0 };
+    // Number of workers that are working on the job, guarded by m_mutex.
+    std::size_t active{ 0 };
+
+    void drain() LOX_NOEXCEPT
+    {
+        for (std::size_t index = next++; index < count; index = next++) {
+            task(index);
+        }
+    }
+};
+
+lox::thread_pool::thread_pool(std::size_t thread_count) LOX_NOEXCEPT
+{
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_threads.reserve(thread_count - 1);
+    for (std::size_t index = 1; index < thread_count; ++index) {
+        m_threads.emplace_back([this]() { work(); });
+    }
+}
+
+lox::thread_pool::~thread_pool()
+{
+    {
+        const std::lock_guard lock{ m_mutex };
+        m_is_stopping = true;
+    }
+
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+std::size_t lox::thread_pool::size() const LOX_NOEXCEPT
+{
+    return m_threads.size() + 1;
+}
+
+void lox::thread_pool::run(std::size_t count,
+  const std::function<void(std::size_t)>& task) LOX_NOEXCEPT
+{
+    job current{ task, count };
+    if (m_threads.empty() || count < 2) {
+        current.drain();
+        return;
+    }
+
+    {
+        const std::lock_guard lock{ m_mutex };
+        m_job = &current;
+        m_generation++;
+    }
+
+    m_wake.notify_all();
+    current.drain();
+
+    // Every index is taken, wait for the workers that are still on the job
+    // and make sure that no other worker picks it up after it is gone.
+    std::unique_lock lock{ m_mutex };
+    m_done.wait(lock, [&current]() { return current.active == 0; });
+    m_job = nullptr;
+}
+
+void lox::thread_pool::work() LOX_NOEXCEPT
+{
+    std::uint64_t seen_generation{ 0 };
+    while (true) {
+        std::unique_lock lock{ m_mutex };
+        m_wake.wait(lock, [this, seen_generation]() {
+            return m_is_stopping || m_generation != seen_generation;
+        });
+        if (m_is_stopping) {
+            return;
+        }
+
+        seen_generation = m_generation;
+        job* current = m_job;
+        if (!current) {
+            continue;
+        }
+
+        current->active++;
+        lock.unlock();
+        current->drain();
+        lock.lock();
+        current->active--;
+        if (current->active == 0) {
+            m_done.notify_all();
+        }
+    }
+}
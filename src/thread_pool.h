@@ -0,0 +1,63 @@
+#ifndef LOX_THREAD_POOL_H
+#define LOX_THREAD_POOL_H
+
+#include "defs.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lox {
+
+/*!
+ * A fixed set of worker threads that run the iterations of a loop. The calling
+ * thread takes part in the work, so a pool of size one has no workers and runs
+ * everything on the caller.
+ */
+class thread_pool {
+public:
+    /*!
+     * @param thread_count The number of threads including the caller. 0 uses
+     * the hardware concurrency.
+     */
+    explicit thread_pool(std::size_t thread_count = 0) LOX_NOEXCEPT;
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    /*!
+     * Returns the number of threads including the caller.
+     */
+    [[nodiscard]] std::size_t size() const LOX_NOEXCEPT;
+
+    /*!
+     * Calls `task` with every index in `[0, count)` and returns when all the
+     * calls are finished. The order of the calls is not specified.
+     * @note Must not be called concurrently or from inside a task.
+     */
+    void run(std::size_t count,
+      const std::function<void(std::size_t)>& task) LOX_NOEXCEPT;
+
+private:
+    struct job;
+
+    void work() LOX_NOEXCEPT;
+
+private:
+    std::vector<std::thread> m_threads{};
+    std::mutex m_mutex{};
+    std::condition_variable m_wake{};
+    std::condition_variable m_done{};
+    // The running job, guarded by m_mutex.
+    job* m_job{ nullptr };
+    std::uint64_t m_generation{ 0 };
+    bool m_is_stopping{ false };
+};
+}
+
+#endif
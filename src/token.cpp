@@ -1,6 +1,10 @@
 #include "token.h"
 
+#include "simd.h"
+
+#include <algorithm>
 #include <map>
+#include <cassert>
 
 namespace {
 using token_type = lox::token::token_type;
@@ -71,3 +75,81 @@ std::ostream& operator<<(std::ostream& os, const lox::token& tk)
 
     return os;
 }
+
+std::string_view lox::source_info::lexeme(
+  const compact_token& tkn) const LOX_NOEXCEPT
+{
+    return source.substr(tkn.offset, tkn.length);
+}
+
+const lox::object& lox::source_info::literal(
+  const compact_token& tkn) const LOX_NOEXCEPT
+{
+    static const lox::object s_empty{};
+    if (tkn.literal == compact_token::no_literal ||
+        tkn.type == token_type::IDENTIFIER) {
+        return s_empty;
+    }
+
+    assert(tkn.literal < literals.size());
+    return literals[tkn.literal];
+}
+
+std::size_t lox::source_info::line(std::uint32_t offset) const LOX_NOEXCEPT
+{
+    assert(!line_starts.empty());
+    const auto foundIt =
+      std::upper_bound(line_starts.cbegin(), line_starts.cend(), offset);
+    return static_cast<std::size_t>(
+      std::distance(line_starts.cbegin(), foundIt) - 1);
+}
+
+std::string_view lox::source_info::line_str(
+  std::size_t line) const LOX_NOEXCEPT
+{
+    assert(line < line_starts.size());
+    const std::size_t start{ line_starts[line] };
+    const std::size_t end{ line + 1 < line_starts.size()
+                             ? line_starts[line + 1] - 1
+                             : source.size() };
+    return source.substr(start, end - start);
+}
+
+std::pmr::vector<std::uint32_t> lox::make_line_starts(
+  std::string_view source,
+  std::pmr::memory_resource* resource)
+{
+    std::pmr::vector<std::uint32_t> line_starts{ resource };
+    line_starts.reserve(lox::simd::count(source, '\n') + 1);
+    line_starts.push_back(0);
+    std::size_t index{ lox::simd::find_either(source, 0, '\n', '\n') };
+    while (index < source.size()) {
+        line_starts.push_back(static_cast<std::uint32_t>(index + 1));
+        index = lox::simd::find_either(source, index + 1, '\n', '\n');
+    }
+
+    return line_starts;
+}
+
+lox::token lox::source_info::materialize(
+  const compact_token& tkn) const LOX_NOEXCEPT
+{
+    std::string_view lexeme{ this->lexeme(tkn) };
+    if (tkn.type == token_type::COMMENT) {
+        // Strip the `//` or the `/*` and `*/` around the comment.
+        const bool is_multi_line{ lexeme.size() >= 4 &&
+                                  lexeme.substr(0, 2) == "/*" &&
+                                  lexeme.substr(lexeme.size() - 2) == "*/" };
+        lexeme = lexeme.substr(2, lexeme.size() - 2 - (is_multi_line ? 2 : 0));
+    }
+
+    const std::size_t line{ this->line(tkn.offset) };
+    return lox::token{ tkn.type,
+        lexeme,
+        literal(tkn),
+        line,
+        tkn.offset,
+        static_cast<std::size_t>(tkn.offset) + tkn.length,
+        line_str(line),
+        tkn.type == token_type::IDENTIFIER ? tkn.literal : no_symbol };
+}
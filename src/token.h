@@ -3,14 +3,23 @@
 
 #include "defs.h"
 
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <string_view>
+#include <vector>
 
 namespace lox {
 
+/*!
+ * A token with all of its source information resolved. This is what the AST
+ * and the diagnostics use, the scanner stores lox::compact_token instead.
+ */
 struct token {
 
-    enum class token_type {
+    enum class token_type : std::uint8_t {
         COMMENT,
 
         // Single-character tokens.
@@ -71,6 +80,174 @@ struct token {
     std::size_t column_start;
     std::size_t column_end;
     std::string_view line_str;
+    // Set for the identifiers that the scanner made, see lox::symbol_of().
+    symbol_id symbol{ no_symbol };
+};
+
+/*!
+ * The scanner's representation of a token. Positions are byte offsets into the
+ * source, the text, literal value and line are looked up in lox::source_info
+ * when needed.
+ */
+struct compact_token {
+    static constexpr std::uint32_t no_literal{
+        std::numeric_limits<std::uint32_t>::max()
+    };
+
+    token::token_type type;
+    std::uint32_t offset;
+    std::uint32_t length;
+    // Index into lox::source_info::literals or no_literal. The lox::symbol_id
+    // of the lexeme for identifiers.
+    std::uint32_t literal;
+};
+
+static_assert(sizeof(compact_token) == 16, "compact_token must stay small.");
+
+/*!
+ * Side tables that are shared by all the tokens of one source. The tables are
+ * allocated from the memory resource that the source was scanned with.
+ */
+struct source_info {
+    std::string_view source;
+    std::pmr::vector<lox::object> literals;
+    // Offset of the first character of each line. The first entry is 0.
+    std::pmr::vector<std::uint32_t> line_starts;
+
+    [[nodiscard]] std::string_view lexeme(
+      const compact_token& tkn) const LOX_NOEXCEPT;
+    [[nodiscard]] const lox::object& literal(
+      const compact_token& tkn) const LOX_NOEXCEPT;
+
+    /*!
+     * Returns the zero based line number of the offset.
+     */
+    [[nodiscard]] std::size_t line(std::uint32_t offset) const LOX_NOEXCEPT;
+
+    /*!
+     * Returns the text of the line without the line break.
+     */
+    [[nodiscard]] std::string_view line_str(
+      std::size_t line) const LOX_NOEXCEPT;
+
+    /*!
+     * Returns the token with all of its source information filled in.
+     */
+    [[nodiscard]] lox::token materialize(
+      const compact_token& tkn) const LOX_NOEXCEPT;
+};
+
+/*!
+ * Returns the offsets of the first character of each line in the source.
+ */
+[[nodiscard]] std::pmr::vector<std::uint32_t> make_line_starts(
+  std::string_view source,
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/*!
+ * A list of compact tokens along with the tables that are needed to turn them
+ * back into lox::token. Iterating over the list yields lox::token values.
+ */
+struct token_list {
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = lox::token;
+        using difference_type = std::ptrdiff_t;
+        using reference = lox::token;
+
+        struct pointer {
+            lox::token tkn;
+
+            [[nodiscard]] const lox::token* operator->() const LOX_NOEXCEPT
+            {
+                return &tkn;
+            }
+        };
+
+    public:
+        const_iterator() = default;
+        const_iterator(const token_list* list, std::size_t index) LOX_NOEXCEPT
+          : m_list{ list }
+          , m_index{ index }
+        {
+        }
+
+        [[nodiscard]] reference operator*() const LOX_NOEXCEPT
+        {
+            return (*m_list)[m_index];
+        }
+
+        [[nodiscard]] pointer operator->() const LOX_NOEXCEPT
+        {
+            return pointer{ **this };
+        }
+
+        const_iterator& operator++() LOX_NOEXCEPT
+        {
+            m_index++;
+            return *this;
+        }
+
+        const_iterator operator++(int) LOX_NOEXCEPT
+        {
+            const_iterator it{ *this };
+            m_index++;
+            return it;
+        }
+
+        [[nodiscard]] bool operator==(
+          const const_iterator& other) const LOX_NOEXCEPT = default;
+
+    private:
+        const token_list* m_list{ nullptr };
+        std::size_t m_index{ 0 };
+    };
+
+    std::pmr::vector<lox::compact_token> compact;
+    std::shared_ptr<const lox::source_info> info;
+
+    [[nodiscard]] bool empty() const LOX_NOEXCEPT
+    {
+        return compact.empty();
+    }
+
+    [[nodiscard]] std::size_t size() const LOX_NOEXCEPT
+    {
+        return compact.size();
+    }
+
+    [[nodiscard]] lox::token operator[](std::size_t index) const LOX_NOEXCEPT
+    {
+        return materialize(compact[index]);
+    }
+
+    [[nodiscard]] const_iterator begin() const LOX_NOEXCEPT
+    {
+        return { this, 0 };
+    }
+
+    [[nodiscard]] const_iterator end() const LOX_NOEXCEPT
+    {
+        return { this, compact.size() };
+    }
+
+    [[nodiscard]] const_iterator cbegin() const LOX_NOEXCEPT
+    {
+        return begin();
+    }
+
+    [[nodiscard]] const_iterator cend() const LOX_NOEXCEPT
+    {
+        return end();
+    }
+
+    [[nodiscard]] lox::token materialize(
+      const compact_token& tkn) const LOX_NOEXCEPT
+    {
+        assert(info);
+        return info->materialize(tkn);
+    }
 };
 }
 
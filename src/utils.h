@@ -19,17 +19,25 @@ namespace lox {
     return (std::isalpha(ch) || ch == '_') && ch != ';';
 }
 
+inline void log_error(std::ostream& os,
+  std::string_view line_str,
+  std::size_t linenr,
+  std::size_t column_start,
+  std::string_view message) LOX_NOEXCEPT
+{
+    os << "Error: " << message << '\n'
+       << std::setfill(' ') << std::setw(4) << linenr << "| " << line_str
+       << '\n'
+       << std::setfill(' ') << std::setw(column_start + 4 + 1 + 1 + 1) << "^"
+       << "-- Here" << '\n';
+}
+
 inline void log_error(std::string_view line_str,
   std::size_t linenr,
   std::size_t column_start,
   std::string_view message) LOX_NOEXCEPT
 {
-    std::cerr << "Error: " << message << '\n'
-              << std::setfill(' ') << std::setw(4) << linenr << "| " << line_str
-              << '\n'
-              << std::setfill(' ') << std::setw(column_start + 4 + 1 + 1 + 1)
-              << "^"
-              << "-- Here" << '\n';
+    log_error(std::cerr, line_str, linenr, column_start, message);
 }
 
 }
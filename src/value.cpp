@@ -0,0 +1,108 @@
+#include "value.h"
+
+#include <cassert>
+
+namespace {
+template<typename>
+[[maybe_unused]] constexpr bool always_false_v = false;
+}
+
+namespace lox {
+value::value(const heap_string* str) LOX_NOEXCEPT
+  : m_bits{ s_sign_bit | s_qnan | reinterpret_cast<std::uintptr_t>(str) }
+{
+    assert((reinterpret_cast<std::uintptr_t>(str) & ~s_pointer_mask) == 0);
+}
+
+value::kind value::type() const LOX_NOEXCEPT
+{
+    if (is_number()) {
+        return kind::NUMBER;
+    }
+
+    if (m_bits & s_sign_bit) {
+        return kind::STRING;
+    }
+
+    if (is_bool()) {
+        return kind::BOOLEAN;
+    }
+
+    return (m_bits & ~s_qnan) == s_tag_nil ? kind::NIL : kind::EMPTY;
+}
+
+const heap_string& value::as_string() const LOX_NOEXCEPT
+{
+    assert(type() == kind::STRING);
+    return *reinterpret_cast<const heap_string*>(m_bits & s_pointer_mask);
+}
+
+bool operator==(value left, value right) LOX_NOEXCEPT
+{
+    if (left.is_number() && right.is_number()) {
+        return left.as_number() == right.as_number();
+    }
+
+    const auto type = left.type();
+    if (type != right.type()) {
+        return false;
+    }
+
+    if (type == value::kind::STRING) {
+        return left.as_string() == right.as_string();
+    }
+
+    return left.m_bits == right.m_bits;
+}
+
+heap::heap(std::pmr::memory_resource* resource) LOX_NOEXCEPT
+  : m_strings{ resource }
+{
+}
+
+value heap::make_string(heap_string str)
+{
+    return value{ &m_strings.emplace_front(std::move(str)) };
+}
+
+value to_value(const object& obj, heap& hp)
+{
+    return std::visit(
+      [&hp](auto&& arg) -> value {
+          using T = std::decay_t<decltype(arg)>;
+          if constexpr (std::is_same_v<T, std::monostate>) {
+              return value{};
+          }
+          else if constexpr (std::is_same_v<T, heap_string>) {
+              return hp.make_string(arg);
+          }
+          else if constexpr (std::is_same_v<T, double> ||
+                             std::is_same_v<T, bool> ||
+                             std::is_same_v<T, std::nullptr_t>) {
+              return value{ arg };
+          }
+          else {
+              static_assert(always_false_v<T>, "Unhandled type.");
+          }
+      },
+      obj);
+}
+
+object to_object(value val) LOX_NOEXCEPT
+{
+    switch (val.type()) {
+        case value::kind::NUMBER:
+            return val.as_number();
+        case value::kind::BOOLEAN:
+            return val.as_bool();
+        case value::kind::NIL:
+            return nullptr;
+        case value::kind::STRING:
+            return val.as_string();
+        case value::kind::EMPTY:
+            break;
+    }
+
+    return {};
+}
+}
@@ -0,0 +1,144 @@
+#ifndef LOX_VALUE_H
+#define LOX_VALUE_H
+
+#include "defs.h"
+
+#include <bit>
+#include <cstdint>
+#include <forward_list>
+#include <memory_resource>
+
+namespace lox {
+
+/*!
+ * An 8-byte NaN-boxed alternative to lox::object.
+ *
+ * Doubles are stored as is. Every other kind is encoded in the payload of a
+ * quiet NaN: nil, booleans and the empty value are singletons, and strings are
+ * 48-bit pointers with the sign bit set. Strings are not owned by the value,
+ * a lox::heap that must outlive it holds a reference to them.
+ */
+class value {
+public:
+    enum class kind {
+        EMPTY,
+        NIL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+    };
+
+public:
+    constexpr value() LOX_NOEXCEPT : m_bits{ s_qnan | s_tag_empty }
+    {
+    }
+
+    explicit constexpr value(double number) LOX_NOEXCEPT
+      : m_bits{ number != number ? s_canonical_nan
+                                 : std::bit_cast<std::uint64_t>(number) }
+    {
+    }
+
+    explicit constexpr value(bool boolean) LOX_NOEXCEPT
+      : m_bits{ s_qnan | (boolean ? s_tag_true : s_tag_false) }
+    {
+    }
+
+    explicit constexpr value(std::nullptr_t) LOX_NOEXCEPT
+      : m_bits{ s_qnan | s_tag_nil }
+    {
+    }
+
+    explicit value(const heap_string* str) LOX_NOEXCEPT;
+
+    [[nodiscard]] kind type() const LOX_NOEXCEPT;
+
+    [[nodiscard]] constexpr bool is_number() const LOX_NOEXCEPT
+    {
+        return (m_bits & s_qnan) != s_qnan;
+    }
+
+    [[nodiscard]] constexpr bool is_bool() const LOX_NOEXCEPT
+    {
+        return (m_bits | 1) == (s_qnan | s_tag_true);
+    }
+
+    [[nodiscard]] constexpr double as_number() const LOX_NOEXCEPT
+    {
+        assert(is_number());
+        return std::bit_cast<double>(m_bits);
+    }
+
+    [[nodiscard]] constexpr bool as_bool() const LOX_NOEXCEPT
+    {
+        return m_bits == (s_qnan | s_tag_true);
+    }
+
+    [[nodiscard]] const heap_string& as_string() const LOX_NOEXCEPT;
+
+    [[nodiscard]] constexpr std::uint64_t bits() const LOX_NOEXCEPT
+    {
+        return m_bits;
+    }
+
+    /*!
+     * Follows the semantics of comparing two lox::object instances: values of
+     * different kinds are never equal and NaN is not equal to itself.
+     */
+    friend bool operator==(value left, value right) LOX_NOEXCEPT;
+
+private:
+    static constexpr std::uint64_t s_sign_bit{ 0x8000000000000000 };
+    static constexpr std::uint64_t s_qnan{ 0x7ffc000000000000 };
+    static constexpr std::uint64_t s_pointer_mask{ 0x0000fffffffffffe };
+    // NaNs produced by arithmetic are canonicalized so that their payload is
+    // never mistaken for a boxed value.
+    static constexpr std::uint64_t s_canonical_nan{ 0x7ff8000000000000 };
+
+    static constexpr std::uint64_t s_tag_empty{ 1 };
+    static constexpr std::uint64_t s_tag_nil{ 2 };
+    static constexpr std::uint64_t s_tag_false{ 4 };
+    static constexpr std::uint64_t s_tag_true{ 5 };
+
+private:
+    std::uint64_t m_bits;
+};
+
+static_assert(sizeof(value) == 8, "lox::value must fit in a machine word.");
+static_assert(std::is_trivially_copyable_v<value>, "Requirement error.");
+
+/*!
+ * Holds a reference to the strings that are referred to by lox::value
+ * instances. The addresses of the strings are stable, so a heap can be moved
+ * but not copied. Making a value of a string shares its characters, the list
+ * that holds it is allocated from the resource of the heap.
+ */
+class heap {
+public:
+    heap() = default;
+    explicit heap(std::pmr::memory_resource* resource) LOX_NOEXCEPT;
+    heap(heap&&) = default;
+    heap& operator=(heap&&) = default;
+
+    heap(const heap&) = delete;
+    heap& operator=(const heap&) = delete;
+
+    /*!
+     * @throws std::bad_alloc if the resource of the heap runs out.
+     */
+    [[nodiscard]] value make_string(heap_string str);
+
+private:
+    std::pmr::forward_list<heap_string> m_strings;
+};
+
+/*!
+ * Converts the object to a value. Strings are shared with the heap.
+ * @throws std::bad_alloc if the resource of the heap runs out.
+ */
+[[nodiscard]] value to_value(const object& obj, heap& hp);
+
+[[nodiscard]] object to_object(value val) LOX_NOEXCEPT;
+}
+
+#endif
@@ -0,0 +1,247 @@
+#include "vm.h"
+
+#include "environment.h"
+#include "operations.h"
+#include "value.h"
+
+#include <cassert>
+
+#ifndef LOX_EXCEPTION_ENABLED
+#error "VM relies on exceptions to be enabled."
+#endif
+
+namespace {
+struct vm_state {
+    const lox::chunk& chk;
+    const std::uint8_t* ip;
+    // Where the stack and the strings that the chunk creates are allocated,
+    // the resource of the environment.
+    std::pmr::memory_resource* resource;
+    std::pmr::vector<lox::value> stack{ resource };
+    // Owns the strings that are created while the chunk runs.
+    lox::heap strings{ resource };
+};
+
+[[nodiscard]] std::uint32_t read_operand(vm_state& state) LOX_NOEXCEPT
+{
+    const std::uint32_t operand =
+      (static_cast<std::uint32_t>(state.ip[0]) << 24) |
+      (static_cast<std::uint32_t>(state.ip[1]) << 16) |
+      (static_cast<std::uint32_t>(state.ip[2]) << 8) |
+      static_cast<std::uint32_t>(state.ip[3]);
+    state.ip += lox::operand_size;
+    return operand;
+}
+
+[[nodiscard]] lox::slot_index read_slot(vm_state& state) LOX_NOEXCEPT
+{
+    return read_operand(state);
+}
+
+[[nodiscard]] const lox::token& read_token(vm_state& state) LOX_NOEXCEPT
+{
+    return *state.chk.tokens[read_operand(state)];
+}
+
+[[nodiscard]] lox::value pop(vm_state& state) LOX_NOEXCEPT
+{
+    assert(!state.stack.empty());
+    const lox::value value{ state.stack.back() };
+    state.stack.pop_back();
+    return value;
+}
+
+void push(vm_state& state, lox::value value)
+{
+    state.stack.push_back(value);
+}
+
+void push(vm_state& state, const lox::object& object)
+{
+    state.stack.push_back(lox::to_value(object, state.strings));
+}
+
+[[nodiscard]] bool is_truthy(lox::value value) LOX_NOEXCEPT
+{
+    if (value.is_number()) {
+        return value.as_number() > 0;
+    }
+
+    if (value.is_bool()) {
+        return value.as_bool();
+    }
+
+    return lox::ops::is_truthy(lox::to_object(value));
+}
+
+/*!
+ * Pops the right operand and replaces the left operand with the result of
+ * `op`. Operands that are not numbers, or a zero right operand, are handed to
+ * check_number_operand() to report the same error as the tree walker.
+ */
+template<typename Op>
+void arithmetic(vm_state& state, Op op)
+{
+    const lox::token& oprtor = read_token(state);
+    const lox::value right{ pop(state) };
+    lox::value& left = state.stack.back();
+    if (!left.is_number() || !right.is_number() || right.as_number() == 0) {
+        const lox::object right_object{ lox::to_object(right) };
+        lox::ops::check_number_operand(
+          oprtor, lox::to_object(left), right_object);
+    }
+
+    left = lox::value{ op(left.as_number(), right.as_number()) };
+}
+
+void add(vm_state& state)
+{
+    const lox::token& oprtor = read_token(state);
+    const lox::value right{ pop(state) };
+    lox::value& left = state.stack.back();
+    if (left.is_number() && right.is_number()) {
+        left = lox::value{ left.as_number() + right.as_number() };
+        return;
+    }
+
+    const lox::object left_object{ lox::to_object(left) };
+    const lox::object right_object{ lox::to_object(right) };
+    lox::ops::check_concatenation_types(oprtor, left_object, right_object);
+    left = lox::to_value(
+      lox::ops::concatenate(left_object, right_object, state.resource),
+      state.strings);
+}
+}
+
+lox::object lox::execute(const chunk& chk, environment& env)
+{
+    assert(!chk.code.empty());
+
+    vm_state state{ chk, chk.code.data(), env.resource() };
+    state.stack.reserve(16);
+    while (true) {
+        const auto code = static_cast<op_code>(*state.ip++);
+        switch (code) {
+            case op_code::CONSTANT:
+                push(state, chk.constants[read_operand(state)]);
+                break;
+            case op_code::EMPTY:
+                push(state, lox::value{});
+                break;
+            case op_code::NIL:
+                push(state, lox::value{ nullptr });
+                break;
+            case op_code::TRUE:
+                push(state, lox::value{ true });
+                break;
+            case op_code::FALSE:
+                push(state, lox::value{ false });
+                break;
+            case op_code::POP:
+                state.stack.pop_back();
+                break;
+            case op_code::ADD:
+                add(state);
+                break;
+            case op_code::SUBTRACT:
+                arithmetic(state, [](double l, double r) { return l - r; });
+                break;
+            case op_code::MULTIPLY:
+                arithmetic(state, [](double l, double r) { return l * r; });
+                break;
+            case op_code::DIVIDE:
+                arithmetic(state, [](double l, double r) { return l / r; });
+                break;
+            case op_code::GREATER:
+                arithmetic(state, [](double l, double r) { return l > r; });
+                break;
+            case op_code::GREATER_EQUAL:
+                arithmetic(state, [](double l, double r) { return l >= r; });
+                break;
+            case op_code::LESS:
+                arithmetic(state, [](double l, double r) { return l < r; });
+                break;
+            case op_code::LESS_EQUAL:
+                arithmetic(state, [](double l, double r) { return l <= r; });
+                break;
+            case op_code::NEGATE: {
+                const lox::token& oprtor = read_token(state);
+                lox::value& right = state.stack.back();
+                if (!right.is_number()) {
+                    lox::ops::check_number_operand(
+                      oprtor, lox::to_object(right));
+                }
+
+                right = lox::value{ right.as_number() * -1 };
+                break;
+            }
+            case op_code::EQUAL: {
+                const lox::value right{ pop(state) };
+                lox::value& left = state.stack.back();
+                left = lox::value{ left == right };
+                break;
+            }
+            case op_code::NOT_EQUAL: {
+                const lox::value right{ pop(state) };
+                lox::value& left = state.stack.back();
+                left = lox::value{ !(left == right) };
+                break;
+            }
+            case op_code::NOT: {
+                lox::value& right = state.stack.back();
+                right = lox::value{ !is_truthy(right) };
+                break;
+            }
+            case op_code::DEFINE_GLOBAL:
+                lox::env::define(env,
+                  read_token(state),
+                  lox::to_object(state.stack.back()));
+                break;
+            case op_code::GET_GLOBAL:
+                push(state, lox::env::get(env, read_token(state)));
+                break;
+            case op_code::SET_GLOBAL:
+                lox::env::assign(
+                  env, read_token(state), lox::to_object(state.stack.back()));
+                break;
+            case op_code::DEFINE_SLOT:
+                // The name is only needed for diagnostics.
+                LOX_UNUSED(read_operand(state));
+                lox::env::define(
+                  env, read_slot(state), lox::to_object(state.stack.back()));
+                break;
+            case op_code::GET_SLOT: {
+                const lox::token& name = read_token(state);
+                push(state, lox::env::get(env, read_slot(state), name));
+                break;
+            }
+            case op_code::SET_SLOT: {
+                const lox::token& name = read_token(state);
+                lox::env::assign(env,
+                  read_slot(state),
+                  name,
+                  lox::to_object(state.stack.back()));
+                break;
+            }
+            case op_code::JUMP:
+                state.ip += read_operand(state);
+                break;
+            case op_code::JUMP_IF_FALSE: {
+                const std::uint32_t offset{ read_operand(state) };
+                if (!is_truthy(pop(state))) {
+                    state.ip += offset;
+                }
+                break;
+            }
+            case op_code::PRINT:
+                state.stack.back() = lox::to_value(
+                  lox::ops::print(
+                    lox::to_object(state.stack.back()), state.resource),
+                  state.strings);
+                break;
+            case op_code::RETURN:
+                assert(state.stack.size() == 1);
+                return lox::to_object(pop(state));
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef LOX_VM_H
+#define LOX_VM_H
+
+#include "chunk.h"
+#include "defs.h"
+
+namespace lox {
+struct environment;
+
+/*!
+ * Runs the chunk produced by lox::compile() against the environment.
+ *
+ * @throws lox::runtime_error
+ * @throws std::bad_alloc if the environment's resource runs out.
+ * @return The value that is left on top of the stack by op_code::RETURN.
+ */
+[[nodiscard]] object execute(const chunk& chk, environment& env);
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "arena.h"
+
+#include "environment.h"
+#include "interpreter.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+
+SCENARIO("Test the arena resource", "[lox++::arena]")
+{
+    GIVEN("An arena without a limit")
+    {
+        lox::arena_resource arena{};
+        CHECK(arena.allocated() == 0);
+        CHECK(arena.limit() == lox::arena_resource::no_limit);
+
+        void* first{ arena.allocate(100, alignof(double)) };
+        void* second{ arena.allocate(28, 4) };
+        CHECK(first != second);
+        CHECK(arena.allocated() == 128);
+        CHECK(arena.reserved() >= arena.allocated());
+
+        THEN("Deallocation does not give the memory back.")
+        {
+            arena.deallocate(second, 28, 4);
+            CHECK(arena.allocated() == 128);
+        }
+
+        THEN("Releasing the arena gives all of the memory back.")
+        {
+            arena.release();
+            CHECK(arena.allocated() == 0);
+            CHECK(arena.reserved() == 0);
+        }
+    }
+
+    GIVEN("An arena with a limit")
+    {
+        lox::arena_resource arena{ 64 };
+        [[maybe_unused]] void* memory{ arena.allocate(60, 1) };
+        CHECK_THROWS_AS(arena.allocate(8, 1), std::bad_alloc);
+        CHECK(arena.allocated() == 60);
+
+        [[maybe_unused]] void* rest{ arena.allocate(4, 1) };
+        CHECK(arena.allocated() == 64);
+
+        THEN("The limit applies again after a release.")
+        {
+            arena.release();
+            [[maybe_unused]] void* again{ arena.allocate(64, 1) };
+            CHECK(arena.allocated() == 64);
+        }
+    }
+
+    GIVEN("A run that allocates from the arena")
+    {
+        lox::arena_resource arena{};
+        {
+            const auto result = lox::scan_tokens("var a = 2; var b = a * 3;\n"
+                                                 "a + b; // comment",
+              &arena);
+            CHECK(result.tokens.compact.get_allocator().resource() == &arena);
+            CHECK(result.trivia.size() == 1);
+            CHECK(result.tokens.info->literals.get_allocator().resource() ==
+                  &arena);
+
+            auto program = lox::parse_flat(result.tokens, &arena);
+            CHECK(program.statements.get_allocator().resource() == &arena);
+
+            lox::environment env{ &arena };
+            CHECK(env.resource() == &arena);
+            lox::resolve(program, env);
+
+            const std::size_t before_run{ arena.allocated() };
+            CHECK(before_run > 0);
+
+            std::optional<lox::object> last{};
+            for (const lox::flat::node_index statement : program.statements) {
+                lox::interpret(program, statement, env)
+                  .and_then([&last](lox::object value) { last = value; })
+                  .or_else([](auto) { CHECK(false); });
+            }
+
+            REQUIRE(last.has_value());
+            CHECK(std::get<double>(last.value()) == 8);
+            const lox::slot_index slot{ lox::env::find(env, "b") };
+            CHECK(std::get<double>(env.values[slot]) == 6);
+        }
+
+        THEN("The whole run is given back at once.")
+        {
+            CHECK(arena.allocated() > 0);
+            arena.release();
+            CHECK(arena.allocated() == 0);
+        }
+    }
+
+    GIVEN("A statement that is run on the VM")
+    {
+        lox::arena_resource arena{};
+        lox::environment env{ &arena };
+        lox::token_stream tokens{ "var text = \"a\" + \"b\";", &arena };
+        auto statements = lox::parse(tokens, &arena);
+        REQUIRE(statements.size() == 1);
+        lox::resolve(statements, env);
+
+        const std::size_t before_run{ arena.allocated() };
+        const auto result =
+          lox::interpret(statements.front(), env, lox::engine::vm);
+        REQUIRE(result.has_value());
+        CHECK(std::get<lox::heap_string>(result.value()) == "ab");
+        // The chunk is kept in the statement and allocated with its nodes,
+        // the stack of the VM comes from the environment.
+        CHECK(arena.allocated() > before_run);
+
+        THEN("Later runs do not compile it again.")
+        {
+            const std::size_t after_first_run{ arena.allocated() };
+            CHECK(lox::interpret(statements.front(), env).has_value());
+            CHECK(arena.allocated() - after_first_run <
+                  after_first_run - before_run);
+        }
+    }
+
+    GIVEN("A syntax tree that is parsed into the arena")
+    {
+        lox::arena_resource arena{};
+        lox::token_stream tokens{ "print 1 + 2 * 3;", &arena };
+        const std::size_t before_parse{ arena.allocated() };
+        const auto statements = lox::parse(tokens, &arena);
+        REQUIRE(statements.size() == 1);
+        CHECK(arena.allocated() > before_parse);
+    }
+
+    GIVEN("A string that keeps growing")
+    {
+        // Doubles the string 22 times, comparing the ropes flattens them into
+        // two strings of 4 MB each.
+        std::string source{ "var s = \"x\";" };
+        for (int i = 0; i < 22; ++i) {
+            source += " s = s + s;";
+        }
+        source += " s + \"y\" == \"y\" + s;";
+
+        const auto run = [&source](lox::arena_resource& arena,
+                           lox::engine engine) {
+            lox::token_stream tokens{ source, &arena };
+            auto statements = lox::parse(tokens, &arena);
+            lox::environment env{ &arena };
+            lox::resolve(statements, env);
+            for (const lox::stmt& statement : statements) {
+                const auto result = lox::interpret(statement, env, engine);
+                CHECK(result.has_value());
+            }
+        };
+
+        for (const lox::engine engine :
+          { lox::engine::tree_walker, lox::engine::closure, lox::engine::vm }) {
+            THEN("The limit of the arena stops it.")
+            {
+                lox::arena_resource arena{ 200'000 };
+                CHECK_THROWS_AS(run(arena, engine), std::bad_alloc);
+                CHECK(arena.allocated() <= 200'000);
+            }
+        }
+    }
+
+    GIVEN("Runs that go over the limit of the arena")
+    {
+        const std::string_view source{ "var a = \"x\"; var b = a + a + 1;\n"
+                                       "b = b + a; a == b ? b : a;" };
+        const auto run = [source](lox::arena_resource& arena) {
+            const auto result = lox::scan_tokens(source, &arena);
+            auto program = lox::parse_flat(result.tokens, &arena);
+            lox::optimize(program);
+            lox::environment env{ &arena };
+            lox::resolve(program, env);
+            // Outside of CHECK(), which would swallow std::bad_alloc.
+            for (const lox::flat::node_index statement : program.statements) {
+                const auto result = lox::interpret(program, statement, env);
+                CHECK(result.has_value());
+            }
+        };
+
+        THEN("Every limit either runs the script or throws std::bad_alloc.")
+        {
+            std::size_t failed_runs{ 0 };
+            std::size_t limit{ 0 };
+            for (;; limit += 64) {
+                lox::arena_resource arena{ limit };
+                try {
+                    run(arena);
+                    break;
+                }
+                catch (const std::bad_alloc&) {
+                    ++failed_runs;
+                }
+            }
+
+            CHECK(failed_runs > 0);
+            lox::arena_resource arena{ limit };
+            CHECK_NOTHROW(run(arena));
+        }
+    }
+}
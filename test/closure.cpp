@@ -0,0 +1,227 @@
+#include "closure.h"
+
+#include "environment.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace {
+[[nodiscard]] lox::closure compile(std::string_view source)
+{
+    const auto statements = lox::parse(lox::scan_tokens(source).tokens);
+    REQUIRE(statements.size() == 1);
+    return lox::compile_closure(statements.front());
+}
+
+void run(std::string_view source, lox::environment& env)
+{
+    for (const auto& statement :
+      lox::parse(lox::scan_tokens(source).tokens)) {
+        lox::interpret(statement, env, lox::engine::tree_walker)
+          .or_else([](auto) { CHECK(false); });
+    }
+}
+}
+
+SCENARIO("Test closures", "[lox++::closure]")
+{
+    GIVEN("An addition of numbers that runs repeatedly")
+    {
+        lox::environment env{};
+        run("var a = 1;", env);
+        const auto closure = compile("a = a + 1;");
+        REQUIRE(closure.counters().size() == 1);
+        const auto& counters = *closure.counters().front();
+        CHECK(counters.current == lox::specialization::generic);
+
+        for (int i = 0; i < 5; ++i) {
+            closure(env);
+        }
+
+        THEN("The node is specialized once.")
+        {
+            CHECK(std::get<double>(closure(env)) == 7);
+            CHECK(counters.oprtor == lox::token::token_type::PLUS);
+            CHECK(counters.current == lox::specialization::number);
+            CHECK(counters.specializations == 1);
+            CHECK(counters.deoptimizations == 0);
+        }
+    }
+
+    GIVEN("A concatenation of strings")
+    {
+        lox::environment env{};
+        run("var s = \"a\";", env);
+        const auto closure = compile("s + \"b\";");
+        for (int i = 0; i < 3; ++i) {
+            CHECK(std::get<lox::heap_string>(closure(env)) == "ab");
+        }
+
+        CHECK(closure.counters().front()->current ==
+              lox::specialization::string);
+    }
+
+    GIVEN("Operands that change their types")
+    {
+        lox::environment env{};
+        run("var x = 1; var y = 2;", env);
+        const auto closure = compile("x + y;");
+        closure(env);
+        closure(env);
+        const auto& counters = *closure.counters().front();
+        REQUIRE(counters.current == lox::specialization::number);
+
+        THEN("The guard sends the node back to the generic form.")
+        {
+            run("x = \"a\"; y = \"b\";", env);
+            CHECK(std::get<lox::heap_string>(closure(env)) == "ab");
+            CHECK(counters.current == lox::specialization::generic);
+            CHECK(counters.deoptimizations == 1);
+
+            closure(env);
+            CHECK(counters.current == lox::specialization::string);
+            CHECK(counters.specializations == 2);
+
+            run("x = 1;", env);
+            CHECK(std::get<lox::heap_string>(closure(env)) == "1b");
+            CHECK(counters.current == lox::specialization::generic);
+            CHECK(counters.deoptimizations == 2);
+        }
+
+        THEN("Nodes that keep changing stay generic.")
+        {
+            for (int i = 0; i < 10; ++i) {
+                run(i % 2 == 0 ? "x = \"a\";" : "x = 1;", env);
+                closure(env);
+                closure(env);
+            }
+
+            CHECK(counters.deoptimizations == 4);
+            CHECK(counters.specializations == 4);
+            CHECK(counters.current == lox::specialization::generic);
+        }
+    }
+
+    GIVEN("A specialized node with operands that raise an error")
+    {
+        lox::environment env{};
+        run("var a = 4; var b = 2;", env);
+        const auto closure = compile("a / b;");
+        CHECK(std::get<double>(closure(env)) == 2);
+        CHECK(std::get<double>(closure(env)) == 2);
+        REQUIRE(closure.counters().front()->current ==
+                lox::specialization::number);
+
+        run("b = 0;", env);
+        CHECK_THROWS_AS(closure(env), lox::runtime_error);
+        CHECK(closure.counters().front()->deoptimizations == 1);
+
+        run("b = nil;", env);
+        CHECK_THROWS_AS(closure(env), lox::runtime_error);
+    }
+
+    GIVEN("Nested operators")
+    {
+        lox::environment env{};
+        run("var a = 1;", env);
+        const auto closure = compile("-(a + 1) * 2 < 1;");
+        CHECK(std::get<bool>(closure(env)));
+        CHECK(std::get<bool>(closure(env)));
+
+        THEN("Every operator has its counters, operands come first.")
+        {
+            REQUIRE(closure.counters().size() == 4);
+            CHECK(closure.counters()[0]->oprtor ==
+                  lox::token::token_type::PLUS);
+            CHECK(closure.counters()[1]->oprtor ==
+                  lox::token::token_type::MINUS);
+            CHECK(closure.counters()[2]->oprtor ==
+                  lox::token::token_type::STAR);
+            CHECK(closure.counters()[3]->oprtor ==
+                  lox::token::token_type::LESS);
+            for (const auto& counters : closure.counters()) {
+                CHECK(counters->current == lox::specialization::number);
+            }
+        }
+    }
+
+    GIVEN("A statement that is run through lox::interpret()")
+    {
+        lox::environment env{};
+        run("var a = 1;", env);
+        auto statements = lox::parse(lox::scan_tokens("a = a + 1;").tokens);
+        lox::resolve(statements, env);
+        const lox::stmt& statement = statements.front();
+        for (int i = 0; i < 3; ++i) {
+            CHECK(lox::interpret(statement, env, lox::engine::closure)
+                    .has_value());
+        }
+
+        const lox::closure* compiled{ &lox::cached_closure(statement) };
+
+        THEN("Later runs reuse the closure.")
+        {
+            const auto result =
+              lox::interpret(statement, env, lox::engine::closure);
+            REQUIRE(result.has_value());
+            CHECK(std::get<double>(result.value()) == 5);
+            CHECK(&lox::cached_closure(statement) == compiled);
+        }
+
+        THEN("The counters of the closure cover all of the runs.")
+        {
+            REQUIRE(compiled->counters().size() == 1);
+            const auto& counters = *compiled->counters().front();
+            CHECK(counters.current == lox::specialization::number);
+            CHECK(counters.specializations == 1);
+        }
+
+        THEN("Resolving it to the same slots keeps the closure.")
+        {
+            lox::resolve(statements, env);
+            CHECK(&lox::cached_closure(statement) == compiled);
+        }
+
+        THEN("Resolving it to other slots compiles it again.")
+        {
+            lox::environment other{};
+            run("var b = 10; var a = 1;", other);
+            lox::resolve(statements, other);
+            const auto result =
+              lox::interpret(statement, other, lox::engine::closure);
+            REQUIRE(result.has_value());
+            CHECK(std::get<double>(result.value()) == 2);
+            const lox::slot_index slot{ lox::env::find(other, "b") };
+            CHECK(std::get<double>(other.values[slot]) == 10);
+        }
+    }
+
+    GIVEN("Counters that outlive the source")
+    {
+        std::shared_ptr<const lox::quickening_counters> counters{};
+        {
+            const std::string source{ "1;\n2 * 3;" };
+            const auto statements =
+              lox::parse(lox::scan_tokens(source).tokens);
+            REQUIRE(statements.size() == 2);
+            const lox::closure& closure{ lox::cached_closure(
+              statements.back()) };
+            REQUIRE(closure.counters().size() == 1);
+            counters = closure.counters().front();
+        }
+
+        THEN("They keep the type and the position of the operator.")
+        {
+            CHECK(counters->oprtor == lox::token::token_type::STAR);
+            CHECK(counters->line == 1);
+            CHECK(counters->offset == 5);
+        }
+    }
+}
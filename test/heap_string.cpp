@@ -0,0 +1,196 @@
+#include "heap_string.h"
+
+#include "environment.h"
+#include "interpreter.h"
+#include "operations.h"
+#include "parser.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+SCENARIO("Test heap strings", "[lox++::heap_string]")
+{
+    GIVEN("The empty string")
+    {
+        const lox::heap_string empty{};
+        CHECK(empty.empty());
+        CHECK(empty.size() == 0);
+        CHECK(empty.use_count() == 0);
+        CHECK(empty.view().empty());
+        CHECK(empty.hash() == std::hash<std::string_view>{}(""));
+        CHECK(empty == lox::heap_string{ "" });
+        CHECK(lox::heap_string{ "", "" }.use_count() == 0);
+    }
+
+    GIVEN("A string")
+    {
+        const lox::heap_string str{ "Hello" };
+        CHECK(str.view() == "Hello");
+        CHECK(str.size() == 5);
+        CHECK(str.hash() == std::hash<std::string_view>{}("Hello"));
+        CHECK(str.use_count() == 1);
+
+        THEN("Copies share the characters.")
+        {
+            {
+                const lox::heap_string copy{ str };
+                CHECK(str.use_count() == 2);
+                CHECK(copy.view().data() == str.view().data());
+
+                lox::heap_string moved{ copy };
+                lox::heap_string target{ std::move(moved) };
+                CHECK(str.use_count() == 3);
+                CHECK(moved.empty());
+
+                target = lox::heap_string{ "other" };
+                CHECK(str.use_count() == 2);
+            }
+
+            CHECK(str.use_count() == 1);
+        }
+
+        THEN("Strings are compared by their characters.")
+        {
+            CHECK(str == lox::heap_string{ "Hello" });
+            CHECK(str == "Hello");
+            CHECK(!(str == lox::heap_string{ "Hellp" }));
+            CHECK(!(str == lox::heap_string{ "Hell" }));
+            CHECK(!(str == lox::heap_string{}));
+        }
+
+        THEN("Concatenations are made in one piece.")
+        {
+            const lox::heap_string world{ str, ", World!" };
+            CHECK(world == "Hello, World!");
+            CHECK(world.hash() ==
+                  std::hash<std::string_view>{}("Hello, World!"));
+            CHECK(lox::heap_string{ "", str } == str);
+        }
+    }
+}
+
+SCENARIO("Test ropes", "[lox++::heap_string]")
+{
+    const std::string chunk(lox::heap_string::flat_limit / 2, 'a');
+
+    GIVEN("Short concatenations")
+    {
+        const lox::heap_string str{ lox::heap_string{ chunk } +
+                                    lox::heap_string{ chunk } };
+
+        THEN("They are copied into a flat string.")
+        {
+            CHECK(!str.is_rope());
+            CHECK(str.view() == chunk + chunk);
+        }
+    }
+
+    GIVEN("A long concatenation")
+    {
+        const lox::heap_string left{ chunk + chunk };
+        const lox::heap_string str{ left + lox::heap_string{ "b" } };
+        CHECK(str.is_rope());
+        CHECK(str.size() == left.size() + 1);
+        CHECK(left.use_count() == 2);
+
+        THEN("It is flattened when it is looked at.")
+        {
+            const lox::heap_string copy{ str };
+            CHECK(copy == chunk + chunk + "b");
+            CHECK(!str.is_rope());
+            CHECK(str.view().data() == copy.view().data());
+            // The pieces are dropped.
+            CHECK(left.use_count() == 1);
+            CHECK(str.hash() ==
+                  std::hash<std::string_view>{}(chunk + chunk + "b"));
+        }
+
+        THEN("It is compared by its characters.")
+        {
+            CHECK(str == lox::heap_string{ chunk + chunk + "b" });
+            CHECK(!(str == left + lox::heap_string{ "c" }));
+        }
+    }
+
+    GIVEN("A string that is appended to in a loop")
+    {
+        constexpr std::size_t s_appends{ 100'000 };
+        const lox::heap_string piece{ "x" };
+        lox::heap_string str{};
+        lox::heap_string prepended{};
+        for (std::size_t i = 0; i < s_appends; ++i) {
+            str = str + piece;
+            prepended = piece + prepended;
+        }
+
+        THEN("It has all the characters.")
+        {
+            CHECK(str.is_rope());
+            CHECK(str.size() == s_appends);
+            CHECK(str == std::string(s_appends, 'x'));
+            CHECK(prepended == str);
+        }
+
+        THEN("Deep ropes are freed without recursing.")
+        {
+            str = {};
+            prepended = {};
+            CHECK(piece.use_count() == 1);
+        }
+    }
+}
+
+SCENARIO("Test strings in the interpreter", "[lox++::heap_string]")
+{
+    GIVEN("Variables that hold the same string")
+    {
+        const auto statements = lox::parse(
+          lox::scan_tokens("var a = \"ab\" + \"cd\"; var b = a; b;").tokens);
+        REQUIRE(statements.size() == 3);
+
+        lox::environment env{};
+        std::vector<lox::object> results{};
+        for (const auto& statement : statements) {
+            lox::interpret(statement, env)
+              .and_then([&results](auto result) { results.push_back(result); })
+              .or_else([](auto) { CHECK(false); });
+        }
+
+        THEN("Reading and assigning them does not copy the characters.")
+        {
+            REQUIRE(results.size() == 3);
+            const auto& result = std::get<lox::heap_string>(results.back());
+            CHECK(result == "abcd");
+            // a, b and the result of each statement.
+            CHECK(result.use_count() == 5);
+        }
+    }
+
+    GIVEN("Strings that are printed")
+    {
+        const lox::object str{ lox::heap_string{ "printed" } };
+        const lox::object printed{ lox::ops::print(str) };
+
+        THEN("The result is the same string.")
+        {
+            CHECK(std::get<lox::heap_string>(printed).use_count() == 2);
+        }
+    }
+
+    GIVEN("Strings that are made at run time")
+    {
+        THEN("They are truthy unless they are empty.")
+        {
+            CHECK(lox::ops::is_truthy(lox::ops::concatenate(
+              lox::object{ lox::heap_string{ "a" } }, lox::object{ 1.0 })));
+            CHECK(!lox::ops::is_truthy(
+              lox::ops::concatenate(lox::object{ lox::heap_string{} },
+                lox::object{ lox::heap_string{} })));
+        }
+    }
+}
@@ -0,0 +1,269 @@
+#include "parser.h"
+#include "scanner.h"
+#include "ast_printer.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+[[nodiscard]] std::string edit_text(std::string_view text,
+  const lox::text_edit& edit)
+{
+    std::string edited{ text };
+    edited.replace(edit.offset, edit.removed, edit.inserted);
+    return edited;
+}
+
+/*!
+ * Prints everything about the tokens of a statement, including where they
+ * point to.
+ */
+struct token_printer {
+    std::string_view source;
+    std::ostream& os;
+
+    void operator()(const lox::token& tkn) const
+    {
+        CHECK(tkn.lexeme.data() >= source.data());
+        CHECK(tkn.lexeme.data() + tkn.lexeme.size() <=
+              source.data() + source.size());
+        os << tkn.lexeme << '@' << tkn.line << ':' << tkn.column_start << '-'
+           << tkn.column_end << '[' << tkn.line_str << "] ";
+    }
+
+    void operator()(const lox::object& value) const
+    {
+        os << value << ' ';
+    }
+
+    void operator()(lox::slot_index slot) const
+    {
+        os << slot << ' ';
+    }
+
+    void operator()(const lox::copyable<lox::expr*>& child) const
+    {
+        if (child) {
+            std::visit(*this, static_cast<const lox::expr&>(*child));
+        }
+    }
+
+    void operator()(std::monostate /* empty */) const {}
+
+    template<typename Node>
+        requires(!std::is_same_v<Node, lox::stmt>)
+    void operator()(const Node& node) const
+    {
+        lox::for_each_field(node, *this);
+    }
+
+    void operator()(const lox::stmt& statement) const
+    {
+        os << statement << ' ';
+        std::visit(*this, statement);
+    }
+};
+
+[[nodiscard]] std::string print_tokens(const lox::token_list& tokens)
+{
+    std::stringstream ss;
+    for (std::size_t index = 0; index < tokens.size(); ++index) {
+        const lox::compact_token& tkn = tokens.compact[index];
+        ss << tkn.offset << ':' << tkn.length << ':' << tkn.literal << ' '
+           << tokens[index] << '\n';
+    }
+
+    return ss.str();
+}
+
+[[nodiscard]] std::string print(const lox::parse_result& result,
+  std::string_view source)
+{
+    std::stringstream ss;
+    ss << print_tokens(result.scan.tokens) << print_tokens(result.scan.trivia);
+    for (const auto& error : result.scan.errors) {
+        ss << static_cast<int>(error.type) << '@' << error.line << '\n';
+    }
+
+    for (const std::size_t start : result.statement_starts) {
+        ss << start << ' ';
+    }
+
+    ss << '\n';
+    const token_printer printer{ source, ss };
+    for (const lox::stmt& statement : result.statements) {
+        printer(statement);
+        ss << '\n';
+    }
+
+    return ss.str();
+}
+
+/*!
+ * Keeps the errors that a lot of random edits cause out of the test output.
+ */
+class silence_errors {
+public:
+    silence_errors()
+      : m_previous{ std::cerr.rdbuf(m_sink.rdbuf()) }
+    {
+    }
+
+    ~silence_errors()
+    {
+        std::cerr.rdbuf(m_previous);
+    }
+
+private:
+    std::stringstream m_sink{};
+    std::streambuf* m_previous;
+};
+}
+
+SCENARIO("Test incremental parsing", "[lox++::incremental]")
+{
+    GIVEN("A source with many statements")
+    {
+        std::string source{};
+        for (int index = 0; index < 100; ++index) {
+            source += "var a" + std::to_string(index) + " = " +
+                      std::to_string(index) + " + \"text\";\n";
+        }
+
+        auto result = lox::parse_source(source);
+        REQUIRE(result.statements.size() == 100);
+
+        THEN("Editing one statement parses only that one again.")
+        {
+            const std::size_t offset{ source.find("a50 = 50") + 6 };
+            const lox::text_edit edit{ offset, 2, "7 * 3" };
+            const std::string edited{ edit_text(source, edit) };
+            const auto rescan = lox::rescan_tokens(result.scan, edited, edit);
+            CHECK(rescan.end - rescan.first <= 6);
+            CHECK(rescan.scan.tokens.size() ==
+                  result.scan.tokens.size() + 2);
+
+            result = lox::reparse(std::move(result), edited, edit);
+            CHECK(result.reused_statements == 99);
+            CHECK(print(result, edited) ==
+                  print(lox::parse_source(edited), edited));
+        }
+
+        THEN("Adding a line moves the lines of the following statements.")
+        {
+            const lox::text_edit edit{ 0, 0, "// header\n" };
+            const std::string edited{ edit_text(source, edit) };
+            result = lox::reparse(std::move(result), edited, edit);
+            CHECK(result.reused_statements == 100);
+            const auto& last = std::get<lox::var_stmt>(result.statements.back());
+            CHECK(last.name.lexeme == "a99");
+            CHECK(last.name.line == 100);
+            CHECK(last.name.line_str == "var a99 = 99 + \"text\";");
+            CHECK(print(result, edited) ==
+                  print(lox::parse_source(edited), edited));
+        }
+
+        THEN("Editing a token parses its statement again.")
+        {
+            const lox::text_edit edit{ source.find("a10") + 2, 0, "x" };
+            const std::string edited{ edit_text(source, edit) };
+            result = lox::reparse(std::move(result), edited, edit);
+            CHECK(result.reused_statements == 99);
+            CHECK(print(result, edited) ==
+                  print(lox::parse_source(edited), edited));
+        }
+    }
+
+    GIVEN("An edit that opens a string")
+    {
+        const std::string source{ "print 1;\nprint 2;\n" };
+        auto result = lox::parse_source(source);
+        const silence_errors silence{};
+        const lox::text_edit edit{ 6, 0, "\"" };
+        const std::string edited{ edit_text(source, edit) };
+        result = lox::reparse(std::move(result), edited, edit);
+        CHECK(result.scan.errors.size() == 1);
+        CHECK(print(result, edited) ==
+              print(lox::parse_source(edited), edited));
+
+        THEN("Closing it again brings back the statements.")
+        {
+            const lox::text_edit fix{ 6, 1, "" };
+            result = lox::reparse(std::move(result), source, fix);
+            CHECK(result.scan.errors.empty());
+            CHECK(result.statements.size() == 2);
+            CHECK(print(result, source) ==
+                  print(lox::parse_source(source), source));
+        }
+    }
+
+    GIVEN("Random edits")
+    {
+        static constexpr std::array<std::string_view, 24> s_fragments{ "",
+            " ",
+            "\n",
+            ";",
+            "var ",
+            "print ",
+            "a",
+            "bc",
+            "12",
+            "3.5",
+            ".",
+            "\"str\"",
+            "\"",
+            "+",
+            "-",
+            "*",
+            "/",
+            "=",
+            "==",
+            "(",
+            ")",
+            " ? 1 : 2",
+            "// note\n",
+            "/* block */" };
+        static constexpr std::array<std::string_view, 6> s_lines{
+            "var a = 1 + 2;\n",
+            "print a * (3 - 4);\n",
+            "a = a == 3 ? \"x\" : nil; // comment\n",
+            "var bc = \"text\" + \"more\";\n",
+            "/* multi\nline */ print bc;\n",
+            "a;\n"
+        };
+
+        const silence_errors silence{};
+        std::mt19937 random{ 20261017 };
+        for (int run = 0; run < 20; ++run) {
+            std::string source{};
+            for (int line = 0; line < 30; ++line) {
+                source += s_lines[random() % s_lines.size()];
+            }
+
+            auto result = lox::parse_source(source);
+            for (int step = 0; step < 50; ++step) {
+                const std::size_t offset{ random() % (source.size() + 1) };
+                const std::size_t removed{ std::min<std::size_t>(
+                  random() % 6, source.size() - offset) };
+                const lox::text_edit edit{ offset,
+                    removed,
+                    s_fragments[random() % s_fragments.size()] };
+                std::string edited{ edit_text(source, edit) };
+                // The previous source is gone before the result is updated.
+                source.clear();
+                source.shrink_to_fit();
+
+                result = lox::reparse(std::move(result), edited, edit);
+                source = std::move(edited);
+                const auto expected = lox::parse_source(source);
+                REQUIRE(print(result, source) == print(expected, source));
+            }
+        }
+    }
+}
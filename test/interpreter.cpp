@@ -1,12 +1,16 @@
 #include "interpreter.h"
 #include "environment.h"
 
+#include "compiler.h"
 #include "parser.h"
+#include "resolver.h"
 #include "scanner.h"
 
 #include <catch2/catch_test_macros.hpp>
 
 #include <optional>
+#include <string>
+#include <string_view>
 
 SCENARIO("Test Interpreter", "[lox++::interpreter]")
 {
@@ -89,7 +93,7 @@ SCENARIO("Test Interpreter", "[lox++::interpreter]")
             lox::environment env{};
             lox::interpret(statements.front(), env)
               .and_then([](auto result) {
-                  CHECK(std::get<std::string>(result) == "5");
+                  CHECK(std::get<lox::heap_string>(result) == "5");
               })
               .or_else([](auto) { CHECK(false); });
         }
@@ -117,9 +121,394 @@ SCENARIO("Test Interpreter", "[lox++::interpreter]")
         {
             lox::interpret(statements.at(2), env)
               .and_then([](auto result) {
-                  CHECK(std::get<std::string>(result) == "32");
+                  CHECK(std::get<lox::heap_string>(result) == "32");
               })
               .or_else([](auto) { CHECK(false); });
         }
     }
+
+    GIVEN("Test ternary operator")
+    {
+        const auto statements = lox::parse(
+          lox::scan_tokens("var a = 3; a > 2 ? \"big\" : \"small\";").tokens);
+        CHECK(statements.size() == 2);
+
+        lox::environment env{};
+        lox::interpret(statements.at(0), env)
+          .and_then([](auto result) { CHECK(std::get<double>(result) == 3); })
+          .or_else([](auto) { CHECK(false); });
+        lox::interpret(statements.at(1), env)
+          .and_then([](auto result) {
+              CHECK(std::get<lox::heap_string>(result) == "big");
+          })
+          .or_else([](auto) { CHECK(false); });
+    }
+
+    GIVEN("Test that the VM and the tree walker agree")
+    {
+        const auto statements =
+          lox::parse(lox::scan_tokens("var a = 2 * 3 - 1;"
+                                      "var b;"
+                                      "b = a / 2;"
+                                      "-b;"
+                                      "\"a = \" + a;"
+                                      "a >= 5 == true;"
+                                      "a < 1 ? 1 : a > 4 ? 2 : 3;"
+                                      "print a + b;")
+                       .tokens);
+        CHECK(statements.size() == 8);
+
+        lox::environment vm_env{};
+        lox::environment tree_env{};
+        for (const auto& statement : statements) {
+            const auto vm_result =
+              lox::interpret(statement, vm_env, lox::engine::vm)
+                .and_then([](lox::object result) -> std::optional<lox::object> {
+                    return result;
+                })
+                .or_else([](auto) -> std::optional<lox::object> { return {}; });
+            const auto tree_result =
+              lox::interpret(statement, tree_env, lox::engine::tree_walker)
+                .and_then([](lox::object result) -> std::optional<lox::object> {
+                    return result;
+                })
+                .or_else([](auto) -> std::optional<lox::object> { return {}; });
+
+            REQUIRE(vm_result.has_value());
+            REQUIRE(tree_result.has_value());
+            CHECK(vm_result.value() == tree_result.value());
+        }
+    }
+
+    GIVEN("Test runtime errors on the VM")
+    {
+        const auto statements =
+          lox::parse(lox::scan_tokens("print undefined; -\"a\";").tokens);
+        CHECK(statements.size() == 2);
+
+        lox::environment env{};
+        for (const auto& statement : statements) {
+            lox::interpret(statement, env, lox::engine::vm)
+              .and_then([](auto) { CHECK(false); })
+              .or_else([](auto) { CHECK(true); });
+        }
+    }
+
+    GIVEN("Test operands that do not fit in 16 bits on the VM")
+    {
+        const auto run = [](const std::string& source) {
+            const auto statements = lox::parse(lox::scan_tokens(source).tokens);
+            REQUIRE(!statements.empty());
+
+            lox::environment env{};
+            std::optional<lox::object> last{};
+            for (const auto& statement : statements) {
+                lox::interpret(statement, env, lox::engine::vm)
+                  .and_then([&last](lox::object result) { last = result; })
+                  .or_else([](auto) { CHECK(false); });
+            }
+
+            return last;
+        };
+
+        {
+            // The jump over the first branch is longer than 64 KiB.
+            std::string source{ "var x = 0; x >= 1 ? (1" };
+            for (int i = 0; i < 15'000; ++i) {
+                source += " + 1";
+            }
+            source += ") : 7;";
+
+            const auto result = run(source);
+            REQUIRE(result.has_value());
+            CHECK(std::get<double>(*result) == 7);
+        }
+
+        {
+            // More than 64K constants and operator tokens.
+            std::string source{ "0" };
+            for (int i = 1; i < 70'000; ++i) {
+                source += " + " + std::to_string(i);
+            }
+            source += ";";
+
+            const auto result = run(source);
+            REQUIRE(result.has_value());
+            CHECK(std::get<double>(*result) == 2449965000.0);
+        }
+    }
+
+    GIVEN("Test the chunk that the VM keeps in the statement")
+    {
+        const auto declare = [](std::string_view source,
+                               lox::environment& env) {
+            auto declarations = lox::parse(lox::scan_tokens(source).tokens);
+            lox::resolve(declarations, env);
+            for (const auto& declaration : declarations) {
+                CHECK(lox::interpret(declaration, env).has_value());
+            }
+        };
+
+        lox::environment env{};
+        declare("var a = 1;", env);
+        auto statements = lox::parse(lox::scan_tokens("a = a + 1;").tokens);
+        lox::resolve(statements, env);
+        const lox::stmt& statement = statements.front();
+        CHECK(lox::interpret(statement, env).has_value());
+        const lox::chunk* compiled{ lox::cached_chunk(statement) };
+        REQUIRE(compiled != nullptr);
+
+        THEN("Later runs reuse the chunk.")
+        {
+            const auto result = lox::interpret(statement, env);
+            REQUIRE(result.has_value());
+            CHECK(std::get<double>(result.value()) == 3);
+            CHECK(lox::cached_chunk(statement) == compiled);
+        }
+
+        THEN("A copy of the statement compiles its own chunk.")
+        {
+            const lox::stmt copy{ statement };
+            CHECK(lox::cached_chunk(copy) != compiled);
+            const auto result = lox::interpret(copy, env);
+            REQUIRE(result.has_value());
+            CHECK(std::get<double>(result.value()) == 3);
+        }
+
+        THEN("Resolving it to other slots compiles it again.")
+        {
+            lox::environment other{};
+            declare("var b = 10; var a = 1;", other);
+            lox::resolve(statements, other);
+            const auto result = lox::interpret(statement, other);
+            REQUIRE(result.has_value());
+            CHECK(std::get<double>(result.value()) == 2);
+            const lox::slot_index slot{ lox::env::find(other, "b") };
+            CHECK(std::get<double>(other.values[slot]) == 10);
+        }
+    }
+
+    GIVEN("Test that the closures and the tree walker agree")
+    {
+        auto statements =
+          lox::parse(lox::scan_tokens("var a = 2 * 3 - 1;"
+                                      "var b;"
+                                      "b = a / 2;"
+                                      "-b;"
+                                      "!a;"
+                                      "!true;"
+                                      "!nil;"
+                                      "!\"s\";"
+                                      "\"a = \" + a;"
+                                      "a + 0.5 <= 5.5 != false;"
+                                      "a >= 5 == true;"
+                                      "a < 1 ? 1 : a > 4 ? 2 : 3;"
+                                      "a > 9 ? 1 : nil;"
+                                      "(a - 1) * (b + 1) / 2;"
+                                      "print a + b;")
+                       .tokens);
+        CHECK(statements.size() == 15);
+
+        const auto run_all = [&statements](lox::environment& closure_env,
+                               lox::environment& tree_env) {
+            for (const auto& statement : statements) {
+                const auto closure_result =
+                  lox::interpret(statement, closure_env, lox::engine::closure)
+                    .and_then(
+                      [](lox::object result) -> std::optional<lox::object> {
+                          return result;
+                      })
+                    .or_else(
+                      [](auto) -> std::optional<lox::object> { return {}; });
+                const auto tree_result =
+                  lox::interpret(statement, tree_env, lox::engine::tree_walker)
+                    .and_then(
+                      [](lox::object result) -> std::optional<lox::object> {
+                          return result;
+                      })
+                    .or_else(
+                      [](auto) -> std::optional<lox::object> { return {}; });
+
+                REQUIRE(closure_result.has_value());
+                REQUIRE(tree_result.has_value());
+                CHECK(closure_result.value() == tree_result.value());
+            }
+        };
+
+        {
+            lox::environment closure_env{};
+            lox::environment tree_env{};
+            run_all(closure_env, tree_env);
+        }
+
+        {
+            lox::environment closure_env{};
+            lox::environment tree_env{};
+            lox::resolve(statements, closure_env);
+            lox::resolve(statements, tree_env);
+            run_all(closure_env, tree_env);
+        }
+    }
+
+    GIVEN("Test the inline caches of unresolved variables")
+    {
+        const auto statements = lox::parse(
+          lox::scan_tokens("var a = 1; a = a + a; var b = 2; c; var c = 3; c;")
+            .tokens);
+        CHECK(statements.size() == 6);
+
+        const auto run = [&statements](lox::environment& env, std::size_t i) {
+            return lox::interpret(statements[i], env, lox::engine::tree_walker)
+              .and_then([](lox::object result) -> std::optional<lox::object> {
+                  return result;
+              })
+              .or_else([](auto) -> std::optional<lox::object> { return {}; });
+        };
+
+        lox::environment env{};
+        REQUIRE(run(env, 0).has_value());
+        CHECK(std::get<double>(run(env, 1).value()) == 2);
+
+        THEN("The slots are looked up once.")
+        {
+            CHECK(lox::cache_stats(statements).misses == 3);
+            CHECK(lox::cache_stats(statements).hits == 0);
+            CHECK(std::get<double>(run(env, 1).value()) == 4);
+            CHECK(std::get<double>(run(env, 1).value()) == 8);
+            CHECK(lox::cache_stats(statements).misses == 3);
+            CHECK(lox::cache_stats(statements).hits == 6);
+        }
+
+        THEN("A new variable invalidates the caches.")
+        {
+            REQUIRE(run(env, 2).has_value());
+            CHECK(std::get<double>(run(env, 1).value()) == 4);
+            CHECK(lox::cache_stats(statements).misses == 6);
+
+            CHECK_FALSE(run(env, 3).has_value());
+            REQUIRE(run(env, 4).has_value());
+            CHECK(std::get<double>(run(env, 5).value()) == 3);
+            CHECK(lox::cache_stats(statements).misses == 8);
+        }
+
+        THEN("Another environment does not use the caches.")
+        {
+            lox::environment other{};
+            CHECK_FALSE(run(other, 1).has_value());
+            REQUIRE(run(other, 0).has_value());
+            CHECK(std::get<double>(run(other, 1).value()) == 2);
+            CHECK(std::get<double>(run(env, 1).value()) == 4);
+            CHECK(lox::cache_stats(statements).hits == 0);
+        }
+    }
+
+    GIVEN("Test runtime errors in closures")
+    {
+        const auto statements = lox::parse(
+          lox::scan_tokens("print undefined; -\"a\"; 1 / 0; nil + 1; x = 1;")
+            .tokens);
+        CHECK(statements.size() == 5);
+
+        lox::environment env{};
+        for (const auto& statement : statements) {
+            lox::interpret(statement, env, lox::engine::closure)
+              .and_then([](auto) { CHECK(false); })
+              .or_else([](auto) { CHECK(true); });
+        }
+    }
+
+    GIVEN("Test a hash-consed program")
+    {
+        const auto tokens = lox::scan_tokens("var a = (1 + 2) * (1 + 2);"
+                                             "print undefined;"
+                                             "a = a + 1; a = a + 1;"
+                                             "var b = a + 1;"
+                                             "(a + 1) * (a + 1) - b;"
+                                             "-\"a\"; -\"a\";")
+                              .tokens;
+        auto program = lox::parse_flat(tokens);
+        auto shared = lox::parse_flat(tokens, { .is_hash_consed = true });
+        REQUIRE(shared.statements.size() == program.statements.size());
+        CHECK(shared.size() < program.size());
+
+        lox::environment env{};
+        lox::environment shared_env{};
+        lox::resolve(program, env);
+        lox::resolve(shared, shared_env);
+        for (std::size_t i = 0; i < program.statements.size(); ++i) {
+            const auto result =
+              lox::interpret(program, program.statements[i], env)
+                .and_then([](lox::object result) -> std::optional<lox::object> {
+                    return result;
+                })
+                .or_else([](auto) -> std::optional<lox::object> { return {}; });
+            const auto shared_result =
+              lox::interpret(shared, shared.statements[i], shared_env)
+                .and_then([](lox::object result) -> std::optional<lox::object> {
+                    return result;
+                })
+                .or_else([](auto) -> std::optional<lox::object> { return {}; });
+
+            REQUIRE(result.has_value() == shared_result.has_value());
+            if (result) {
+                CHECK(result.value() == shared_result.value());
+            }
+        }
+
+        CHECK(std::get<double>(shared_env.values.front()) == 11);
+    }
+
+    GIVEN("Test the flat representation")
+    {
+        const auto tokens = lox::scan_tokens("var a = 2 * 3 - 1;"
+                                             "var b;"
+                                             "b = a / 2;"
+                                             "-b;"
+                                             "\"a = \" + a;"
+                                             "a >= 5 == true;"
+                                             "a < 1 ? 1 : a > 4 ? 2 : 3;"
+                                             "print a + b;")
+                              .tokens;
+        const auto statements = lox::parse(tokens);
+        auto program = lox::parse_flat(tokens);
+        REQUIRE(program.statements.size() == statements.size());
+
+        lox::environment tree_env{};
+        lox::environment flat_env{};
+        lox::resolve(program, flat_env);
+        for (std::size_t i = 0; i < statements.size(); ++i) {
+            const auto tree_result =
+              lox::interpret(statements[i], tree_env, lox::engine::tree_walker)
+                .and_then([](lox::object result) -> std::optional<lox::object> {
+                    return result;
+                })
+                .or_else([](auto) -> std::optional<lox::object> { return {}; });
+            const auto flat_result =
+              lox::interpret(program, program.statements[i], flat_env)
+                .and_then([](lox::object result) -> std::optional<lox::object> {
+                    return result;
+                })
+                .or_else([](auto) -> std::optional<lox::object> { return {}; });
+
+            REQUIRE(tree_result.has_value());
+            REQUIRE(flat_result.has_value());
+            CHECK(tree_result.value() == flat_result.value());
+        }
+
+        const auto copy = program;
+        program.clear();
+        CHECK(program.size() == 0);
+        CHECK(copy.statements.size() == statements.size());
+        lox::interpret(copy, copy.statements.at(2), flat_env)
+          .and_then([](auto result) { CHECK(std::get<double>(result) == 2.5); })
+          .or_else([](auto) { CHECK(false); });
+
+        const auto errors = lox::parse_flat(
+          lox::scan_tokens("print undefined; -\"a\"; 1 / 0;").tokens);
+        for (const auto statement : errors.statements) {
+            lox::interpret(errors, statement, flat_env)
+              .and_then([](auto) { CHECK(false); })
+              .or_else([](auto) { CHECK(true); });
+        }
+    }
 }
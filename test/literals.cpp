@@ -0,0 +1,86 @@
+#include "literals.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <string>
+
+using token_type = lox::token::token_type;
+
+SCENARIO("Test literal decoding", "[lox++::literals]")
+{
+    GIVEN("Keywords and identifiers")
+    {
+        CHECK(lox::literals::classify_identifier("and") == token_type::AND);
+        CHECK(lox::literals::classify_identifier("class") == token_type::CLASS);
+        CHECK(lox::literals::classify_identifier("else") == token_type::ELSE);
+        CHECK(lox::literals::classify_identifier("false") == token_type::FALSE);
+        CHECK(lox::literals::classify_identifier("for") == token_type::FOR);
+        CHECK(lox::literals::classify_identifier("fun") == token_type::FUN);
+        CHECK(lox::literals::classify_identifier("if") == token_type::IF);
+        CHECK(lox::literals::classify_identifier("nil") == token_type::NIL);
+        CHECK(lox::literals::classify_identifier("or") == token_type::OR);
+        CHECK(lox::literals::classify_identifier("print") == token_type::PRINT);
+        CHECK(lox::literals::classify_identifier("super") == token_type::SUPER);
+        CHECK(lox::literals::classify_identifier("this") == token_type::THIS);
+        CHECK(lox::literals::classify_identifier("true") == token_type::TRUE);
+        CHECK(lox::literals::classify_identifier("var") == token_type::VAR);
+        CHECK(lox::literals::classify_identifier("while") == token_type::WHILE);
+
+        for (const auto* text :
+          { "a", "an", "ands", "klass", "Print", "whilee", "fo", "vars" }) {
+            CHECK(lox::literals::classify_identifier(text) ==
+                  token_type::IDENTIFIER);
+        }
+    }
+
+    GIVEN("Numbers")
+    {
+        CHECK(lox::literals::parse_number("0") == 0);
+        CHECK(lox::literals::parse_number("1234") == 1234);
+        CHECK(lox::literals::parse_number("1234.5") == 1234.5);
+        CHECK(lox::literals::parse_number("0.1") == 0.1);
+        CHECK(std::isinf(lox::literals::parse_number(std::string(400, '9'))));
+        CHECK(lox::literals::parse_number(
+                "0." + std::string(400, '0') + "1") == 0);
+        CHECK(lox::literals::parse_number(
+                "000." + std::string(320, '0') + "1") > 0);
+    }
+
+    GIVEN("Repeated literals")
+    {
+        const auto result =
+          lox::scan_tokens("print 1; print \"a\"; print 1; print \"a\"; 2;");
+        const auto& tokens = result.tokens.compact;
+        REQUIRE(tokens.size() == 15);
+
+        THEN("Identical literals share the same index.")
+        {
+            CHECK(tokens[1].literal == tokens[7].literal);
+            CHECK(tokens[4].literal == tokens[10].literal);
+            CHECK(tokens[1].literal != tokens[4].literal);
+            CHECK(tokens[12].literal != tokens[1].literal);
+            CHECK(result.tokens.info->literals.size() == 3);
+        }
+
+        THEN("The values are kept.")
+        {
+            CHECK(std::get<double>(result.tokens[7].literal) == 1);
+            CHECK(std::get<lox::heap_string>(result.tokens[10].literal) == "a");
+            CHECK(std::get<double>(result.tokens[12].literal) == 2);
+        }
+    }
+
+    GIVEN("Thousands of distinct literals")
+    {
+        std::string source{};
+        for (int i = 0; i < 10'000; ++i) {
+            source += std::to_string(i) + "; \"" + std::to_string(i) + "\";\n";
+        }
+
+        const auto result = lox::scan_tokens(source);
+        CHECK(result.tokens.info->literals.size() == 20'000);
+        CHECK(std::get<double>(result.tokens[4 * 9'999].literal) == 9'999);
+    }
+}
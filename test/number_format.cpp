@@ -0,0 +1,111 @@
+#include "number_format.h"
+
+#include "environment.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+[[nodiscard]] std::string format(double number)
+{
+    lox::number_buffer buffer{};
+    return std::string{ lox::format_number(number, buffer) };
+}
+}
+
+SCENARIO("Test number formatting", "[lox++::number_format]")
+{
+    GIVEN("Integers")
+    {
+        CHECK(format(0) == "0");
+        CHECK(format(-0.0) == "-0");
+        CHECK(format(3) == "3");
+        CHECK(format(-42) == "-42");
+        CHECK(format(1234567) == "1234567");
+        CHECK(format(100000000) == "100000000");
+        CHECK(format(9007199254740991.0) == "9007199254740991");
+        CHECK(format(1e21) == "1e+21");
+    }
+
+    GIVEN("Fractions")
+    {
+        CHECK(format(0.1) == "0.1");
+        CHECK(format(2.5) == "2.5");
+        CHECK(format(0.1 + 0.2) == "0.30000000000000004");
+        CHECK(format(1.0 / 3) == "0.3333333333333333");
+        CHECK(format(123456.789) == "123456.789");
+        CHECK(format(1e-7) == "1e-07");
+    }
+
+    GIVEN("Special values")
+    {
+        CHECK(format(std::numeric_limits<double>::infinity()) == "inf");
+        CHECK(format(-std::numeric_limits<double>::infinity()) == "-inf");
+        CHECK(format(std::numeric_limits<double>::quiet_NaN()) == "nan");
+        CHECK(format(-std::numeric_limits<double>::quiet_NaN()) == "nan");
+    }
+
+    GIVEN("Any finite number")
+    {
+        THEN("The text reads back as the same number.")
+        {
+            std::mt19937_64 random{ 42 };
+            for (int i = 0; i < 10'000; ++i) {
+                const double number{ std::bit_cast<double>(random()) };
+                if (!std::isfinite(number)) {
+                    continue;
+                }
+
+                const std::string text{ format(number) };
+                CHECK(std::strtod(text.c_str(), nullptr) == number);
+            }
+
+            for (const double number : { std::numeric_limits<double>::max(),
+                   std::numeric_limits<double>::lowest(),
+                   std::numeric_limits<double>::min(),
+                   -std::numeric_limits<double>::denorm_min() }) {
+                CHECK(std::strtod(format(number).c_str(), nullptr) == number);
+            }
+        }
+    }
+}
+
+SCENARIO("Test numbers in print and concatenation", "[lox++::number_format]")
+{
+    GIVEN("A script that prints and concatenates numbers")
+    {
+        const auto statements = lox::parse(lox::scan_tokens(
+          "print 1234567; print 0.1 + 0.2; \"total: \" + 2.5;")
+                                             .tokens);
+        REQUIRE(statements.size() == 3);
+
+        THEN("They are written in full.")
+        {
+            lox::environment env{};
+            std::vector<std::string> results{};
+            for (const auto& statement : statements) {
+                lox::interpret(statement, env)
+                  .and_then([&results](auto result) {
+                      results.emplace_back(
+                        std::get<lox::heap_string>(result).view());
+                  })
+                  .or_else([](auto) { CHECK(false); });
+            }
+
+            CHECK(results ==
+                  std::vector<std::string>{
+                    "1234567", "0.30000000000000004", "total: 2.5" });
+        }
+    }
+}
@@ -0,0 +1,191 @@
+#include "optimizer.h"
+
+#include "ast_printer.h"
+#include "environment.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+[[nodiscard]] std::vector<std::string> print(
+  const std::vector<lox::stmt>& statements)
+{
+    std::vector<std::string> printed{};
+    for (const auto& statement : statements) {
+        std::stringstream ss{};
+        ss << statement;
+        printed.push_back(ss.str());
+    }
+
+    return printed;
+}
+
+[[nodiscard]] std::vector<std::string> print(
+  const lox::flat::program& program)
+{
+    std::vector<std::string> printed{};
+    for (const lox::flat::node_index statement : program.statements) {
+        printed.push_back(lox::to_string(program, statement));
+    }
+
+    return printed;
+}
+
+[[nodiscard]] std::vector<std::string> optimized(std::string_view source)
+{
+    auto statements = lox::parse(lox::scan_tokens(source).tokens);
+    lox::optimize(statements);
+    return print(statements);
+}
+
+/*!
+ * Runs the statements and prints the value or the error of each.
+ */
+[[nodiscard]] std::vector<std::string> run(std::vector<lox::stmt>& statements,
+  lox::engine eng)
+{
+    std::vector<std::string> results{};
+    lox::environment env{};
+    lox::resolve(statements, env);
+    for (const auto& statement : statements) {
+        std::stringstream ss{};
+        lox::interpret(statement, env, eng)
+          .and_then([&ss](lox::object value) { ss << value; })
+          .or_else([&ss](lox::runtime_error error) {
+              ss << "error: " << error.what();
+          });
+        results.push_back(ss.str());
+    }
+
+    return results;
+}
+}
+
+SCENARIO("Test the optimizer", "[lox++::optimizer]")
+{
+    GIVEN("Constant expressions")
+    {
+        CHECK(optimized("print 2 * 3 + x * 1;") ==
+              std::vector<std::string>{ "print (+ 6 (* (var x) 1))" });
+        CHECK(optimized("\"a\" + \"b\"; 1 + \"b\";") ==
+              std::vector<std::string>{ "ab", "1b" });
+        CHECK(optimized("-(2 - 5); !0; !1; 1 < 2; 1 == nil;") ==
+              std::vector<std::string>{ "3", "true", "false", "true",
+                "false" });
+        CHECK(optimized("!true; !nil; !\"s\"; !\"\";") ==
+              std::vector<std::string>{ "false", "true", "false", "true" });
+        CHECK(optimized("var a = (((1)));") ==
+              std::vector<std::string>{ "var a = 1" });
+    }
+
+    GIVEN("Operations that raise an error")
+    {
+        THEN("They are left for the run.")
+        {
+            CHECK(optimized("1 / 0; 1 - 0; 2 * -0; -nil; nil + 1;") ==
+                  std::vector<std::string>{ "(/ 1 0)",
+                      "(- 1 0)",
+                      "(* 2 -0)",
+                      "(- null)",
+                      "(+ null 1)" });
+
+            auto statements =
+              lox::parse(lox::scan_tokens("print 4 / (2 - 2);").tokens);
+            lox::optimize(statements);
+            CHECK(print(statements) ==
+                  std::vector<std::string>{ "print (/ 4 0)" });
+            CHECK(run(statements, lox::engine::tree_walker) ==
+                  std::vector<std::string>{ "error: Division by zero." });
+        }
+    }
+
+    GIVEN("Algebraic identities")
+    {
+        THEN("They apply to numbers.")
+        {
+            CHECK(optimized("(a - 1) * 1; -a / 1; (a * 2) + -0; -0 + -a;") ==
+                  std::vector<std::string>{ "(- (var a) 1)",
+                      "(- (var a))",
+                      "(* (var a) 2)",
+                      "(- (var a))" });
+        }
+
+        THEN("They do not apply to operands that may not be numbers.")
+        {
+            CHECK(optimized("a * 1; a + -0; (a + 1) * 1; 1 * (a - 1);") ==
+                  std::vector<std::string>{ "(* (var a) 1)",
+                      "(+ (var a) -0)",
+                      "(* (+ (var a) 1) 1)",
+                      "(* 1 (- (var a) 1))" });
+        }
+    }
+
+    GIVEN("Ternaries with a constant condition")
+    {
+        CHECK(optimized("true ? a : b; nil ? a : b; 1 > 2 ? a;") ==
+              std::vector<std::string>{ "(var a)", "(var b)", "" });
+        CHECK(optimized("a ? 1 + 1 : 2;") ==
+              std::vector<std::string>{ "(var a) ? 2 : 2" });
+    }
+
+    GIVEN("Programs that are run with and without optimizations")
+    {
+        const std::vector<std::string_view> sources{
+            "var a = 2 * 3 + 4; var b = a * 1 - -0; print a / b;",
+            "var s = \"x\" + 1.5; print s + (s ? \"y\" : \"z\");",
+            "var n = 1 / 0;",
+            "var a = 3; a = (a - 1) * 1 + -0; print -a / 1;",
+            "var b = true ? (1 < 2) : nil; print !(b == true ? 0 : 1);",
+            "var c = 0 * 1; print c; print 2 - 2 > 0;",
+            "var d = -0 + (5 - 2); d = d * 1 / 1; d;",
+            "print 1 == 1 ? \"a\" + \"b\" : \"c\";",
+            "var e = (1 + 2) * (3 - 4) / (5 * 6); e + e * 1;",
+        };
+
+        for (const std::string_view source : sources) {
+            const auto tokens = lox::scan_tokens(source).tokens;
+            for (const lox::engine eng :
+              { lox::engine::tree_walker,
+                lox::engine::vm,
+                lox::engine::closure }) {
+                auto original = lox::parse(tokens);
+                auto statements = lox::parse(tokens);
+                lox::optimize(statements);
+                CHECK(run(statements, eng) == run(original, eng));
+            }
+
+            auto program = lox::parse_flat(tokens);
+            lox::optimize(program);
+            auto statements = lox::parse(tokens);
+            lox::optimize(statements);
+            CHECK(print(program) == print(statements));
+        }
+    }
+
+    GIVEN("A hash-consed program")
+    {
+        auto program =
+          lox::parse_flat(lox::scan_tokens("(a - 1) * 1; (a - 1) * 1;").tokens,
+            lox::parse_options{ .is_hash_consed = true });
+        lox::optimize(program);
+        REQUIRE(program.statements.size() == 2);
+
+        THEN("Shared nodes stay shared.")
+        {
+            const auto& first = program.get_expr_stmt(program.statements[0]);
+            const auto& second = program.get_expr_stmt(program.statements[1]);
+            CHECK(first.expression == second.expression);
+            CHECK(lox::to_string(program, first.expression) ==
+                  "(- (var a) 1)");
+            CHECK(lox::report_sharing(program).unique_nodes == 5);
+        }
+    }
+}
@@ -1,12 +1,42 @@
 #include "parser.h"
 #include "scanner.h"
+#include "ast_printer.h"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <iostream>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 using namespace lox;
 
+namespace {
+/*!
+ * Returns what `func` logs to std::cerr.
+ */
+template<typename Func>
+[[nodiscard]] std::string capture_errors(Func&& func)
+{
+    std::stringstream sink{};
+    std::streambuf* previous{ std::cerr.rdbuf(sink.rdbuf()) };
+    func();
+    std::cerr.rdbuf(previous);
+    return sink.str();
+}
+
+[[nodiscard]] std::vector<std::string> print(const flat::program& program)
+{
+    std::vector<std::string> printed{};
+    for (const flat::node_index statement : program.statements) {
+        printed.push_back(to_string(program, statement));
+    }
+
+    return printed;
+}
+}
+
 SCENARIO("Test AST", "[lox++::parser]")
 {
     GIVEN("Test semicolon requirement.")
@@ -15,6 +45,12 @@ SCENARIO("Test AST", "[lox++::parser]")
         CHECK(statements.size() == 1);
     }
 
+    GIVEN("Errors after the last token.")
+    {
+        CHECK(parse(scan_tokens("print (").tokens).size() == 1);
+        CHECK(parse(scan_tokens("1 ? 2").tokens).size() == 1);
+    }
+
     GIVEN("Simple ternary operator.")
     {
         const auto statements = parse(scan_tokens("1 ? 2 : 3;").tokens);
@@ -116,4 +152,207 @@ SCENARIO("Test AST", "[lox++::parser]")
         const auto variable = std::get<lox::variable>(*print.expression);
         CHECK(variable.name.lexeme == "a");
     }
+
+    GIVEN("Tokens from a stream.")
+    {
+        token_stream tokens{ "var a = 1 + 2; print a ? \"yes\" : \"no\";" };
+        const auto statements = parse(tokens);
+        CHECK(tokens.peek().type == token::token_type::END_OF_FILE);
+        REQUIRE(statements.size() == 2);
+
+        const auto var = std::get<lox::var_stmt>(statements.at(0));
+        CHECK(var.name.lexeme == "a");
+        CHECK(var.name.line_str == "var a = 1 + 2; print a ? \"yes\" : \"no\";");
+        CHECK(std::get<lox::binary>(*var.expression).oprtor.type ==
+              token::token_type::PLUS);
+
+        const auto print = std::get<lox::print_stmt>(statements.at(1));
+        CHECK(std::holds_alternative<lox::ternary>(*print.expression));
+    }
+
+    GIVEN("A flat program.")
+    {
+        const auto program =
+          parse_flat(scan_tokens("var a = 1 + 2; print a ? \"yes\" : \"no\";"
+                                 "a = (a);")
+                       .tokens);
+        REQUIRE(program.statements.size() == 3);
+        CHECK(program.size() == 14);
+
+        const auto& var = program.get_var_stmt(program.statements.at(0));
+        CHECK(var.name.lexeme == "a");
+        REQUIRE(program.kind(var.expression) == flat::node_kind::BINARY);
+        const auto& sum = program.get_binary(var.expression);
+        CHECK(sum.oprtor.type == token::token_type::PLUS);
+        CHECK(std::get<double>(program.get_literal(sum.left).value) == 1);
+        CHECK(std::get<double>(program.get_literal(sum.right).value) == 2);
+
+        const auto& print = program.get_print_stmt(program.statements.at(1));
+        REQUIRE(program.kind(print.expression) == flat::node_kind::TERNARY);
+        CHECK(program.get_ternary(print.expression).third != flat::no_node);
+
+        const auto& assign = program.get_expr_stmt(program.statements.at(2));
+        REQUIRE(program.kind(assign.expression) == flat::node_kind::ASSIGNMENT);
+        CHECK(program.kind(program.get_assignment(assign.expression).value) ==
+              flat::node_kind::GROUPING);
+
+        THEN("Children are added before their parents.")
+        {
+            for (const auto statement : program.statements) {
+                program.visit(statement, [statement](const auto& node) {
+                    if constexpr (requires { node.expression; }) {
+                        CHECK(node.expression < statement);
+                    }
+                });
+            }
+        }
+    }
+
+    GIVEN("A hash-consed program.")
+    {
+        const auto tokens = scan_tokens("var a = (1 + 2) * (1 + 2);"
+                                        "print (1 + 2) * (1 + 2);"
+                                        "a = -a; b = -a;")
+                              .tokens;
+        const auto tree = parse(tokens);
+        const auto program = parse_flat(tokens);
+        const auto shared =
+          parse_flat(tokens, parse_options{ .is_hash_consed = true });
+        REQUIRE(shared.statements.size() == 4);
+        CHECK(program.size() == 30);
+        CHECK(shared.size() == 14);
+
+        const auto& var = shared.get_var_stmt(shared.statements.at(0));
+        const auto& product = shared.get_binary(var.expression);
+        CHECK(product.left == product.right);
+        CHECK(shared.get_print_stmt(shared.statements.at(1)).expression ==
+              var.expression);
+
+        const auto& first = shared.get_expr_stmt(shared.statements.at(2));
+        const auto& second = shared.get_expr_stmt(shared.statements.at(3));
+        CHECK(first.expression != second.expression);
+        CHECK(shared.get_assignment(first.expression).value ==
+              shared.get_assignment(second.expression).value);
+
+        THEN("The shared program prints like the tree.")
+        {
+            for (std::size_t i = 0; i < tree.size(); ++i) {
+                std::stringstream expected{};
+                expected << tree[i];
+                CHECK(to_string(shared, shared.statements[i]) ==
+                      expected.str());
+                CHECK(to_string(program, program.statements[i]) ==
+                      expected.str());
+            }
+        }
+
+        THEN("The report counts the nodes of the tree.")
+        {
+            const sharing_report unshared_report{ report_sharing(program) };
+            CHECK(unshared_report.tree_nodes == 28);
+            CHECK(unshared_report.unique_nodes == 28);
+            CHECK(unshared_report.ratio() == 1);
+
+            const sharing_report report{ report_sharing(shared) };
+            CHECK(report.tree_nodes == 28);
+            CHECK(report.unique_nodes == 13);
+            CHECK(report.ratio() == 28.0 / 13.0);
+        }
+
+        THEN("Only the operands are shared between different operations.")
+        {
+            const auto operations =
+              parse_flat(scan_tokens("a + b; a - b; b + a; \"a\" + b;").tokens,
+                parse_options{ .is_hash_consed = true });
+            CHECK(operations.size() == 11);
+        }
+    }
+
+    GIVEN("A source that is parsed in parallel.")
+    {
+        std::string source{};
+        for (int i = 0; i < 200; ++i) {
+            const std::string index{ std::to_string(i) };
+            source += "var a" + index + " = (1 + " + index + ") * 2;\n";
+            source += "print a" + index + " ? \"s\" : (a" + index + " - 1);\n";
+            if (i % 37 == 5) {
+                // Runs into the next declaration.
+                source += "print (1;\n";
+            }
+            if (i % 53 == 7) {
+                source += "1 = 2;\n";
+            }
+            if (i % 5 == 3) {
+                // Takes the `var` of the next declaration.
+                source += "var;\n";
+            }
+        }
+
+        const auto tokens = scan_tokens(source).tokens;
+        // The segments depend on the number of threads, some of them start
+        // right after a declaration that takes the `var` of the next one.
+        const auto parallel = [](std::size_t thread_count) {
+            return parse_options{ .is_parallel = true,
+                .min_segment_size = 16,
+                .thread_count = thread_count };
+        };
+
+        THEN("The tree is the same as the sequential one.")
+        {
+            std::size_t expected_errors{ 0 };
+            std::vector<stmt> expected{};
+            const std::string expected_log{ capture_errors([&]() {
+                expected = parse(
+                  tokens, parse_options{ .error_count = &expected_errors });
+            }) };
+
+            CHECK(expected_errors == 94);
+            for (std::size_t thread_count = 2; thread_count <= 12;
+                 ++thread_count) {
+                parse_options options{ parallel(thread_count) };
+                std::size_t errors{ 0 };
+                options.error_count = &errors;
+                std::vector<stmt> statements{};
+                const std::string log{ capture_errors(
+                  [&]() { statements = parse(tokens, options); }) };
+
+                CHECK(errors == expected_errors);
+                CHECK(log == expected_log);
+                REQUIRE(statements.size() == expected.size());
+                for (std::size_t i = 0; i < statements.size(); ++i) {
+                    std::stringstream expected_ss{};
+                    std::stringstream ss{};
+                    expected_ss << expected[i];
+                    ss << statements[i];
+                    CHECK(ss.str() == expected_ss.str());
+                }
+            }
+        }
+
+        THEN("The flat program is the same as the sequential one.")
+        {
+            for (const bool is_hash_consed : { false, true }) {
+                flat::program expected{};
+                const std::string expected_log{ capture_errors([&]() {
+                    expected = parse_flat(
+                      tokens, parse_options{ .is_hash_consed = is_hash_consed });
+                }) };
+
+                for (std::size_t thread_count = 2; thread_count <= 12;
+                     ++thread_count) {
+                    parse_options options{ parallel(thread_count) };
+                    options.is_hash_consed = is_hash_consed;
+                    flat::program program{};
+                    const std::string log{ capture_errors(
+                      [&]() { program = parse_flat(tokens, options); }) };
+
+                    CHECK(log == expected_log);
+                    CHECK(program.size() == expected.size());
+                    CHECK(print(program) == print(expected));
+                    CHECK(report_sharing(program).unique_nodes ==
+                          report_sharing(expected).unique_nodes);
+                }
+            }
+        }
+    }
 }
@@ -0,0 +1,183 @@
+#include "program_cache.h"
+
+#include "ast_printer.h"
+#include "environment.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr std::string_view s_source{
+    "var text = \"a\" + \"b\";\n"
+    "var number = 1.5 * (2 - -3) / 4;\n"
+    "number = (number > 1 ? number : nil);\n"
+    "print -number == 2 - number;\n"
+    "text + \"c\";\n"
+};
+
+[[nodiscard]] std::vector<std::string> print(
+  const lox::flat::program& program)
+{
+    std::vector<std::string> printed{};
+    for (const lox::flat::node_index statement : program.statements) {
+        printed.push_back(lox::to_string(program, statement));
+    }
+
+    return printed;
+}
+
+[[nodiscard]] std::optional<lox::object> run(lox::flat::program& program)
+{
+    lox::environment env{};
+    lox::resolve(program, env);
+    std::optional<lox::object> last{};
+    for (const lox::flat::node_index statement : program.statements) {
+        lox::interpret(program, statement, env)
+          .and_then([&last](lox::object value) { last = value; })
+          .or_else([](auto) { CHECK(false); });
+    }
+
+    return last;
+}
+}
+
+SCENARIO("Test the program cache", "[lox++::program_cache]")
+{
+    GIVEN("A serialized program")
+    {
+        const auto program = lox::parse_flat(lox::scan_tokens(s_source).tokens);
+        const auto data = lox::serialize(program, s_source);
+        REQUIRE(data.has_value());
+
+        THEN("It loads back to the same program.")
+        {
+            auto loaded = lox::deserialize(data.value(), s_source);
+            REQUIRE(loaded.has_value());
+            CHECK(loaded->size() == program.size());
+            CHECK(print(loaded.value()) == print(program));
+
+            const auto last = run(loaded.value());
+            REQUIRE(last.has_value());
+            CHECK(std::get<lox::heap_string>(last.value()) == "abc");
+        }
+
+        THEN("The tokens refer to the source.")
+        {
+            const std::string copy{ s_source };
+            const auto loaded = lox::deserialize(data.value(), copy);
+            REQUIRE(loaded.has_value());
+            const auto& stmt =
+              loaded->get_var_stmt(loaded->statements.front());
+            CHECK(stmt.name.lexeme == "text");
+            CHECK(stmt.name.lexeme.data() == copy.data() + 4);
+        }
+
+        THEN("It does not load for another source.")
+        {
+            std::string other{ s_source };
+            other.back() = ' ';
+            CHECK_FALSE(lox::deserialize(data.value(), other).has_value());
+            CHECK_FALSE(lox::deserialize(data.value(), "").has_value());
+        }
+
+        THEN("Damaged data does not load.")
+        {
+            for (std::size_t size = 0; size < data->size(); ++size) {
+                CHECK_FALSE(
+                  lox::deserialize(std::string_view{ data.value() }.substr(
+                                     0, size),
+                    s_source)
+                    .has_value());
+            }
+
+            CHECK_FALSE(
+              lox::deserialize(data.value() + '\0', s_source).has_value());
+
+            std::string version{ data.value() };
+            version[8] ^= 1;
+            CHECK_FALSE(lox::deserialize(version, s_source).has_value());
+        }
+    }
+
+    GIVEN("A hash-consed program")
+    {
+        const std::string_view source{ "var a = 1; print (a + 1) * (a + 1);" };
+        auto program = lox::parse_flat(lox::scan_tokens(source).tokens,
+          lox::parse_options{ .is_hash_consed = true });
+        const auto data = lox::serialize(program, source);
+        REQUIRE(data.has_value());
+
+        THEN("The shared nodes stay shared.")
+        {
+            const auto loaded = lox::deserialize(data.value(), source);
+            REQUIRE(loaded.has_value());
+            CHECK(loaded->size() == program.size());
+            CHECK(lox::report_sharing(loaded.value()).unique_nodes ==
+                  lox::report_sharing(program).unique_nodes);
+        }
+    }
+
+    GIVEN("A program that does not point into the source")
+    {
+        const std::string source{ "1 + 2;" };
+        const std::string copy{ source };
+        const auto program = lox::parse_flat(lox::scan_tokens(source).tokens);
+        CHECK(lox::serialize(program, source).has_value());
+        CHECK_FALSE(lox::serialize(program, copy).has_value());
+    }
+
+    GIVEN("A content hash")
+    {
+        CHECK(lox::hash_content(s_source) == lox::hash_content(s_source));
+        CHECK_FALSE(lox::hash_content("a") == lox::hash_content("b"));
+        CHECK_FALSE(lox::hash_content("") ==
+                    lox::hash_content(std::string_view{ "\0", 1 }));
+        CHECK_FALSE(lox::hash_content(std::string(8, 'a')) ==
+                    lox::hash_content(std::string(9, 'a')));
+    }
+
+    GIVEN("A cache directory")
+    {
+        const auto directory =
+          std::filesystem::temp_directory_path() / "lox_program_cache_test";
+        std::filesystem::remove_all(directory);
+        const lox::program_cache cache{ directory };
+
+        CHECK_FALSE(cache.load(s_source).has_value());
+
+        const auto program = lox::parse_flat(lox::scan_tokens(s_source).tokens);
+        REQUIRE(cache.store(s_source, program));
+        CHECK(std::filesystem::exists(cache.entry_path(s_source)));
+        CHECK(std::distance(std::filesystem::directory_iterator{ directory },
+                std::filesystem::directory_iterator{}) == 1);
+
+        THEN("The entry is loaded.")
+        {
+            auto loaded = cache.load(s_source);
+            REQUIRE(loaded.has_value());
+            CHECK(print(loaded.value()) == print(program));
+        }
+
+        THEN("A damaged entry is a miss.")
+        {
+            std::ofstream{ cache.entry_path(s_source),
+                std::ofstream::binary | std::ofstream::app }
+              << 'x';
+            CHECK_FALSE(cache.load(s_source).has_value());
+
+            REQUIRE(cache.store(s_source, program));
+            CHECK(cache.load(s_source).has_value());
+        }
+
+        std::filesystem::remove_all(directory);
+    }
+}
@@ -0,0 +1,116 @@
+#include "resolver.h"
+#include "interpreter.h"
+#include "environment.h"
+
+#include "parser.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <optional>
+#include <string>
+
+SCENARIO("Test Resolver", "[lox++::resolver]")
+{
+    GIVEN("Declared variables")
+    {
+        auto statements =
+          lox::parse(lox::scan_tokens("var a = 1; var b = a; b = 2;").tokens);
+        REQUIRE(statements.size() == 3);
+
+        lox::environment env{};
+        lox::resolve(statements, env);
+
+        THEN("Every declaration gets its own slot.")
+        {
+            CHECK(std::get<lox::var_stmt>(statements.at(0)).slot == 0);
+            CHECK(std::get<lox::var_stmt>(statements.at(1)).slot == 1);
+            CHECK(env.values.size() == 2);
+        }
+
+        THEN("Uses refer to the slot of the declaration.")
+        {
+            const auto& b = std::get<lox::var_stmt>(statements.at(1));
+            CHECK(std::get<lox::variable>(*b.expression).slot == 0);
+
+            const auto& assign = std::get<lox::expr_stmt>(statements.at(2));
+            CHECK(std::get<lox::assignment>(*assign.expression).slot == 1);
+        }
+    }
+
+    GIVEN("A variable that is used before it is declared")
+    {
+        auto statements =
+          lox::parse(lox::scan_tokens("print a; var a = a;").tokens);
+        REQUIRE(statements.size() == 2);
+
+        lox::environment env{};
+        lox::resolve(statements, env);
+
+        const auto& print = std::get<lox::print_stmt>(statements.at(0));
+        CHECK(std::get<lox::variable>(*print.expression).slot ==
+              lox::unresolved_slot);
+
+        const auto& var = std::get<lox::var_stmt>(statements.at(1));
+        CHECK(std::get<lox::variable>(*var.expression).slot ==
+              lox::unresolved_slot);
+
+        for (const auto& statement : statements) {
+            lox::interpret(statement, env)
+              .and_then([](auto) { CHECK(false); })
+              .or_else([](auto) { CHECK(true); });
+        }
+    }
+
+    GIVEN("Statements that are resolved one at a time")
+    {
+        lox::environment env{};
+        for (const auto engine : { lox::engine::vm,
+               lox::engine::tree_walker,
+               lox::engine::closure }) {
+            env = {};
+            auto first =
+              lox::parse(lox::scan_tokens("var a = 1; var a = 2;").tokens);
+            lox::resolve(first, env);
+            CHECK(std::get<lox::var_stmt>(first.at(0)).slot ==
+                  std::get<lox::var_stmt>(first.at(1)).slot);
+            for (const auto& statement : first) {
+                lox::interpret(statement, env, engine)
+                  .and_then([](auto) { CHECK(true); })
+                  .or_else([](auto) { CHECK(false); });
+            }
+
+            auto second = lox::parse(lox::scan_tokens("a = a + 1;").tokens);
+            lox::resolve(second, env);
+            lox::interpret(second.front(), env, engine)
+              .and_then(
+                [](auto result) { CHECK(std::get<double>(result) == 3); })
+              .or_else([](auto) { CHECK(false); });
+        }
+    }
+
+    GIVEN("Thousands of globals")
+    {
+        std::string source{};
+        for (int i = 0; i < 5000; ++i) {
+            source += "var v" + std::to_string(i) + " = " + std::to_string(i) +
+                      ";";
+        }
+        source += "v4999 + v0;";
+
+        auto statements = lox::parse(lox::scan_tokens(source).tokens);
+        lox::environment env{};
+        lox::resolve(statements, env);
+        CHECK(env.values.size() == 5000);
+
+        std::optional<lox::object> last{};
+        for (const auto& statement : statements) {
+            lox::interpret(statement, env)
+              .and_then([&last](lox::object result) { last = result; })
+              .or_else([](auto) { CHECK(false); });
+        }
+
+        REQUIRE(last.has_value());
+        CHECK(std::get<double>(last.value()) == 4999);
+    }
+}
@@ -1,16 +1,31 @@
 #include "scanner.h"
 
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 
+#include <cstdint>
+#include <limits>
+#include <string>
 #include <string_view>
 
 using namespace lox;
 
+namespace {
+const scan_options s_sequential{};
+// Tiny chunks so that even the short sources are split at every line.
+const scan_options s_parallel{ .is_parallel = true,
+    .min_chunk_size = 1,
+    .thread_count = 4 };
+}
+
 SCENARIO("Test all the token types.", "[lox++::scanner]")
 {
+    const scan_options options = GENERATE(s_sequential, s_parallel);
+
     GIVEN("A print statement with string.")
     {
-        const auto tokens = scan_tokens("print \"Hello, World!\"").tokens;
+        const auto tokens =
+          scan_tokens("print \"Hello, World!\"", options).tokens;
         THEN("There's a print IDENTIFIER.")
         {
             auto foundIt =
@@ -33,9 +48,9 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
 
             CHECK(foundIt != tokens.cend());
             CHECK(foundIt->lexeme == "\"Hello, World!\"");
-            REQUIRE(std::holds_alternative<std::string_view>(foundIt->literal));
+            REQUIRE(std::holds_alternative<lox::heap_string>(foundIt->literal));
             CHECK(
-              std::get<std::string_view>(foundIt->literal) == "Hello, World!");
+              std::get<lox::heap_string>(foundIt->literal) == "Hello, World!");
             CHECK(foundIt->column_start == 6);
             CHECK(foundIt->column_end == 21);
         }
@@ -43,7 +58,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
 
     GIVEN("A print statement with non-fractional number.")
     {
-        const auto tokens = scan_tokens("print 1234").tokens;
+        const auto tokens = scan_tokens("print 1234", options).tokens;
         THEN("There's a NUMBER.")
         {
             auto foundIt =
@@ -61,7 +76,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
     GIVEN("A string with an unterminated quotation mark.")
     {
         using error_type = lox::scan_result::error::error_type;
-        const auto result = scan_tokens("print \"Hello, World!");
+        const auto result = scan_tokens("print \"Hello, World!", options);
         THEN("There's an error.")
         {
             CHECK(!result.errors.empty());
@@ -73,7 +88,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
 
     GIVEN("A print statement with fractional number.")
     {
-        const auto tokens = scan_tokens("print 1234.3").tokens;
+        const auto tokens = scan_tokens("print 1234.3", options).tokens;
         THEN("There's a fractional NUMBER.")
         {
             auto foundIt =
@@ -88,11 +103,20 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
         }
     }
 
+    GIVEN("A number with two fractional parts.")
+    {
+        const auto tokens = scan_tokens("1.2.3", options).tokens;
+        REQUIRE(tokens.size() == 4);
+        CHECK(tokens[0].lexeme == "1.2");
+        CHECK(tokens[1].type == token::token_type::DOT);
+        CHECK(tokens[2].lexeme == "3");
+    }
+
     GIVEN("A comment")
     {
         THEN("Single line comment is parsed.")
         {
-            const auto tokens = scan_tokens("//Hello there").tokens;
+            const auto tokens = scan_tokens("//Hello there", options).trivia;
             auto foundIt =
               std::find_if(tokens.cbegin(), tokens.cend(), [](const auto& tkn) {
                   return tkn.type == token::token_type::COMMENT;
@@ -106,7 +130,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
 
         THEN("Multi line comment is parsed.")
         {
-            const auto tokens = scan_tokens("/*Hello there*/").tokens;
+            const auto tokens = scan_tokens("/*Hello there*/", options).trivia;
             auto foundIt =
               std::find_if(tokens.cbegin(), tokens.cend(), [](const auto& tkn) {
                   return tkn.type == token::token_type::COMMENT;
@@ -122,7 +146,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
     GIVEN("A function.")
     {
         const auto tokens =
-          scan_tokens("fun add(a, b) { return a + b }").tokens;
+          scan_tokens("fun add(a, b) { return a + b }", options).tokens;
         auto foundIt = std::find_if(tokens.cbegin(),
           tokens.cend(),
           [](const auto& tkn) { return tkn.type == token::token_type::FUN; });
@@ -144,7 +168,8 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
                       "serve(who) {"
                       "print \"Enjoy your breakfast, \" + who + \".\";"
                       "}"
-                      "}")
+                      "}",
+                      options)
             .tokens;
         auto foundIt = std::find_if(tokens.cbegin(),
           tokens.cend(),
@@ -158,7 +183,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
 
     GIVEN("A ternary operator.")
     {
-        const auto tokens = scan_tokens("true ? false : true").tokens;
+        const auto tokens = scan_tokens("true ? false : true", options).tokens;
         auto foundIt =
           std::find_if(tokens.cbegin(), tokens.cend(), [](const auto& tkn) {
               return tkn.type == token::token_type::QUESTION_MARK;
@@ -183,7 +208,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
 
     GIVEN("A print statement with a number and semicolon.")
     {
-        const auto tokens = scan_tokens("print 32;").tokens;
+        const auto tokens = scan_tokens("print 32;", options).tokens;
 
         auto foundIt = tokens.begin();
         CHECK(foundIt->type == token::token_type::PRINT);
@@ -200,7 +225,8 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
 
     GIVEN("A print statement with a string and semicolon.")
     {
-        const auto tokens = scan_tokens("print \"Hello world!\";").tokens;
+        const auto tokens =
+          scan_tokens("print \"Hello world!\";", options).tokens;
 
         auto foundIt = tokens.begin();
         CHECK(foundIt->type == token::token_type::PRINT);
@@ -209,7 +235,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
         foundIt = std::next(foundIt);
         CHECK(foundIt->type == token::token_type::STRING);
         CHECK(foundIt->lexeme == "\"Hello world!\"");
-        CHECK(std::get<std::string_view>(foundIt->literal) == "Hello world!");
+        CHECK(std::get<lox::heap_string>(foundIt->literal) == "Hello world!");
 
         foundIt = std::next(foundIt);
         CHECK(foundIt->type == token::token_type::SEMICOLON);
@@ -218,7 +244,7 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
 
     GIVEN("A print statement with an identifier and semicolon.")
     {
-        const auto tokens = scan_tokens("print message;").tokens;
+        const auto tokens = scan_tokens("print message;", options).tokens;
 
         auto foundIt = tokens.begin();
         CHECK(foundIt->type == token::token_type::PRINT);
@@ -232,4 +258,207 @@ SCENARIO("Test all the token types.", "[lox++::scanner]")
         CHECK(foundIt->type == token::token_type::SEMICOLON);
         CHECK(foundIt->lexeme == ";");
     }
+
+    GIVEN("Tokens on multiple lines.")
+    {
+        const auto result =
+          scan_tokens("var a = 1;\n// comment\nprint a;", options);
+        REQUIRE(result.tokens.size() == 9);
+        REQUIRE(result.trivia.size() == 1);
+
+        const auto print = result.tokens[5];
+        CHECK(print.type == token::token_type::PRINT);
+        CHECK(print.line == 2);
+        CHECK(print.line_str == "print a;");
+        CHECK(print.column_start == 22);
+        CHECK(print.column_end == 27);
+
+        const auto comment = result.trivia[0];
+        CHECK(comment.line == 1);
+        CHECK(comment.line_str == "// comment");
+
+        CHECK(result.tokens.compact[3].literal !=
+              lox::compact_token::no_literal);
+        CHECK(result.tokens.compact[5].literal ==
+              lox::compact_token::no_literal);
+    }
+
+    GIVEN("A long source on a single line.")
+    {
+        std::string source{};
+        for (int i = 0; i < 100'000; ++i) {
+            source += "a = a + 1;";
+        }
+
+        const auto result = scan_tokens(source, options);
+        REQUIRE(result.tokens.size() == 600'001);
+        CHECK(result.tokens.info->line_starts.size() == 1);
+
+        const auto last = result.tokens[result.tokens.size() - 2];
+        CHECK(last.type == token::token_type::SEMICOLON);
+        CHECK(last.line == 0);
+        CHECK(last.column_start == source.size() - 1);
+        CHECK(last.line_str.size() == source.size());
+    }
+
+    GIVEN("A token stream.")
+    {
+        const std::string_view source{ "var a = 1;\n// comment\nprint a;" };
+        const auto expected = scan_tokens(source, options);
+        token_stream stream{ source };
+
+        THEN("It produces the same tokens as scan_tokens.")
+        {
+            CHECK_FALSE(stream.has_previous());
+            for (std::size_t i = 0; i < expected.tokens.size(); ++i) {
+                REQUIRE_FALSE(stream.at_end());
+                if (i + 1 < expected.tokens.size()) {
+                    CHECK(stream.peek(1).offset ==
+                          expected.tokens.compact[i + 1].offset);
+                }
+
+                CHECK(stream.peek().type == expected.tokens.compact[i].type);
+                CHECK(stream.peek().offset ==
+                      expected.tokens.compact[i].offset);
+                stream.advance();
+                CHECK(stream.previous().length ==
+                      expected.tokens.compact[i].length);
+            }
+
+            CHECK(stream.at_end());
+            CHECK(stream.trivia().size() == 1);
+            CHECK(stream.materialize(stream.previous()).type ==
+                  token::token_type::END_OF_FILE);
+        }
+
+        THEN("It can replay a token list.")
+        {
+            token_stream replay{ expected.tokens };
+            std::size_t count{ 0 };
+            while (!replay.at_end()) {
+                CHECK(replay.materialize(replay.peek()).lexeme ==
+                      expected.tokens[count].lexeme);
+                replay.advance();
+                count++;
+            }
+
+            CHECK(count == expected.tokens.size());
+        }
+    }
+
+    GIVEN("A token stream with an error.")
+    {
+        token_stream stream{ "print 1; # print 2;" };
+        std::size_t count{ 0 };
+        while (!stream.at_end()) {
+            stream.advance();
+            count++;
+        }
+
+        CHECK(count == 4);
+        REQUIRE(stream.errors().size() == 1);
+        CHECK(stream.errors().front().type ==
+              scan_result::error::error_type::UNKNOWN_TOKEN);
+    }
+
+    GIVEN("A source that is too large for 32-bit offsets.")
+    {
+        // Only the size is looked at, the text past the string is never read.
+        const std::string text{ "print 1;" };
+        const std::string_view source{ text.data(),
+            std::size_t{ std::numeric_limits<std::uint32_t>::max() } };
+        using error_type = scan_result::error::error_type;
+
+        THEN("The scan stops with an error.")
+        {
+            const auto result = scan_tokens(source, options);
+            CHECK(result.tokens.size() == 0);
+            REQUIRE(result.errors.size() == 1);
+            CHECK(result.errors.front().type == error_type::SOURCE_TOO_LARGE);
+            CHECK(result.errors.front().line == 0);
+        }
+
+        THEN("The token stream is empty.")
+        {
+            token_stream stream{ source };
+            CHECK(stream.at_end());
+            REQUIRE(stream.errors().size() == 1);
+            CHECK(stream.errors().front().type == error_type::SOURCE_TOO_LARGE);
+        }
+    }
+}
+
+namespace {
+void check_same(const scan_result& actual, const scan_result& expected)
+{
+    const auto check_tokens = [](const token_list& lhs, const token_list& rhs) {
+        REQUIRE(lhs.size() == rhs.size());
+        for (std::size_t i = 0; i < lhs.size(); ++i) {
+            CHECK(lhs.compact[i].type == rhs.compact[i].type);
+            CHECK(lhs.compact[i].offset == rhs.compact[i].offset);
+            CHECK(lhs.compact[i].length == rhs.compact[i].length);
+            CHECK(lhs.compact[i].literal == rhs.compact[i].literal);
+            CHECK(lhs[i].line == rhs[i].line);
+        }
+    };
+
+    check_tokens(actual.tokens, expected.tokens);
+    check_tokens(actual.trivia, expected.trivia);
+    CHECK(actual.tokens.info->literals == expected.tokens.info->literals);
+    REQUIRE(actual.errors.size() == expected.errors.size());
+    for (std::size_t i = 0; i < actual.errors.size(); ++i) {
+        CHECK(actual.errors[i].type == expected.errors[i].type);
+        CHECK(actual.errors[i].line == expected.errors[i].line);
+    }
+}
+}
+
+SCENARIO("Parallel scanning gives the same result.", "[lox++::scanner]")
+{
+    GIVEN("Strings and comments that span chunks.")
+    {
+        const std::string_view source = GENERATE(
+          std::string_view{ "print \"a\nvar b = 2;\n\" + \"x\";\n"
+                            "var c = \"\n\";\nprint c;\n" },
+          std::string_view{ "/* start\n\" not a string\nprint 1;\n*/ "
+                            "print \"after\";\nprint 2;\n" },
+          std::string_view{ "var s = \"/*\n\";\nprint s;\n// \"\nprint "
+                            "\"*/\";\n" },
+          std::string_view{ "print 1;\nprint 2;\nprint \"a\";\n# print 3;\n"
+                            "print 4;\n" },
+          std::string_view{ "print 1;\nvar a = \"never\nclosed;\nprint 2;\n" },
+          std::string_view{ "print 1;\n/* never\nclosed\nprint 2;\n" },
+          std::string_view{ "\n\n  \"\n\n\"\n\n" });
+
+        check_same(scan_tokens(source, s_parallel), scan_tokens(source));
+    }
+
+    GIVEN("A long generated source.")
+    {
+        constexpr std::string_view fragments[]{ "var a = 1;",
+            "print \"b\";",
+            "\"",
+            "/*",
+            "*/",
+            "// \"",
+            "a = a + 2.5;",
+            "\n",
+            "\n",
+            "\n",
+            "fun f(x) { return x * 3; }" };
+
+        const auto seed = GENERATE(1u, 2u, 3u, 4u, 5u);
+        std::string source{};
+        std::uint32_t state{ seed };
+        for (int i = 0; i < 20'000; ++i) {
+            state = state * 1'103'515'245 + 12'345;
+            source += fragments[(state >> 16) % std::size(fragments)];
+            source += ' ';
+        }
+
+        const scan_options options{ .is_parallel = true,
+            .min_chunk_size = 512,
+            .thread_count = 4 };
+        check_same(scan_tokens(source, options), scan_tokens(source));
+    }
 }
@@ -0,0 +1,132 @@
+#include "simd.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+const std::vector<lox::simd::level> s_levels{ lox::simd::level::SCALAR,
+    lox::simd::level::SSE2,
+    lox::simd::level::AVX2 };
+}
+
+SCENARIO("Test the vectorized character scanning", "[lox++::simd]")
+{
+    GIVEN("Every implementation level")
+    {
+        THEN("Whitespace runs of any length are skipped.")
+        {
+            for (const auto level : s_levels) {
+                lox::simd::set_level(level);
+                for (std::size_t length = 0; length < 70; ++length) {
+                    const std::string source{ "x" + std::string(length, ' ') +
+                                              "\t\r\n" };
+                    CHECK(lox::simd::skip_whitespace(source, 1) ==
+                          length + 4);
+                    CHECK(lox::simd::skip_whitespace(source + ";", 1) ==
+                          length + 4);
+                    CHECK(lox::simd::skip_whitespace(source, source.size()) ==
+                          source.size());
+                }
+            }
+        }
+
+        THEN("Identifiers of any length are skipped.")
+        {
+            for (const auto level : s_levels) {
+                lox::simd::set_level(level);
+                for (std::size_t length = 0; length < 70; ++length) {
+                    std::string source{};
+                    for (std::size_t i = 0; i < length; ++i) {
+                        source += "aZ_9"[i % 4];
+                    }
+
+                    CHECK(lox::simd::skip_identifier(source, 0) == length);
+                    for (const char ch : { ';', '@', '[', '`', '{', '/', ':',
+                           ' ', '\xe2' }) {
+                        CHECK(lox::simd::skip_identifier(source + ch, 0) ==
+                              length);
+                    }
+                }
+            }
+        }
+
+        THEN("The first of two characters is found.")
+        {
+            for (const auto level : s_levels) {
+                lox::simd::set_level(level);
+                for (std::size_t length = 0; length < 70; ++length) {
+                    const std::string source{ std::string(length, 'a') +
+                                              "\n\"" };
+                    CHECK(lox::simd::find_either(source, 0, '"', '\n') ==
+                          length);
+                    CHECK(lox::simd::find_either(source, 0, '"', '"') ==
+                          length + 1);
+                    CHECK(lox::simd::find_either(source, 0, '*', '*') ==
+                          source.size());
+                }
+            }
+        }
+
+        THEN("Characters are counted.")
+        {
+            for (const auto level : s_levels) {
+                lox::simd::set_level(level);
+                std::string source{};
+                for (std::size_t length = 0; length < 70; ++length) {
+                    CHECK(lox::simd::count(source, '\n') == length);
+                    source += length % 3 == 0 ? "\n" : "a\n";
+                }
+            }
+        }
+
+        lox::simd::set_level(lox::simd::supported_level());
+    }
+
+    GIVEN("A source with long tokens")
+    {
+        const std::string source{
+            "var a_very_long_identifier_that_spans_several_blocks = \"a "
+            "string that\nspans two lines and is longer than a block\";\n"
+            "/* A multi line comment * with a star\n in the middle. */"
+            "print              a_very_long_identifier_that_spans_several_blocks;"
+            "// A single line comment * with a star\n"
+            "print 1;"
+        };
+
+        lox::simd::set_level(lox::simd::level::SCALAR);
+        const auto expected = lox::scan_tokens(source);
+        REQUIRE(expected.tokens.size() == 12);
+        REQUIRE(expected.trivia.size() == 2);
+        CHECK(expected.tokens[5].line == 3);
+        CHECK(expected.tokens[6].lexeme ==
+              "a_very_long_identifier_that_spans_several_blocks");
+
+        THEN("All the levels produce the same tokens.")
+        {
+            for (const auto level : s_levels) {
+                lox::simd::set_level(level);
+                const auto result = lox::scan_tokens(source);
+                REQUIRE(result.tokens.size() == expected.tokens.size());
+                for (std::size_t i = 0; i < result.tokens.size(); ++i) {
+                    CHECK(result.tokens.compact[i].type ==
+                          expected.tokens.compact[i].type);
+                    CHECK(result.tokens.compact[i].offset ==
+                          expected.tokens.compact[i].offset);
+                    CHECK(result.tokens.compact[i].length ==
+                          expected.tokens.compact[i].length);
+                }
+
+                REQUIRE(result.trivia.size() == expected.trivia.size());
+                CHECK(result.trivia[1].lexeme ==
+                      " A single line comment * with a star");
+                CHECK(result.tokens.info->line_starts ==
+                      expected.tokens.info->line_starts);
+            }
+        }
+
+        lox::simd::set_level(lox::simd::supported_level());
+    }
+}
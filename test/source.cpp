@@ -0,0 +1,68 @@
+#include "source.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+[[nodiscard]] std::filesystem::path write_file(std::string_view name,
+  std::string_view content)
+{
+    const auto path = std::filesystem::temp_directory_path() / name;
+    std::ofstream writer{ path, std::ofstream::binary };
+    writer << content;
+    return path;
+}
+}
+
+SCENARIO("Test source loading", "[lox++::source]")
+{
+    GIVEN("A regular file")
+    {
+        const auto path = write_file("lox_source_test.lox", "print 1 + 2;\n");
+        auto source = lox::source_file::open(path.string());
+        REQUIRE(source.has_value());
+        CHECK(source->text() == "print 1 + 2;\n");
+#ifndef _WIN32
+        CHECK(source->type() == lox::source_file::storage::MAPPED);
+#endif
+
+        THEN("Moving the file keeps the text in place.")
+        {
+            const std::string_view text{ source->text() };
+            const lox::source_file moved{ std::move(source.value()) };
+            CHECK(moved.text().data() == text.data());
+            CHECK(lox::scan_tokens(moved.text()).tokens.size() == 6);
+        }
+
+        std::filesystem::remove(path);
+    }
+
+    GIVEN("An empty file")
+    {
+        const auto path = write_file("lox_source_test_empty.lox", "");
+        const auto source = lox::source_file::open(path.string());
+        REQUIRE(source.has_value());
+        CHECK(source->text().empty());
+        CHECK(source->type() == lox::source_file::storage::BUFFERED);
+        std::filesystem::remove(path);
+    }
+
+    GIVEN("A file that does not exist")
+    {
+        CHECK_FALSE(
+          lox::source_file::open("lox_source_test_missing.lox").has_value());
+    }
+
+    GIVEN("A stream")
+    {
+        std::istringstream stream{ "var a = 1;" };
+        const auto source = lox::source_file::read(stream);
+        CHECK(source.text() == "var a = 1;");
+        CHECK(source.type() == lox::source_file::storage::BUFFERED);
+    }
+}
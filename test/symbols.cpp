@@ -0,0 +1,145 @@
+#include "symbols.h"
+
+#include "environment.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+SCENARIO("Test the symbol table", "[lox++::symbols]")
+{
+    GIVEN("A new table")
+    {
+        lox::symbol_table table{};
+        CHECK(table.find("a") == lox::no_symbol);
+
+        THEN("Names get dense ids in the order they are interned.")
+        {
+            CHECK(table.intern("a") == 0);
+            CHECK(table.intern("bb") == 1);
+            CHECK(table.intern("a") == 0);
+            CHECK(table.find("bb") == 1);
+            CHECK(table.name(1) == "bb");
+            CHECK(table.size() == 2);
+        }
+
+        THEN("The names stay valid while the table grows.")
+        {
+            const std::string_view first{ table.name(table.intern("first")) };
+            for (int i = 0; i < 10'000; ++i) {
+                CHECK(table.intern("n" + std::to_string(i)) ==
+                      static_cast<lox::symbol_id>(i + 1));
+            }
+
+            CHECK(first == "first");
+            CHECK(table.find("n9999") == 10'000);
+            CHECK(table.find("n10000") == lox::no_symbol);
+        }
+    }
+
+    GIVEN("Threads that intern the same names")
+    {
+        lox::symbol_table table{};
+        std::vector<std::vector<lox::symbol_id>> ids(4);
+        std::vector<std::thread> threads{};
+        for (std::size_t t = 0; t < ids.size(); ++t) {
+            threads.emplace_back([&table, &ids, t]() {
+                for (int i = 0; i < 2'000; ++i) {
+                    ids[t].push_back(table.intern("v" + std::to_string(i)));
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        THEN("They all get the same ids.")
+        {
+            CHECK(table.size() == 2'000);
+            for (const auto& thread_ids : ids) {
+                CHECK(thread_ids == ids.front());
+            }
+        }
+    }
+
+    GIVEN("Identifiers that are scanned")
+    {
+        const auto first = lox::scan_tokens("var symbol_a = symbol_b;").tokens;
+        const auto second = lox::scan_tokens("symbol_b = 1;").tokens;
+
+        THEN("The tokens carry the symbols of their lexemes.")
+        {
+            CHECK(first[0].symbol == lox::no_symbol);
+            CHECK(first[1].symbol == lox::symbols().find("symbol_a"));
+            CHECK(first[1].literal == lox::object{});
+            CHECK(first[3].symbol != lox::no_symbol);
+            CHECK(first[3].symbol == second[0].symbol);
+            CHECK(lox::symbols().name(second[0].symbol) == "symbol_b");
+        }
+    }
+}
+
+SCENARIO("Test the environment", "[lox++::symbols]")
+{
+    GIVEN("Statements that are run one at a time like in the REPL")
+    {
+        lox::environment env{};
+        const auto run = [&env](std::string_view source) {
+            std::optional<lox::object> last{};
+            for (auto& statement :
+              lox::parse(lox::scan_tokens(source).tokens)) {
+                lox::resolve(statement, env);
+                lox::interpret(statement, env)
+                  .and_then([&last](lox::object value) { last = value; })
+                  .or_else([](auto) { CHECK(false); });
+            }
+
+            REQUIRE(last.has_value());
+            return last.value();
+        };
+
+        run("var repl_a = 1;");
+        const lox::slot_index slot{ lox::env::find(env, "repl_a") };
+        REQUIRE(slot != lox::unresolved_slot);
+
+        THEN("Redefinitions and assignments reuse the slot.")
+        {
+            run("var repl_a = 2;");
+            run("repl_a = repl_a + 1;");
+            CHECK(std::get<double>(run("repl_a;")) == 3);
+            CHECK(lox::env::find(env, "repl_a") == slot);
+            CHECK(env.values.size() == 1);
+        }
+    }
+
+    GIVEN("Thousands of variables")
+    {
+        lox::environment env{};
+        std::vector<lox::slot_index> slots{};
+        for (int i = 0; i < 5'000; ++i) {
+            slots.push_back(
+              lox::env::declare(env, "env_" + std::to_string(i)));
+        }
+
+        THEN("Every symbol keeps its own slot.")
+        {
+            for (int i = 0; i < 5'000; ++i) {
+                CHECK(slots[i] == static_cast<lox::slot_index>(i));
+                CHECK(lox::env::find(env, "env_" + std::to_string(i)) ==
+                      slots[i]);
+            }
+
+            CHECK(lox::env::find(env, "env_5000") == lox::unresolved_slot);
+            CHECK(lox::env::find(env, "never_interned_name") ==
+                  lox::unresolved_slot);
+        }
+    }
+}
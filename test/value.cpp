@@ -0,0 +1,64 @@
+#include "value.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <limits>
+#include <string>
+
+SCENARIO("Test NaN-boxed values", "[lox++::value]")
+{
+    GIVEN("Numbers")
+    {
+        for (const double number :
+          { 0.0, -0.0, 1.5, -2.25, 1e300, std::numeric_limits<double>::max() }) {
+            const lox::value val{ number };
+            CHECK(val.is_number());
+            CHECK(val.type() == lox::value::kind::NUMBER);
+            CHECK(val.as_number() == number);
+        }
+
+        const lox::value nan{ std::numeric_limits<double>::quiet_NaN() };
+        CHECK(nan.is_number());
+        CHECK(!(nan == nan));
+    }
+
+    GIVEN("Singletons")
+    {
+        CHECK(lox::value{}.type() == lox::value::kind::EMPTY);
+        CHECK(lox::value{ nullptr }.type() == lox::value::kind::NIL);
+        CHECK(lox::value{ true }.type() == lox::value::kind::BOOLEAN);
+        CHECK(lox::value{ true }.as_bool());
+        CHECK(lox::value{ false }.type() == lox::value::kind::BOOLEAN);
+        CHECK(!lox::value{ false }.as_bool());
+        CHECK(!lox::value{ nullptr }.is_bool());
+        CHECK(!lox::value{}.is_number());
+    }
+
+    GIVEN("Strings in a heap")
+    {
+        lox::heap hp{};
+        const lox::heap_string hello{ "Hello" };
+        const lox::value str = hp.make_string(hello);
+        CHECK(str.type() == lox::value::kind::STRING);
+        CHECK(str.as_string() == "Hello");
+        // The heap shares the characters of the string.
+        CHECK(hello.use_count() == 2);
+
+        CHECK(str == hp.make_string(lox::heap_string{ "Hello" }));
+        CHECK(!(str == hp.make_string(lox::heap_string{ "World" })));
+        CHECK(!(str == lox::value{ 1.0 }));
+    }
+
+    GIVEN("Round trips through lox::object")
+    {
+        lox::heap hp{};
+        for (const lox::object& obj : { lox::object{},
+               lox::object{ nullptr },
+               lox::object{ true },
+               lox::object{ 42.0 },
+               lox::object{ lox::heap_string{ "string" } },
+               lox::object{ lox::heap_string{} } }) {
+            CHECK(lox::to_object(lox::to_value(obj, hp)) == obj);
+        }
+    }
+}